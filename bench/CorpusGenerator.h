@@ -0,0 +1,150 @@
+#ifndef CORPUSGENERATOR_H
+#define CORPUSGENERATOR_H
+
+#include <cstdint>
+#include <format>
+#include <string>
+#include <string_view>
+
+// Every axis of the generated program can be scaled on its own.
+struct CorpusShape {
+    int functions = 32;
+    // statements in every function body
+    int function_length = 16;
+    int expression_depth = 4;
+    // cases in the switch statement at the end of every function
+    int switch_cases = 8;
+    int nesting_depth = 2;
+    // elements of the static table next to every function
+    int static_initializer_size = 16;
+    // bytes of string literal data next to every function
+    int string_volume = 64;
+};
+
+// Produces deterministic, self contained C source (no headers, no preprocessor) in the subset CuteC accepts.
+class CorpusGenerator {
+public:
+    explicit CorpusGenerator(const CorpusShape &shape) : shape(shape) {
+    }
+
+    std::string generate() {
+        out.clear();
+        state = 1;
+        for (int i = 0; i < shape.functions; i++) {
+            function(i);
+        }
+        out += std::format("int main(void) {{\n    return (int) f{}(1, 2l);\n}}\n", shape.functions - 1);
+        return out;
+    }
+
+private:
+    void function(int index) {
+        out += std::format("static long table{}[{}] = {{", index, shape.static_initializer_size);
+        for (int i = 0; i < shape.static_initializer_size; i++) {
+            out += std::format("{}{}", i ? ", " : "", next() % 1000);
+        }
+        out += "};\n";
+        out += std::format("static char text{}[{}] = \"", index, shape.string_volume + 1);
+        for (int i = 0; i < shape.string_volume; i++) {
+            out += static_cast<char>('a' + next() % 26);
+        }
+        out += "\";\n";
+
+        out += std::format("long f{}(int a, long b) {{\n", index);
+        out += "    long acc = b;\n";
+        out += "    int i = a;\n";
+        for (int i = 0; i < shape.function_length; i++) {
+            switch (i % 4) {
+                case 0:
+                    out += "    acc = ";
+                    expression(shape.expression_depth);
+                    out += ";\n";
+                    break;
+                case 1:
+                    nested(index, shape.nesting_depth, 1);
+                    break;
+                case 2:
+                    out += std::format("    acc = acc + table{}[{}] + text{}[{}];\n", index,
+                                       i % shape.static_initializer_size, index, i % (shape.string_volume + 1));
+                    break;
+                case 3:
+                    // a single call per function keeps the runtime of the generated program linear
+                    if (index > 0 && i == 3) {
+                        out += std::format("    acc = acc + f{}(i + {}, acc);\n", index - 1, i);
+                    } else {
+                        out += std::format("    i = i * {} + 1;\n", i);
+                    }
+                    break;
+            }
+        }
+        out += "    switch (i) {\n";
+        for (int i = 0; i < shape.switch_cases; i++) {
+            out += std::format("        case {}:\n            acc = acc + {};\n            break;\n", i, next() % 100);
+        }
+        out += "        default:\n            acc = acc - 1;\n    }\n";
+        out += "    return acc;\n}\n";
+    }
+
+    // alternating if and for statements with an assignment at the innermost level
+    void nested(int index, int depth, int level) {
+        std::string indent(level * 4, ' ');
+        if (depth == 0) {
+            out += indent + "acc = ";
+            expression(shape.expression_depth);
+            out += ";\n";
+            return;
+        }
+        if (depth % 2) {
+            out += std::format("{}if (acc > {}) {{\n", indent, next() % 100);
+        } else {
+            out += std::format("{}for (int j{} = 0; j{} < {}; j{} = j{} + 1) {{\n", indent, level, level,
+                               next() % 8 + 1, level, level);
+        }
+        nested(index, depth - 1, level + 1);
+        out += indent + "}\n";
+    }
+
+    // the tree is kept degenerate (one operand is always a leaf) so the size grows linearly with the depth
+    void expression(int depth) {
+        if (depth == 0) {
+            leaf();
+            return;
+        }
+        static constexpr std::string_view operators[] = {" + ", " - ", " * ", " & ", " | ", " ^ ", " < ", " == "};
+        auto op = operators[next() % std::size(operators)];
+        out += '(';
+        if (next() % 2) {
+            expression(depth - 1);
+            out += op;
+            leaf();
+        } else {
+            leaf();
+            out += op;
+            expression(depth - 1);
+        }
+        out += ')';
+    }
+
+    void leaf() {
+        static constexpr std::string_view variables[] = {"a", "b", "acc", "i"};
+        if (next() % 3 == 0) {
+            out += std::to_string(next() % 1000);
+        } else {
+            out += variables[next() % std::size(variables)];
+        }
+    }
+
+    // xorshift, the corpus has to be identical across runs and platforms
+    std::uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    CorpusShape shape;
+    std::string out;
+    std::uint32_t state = 1;
+};
+
+#endif //CORPUSGENERATOR_H
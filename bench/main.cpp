@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "CorpusGenerator.h"
+#include "../source/Compiler.h"
+#include "../source/common/OutputBuffer.h"
+#include "../source/common/StageTimings.h"
+
+// Compiles synthetic programs that grow along one axis at a time and reports throughput per stage.
+// Every measurement is a single line of key=value pairs so results can be diffed or fed to a regression tracker.
+// A stage whose time grows faster than the source size (log-log slope above the threshold) is reported as superlinear,
+// in which case the exit status is 1.
+
+struct Axis {
+    std::string_view name;
+    int CorpusShape::*field;
+};
+
+static constexpr Axis axes[] = {
+    {"functions", &CorpusShape::functions},
+    {"function_length", &CorpusShape::function_length},
+    {"expression_depth", &CorpusShape::expression_depth},
+    {"switch_cases", &CorpusShape::switch_cases},
+    {"nesting_depth", &CorpusShape::nesting_depth},
+    {"static_initializer_size", &CorpusShape::static_initializer_size},
+    {"string_volume", &CorpusShape::string_volume},
+};
+
+struct Measurement {
+    std::size_t source_bytes = 0;
+    std::size_t asm_bytes = 0;
+    StageTimings timings;
+};
+
+// best of `repetitions` runs, judged by the total time
+static std::optional<Measurement> measure(const std::string &source, int repetitions, int level) {
+    std::optional<Measurement> best;
+    for (int i = 0; i < repetitions; i++) {
+        Compiler compiler;
+        compiler.optimization = optimization::OptimizationOptions::for_level(level);
+        Measurement measurement;
+        compiler.timings = &measurement.timings;
+        OutputBuffer output;
+        if (!compiler.compile(source, output)) {
+            return {};
+        }
+        measurement.source_bytes = source.size();
+        measurement.asm_bytes = output.size();
+        if (!best || measurement.timings.total() < best->timings.total()) {
+            best = std::move(measurement);
+        }
+    }
+    return best;
+}
+
+// least squares slope of log(time) over log(input size)
+static double scaling_exponent(const std::vector<std::pair<double, double> > &points) {
+    double n = points.size(), sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (auto [size, time]: points) {
+        double x = std::log(size), y = std::log(time);
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+    }
+    double denominator = n * sxx - sx * sx;
+    return denominator == 0 ? 0 : (n * sxy - sx * sy) / denominator;
+}
+
+int main(int argc, char *argv[]) {
+    int repetitions = 3;
+    int steps = 4;
+    // -O level the corpora are compiled at
+    int level = 0;
+    double threshold = 1.5;
+    // stages faster than this at the largest size are too noisy to judge
+    double min_time_ms = 5;
+    std::string only_axis;
+    std::string dump_axis;
+    CorpusShape base;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&] { return i + 1 < argc ? std::string(argv[++i]) : std::string(); };
+        if (arg == "--reps") {
+            repetitions = std::max(1, std::stoi(value()));
+        } else if (arg == "--steps") {
+            steps = std::max(2, std::stoi(value()));
+        } else if (arg == "--level") {
+            level = std::clamp(std::stoi(value()), 0, 3);
+        } else if (arg == "--threshold") {
+            threshold = std::stod(value());
+        } else if (arg == "--axis") {
+            only_axis = value();
+        } else if (arg == "--dump") {
+            // prints the largest corpus of the given axis, handy for feeding the real driver
+            dump_axis = value();
+        } else {
+            std::cerr << "Usage: " << argv[0] <<
+                    " [--reps N] [--steps N] [--level N] [--threshold SLOPE] [--axis NAME] [--dump NAME]" << std::endl;
+            return 2;
+        }
+    }
+
+    if (!dump_axis.empty()) {
+        for (const auto &axis: axes) {
+            if (axis.name == dump_axis) {
+                auto shape = base;
+                shape.*axis.field <<= steps - 1;
+                std::cout << CorpusGenerator(shape).generate();
+                return 0;
+            }
+        }
+        std::cerr << "Unknown axis " << dump_axis << std::endl;
+        return 2;
+    }
+
+    bool superlinear = false;
+    for (const auto &axis: axes) {
+        if (!only_axis.empty() && axis.name != only_axis) continue;
+
+        std::vector<Measurement> measurements;
+        for (int step = 0; step < steps; step++) {
+            auto shape = base;
+            shape.*axis.field <<= step;
+            auto source = CorpusGenerator(shape).generate();
+
+            auto measurement = measure(source, repetitions, level);
+            if (!measurement) {
+                std::cerr << std::format("axis={} step={} failed to compile\n", axis.name, step);
+                return 2;
+            }
+
+            const auto &timings = measurement->timings;
+            double seconds = to_milliseconds(timings.total()) / 1000;
+            std::string line = std::format("bench axis={} value={} source_bytes={} lines={} tokens={} asm_bytes={} "
+                                           "total_ms={:.3f} tokens_per_s={:.0f} lines_per_s={:.0f}", axis.name,
+                                           shape.*axis.field, measurement->source_bytes, timings.lines,
+                                           timings.tokens, measurement->asm_bytes, seconds * 1000,
+                                           timings.tokens / seconds, timings.lines / seconds);
+            for (const auto &stage: timings.stages) {
+                line += std::format(" {}_ms={:.3f}", stage.name, to_milliseconds(stage.time));
+            }
+            std::cout << line << '\n';
+            measurements.push_back(std::move(*measurement));
+        }
+
+        // the total and every stage that takes measurable time get their own verdict
+        auto judge = [&](std::string_view name, auto &&time_of) {
+            std::vector<std::pair<double, double> > points;
+            for (const auto &measurement: measurements) {
+                points.emplace_back(measurement.source_bytes, std::max(time_of(measurement), 1e-6));
+            }
+            if (points.back().second < min_time_ms) return;
+            double exponent = scaling_exponent(points);
+            bool is_superlinear = exponent > threshold;
+            superlinear |= is_superlinear;
+            std::cout << std::format("scaling axis={} stage={} exponent={:.2f} status={}\n", axis.name, name,
+                                     exponent, is_superlinear ? "SUPERLINEAR" : "ok");
+        };
+        judge("total", [](const Measurement &m) { return to_milliseconds(m.timings.total()); });
+        for (const auto &stage: measurements.front().timings.stages) {
+            judge(stage.name, [&](const Measurement &m) {
+                auto it = std::ranges::find(m.timings.stages, stage.name, &StageTimings::Stage::name);
+                return it == m.timings.stages.end() ? 0.0 : to_milliseconds(it->time);
+            });
+        }
+        std::cout.flush();
+    }
+
+    return superlinear ? 1 : 0;
+}
@@ -0,0 +1,75 @@
+// Output helpers shared by the kernels, <stdio.h> is outside the subset CuteC accepts.
+int putchar(int c);
+
+static void print_ulong(unsigned long value) {
+    char digits[24];
+    int count = 0;
+    if (value == 0) {
+        putchar('0');
+        return;
+    }
+    while (value > 0) {
+        digits[count++] = '0' + (char) (value % 10);
+        value = value / 10;
+    }
+    while (count > 0) {
+        putchar(digits[--count]);
+    }
+}
+
+static void print_long(long value) {
+    if (value < 0) {
+        putchar('-');
+        print_ulong((unsigned long) 0 - (unsigned long) value);
+        return;
+    }
+    print_ulong((unsigned long) value);
+}
+
+static void print_string(char *text) {
+    while (*text) {
+        putchar(*text++);
+    }
+}
+
+// fixed six decimal places, truncated
+static void print_double(double value) {
+    if (value < 0) {
+        putchar('-');
+        value = -value;
+    }
+    unsigned long integer = (unsigned long) value;
+    print_ulong(integer);
+    putchar('.');
+    double fraction = value - (double) integer;
+    for (int i = 0; i < 6; i++) {
+        fraction = fraction * 10;
+        int digit = (int) fraction;
+        putchar('0' + digit);
+        fraction = fraction - digit;
+    }
+}
+
+static void report_long(char *name, long value) {
+    print_string(name);
+    print_string(": ");
+    print_long(value);
+    putchar('\n');
+}
+
+static void report_double(char *name, double value) {
+    print_string(name);
+    print_string(": ");
+    print_double(value);
+    putchar('\n');
+}
+
+// deterministic pseudo random numbers, identical for every compiler
+static unsigned long random_state = 88172645463325252ul;
+
+static unsigned long next_random(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return random_state;
+}
@@ -0,0 +1,54 @@
+#include "common.h"
+
+static unsigned int table[256];
+static unsigned char buffer[1048576];
+
+static void make_table(void) {
+    for (unsigned int i = 0; i < 256; i++) {
+        unsigned int crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            if (crc & 1) {
+                crc = (crc >> 1) ^ 3988292384u;
+            } else {
+                crc = crc >> 1;
+            }
+        }
+        table[i] = crc;
+    }
+}
+
+static unsigned int crc32(unsigned char *data, long length, unsigned int crc) {
+    crc = ~crc;
+    for (long i = 0; i < length; i++) {
+        crc = table[(crc ^ data[i]) & 255] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// bit at a time variant, exercises shifts and branches instead of loads
+static unsigned int crc32_bitwise(unsigned char *data, long length) {
+    unsigned int crc = 4294967295u;
+    for (long i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            unsigned int mask = -(crc & 1);
+            crc = (crc >> 1) ^ (3988292384u & mask);
+        }
+    }
+    return ~crc;
+}
+
+int main(void) {
+    long length = 1048576;
+    for (long i = 0; i < length; i++) {
+        buffer[i] = (unsigned char) next_random();
+    }
+    make_table();
+    unsigned int crc = 0;
+    for (int round = 0; round < 24; round++) {
+        crc = crc32(buffer, length, crc);
+    }
+    report_long("crc32", crc);
+    report_long("crc32_bitwise", crc32_bitwise(buffer, length / 4));
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include "common.h"
+
+static double x[200000];
+static double y[200000];
+static double z[200000];
+
+static void saxpy(double a, double *from, double *to, int n) {
+    for (int i = 0; i < n; i++) {
+        to[i] = a * from[i] + to[i];
+    }
+}
+
+static double dot(double *left, double *right, int n) {
+    double sum = 0.0;
+    for (int i = 0; i < n; i++) {
+        sum += left[i] * right[i];
+    }
+    return sum;
+}
+
+static void prefix_sum(double *from, double *to, int n) {
+    double running = 0.0;
+    for (int i = 0; i < n; i++) {
+        running += from[i];
+        to[i] = running;
+    }
+}
+
+static double horner(double *coefficients, int degree, double at) {
+    double result = coefficients[degree];
+    for (int i = degree - 1; i >= 0; i--) {
+        result = result * at + coefficients[i];
+    }
+    return result;
+}
+
+static void smooth(double *from, double *to, int n) {
+    to[0] = from[0];
+    to[n - 1] = from[n - 1];
+    for (int i = 1; i < n - 1; i++) {
+        to[i] = 0.25 * from[i - 1] + 0.5 * from[i] + 0.25 * from[i + 1];
+    }
+}
+
+int main(void) {
+    int n = 200000;
+    for (int i = 0; i < n; i++) {
+        x[i] = (double) (next_random() % 10000) / 1000.0;
+        y[i] = (double) (next_random() % 10000) / 5000.0 - 1.0;
+    }
+    for (int round = 0; round < 60; round++) {
+        saxpy(0.001 * round, x, y, n);
+        smooth(y, z, n);
+        smooth(z, y, n);
+    }
+    report_double("dot", dot(x, y, n));
+    prefix_sum(y, z, n);
+    report_double("prefix", z[n - 1]);
+    double polynomial = 0.0;
+    for (int i = 0; i < 2000; i++) {
+        polynomial += horner(x, 63, (double) i / 2000.0);
+    }
+    report_double("horner", polynomial);
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include "common.h"
+
+static double a[160][160];
+static double b[160][160];
+static double c[160][160];
+
+static void multiply(int n) {
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            double sum = 0.0;
+            for (int k = 0; k < n; k++) {
+                sum += a[i][k] * b[k][j];
+            }
+            c[i][j] = sum;
+        }
+    }
+}
+
+int main(void) {
+    int n = 160;
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            a[i][j] = (double) ((i * 7 + j * 3) % 17) / 8.0;
+            b[i][j] = (double) ((i * 5 + j * 11) % 13) / 4.0 - 1.5;
+        }
+    }
+    for (int round = 0; round < 10; round++) {
+        multiply(n);
+        a[round][round] = c[n - 1 - round][round];
+    }
+    double trace = 0.0;
+    double total = 0.0;
+    for (int i = 0; i < n; i++) {
+        trace += c[i][i];
+        for (int j = 0; j < n; j++) {
+            total += c[i][j];
+        }
+    }
+    report_double("trace", trace);
+    report_double("total", total);
+    return 0;
+}
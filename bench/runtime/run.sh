@@ -0,0 +1,99 @@
+#!/usr/bin/env bash
+# Runtime benchmark of the code CuteC generates.
+# Every kernel is built with CuteC, gcc -O0 and gcc -O2, the outputs have to match,
+# and the best of REPS wall clock runs is compared.
+#
+# usage: run.sh <path to CuteC> [--reps N] [--kernel NAME]... [-- extra CuteC flags]
+# exit status is 1 if a kernel fails to build or its output differs from gcc
+
+set -u
+
+if [ $# -lt 1 ]; then
+    echo "usage: $0 <path to CuteC> [--reps N] [--kernel NAME]... [-- extra CuteC flags]" >&2
+    exit 2
+fi
+
+cutec=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+shift
+reps=3
+kernels=()
+cutec_flags=()
+while [ $# -gt 0 ]; do
+    case "$1" in
+        --reps) reps=$2; shift 2 ;;
+        --kernel) kernels+=("$2"); shift 2 ;;
+        --) shift; cutec_flags=("$@"); break ;;
+        *) echo "unknown argument $1" >&2; exit 2 ;;
+    esac
+done
+
+source_dir=$(cd "$(dirname "$0")" && pwd)
+if [ ${#kernels[@]} -eq 0 ]; then
+    for file in "$source_dir"/*.c; do
+        kernels+=("$(basename "$file" .c)")
+    done
+fi
+
+# CuteC writes its output next to the input, so everything is built in a scratch directory
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cp "$source_dir"/*.c "$source_dir"/common.h "$work"
+
+# prints the best wall clock time in seconds of running $1 $reps times, stdout goes to $2
+best_time() {
+    local best=""
+    for ((i = 0; i < reps; i++)); do
+        local start end elapsed
+        start=$(date +%s%N)
+        "$1" > "$2"
+        end=$(date +%s%N)
+        elapsed=$((end - start))
+        if [ -z "$best" ] || [ "$elapsed" -lt "$best" ]; then
+            best=$elapsed
+        fi
+    done
+    awk -v ns="$best" 'BEGIN { printf "%.4f", ns / 1e9 }'
+}
+
+failed=0
+log_o0=0
+log_o2=0
+measured=0
+printf "%-14s %10s %10s %10s %9s %9s  %s\n" kernel gcc-O0 gcc-O2 cutec "vs O0" "vs O2" status
+for kernel in "${kernels[@]}"; do
+    (
+        cd "$work" &&
+        gcc -w -O0 "$kernel.c" -o "$kernel.O0" &&
+        gcc -w -O2 "$kernel.c" -o "$kernel.O2" &&
+        "$cutec" ${cutec_flags[@]+"${cutec_flags[@]}"} "$kernel.c" > "$kernel.log" 2>&1
+    )
+    if [ ! -x "$work/$kernel" ] || [ ! -x "$work/$kernel.O0" ] || [ ! -x "$work/$kernel.O2" ]; then
+        printf "%-14s %10s %10s %10s %9s %9s  %s\n" "$kernel" - - - - - "BUILD FAILED"
+        failed=1
+        continue
+    fi
+
+    o0=$(best_time "$work/$kernel.O0" "$work/$kernel.O0.out")
+    o2=$(best_time "$work/$kernel.O2" "$work/$kernel.O2.out")
+    cute=$(best_time "$work/$kernel" "$work/$kernel.out")
+
+    status=ok
+    if ! cmp -s "$work/$kernel.O0.out" "$work/$kernel.out" || ! cmp -s "$work/$kernel.O2.out" "$work/$kernel.out"; then
+        status=MISMATCH
+        failed=1
+    fi
+    ratio_o0=$(awk -v a="$cute" -v b="$o0" 'BEGIN { printf "%.2f", a / b }')
+    ratio_o2=$(awk -v a="$cute" -v b="$o2" 'BEGIN { printf "%.2f", a / b }')
+    printf "%-14s %10s %10s %10s %8sx %8sx  %s\n" "$kernel" "$o0" "$o2" "$cute" "$ratio_o0" "$ratio_o2" "$status"
+
+    log_o0=$(awk -v s="$log_o0" -v r="$ratio_o0" 'BEGIN { print s + log(r) }')
+    log_o2=$(awk -v s="$log_o2" -v r="$ratio_o2" 'BEGIN { print s + log(r) }')
+    measured=$((measured + 1))
+done
+
+if [ "$measured" -gt 0 ]; then
+    awk -v a="$log_o0" -v b="$log_o2" -v n="$measured" \
+        'BEGIN { printf "%-14s %10s %10s %10s %8.2fx %8.2fx\n", "geomean", "", "", "", exp(a / n), exp(b / n) }'
+fi
+
+exit $failed
@@ -0,0 +1,29 @@
+#include "common.h"
+
+static char composite[8000001];
+
+static long sieve(long limit) {
+    for (long i = 0; i <= limit; i++) {
+        composite[i] = 0;
+    }
+    long count = 0;
+    for (long i = 2; i <= limit; i++) {
+        if (!composite[i]) {
+            count++;
+            for (long j = i * i; j <= limit; j += i) {
+                composite[j] = 1;
+            }
+        }
+    }
+    return count;
+}
+
+int main(void) {
+    report_long("primes", sieve(8000000));
+    long twins = 0;
+    for (long i = 3; i + 2 <= 8000000; i += 2) {
+        if (!composite[i] && !composite[i + 2]) twins++;
+    }
+    report_long("twin_primes", twins);
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include "common.h"
+
+static long values[300000];
+static long scratch[300000];
+
+static void insertion_sort(long *data, int low, int high) {
+    for (int i = low + 1; i <= high; i++) {
+        long value = data[i];
+        int j = i - 1;
+        while (j >= low && data[j] > value) {
+            data[j + 1] = data[j];
+            j--;
+        }
+        data[j + 1] = value;
+    }
+}
+
+static void quick_sort(long *data, int low, int high) {
+    while (high - low > 16) {
+        long pivot = data[low + (high - low) / 2];
+        int i = low;
+        int j = high;
+        while (i <= j) {
+            while (data[i] < pivot) i++;
+            while (data[j] > pivot) j--;
+            if (i <= j) {
+                long tmp = data[i];
+                data[i] = data[j];
+                data[j] = tmp;
+                i++;
+                j--;
+            }
+        }
+        // recurse into the smaller half, loop on the larger one
+        if (j - low < high - i) {
+            quick_sort(data, low, j);
+            low = i;
+        } else {
+            quick_sort(data, i, high);
+            high = j;
+        }
+    }
+    insertion_sort(data, low, high);
+}
+
+static void merge_sort(long *data, long *buffer, int low, int high) {
+    if (high - low < 1) return;
+    int middle = low + (high - low) / 2;
+    merge_sort(data, buffer, low, middle);
+    merge_sort(data, buffer, middle + 1, high);
+    int i = low;
+    int j = middle + 1;
+    int k = low;
+    while (i <= middle && j <= high) {
+        if (data[i] <= data[j]) {
+            buffer[k++] = data[i++];
+        } else {
+            buffer[k++] = data[j++];
+        }
+    }
+    while (i <= middle) buffer[k++] = data[i++];
+    while (j <= high) buffer[k++] = data[j++];
+    for (k = low; k <= high; k++) {
+        data[k] = buffer[k];
+    }
+}
+
+static long checksum(long *data, int n) {
+    long sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum = sum * 31 + data[i];
+        if (i > 0 && data[i - 1] > data[i]) return -1;
+    }
+    return sum;
+}
+
+int main(void) {
+    int n = 300000;
+    for (int i = 0; i < n; i++) {
+        values[i] = (long) (next_random() % 1000000000ul) - 500000000l;
+        scratch[i] = values[i];
+    }
+    quick_sort(values, 0, n - 1);
+    report_long("quick_sort", checksum(values, n));
+    for (int i = 0; i < n; i++) {
+        values[i] = (long) (next_random() % 1000ul);
+    }
+    merge_sort(values, scratch, 0, n - 1);
+    report_long("merge_sort", checksum(values, n));
+    return 0;
+}
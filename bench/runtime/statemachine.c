@@ -0,0 +1,150 @@
+#include "common.h"
+
+// A tiny bytecode interpreter and a tokenizer, both are one big switch in a loop.
+
+static int program[64];
+static long stack[256];
+static char input[1000001];
+
+static long interpret(long argument) {
+    int pc = 0;
+    int sp = 0;
+    long accumulator = argument;
+    long counter = 0;
+    while (1) {
+        switch (program[pc++]) {
+            case 0:
+                return accumulator;
+            case 1:
+                stack[sp++] = accumulator;
+                break;
+            case 2:
+                accumulator -= stack[--sp] / 2;
+                break;
+            case 3:
+                accumulator += program[pc++];
+                break;
+            case 4:
+                accumulator *= program[pc++];
+                break;
+            case 5:
+                accumulator = accumulator % 1000003;
+                break;
+            case 6:
+                accumulator ^= accumulator >> 3;
+                break;
+            case 7:
+                counter = program[pc++];
+                break;
+            case 8:
+                // decrement and jump back while not zero
+                if (--counter > 0) {
+                    pc = program[pc];
+                } else {
+                    pc++;
+                }
+                break;
+            case 9:
+                accumulator += stack[sp - 1];
+                break;
+            default:
+                return -1;
+        }
+    }
+}
+
+static long tokenize(char *s, long *counts) {
+    int state = 0;
+    long tokens = 0;
+    for (; *s; s++) {
+        char c = *s;
+        int kind = c >= '0' && c <= '9' ? 1 : (c >= 'a' && c <= 'z' ? 2 : (c == ' ' ? 0 : 3));
+        switch (state) {
+            case 0:
+                switch (kind) {
+                    case 1:
+                        state = 1;
+                        break;
+                    case 2:
+                        state = 2;
+                        break;
+                    case 3:
+                        counts[3]++;
+                        tokens++;
+                        break;
+                    default:
+                        break;
+                }
+                break;
+            case 1:
+                if (kind != 1) {
+                    counts[1]++;
+                    tokens++;
+                    state = kind == 2 ? 2 : 0;
+                    if (kind == 3) {
+                        counts[3]++;
+                        tokens++;
+                    }
+                }
+                break;
+            case 2:
+                if (kind != 2 && kind != 1) {
+                    counts[2]++;
+                    tokens++;
+                    state = 0;
+                    if (kind == 3) {
+                        counts[3]++;
+                        tokens++;
+                    }
+                }
+                break;
+            default:
+                return -1;
+        }
+    }
+    return tokens;
+}
+
+int main(void) {
+    int code[24];
+    code[0] = 7;
+    code[1] = 200;
+    code[2] = 1;
+    code[3] = 4;
+    code[4] = 31;
+    code[5] = 3;
+    code[6] = 7;
+    code[7] = 6;
+    code[8] = 9;
+    code[9] = 2;
+    code[10] = 5;
+    code[11] = 8;
+    code[12] = 2;
+    code[13] = 0;
+    for (int i = 0; i < 14; i++) {
+        program[i] = code[i];
+    }
+    long total = 0;
+    for (long i = 0; i < 6000; i++) {
+        total += interpret(i);
+    }
+    report_long("interpreter", total);
+
+    for (long i = 0; i < 1000000; i++) {
+        unsigned long r = next_random() % 8;
+        input[i] = r < 3 ? 'a' + (char) (next_random() % 26) : r < 5 ? '0' + (char) (next_random() % 10) : r < 7 ? ' ' : '+';
+    }
+    long counts[4];
+    for (int i = 0; i < 4; i++) {
+        counts[i] = 0;
+    }
+    long tokens = 0;
+    for (int round = 0; round < 8; round++) {
+        tokens += tokenize(input, counts);
+    }
+    report_long("tokens", tokens);
+    report_long("numbers", counts[1]);
+    report_long("words", counts[2]);
+    report_long("symbols", counts[3]);
+    return 0;
+}
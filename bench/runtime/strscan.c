@@ -0,0 +1,82 @@
+#include "common.h"
+
+static char text[2000001];
+
+static long length_of(char *s) {
+    char *p = s;
+    while (*p) p++;
+    return p - s;
+}
+
+static long count_words(char *s) {
+    long words = 0;
+    int in_word = 0;
+    for (; *s; s++) {
+        int letter = (*s >= 'a' && *s <= 'z') || (*s >= 'A' && *s <= 'Z');
+        if (letter && !in_word) words++;
+        in_word = letter;
+    }
+    return words;
+}
+
+// naive search, the needle is short so this is dominated by the first character compare
+static long count_occurrences(char *haystack, char *needle) {
+    long count = 0;
+    for (char *p = haystack; *p; p++) {
+        char *h = p;
+        char *n = needle;
+        while (*n && *h == *n) {
+            h++;
+            n++;
+        }
+        if (!*n) count++;
+    }
+    return count;
+}
+
+static unsigned long hash_lines(char *s) {
+    unsigned long hash = 5381;
+    unsigned long total = 0;
+    for (; *s; s++) {
+        if (*s == '\n') {
+            total = total * 33 + hash;
+            hash = 5381;
+        } else {
+            hash = hash * 33 + (unsigned char) *s;
+        }
+    }
+    return total + hash;
+}
+
+int main(void) {
+    char *words[8];
+    words[0] = "the";
+    words[1] = "quick";
+    words[2] = "brown";
+    words[3] = "fox";
+    words[4] = "jumps";
+    words[5] = "over";
+    words[6] = "lazy";
+    words[7] = "dog";
+    long position = 0;
+    long limit = 2000000 - 16;
+    while (position < limit) {
+        char *word = words[next_random() % 8];
+        while (*word) {
+            text[position++] = *word++;
+        }
+        unsigned long separator = next_random() % 16;
+        text[position++] = separator == 0 ? '\n' : separator == 1 ? ',' : ' ';
+    }
+    text[position] = 0;
+    long total = 0;
+    for (int round = 0; round < 16; round++) {
+        total += length_of(text);
+    }
+    report_long("length", total);
+    report_long("words", count_words(text));
+    report_long("fox", count_occurrences(text, "fox"));
+    report_long("lazy dog", count_occurrences(text, "lazy dog"));
+    report_long("line_hash", (long) hash_lines(text));
+    return 0;
+}
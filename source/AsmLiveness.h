@@ -0,0 +1,603 @@
+#ifndef ASMLIVENESS_H
+#define ASMLIVENESS_H
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "AsmTree.h"
+#include "overloaded.h"
+#include "optimization/BitSet.h"
+
+// liveness of hardware registers and pseudos on the asm tree of one function, shared by the register allocators
+
+namespace codegen {
+    enum class RegisterClass {
+        GENERAL,
+        XMM,
+    };
+
+    inline RegisterClass register_class(ASM::Reg::Name name) {
+        return name >= ASM::Reg::Name::XMM0 ? RegisterClass::XMM : RegisterClass::GENERAL;
+    }
+
+    // registers a call may overwrite, r10, r11, xmm14 and xmm15 are left out because only the fix up pass uses them
+    inline constexpr std::array caller_saved_registers = {
+        ASM::Reg::Name::AX, ASM::Reg::Name::CX, ASM::Reg::Name::DX, ASM::Reg::Name::DI, ASM::Reg::Name::SI,
+        ASM::Reg::Name::R8, ASM::Reg::Name::R9, ASM::Reg::Name::XMM0, ASM::Reg::Name::XMM1, ASM::Reg::Name::XMM2,
+        ASM::Reg::Name::XMM3, ASM::Reg::Name::XMM4, ASM::Reg::Name::XMM5, ASM::Reg::Name::XMM6, ASM::Reg::Name::XMM7,
+        ASM::Reg::Name::XMM8, ASM::Reg::Name::XMM9, ASM::Reg::Name::XMM10, ASM::Reg::Name::XMM11,
+        ASM::Reg::Name::XMM12, ASM::Reg::Name::XMM13
+    };
+
+    // registers a function has to give back unchanged, the prologue saves the ones it writes
+    inline constexpr std::array callee_saved_registers = {
+        ASM::Reg::Name::BX, ASM::Reg::Name::R12, ASM::Reg::Name::R13, ASM::Reg::Name::R14, ASM::Reg::Name::R15
+    };
+
+    // what the allocators may hand out, in the order they try them: caller saved first since they cost nothing
+    // until a call, values live across a call can only get a callee saved one
+    inline constexpr std::array allocatable_registers = {
+        ASM::Reg::Name::AX, ASM::Reg::Name::CX, ASM::Reg::Name::DX, ASM::Reg::Name::DI, ASM::Reg::Name::SI,
+        ASM::Reg::Name::R8, ASM::Reg::Name::R9, ASM::Reg::Name::BX, ASM::Reg::Name::R12, ASM::Reg::Name::R13,
+        ASM::Reg::Name::R14, ASM::Reg::Name::R15, ASM::Reg::Name::XMM0, ASM::Reg::Name::XMM1, ASM::Reg::Name::XMM2,
+        ASM::Reg::Name::XMM3, ASM::Reg::Name::XMM4, ASM::Reg::Name::XMM5, ASM::Reg::Name::XMM6, ASM::Reg::Name::XMM7,
+        ASM::Reg::Name::XMM8, ASM::Reg::Name::XMM9, ASM::Reg::Name::XMM10, ASM::Reg::Name::XMM11,
+        ASM::Reg::Name::XMM12, ASM::Reg::Name::XMM13
+    };
+
+    // calls use with every register or pseudo the instruction reads and def with every one it writes, registers
+    // used for addressing memory are reads, implicit operands (division, calls) are included
+    template<typename Use, typename Def>
+    void for_each_register(const ASM::Instruction &instruction, Use &&use, Def &&def) {
+        auto reg = [](ASM::Reg::Name name) { return ASM::Operand(ASM::Reg(name)); };
+        auto address = [&](const ASM::Operand &operand) {
+            if (auto *memory = std::get_if<ASM::Memory>(&operand)) {
+                use(ASM::Operand(memory->reg));
+            } else if (auto *indexed = std::get_if<ASM::Indexed>(&operand)) {
+                use(ASM::Operand(indexed->base));
+                use(ASM::Operand(indexed->index));
+            }
+        };
+        auto read = [&](const ASM::Operand &operand) {
+            if (std::holds_alternative<ASM::Reg>(operand) || std::holds_alternative<ASM::Pseudo>(operand)) {
+                use(operand);
+            } else {
+                address(operand);
+            }
+        };
+        auto write = [&](const ASM::Operand &operand) {
+            if (std::holds_alternative<ASM::Reg>(operand) || std::holds_alternative<ASM::Pseudo>(operand)) {
+                def(operand);
+            } else {
+                address(operand);
+            }
+        };
+        std::visit(overloaded{
+                       [&](const ASM::Mov &ins) {
+                           read(ins.src);
+                           write(ins.dst);
+                       },
+                       [&](const ASM::Movsx &ins) {
+                           read(ins.source);
+                           write(ins.destination);
+                       },
+                       [&](const ASM::MovZeroExtend &ins) {
+                           read(ins.source);
+                           write(ins.destination);
+                       },
+                       [&](const ASM::Cvtsi2sd &ins) {
+                           read(ins.source);
+                           write(ins.destination);
+                       },
+                       [&](const ASM::Cvttsd2si &ins) {
+                           read(ins.source);
+                           write(ins.destination);
+                       },
+                       [&](const ASM::PackedBinary &ins) {
+                           read(ins.left);
+                           read(ins.right);
+                           write(ins.right);
+                       },
+                       [&](const ASM::PackedShuffle &ins) {
+                           read(ins.source);
+                           write(ins.destination);
+                       },
+                       [&](const ASM::MovToVector &ins) {
+                           read(ins.source);
+                           write(ins.destination);
+                       },
+                       [&](const ASM::MovFromVector &ins) {
+                           read(ins.source);
+                           write(ins.destination);
+                       },
+                       [&](const ASM::Lea &ins) {
+                           // the address of a pseudo is not a read of it
+                           address(ins.source);
+                           write(ins.destination);
+                       },
+                       [&](const ASM::Unary &ins) {
+                           read(ins.operand);
+                           write(ins.operand);
+                       },
+                       [&](const ASM::Binary &ins) {
+                           // xor of a register with itself only writes it
+                           bool zeroing = ins.op == ASM::Binary::Operator::XOR && std::holds_alternative<ASM::Reg>(
+                                              ins.left) && std::holds_alternative<ASM::Reg>(ins.right) &&
+                                          std::get<ASM::Reg>(ins.left).name == std::get<ASM::Reg>(ins.right).name;
+                           if (!zeroing) {
+                               read(ins.left);
+                               read(ins.right);
+                           }
+                           write(ins.right);
+                       },
+                       [&](const ASM::Cmp &ins) {
+                           read(ins.left);
+                           read(ins.right);
+                       },
+                       [&](const ASM::Test &ins) {
+                           read(ins.left);
+                           read(ins.right);
+                       },
+                       [&](const ASM::JumpTable &ins) {
+                           read(ins.index);
+                       },
+                       [&](const ASM::SetCC &ins) {
+                           // only the low byte is written, the rest of the destination is kept
+                           read(ins.destination);
+                           write(ins.destination);
+                       },
+                       [&](const ASM::Push &ins) {
+                           read(ins.value);
+                       },
+                       [&](const ASM::Idiv &ins) {
+                           read(ins.divisor);
+                           use(reg(ASM::Reg::Name::AX));
+                           use(reg(ASM::Reg::Name::DX));
+                           def(reg(ASM::Reg::Name::AX));
+                           def(reg(ASM::Reg::Name::DX));
+                       },
+                       [&](const ASM::Div &ins) {
+                           read(ins.divisor);
+                           use(reg(ASM::Reg::Name::AX));
+                           use(reg(ASM::Reg::Name::DX));
+                           def(reg(ASM::Reg::Name::AX));
+                           def(reg(ASM::Reg::Name::DX));
+                       },
+                       [&](const ASM::Mul &ins) {
+                           read(ins.factor);
+                           use(reg(ASM::Reg::Name::AX));
+                           def(reg(ASM::Reg::Name::AX));
+                           def(reg(ASM::Reg::Name::DX));
+                       },
+                       [&](const ASM::Cdq &) {
+                           use(reg(ASM::Reg::Name::AX));
+                           def(reg(ASM::Reg::Name::DX));
+                       },
+                       [&](const ASM::Call &ins) {
+                           for (auto argument: ins.arguments) {
+                               use(reg(argument));
+                           }
+                           for (auto clobbered: caller_saved_registers) {
+                               def(reg(clobbered));
+                           }
+                       },
+                       [&](const ASM::Ret &ins) {
+                           if (ins.value) {
+                               use(reg(*ins.value));
+                           }
+                       },
+                       [&](const ASM::TailCall &ins) {
+                           for (auto argument: ins.arguments) {
+                               use(reg(argument));
+                           }
+                       },
+                       [](const auto &) {
+                       }
+                   }, instruction);
+    }
+
+    // calls f with every operand of the instruction that may name a pseudo
+    template<typename F>
+    void for_each_operand(ASM::Instruction &instruction, F &&f) {
+        std::visit(overloaded{
+                       [&](ASM::Mov &ins) {
+                           f(ins.src);
+                           f(ins.dst);
+                       },
+                       [&](ASM::Movsx &ins) {
+                           f(ins.source);
+                           f(ins.destination);
+                       },
+                       [&](ASM::MovZeroExtend &ins) {
+                           f(ins.source);
+                           f(ins.destination);
+                       },
+                       [&](ASM::Cvtsi2sd &ins) {
+                           f(ins.source);
+                           f(ins.destination);
+                       },
+                       [&](ASM::Cvttsd2si &ins) {
+                           f(ins.source);
+                           f(ins.destination);
+                       },
+                       [&](ASM::PackedBinary &ins) {
+                           f(ins.left);
+                           f(ins.right);
+                       },
+                       [&](ASM::PackedShuffle &ins) {
+                           f(ins.source);
+                           f(ins.destination);
+                       },
+                       [&](ASM::MovToVector &ins) {
+                           f(ins.source);
+                           f(ins.destination);
+                       },
+                       [&](ASM::MovFromVector &ins) {
+                           f(ins.source);
+                           f(ins.destination);
+                       },
+                       [&](ASM::Lea &ins) {
+                           f(ins.source);
+                           f(ins.destination);
+                       },
+                       [&](ASM::Unary &ins) {
+                           f(ins.operand);
+                       },
+                       [&](ASM::Binary &ins) {
+                           f(ins.left);
+                           f(ins.right);
+                       },
+                       [&](ASM::Cmp &ins) {
+                           f(ins.left);
+                           f(ins.right);
+                       },
+                       [&](ASM::Test &ins) {
+                           f(ins.left);
+                           f(ins.right);
+                       },
+                       [&](ASM::JumpTable &ins) {
+                           f(ins.index);
+                       },
+                       [&](ASM::SetCC &ins) {
+                           f(ins.destination);
+                       },
+                       [&](ASM::Push &ins) {
+                           f(ins.value);
+                       },
+                       [&](ASM::Idiv &ins) {
+                           f(ins.divisor);
+                       },
+                       [&](ASM::Div &ins) {
+                           f(ins.divisor);
+                       },
+                       [&](ASM::Mul &ins) {
+                           f(ins.factor);
+                       },
+                       [](auto &) {
+                       }
+                   }, instruction);
+    }
+
+    // mov of a register or pseudo to itself
+    inline bool is_self_move(const ASM::Instruction &instruction) {
+        auto *mov = std::get_if<ASM::Mov>(&instruction);
+        if (!mov) return false;
+        if (auto *source = std::get_if<ASM::Reg>(&mov->src)) {
+            auto *destination = std::get_if<ASM::Reg>(&mov->dst);
+            return destination && destination->name == source->name;
+        }
+        if (auto *source = std::get_if<ASM::Pseudo>(&mov->src)) {
+            auto *destination = std::get_if<ASM::Pseudo>(&mov->dst);
+            return destination && destination->name == source->name;
+        }
+        return false;
+    }
+
+    // gives every pseudo in replacements its register (or the pseudo it was merged into), drops the moves that
+    // became moves to themselves and records the callee saved registers the function now writes
+    inline void replace_pseudos(ASM::Function &function,
+                                const std::unordered_map<std::string, ASM::Operand> &replacements) {
+        for (auto &instruction: function.instructions) {
+            for_each_operand(instruction, [&](ASM::Operand &operand) {
+                if (auto *pseudo = std::get_if<ASM::Pseudo>(&operand)) {
+                    auto it = replacements.find(pseudo->name);
+                    if (it != replacements.end()) operand = it->second;
+                }
+            });
+        }
+        std::erase_if(function.instructions, is_self_move);
+
+        function.callee_saved.clear();
+        std::array<bool, static_cast<int>(ASM::Reg::Name::XMM15) + 1> written{};
+        for (const auto &instruction: function.instructions) {
+            for_each_register(instruction, [](const ASM::Operand &) {
+            }, [&](const ASM::Operand &operand) {
+                if (auto *reg = std::get_if<ASM::Reg>(&operand)) written[static_cast<int>(reg->name)] = true;
+            });
+        }
+        for (auto name: callee_saved_registers) {
+            if (written[static_cast<int>(name)]) function.callee_saved.push_back(name);
+        }
+    }
+
+    // 10^loop depth for every instruction, a loop is a jump back to an earlier label
+    inline std::vector<double> loop_weights(const std::vector<ASM::Instruction> &instructions) {
+        std::unordered_map<std::string, std::size_t> labels;
+        for (std::size_t i = 0; i < instructions.size(); i++) {
+            if (auto *label = std::get_if<ASM::Label>(&instructions[i])) {
+                labels[label->name] = i;
+            }
+        }
+        std::vector<int> depth_change(instructions.size() + 1, 0);
+        for (std::size_t i = 0; i < instructions.size(); i++) {
+            const std::string *target = nullptr;
+            if (auto *jump = std::get_if<ASM::Jmp>(&instructions[i])) {
+                target = &jump->target;
+            } else if (auto *jump_cc = std::get_if<ASM::JmpCC>(&instructions[i])) {
+                target = &jump_cc->target;
+            }
+            if (!target) continue;
+            auto it = labels.find(*target);
+            if (it == labels.end() || it->second > i) continue;
+            depth_change[it->second]++;
+            depth_change[i + 1]--;
+        }
+        std::vector<double> weights(instructions.size());
+        int depth = 0;
+        for (std::size_t i = 0; i < instructions.size(); i++) {
+            depth += depth_change[i];
+            weights[i] = std::pow(10.0, std::min(depth, 6));
+        }
+        return weights;
+    }
+
+    // what the allocators track: every register they may hand out and every pseudo that may live in one
+    class RegisterNodes {
+    public:
+        struct Node {
+            RegisterClass register_class;
+            // hardware registers come first
+            bool hard;
+            ASM::Reg::Name reg;
+            std::string pseudo;
+            ASM::Type type;
+        };
+
+        RegisterNodes(const ASM::Function &function, const std::unordered_map<std::string, ASM::Symbol> &symbols,
+                      std::span<const ASM::Reg::Name> registers) {
+            reg_to_node.fill(-1);
+            for (auto name: registers) {
+                reg_to_node[static_cast<int>(name)] = static_cast<int>(nodes.size());
+                nodes.push_back(Node{register_class(name), true, name, {}, ASM::QuadWord()});
+            }
+            hard_count = static_cast<int>(nodes.size());
+
+            // pseudos whose address is taken have to stay in memory
+            std::unordered_set<std::string> address_taken;
+            for (const auto &instruction: function.instructions) {
+                if (auto *lea = std::get_if<ASM::Lea>(&instruction)) {
+                    if (auto *pseudo = std::get_if<ASM::Pseudo>(&lea->source)) {
+                        address_taken.insert(pseudo->name);
+                    }
+                }
+            }
+            auto add = [&](const ASM::Operand &operand) {
+                auto *pseudo = std::get_if<ASM::Pseudo>(&operand);
+                if (!pseudo || pseudo_to_node.contains(pseudo->name) || address_taken.contains(pseudo->name)) return;
+                auto symbol = symbols.find(pseudo->name);
+                if (symbol == symbols.end()) return;
+                const auto &object = std::get<ASM::ObjectSymbol>(symbol->second);
+                if (object.is_static || std::holds_alternative<ASM::ByteArray>(object.type)) return;
+                pseudo_to_node[pseudo->name] = static_cast<int>(nodes.size());
+                nodes.push_back(Node{
+                    std::holds_alternative<ASM::Double>(object.type) || std::holds_alternative<ASM::Vector>(object.type)
+                        ? RegisterClass::XMM
+                        : RegisterClass::GENERAL,
+                    false, ASM::Reg::Name::AX, pseudo->name, object.type
+                });
+            };
+            for (const auto &instruction: function.instructions) {
+                for_each_register(instruction, add, add);
+            }
+        }
+
+        // -1 for operands that are not tracked
+        int of(const ASM::Operand &operand) const {
+            if (auto *reg = std::get_if<ASM::Reg>(&operand)) {
+                return reg_to_node[static_cast<int>(reg->name)];
+            }
+            if (auto *pseudo = std::get_if<ASM::Pseudo>(&operand)) {
+                auto it = pseudo_to_node.find(pseudo->name);
+                return it == pseudo_to_node.end() ? -1 : it->second;
+            }
+            return -1;
+        }
+
+        int of(ASM::Reg::Name name) const {
+            return reg_to_node[static_cast<int>(name)];
+        }
+
+        int size() const {
+            return static_cast<int>(nodes.size());
+        }
+
+        std::vector<Node> nodes;
+        int hard_count = 0;
+
+    private:
+        std::array<int, static_cast<int>(ASM::Reg::Name::XMM15) + 1> reg_to_node{};
+        std::unordered_map<std::string, int> pseudo_to_node;
+    };
+
+    // backward dataflow over the blocks of the instruction list, a block starts at a label or after a jump or return
+    class AsmLiveness {
+    public:
+        AsmLiveness(const std::vector<ASM::Instruction> &instructions, const RegisterNodes &nodes)
+            : instructions(instructions) {
+            collect_accesses(nodes);
+            split();
+            solve(nodes.size());
+        }
+
+        std::span<const int> uses(std::size_t instruction) const {
+            return {accesses.data() + use_begin[instruction], accesses.data() + def_begin[instruction]};
+        }
+
+        std::span<const int> defs(std::size_t instruction) const {
+            return {accesses.data() + def_begin[instruction], accesses.data() + use_begin[instruction + 1]};
+        }
+
+        // calls f(index, live) for every instruction from the last to the first, live holds the nodes live right
+        // after the instruction
+        template<typename F>
+        void walk(F &&f) const {
+            for (std::size_t b = blocks.size(); b-- > 0;) {
+                auto live = live_out[b];
+                for (auto i = blocks[b].last; i-- > blocks[b].first;) {
+                    f(i, static_cast<const optimization::BitSet &>(live));
+                    for (int def: defs(i)) live.reset(def);
+                    for (int use: uses(i)) live.set(use);
+                }
+            }
+        }
+
+        struct Block {
+            // [first, last) instruction indices
+            std::size_t first;
+            std::size_t last;
+            std::vector<int> successors;
+        };
+
+        std::vector<Block> blocks;
+        std::vector<optimization::BitSet> live_in;
+        std::vector<optimization::BitSet> live_out;
+
+    private:
+        void collect_accesses(const RegisterNodes &nodes) {
+            use_begin.reserve(instructions.size() + 1);
+            def_begin.reserve(instructions.size());
+            std::vector<int> defs;
+            for (const auto &instruction: instructions) {
+                use_begin.push_back(accesses.size());
+                defs.clear();
+                for_each_register(instruction, [&](const ASM::Operand &operand) {
+                                      if (int node = nodes.of(operand); node != -1) accesses.push_back(node);
+                                  }, [&](const ASM::Operand &operand) {
+                                      if (int node = nodes.of(operand); node != -1) defs.push_back(node);
+                                  });
+                def_begin.push_back(accesses.size());
+                accesses.insert(accesses.end(), defs.begin(), defs.end());
+            }
+            use_begin.push_back(accesses.size());
+        }
+
+        void split() {
+            std::unordered_map<std::string, int> label_to_block;
+            for (std::size_t i = 0; i < instructions.size(); i++) {
+                bool label = std::holds_alternative<ASM::Label>(instructions[i]);
+                if (blocks.empty() || (label && blocks.back().first != i)) {
+                    if (!blocks.empty()) blocks.back().last = i;
+                    blocks.push_back(Block{i, i, {}});
+                }
+                if (label) {
+                    label_to_block[std::get<ASM::Label>(instructions[i]).name] = static_cast<int>(blocks.size()) - 1;
+                }
+                if (ends_block(instructions[i]) && i + 1 < instructions.size() &&
+                    !std::holds_alternative<ASM::Label>(instructions[i + 1])) {
+                    blocks.back().last = i + 1;
+                    blocks.push_back(Block{i + 1, i + 1, {}});
+                }
+            }
+            if (!blocks.empty()) blocks.back().last = instructions.size();
+
+            for (int b = 0; b < static_cast<int>(blocks.size()); b++) {
+                auto &block = blocks[b];
+                bool falls_through = true;
+                if (block.last > block.first) {
+                    std::visit(overloaded{
+                                   [&](const ASM::Jmp &ins) {
+                                       block.successors.push_back(label_to_block.at(ins.target));
+                                       falls_through = false;
+                                   },
+                                   [&](const ASM::JmpCC &ins) {
+                                       block.successors.push_back(label_to_block.at(ins.target));
+                                   },
+                                   [&](const ASM::JumpTable &ins) {
+                                       for (const auto &target: ins.targets) {
+                                           int successor = label_to_block.at(target);
+                                           if (std::ranges::find(block.successors, successor) == block.successors.end()) {
+                                               block.successors.push_back(successor);
+                                           }
+                                       }
+                                       falls_through = false;
+                                   },
+                                   [&](const ASM::Ret &) {
+                                       falls_through = false;
+                                   },
+                                   [&](const ASM::TailCall &) {
+                                       falls_through = false;
+                                   },
+                                   [](const auto &) {
+                                   }
+                               }, instructions[block.last - 1]);
+                }
+                if (falls_through && b + 1 < static_cast<int>(blocks.size())) {
+                    block.successors.push_back(b + 1);
+                }
+            }
+        }
+
+        static bool ends_block(const ASM::Instruction &instruction) {
+            return std::holds_alternative<ASM::Jmp>(instruction) || std::holds_alternative<ASM::JmpCC>(instruction) ||
+                   std::holds_alternative<ASM::JumpTable>(instruction) || std::holds_alternative<ASM::Ret>(instruction) ||
+                   std::holds_alternative<ASM::TailCall>(instruction);
+        }
+
+        void solve(std::size_t size) {
+            std::vector<optimization::BitSet> gen(blocks.size(), optimization::BitSet(size));
+            std::vector<optimization::BitSet> kill(blocks.size(), optimization::BitSet(size));
+            for (std::size_t b = 0; b < blocks.size(); b++) {
+                for (auto i = blocks[b].first; i < blocks[b].last; i++) {
+                    for (int use: uses(i)) {
+                        if (!kill[b].test(use)) gen[b].set(use);
+                    }
+                    for (int def: defs(i)) kill[b].set(def);
+                }
+            }
+
+            live_in.assign(blocks.size(), optimization::BitSet(size));
+            live_out.assign(blocks.size(), optimization::BitSet(size));
+            // blocks mostly flow forward, so going backward converges in few rounds
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                for (std::size_t b = blocks.size(); b-- > 0;) {
+                    auto &out = live_out[b];
+                    for (int successor: blocks[b].successors) {
+                        out |= live_in[successor];
+                    }
+                    auto in = out;
+                    in.subtract(kill[b]);
+                    in |= gen[b];
+                    if (!(in == live_in[b])) {
+                        live_in[b] = std::move(in);
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        const std::vector<ASM::Instruction> &instructions;
+        // uses then defs of every instruction, as node indices
+        std::vector<int> accesses;
+        std::vector<std::size_t> use_begin;
+        std::vector<std::size_t> def_begin;
+    };
+}
+
+#endif //ASMLIVENESS_H
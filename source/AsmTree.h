@@ -1,5 +1,7 @@
 #ifndef ASMTREE_H
 #define ASMTREE_H
+#include <cstdint>
+#include <optional>
 #include <string>
 #include <vector>
 #include <variant>
@@ -11,11 +13,13 @@ namespace ASM {
     struct LongWord {};
     struct QuadWord {};
     struct Double {};
+    // 16 bytes in an xmm register, moved with movdqu
+    struct Vector {};
     struct ByteArray {
         int size;
         int alignment;
     };
-    using Type = std::variant<Byte, LongWord, QuadWord, Double, ByteArray>;
+    using Type = std::variant<Byte, LongWord, QuadWord, Double, Vector, ByteArray>;
 
     struct ObjectSymbol {
         Type type;
@@ -48,35 +52,8 @@ namespace ASM {
     using Operand = std::variant<struct Imm, struct Reg, struct Pseudo, struct Memory, struct Data, struct Indexed, struct PseudoMem>;
     using Instruction = std::variant<struct Mov, struct Ret, struct Unary, struct Binary, struct
         Idiv, struct Div, struct Cdq, struct Cmp, struct Jmp, struct JmpCC, struct SetCC, struct Label,
-        struct Push, struct Call, struct Movsx, struct MovZeroExtend, struct Cvttsd2si, struct Cvtsi2sd, struct Lea>;
-
-    struct Function {
-        std::string name;
-        bool global;
-        std::vector<Instruction> instructions;
-        int stack_size = 0;
-    };
-
-    struct StaticVariable {
-        std::string name;
-        bool global;
-        int alignment;
-        Initial initial_value;
-    };
-
-    struct StaticConstant {
-        std::string name;
-        int alignment;
-        Initial initial_value;
-    };
-
-    struct Program {
-        std::vector<std::variant<Function, StaticVariable, StaticConstant>> items;
-    };
-
-    struct Imm {
-        std::uint64_t value;
-    };
+        struct Push, struct Call, struct Movsx, struct MovZeroExtend, struct Cvttsd2si, struct Cvtsi2sd, struct Lea, struct Test, struct JumpTable, struct Mul, struct TailCall, struct PackedBinary,
+        struct PackedShuffle, struct MovToVector, struct MovFromVector>;
 
     struct Reg {
         enum class Name {
@@ -91,6 +68,12 @@ namespace ASM {
             R11,
             SP,
             BP,
+            // callee saved
+            BX,
+            R12,
+            R13,
+            R14,
+            R15,
             XMM0,
             XMM1,
             XMM2,
@@ -99,6 +82,12 @@ namespace ASM {
             XMM5,
             XMM6,
             XMM7,
+            XMM8,
+            XMM9,
+            XMM10,
+            XMM11,
+            XMM12,
+            XMM13,
             XMM14,
             XMM15
         };
@@ -106,6 +95,36 @@ namespace ASM {
         Name name;
     };
 
+    struct Function {
+        std::string name;
+        bool global;
+        std::vector<Instruction> instructions;
+        int stack_size = 0;
+        // pushed right below the saved frame pointer by the prologue and restored before every return
+        std::vector<Reg::Name> callee_saved = {};
+    };
+
+    struct StaticVariable {
+        std::string name;
+        bool global;
+        int alignment;
+        Initial initial_value;
+    };
+
+    struct StaticConstant {
+        std::string name;
+        int alignment;
+        Initial initial_value;
+    };
+
+    struct Program {
+        std::vector<std::variant<Function, StaticVariable, StaticConstant>> items;
+    };
+
+    struct Imm {
+        std::uint64_t value;
+    };
+
     struct Pseudo {
         std::string name;
     };
@@ -137,13 +156,17 @@ namespace ASM {
     };
 
     struct Ret {
+        // register holding the return value, read by the return
+        std::optional<Reg::Name> value;
     };
 
     struct Unary {
         enum class Operator {
             Neg,
             Not,
-            Shr
+            Shr,
+            Inc,
+            Dec
         };
         Operator op;
         Type type;
@@ -180,6 +203,13 @@ namespace ASM {
         Operand divisor;
     };
 
+    // full product of ax and factor into dx:ax, only used for division by constants
+    struct Mul {
+        Type type;
+        Operand factor;
+        bool is_signed;
+    };
+
     struct Cdq {
         Type type;
     };
@@ -190,6 +220,13 @@ namespace ASM {
         Operand right;
     };
 
+    // and without storing the result, only introduced by the peephole pass
+    struct Test {
+        Type type;
+        Operand left;
+        Operand right;
+    };
+
     struct Jmp {
         std::string target;
     };
@@ -199,6 +236,14 @@ namespace ASM {
         std::string target;
     };
 
+    // jumps to targets[index] through the table of label offsets named table, the index was checked to be in range
+    struct JumpTable {
+        std::string table;
+        Type type;
+        Operand index;
+        std::vector<std::string> targets;
+    };
+
     struct SetCC {
         ConditionCode cond_code;
         Operand destination;
@@ -214,6 +259,14 @@ namespace ASM {
 
     struct Call {
         std::string name;
+        // registers holding the arguments, read by the call
+        std::vector<Reg::Name> arguments;
+    };
+
+    // leaves the frame like a return and jumps to the function, whatever it returns goes straight to our caller
+    struct TailCall {
+        std::string name;
+        std::vector<Reg::Name> arguments;
     };
 
     struct Movsx {
@@ -246,6 +299,36 @@ namespace ASM {
         Operand source;
         Operand destination;
     };
+
+    // lane by lane on vectors, lane_type is Byte, LongWord, QuadWord or Double, right is the destination like in
+    // Binary, SSE2 has no multiplication of integer lanes and divides doubles only
+    struct PackedBinary {
+        Binary::Operator op;
+        Type lane_type;
+        Operand left;
+        Operand right;
+    };
+
+    // pshufd, lane i of destination is the 32 bit lane (control >> 2 * i) & 3 of source
+    struct PackedShuffle {
+        std::uint8_t control;
+        Operand source;
+        Operand destination;
+    };
+
+    // movd or movq of an integer into the lowest lane of a vector, the other lanes are cleared
+    struct MovToVector {
+        Type type;
+        Operand source;
+        Operand destination;
+    };
+
+    // movd or movq of the lowest lane of a vector
+    struct MovFromVector {
+        Type type;
+        Operand source;
+        Operand destination;
+    };
 }
 
 #endif //ASMTREE_H
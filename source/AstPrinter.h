@@ -1,25 +1,36 @@
 #ifndef ASTPRINTER_H
 #define ASTPRINTER_H
 #include <format>
-#include <iostream>
+#include <string>
 
 #include "Ast.h"
 #include "overloaded.h"
+#include "common/OutputBuffer.h"
 
 using namespace AST;
 
 class AstPrinter {
 public:
+    explicit AstPrinter(OutputBuffer *output) : out(*output) {
+    }
+
     void program(const Program &program) {
         println("Program(");
         with_indent([this, &program] {
             for (const auto &decl: program.declarations) {
-                visit_decl(*decl);
+                if (function_filter.empty() || (std::holds_alternative<FunctionDecl>(*decl) &&
+                                                std::get<FunctionDecl>(*decl).name == function_filter)) {
+                    visit_decl(*decl);
+                }
             }
         });
         println(")");
+        out.flush();
     }
 
+    // only the top level function with this name is printed when set
+    std::string function_filter;
+
     void function(const FunctionDecl &function) {
         println("FunctionDecl(");
         with_indent([this, &function] {
@@ -591,16 +602,17 @@ private:
 
     void print(const std::string &str) {
         for (int i = 0; i < m_depth; i++) {
-            std::cout << "  ";
+            out.write("  ");
         }
-        std::cout << str;
+        out.write(str);
     }
 
     void println(const std::string &str) {
         print(str);
-        print("\n");
+        out.put('\n');
     }
 
+    OutputBuffer &out;
     int m_depth = 0;
 };
 
@@ -1,26 +1,34 @@
 #ifndef CODEEMITTER_H
 #define CODEEMITTER_H
-#include <format>
+#include <array>
 #include <cstring> // for memcpy
+#include <span>
+#include <string>
+#include <string_view>
 
 #include "AsmTree.h"
 #include "Codegen.h"
 #include "overloaded.h"
 #include "analysis/TypeCheckerPass.h"
+#include "common/OutputBuffer.h"
 
 // asm tree -> asm file
 
 
 class CodeEmitter {
 public:
-    CodeEmitter(ASM::Program program,
-                std::unordered_map<std::string, ASM::Symbol> *symbols) : asmProgram(std::move(program)), symbols(symbols) {
+    CodeEmitter(const ASM::Program *program,
+                std::unordered_map<std::string, ASM::Symbol> *symbols, OutputBuffer *output) : asmProgram(program),
+        symbols(symbols), out(*output) {
     }
 
     void emit() {
-        emit_program(asmProgram);
+        emit_program(*asmProgram);
     }
 
+    // used for dumps, only the function with this name is emitted when set
+    std::string function_filter;
+
 
 
 
@@ -28,45 +36,49 @@ public:
         for (const auto &item: program.items) {
             std::visit(overloaded {
                 [this](const ASM::Function& item) {
-                    emit_function(item);
+                    if (function_filter.empty() || item.name == function_filter) {
+                        emit_function(item);
+                    }
                 },
                 [this](const ASM::StaticVariable& item) {
-                    emit_static_variable(item);
+                    if (function_filter.empty()) {
+                        emit_static_variable(item);
+                    }
                 },
                 [this](const ASM::StaticConstant& item) {
-                    emit_static_constant(item);
+                    if (function_filter.empty()) {
+                        emit_static_constant(item);
+                    }
                 }
             }, item);
         }
+        if (!function_filter.empty()) {
+            return;
+        }
 #if __linux__
         // disable executable stack
-        assembly += ".section .note.GNU-stack,\"\",@progbits\n";
+        out.write(".section .note.GNU-stack,\"\",@progbits\n");
 #endif
     }
 
     void emit_function(const ASM::Function &function) {
-        assembly += "    .text\n";
-        // functions names on apple must be prefixed by an underscore
+        out.write("    .text\n");
         if (function.global) {
-#if __APPLE__
-            assembly += "    .globl _" + function.name + "\n";
-#else
-            assembly += "    .globl " + function.name + "\n";
-#endif
+            out.format("    .globl {}{}\n", symbol_prefix, function.name);
         }
-#if __APPLE__
-        assembly += "_" + function.name + ":\n";
-#else
-        assembly += function.name + ":\n";
-#endif
-        assembly += "    pushq %rbp\n";
-        assembly += "    movq %rsp, %rbp\n";
+        out << symbol_prefix << function.name << ":\n";
+        out.write("    pushq %rbp\n");
+        out.write("    movq %rsp, %rbp\n");
+        for (auto reg: function.callee_saved) {
+            out.format("    pushq {}\n", quad_registers[static_cast<int>(reg)]);
+        }
+        callee_saved = function.callee_saved;
         for (const auto &instruction: function.instructions) {
             emit_instruction(instruction);
         }
     }
 
-    std::string type_suffix(ASM::Type type) {
+    std::string_view type_suffix(const ASM::Type &type) {
         return std::visit(overloaded {
             [](const ASM::LongWord) {
                 return "l";
@@ -77,6 +89,10 @@ public:
             [](const ASM::Double) {
                 return "sd";
             },
+            // only movs take a vector, which makes them movdqu
+            [](const ASM::Vector) {
+                return "dqu";
+            },
             [](const ASM::Byte) {
                 return "b";
             },
@@ -85,7 +101,7 @@ public:
             }
         }, type);
     }
-    int type_reg_size(ASM::Type type) {
+    int type_reg_size(const ASM::Type &type) {
         return std::visit(overloaded {
             [](const ASM::LongWord) {
                 return 4;
@@ -96,6 +112,9 @@ public:
             [](const ASM::Double) {
                 return 8;
             },
+            [](const ASM::Vector) {
+                return 16;
+            },
             [](const ASM::Byte) {
                 return 1;
             },
@@ -144,33 +163,25 @@ public:
 
     void emit_static_variable(const ASM::StaticVariable & variable) {
         if (variable.global) {
-#if __APPLE__
-            assembly += "    .globl _" + variable.name + "\n";
-#else
-            assembly += "    .globl " + variable.name + "\n";
-#endif
+            out.format("    .globl {}{}\n", symbol_prefix, variable.name);
         }
 
         if (is_initial_zero(variable.initial_value)) {
-            assembly += "    .bss\n";
+            out.write("    .bss\n");
         } else {
-            assembly += "    .data\n";
+            out.write("    .data\n");
         }
-        assembly += "    .balign " + std::to_string(variable.alignment) + " \n";
-#if __APPLE__
-        assembly += "_" + variable.name + ":\n";
-#else
-        assembly += variable.name + ":\n";
-#endif
+        out.format("    .balign {} \n", variable.alignment);
+        out.format("{}{}:\n", symbol_prefix, variable.name);
         if (is_initial_zero(variable.initial_value)) {
             if (std::holds_alternative<InitialZero>(variable.initial_value[0])) {
-                assembly += "    .zero " + std::to_string(std::get<InitialZero>(variable.initial_value[0]).bytes) + " \n";
+                out.format("    .zero {} \n", std::get<InitialZero>(variable.initial_value[0]).bytes);
             } else if (std::holds_alternative<InitialChar>(variable.initial_value[0]) || std::holds_alternative<InitialUChar>(variable.initial_value[0])) {
-                assembly += "    .zero 1\n";
+                out.write("    .zero 1\n");
             } else if (std::holds_alternative<InitialInt>(variable.initial_value[0]) || std::holds_alternative<InitialUInt>(variable.initial_value[0])) {
-                assembly += "    .zero 4\n";
+                out.write("    .zero 4\n");
             } else {
-                assembly += "    .zero 8\n";
+                out.write("    .zero 8\n");
             }
         } else {
             for (const auto& element : variable.initial_value) {
@@ -182,89 +193,81 @@ public:
     void emit_init(const InitialElement& initial_value) {
         std::visit(overloaded {
                 [this](const InitialInt& init) {
-                    assembly += "    .long " + std::to_string(init.value) + "\n";
+                    out.format("    .long {}\n", init.value);
                 },
                 [this](const InitialUInt& init) {
-                    assembly += "    .long " + std::to_string(init.value) + "\n";
+                    out.format("    .long {}\n", init.value);
                 },
                 [this](const InitialLong& init) {
-                    assembly += "    .quad " + std::to_string(init.value) + "\n";
+                    out.format("    .quad {}\n", init.value);
                 },
                 [this](const InitialULong& init) {
-                    assembly += "    .quad " + std::to_string(init.value) + "\n";
+                    out.format("    .quad {}\n", init.value);
                 },
                 [this](const InitialDouble& init) {
                     // hack to get double binary representation
                     std::uint64_t u;
                     std::memcpy(&u, &init.value, sizeof(init.value));
-                    assembly += "    .quad " + std::to_string(u) + "\n";
+                    out.format("    .quad {}\n", u);
                 },
                 [this](const InitialZero& init) {
-                    assembly += "    .zero " + std::to_string(init.bytes) + "\n";
+                    out.format("    .zero {}\n", init.bytes);
                 },
                 [this](const InitialChar& init) {
-                    assembly += "    .byte " + std::to_string(init.value) + "\n";
+                    out.format("    .byte {}\n", static_cast<int>(init.value));
                 },
             [this](const InitialUChar& init) {
-                    assembly += "    .byte " + std::to_string(init.value) + "\n";
+                    out.format("    .byte {}\n", static_cast<int>(init.value));
                 },
                 [this](const InitialString& init) {
                     if (init.null_terminated) {
-                        assembly += "    .asciz ";
+                        out.write("    .asciz ");
                     } else {
-                        assembly += "    .ascii ";
+                        out.write("    .ascii ");
                     }
-                    assembly += '\"';
+                    out.put('\"');
                     for (char c : init.value) {
                         if (c == '\n') {
-                            assembly += "\\n";
+                            out.write("\\n");
                         } else if (c == '\\') {
-                            assembly += "\\\\";
+                            out.write("\\\\");
                         } else if (c == '\"') {
-                            assembly += "\\\"";
+                            out.write("\\\"");
                         } else {
-                            assembly += c;
+                            out.put(c);
                         }
                     }
-                    assembly += "\"\n";
+                    out.write("\"\n");
                 },
                 [this](const InitialPointer& init) {
-                    assembly += "    .quad " + with_local_label(init.name);
+                    out.format("    .quad {}{}\n", local_label_prefix, init.name);
                 }
 
             }, initial_value);
     }
 
-    std::string with_local_label(std::string x) {
-#ifdef __APPLE__
-        return "L" + x;
-#else
-        return ".L" + x;
-#endif
-    }
-
     void emit_static_constant(const ASM::StaticConstant & item) {
 #ifdef __APPLE__
         if (std::holds_alternative<InitialString>(item.initial_value[0])) {
-            assembly += "    .cstring\n";
+            out.write("    .cstring\n");
         } else if (item.alignment == 8) {
-            assembly += "    .literal8\n";
-            assembly += "    .balign 8\n";
+            out.write("    .literal8\n");
+            out.write("    .balign 8\n");
         } else { // must be 16
-            assembly += "    .literal16\n";
-            assembly += "    .balign 16\n";
+            out.write("    .literal16\n");
+            out.write("    .balign 16\n");
         }
 #else
-        assembly += "    .section .rodata\n";
-        assembly += "    .balign " + std::to_string(item.alignment) + "\n";
+        out.write("    .section .rodata\n");
+        out.format("    .balign {}\n", item.alignment);
 #endif
-        assembly += with_local_label(item.name) + ":\n";
+        out.format("{}{}:\n", local_label_prefix, item.name);
         for (const auto& element : item.initial_value) {
             emit_init(element);
         }
 #if __APPLE__
         if (item.alignment == 16) {
-            assembly += "    .quad 0\n";
+            out.write("    .quad 0\n");
         }
 #endif
     }
@@ -272,63 +275,114 @@ public:
 
     void emit_call(const ASM::Call &ins) {
 #if __APPLE__
-        assembly += "    call _" + ins.name + "\n";
+        out.format("    call _{}\n", ins.name);
 #else
-        assembly += "    call " + ins.name + (symbols->contains(ins.name) ? "" : "@PLT") + "\n";
+        out << "    call " << ins.name << (symbols->contains(ins.name) ? "\n" : "@PLT\n");
 #endif
     }
 
 
     void emit_push(const ASM::Push &ins) {
-        assembly += "    pushq ";
+        out.write("    pushq ");
         emit_operand(ins.value, 8);
-        assembly += "\n";
+        out.put('\n');
     }
 
     void emit_movsx(const ASM::Movsx & ins) {
-        assembly += "    movs" + type_suffix(ins.source_type) + type_suffix(ins.destination_type) + " ";
+        out << "    movs" << type_suffix(ins.source_type) << type_suffix(ins.destination_type) << ' ';
         emit_operand(ins.source, type_reg_size(ins.source_type));
-        assembly += ", ";
+        out.write(", ");
         emit_operand(ins.destination, type_reg_size(ins.destination_type));
-        assembly += "\n";
+        out.put('\n');
+    }
+
+    void emit_mul(const ASM::Mul &ins) {
+        out << (ins.is_signed ? "    imul" : "    mul") << type_suffix(ins.type) << ' ';
+        emit_operand(ins.factor, type_reg_size(ins.type));
+        out.put('\n');
     }
 
     void emit_div(const ASM::Div & ins) {
-        assembly += "    div" + type_suffix(ins.type) + " ";
+        out << "    div" << type_suffix(ins.type) << ' ';
         emit_operand(ins.divisor, type_reg_size(ins.type));
-        assembly += "\n";
+        out.put('\n');
     }
 
     void emit_cvtsi2sd(const ASM::Cvtsi2sd & ins) {
-        assembly += "    cvtsi2sd" + type_suffix(ins.type) + " ";
+        out << "    cvtsi2sd" << type_suffix(ins.type) << ' ';
         emit_operand(ins.source, type_reg_size(ins.type));
-        assembly += ", ";
+        out.write(", ");
         emit_operand(ins.destination, type_reg_size(ins.type));
-        assembly += "\n";
+        out.put('\n');
     }
 
     void emit_cvttsd2si(const ASM::Cvttsd2si & ins) {
-        assembly += "    cvttsd2si" + type_suffix(ins.type) + " ";
+        out << "    cvttsd2si" << type_suffix(ins.type) << ' ';
         emit_operand(ins.source, type_reg_size(ins.type));
-        assembly += ", ";
+        out.write(", ");
         emit_operand(ins.destination, type_reg_size(ins.type));
-        assembly += "\n";
+        out.put('\n');
     }
 
     void emit_lea(const ASM::Lea & ins) {
-        assembly += "    leaq ";
+        out.write("    leaq ");
         emit_operand(ins.source, 8);
-        assembly += ", ";
+        out.write(", ");
         emit_operand(ins.destination, 8);
-        assembly += "\n";
+        out.put('\n');
     }
 
     void emit_mov_zero_extend(const ASM::MovZeroExtend & ins) {
-        assembly += "    movz" + type_suffix(ins.source_type) + type_suffix(ins.destination_type) + " ";
+        out << "    movz" << type_suffix(ins.source_type) << type_suffix(ins.destination_type) << ' ';
         emit_operand(ins.source, type_reg_size(ins.source_type));
-        assembly += ", ";
+        out.write(", ");
         emit_operand(ins.destination, type_reg_size(ins.destination_type));
-        assembly += "\n";
+        out.put('\n');
+    }
+
+    void emit_packed_binary(const ASM::PackedBinary &ins) {
+        bool is_double = std::holds_alternative<ASM::Double>(ins.lane_type);
+        switch (ins.op) {
+            case ASM::Binary::Operator::ADD:
+            case ASM::Binary::Operator::SUB:
+            case ASM::Binary::Operator::MULT:
+            case ASM::Binary::Operator::DIV_DOUBLE:
+                if (is_double) {
+                    out.format("    {}pd ", ins.op == ASM::Binary::Operator::MULT
+                                               ? "mul"
+                                               : binary_mnemonics[static_cast<int>(ins.op)]);
+                } else {
+                    // padd and psub with b, d or q for the width of the lanes, there is no integer multiplication
+                    auto width = type_reg_size(ins.lane_type);
+                    out.format("    p{}{} ", binary_mnemonics[static_cast<int>(ins.op)],
+                               width == 1 ? 'b' : width == 4 ? 'd' : 'q');
+                }
+                break;
+            default:
+                // the bitwise ones do not care about lanes
+                out.format("    p{} ", binary_mnemonics[static_cast<int>(ins.op)]);
+                break;
+        }
+        emit_operand(ins.left, 16);
+        out.write(", ");
+        emit_operand(ins.right, 16);
+        out.put('\n');
+    }
+
+    void emit_packed_shuffle(const ASM::PackedShuffle &ins) {
+        out.format("    pshufd ${}, ", static_cast<int>(ins.control));
+        emit_operand(ins.source, 16);
+        out.write(", ");
+        emit_operand(ins.destination, 16);
+        out.put('\n');
+    }
+
+    void emit_mov_vector(const ASM::Type &type, const ASM::Operand &source, const ASM::Operand &destination) {
+        out.write(std::holds_alternative<ASM::QuadWord>(type) ? "    movq " : "    movd ");
+        emit_operand(source, type_reg_size(type));
+        out.write(", ");
+        emit_operand(destination, type_reg_size(type));
+        out.put('\n');
     }
 
     void emit_instruction(const ASM::Instruction &instruction) {
@@ -354,12 +408,18 @@ public:
                        [this](const ASM::Cmp &ins) {
                            emit_cmp(ins);
                        },
+                       [this](const ASM::Test &ins) {
+                           emit_test(ins);
+                       },
                        [this](const ASM::Jmp &ins) {
                            emit_jmp(ins);
                        },
                        [this](const ASM::JmpCC &ins) {
                            emit_jmpcc(ins);
                        },
+                       [this](const ASM::JumpTable &ins) {
+                           emit_jump_table(ins);
+                       },
                        [this](const ASM::SetCC &ins) {
                            emit_setcc(ins);
                        },
@@ -369,6 +429,9 @@ public:
                        [this](const ASM::Call &ins) {
                            emit_call(ins);
                        },
+                       [this](const ASM::TailCall &ins) {
+                           emit_tail_call(ins);
+                       },
                        [this](const ASM::Push &ins) {
                            emit_push(ins);
                        },
@@ -378,6 +441,9 @@ public:
                 [this](const ASM::Div &ins) {
                     emit_div(ins);
                 },
+                [this](const ASM::Mul &ins) {
+                    emit_mul(ins);
+                },
             [this](const ASM::Cvtsi2sd& ins) {
                 emit_cvtsi2sd(ins);
             },
@@ -389,249 +455,159 @@ public:
             },
              [this](const ASM::MovZeroExtend &ins) {
                  emit_mov_zero_extend(ins);
-             }
+             },
+            [this](const ASM::PackedBinary &ins) {
+                emit_packed_binary(ins);
+            },
+            [this](const ASM::PackedShuffle &ins) {
+                emit_packed_shuffle(ins);
+            },
+            [this](const ASM::MovToVector &ins) {
+                emit_mov_vector(ins.type, ins.source, ins.destination);
+            },
+            [this](const ASM::MovFromVector &ins) {
+                emit_mov_vector(ins.type, ins.source, ins.destination);
+            }
                    }, instruction);
     }
 
     void emit_mov(const ASM::Mov &ins) {
-        assembly += "    mov" + type_suffix(ins.type) + " ";
+        out << "    mov" << type_suffix(ins.type) << ' ';
         emit_operand(ins.src, type_reg_size(ins.type));
-        assembly += ", ";
+        out.write(", ");
         emit_operand(ins.dst, type_reg_size(ins.type));
-        assembly += "\n";
+        out.put('\n');
     }
 
-    void emit_ret(const ASM::Ret &ins) {
-        assembly += "    movq %rbp, %rsp\n";
-        assembly += "    popq %rbp\n";
-        assembly += "    ret\n";
+    void emit_ret(const ASM::Ret &) {
+        emit_epilogue();
+        out.write("    ret\n");
     }
 
-    void emit_unary(const ASM::Unary &ins) {
-        switch (ins.op) {
-            case ASM::Unary::Operator::Not:
-                assembly += "    not";
-                break;
-            case ASM::Unary::Operator::Neg:
-                assembly += "    neg";
-                break;
-            case ASM::Unary::Operator::Shr:
-                assembly += "    shr";
-                break;
+    void emit_tail_call(const ASM::TailCall &ins) {
+        emit_epilogue();
+#if __APPLE__
+        out.format("    jmp _{}\n", ins.name);
+#else
+        out << "    jmp " << ins.name << (symbols->contains(ins.name) ? "\n" : "@PLT\n");
+#endif
+    }
+
+    void emit_epilogue() {
+        // the saved registers sit right below the frame pointer in the order they were pushed
+        for (std::size_t i = 0; i < callee_saved.size(); i++) {
+            out.format("    movq -{}(%rbp), {}\n", 8 * (i + 1), quad_registers[static_cast<int>(callee_saved[i])]);
         }
-        assembly += type_suffix(ins.type) + " ";
+        out.write("    movq %rbp, %rsp\n");
+        out.write("    popq %rbp\n");
+    }
+
+    void emit_unary(const ASM::Unary &ins) {
+        out << "    " << unary_mnemonics[static_cast<int>(ins.op)] << type_suffix(ins.type) << ' ';
         emit_operand(ins.operand, type_reg_size(ins.type));
-        assembly += "\n";
+        out.put('\n');
     }
 
 
     void emit_binary(const ASM::Binary &ins) {
-        switch (ins.op) {
-            case ASM::Binary::Operator::ADD:
-                assembly += "    add";
-                break;
-            case ASM::Binary::Operator::SUB:
-                assembly += "    sub";
-                break;
-            case ASM::Binary::Operator::MULT:
-                if (std::holds_alternative<ASM::Double>(ins.type)) {
-                    assembly += "    mul";
-                } else {
-                    assembly += "    imul";
-                }
-                break;
-            case ASM::Binary::Operator::SHL:
-                assembly += "    shl";
-                break;
-            case ASM::Binary::Operator::SAR:
-                assembly += "    sar";
-                break;
-            case ASM::Binary::Operator::SHR:
-                assembly += "    shr";
-            break;
-            case ASM::Binary::Operator::AND:
-                assembly += "    and";
-                break;
-            case ASM::Binary::Operator::XOR:
-                if (std::holds_alternative<ASM::Double>(ins.type)) {
-                    assembly += "    xorpd ";
-                } else {
-                    assembly += "    xor";
-                }
-                break;
-            case ASM::Binary::Operator::OR:
-                assembly += "    or";
-                break;
-            case ASM::Binary::Operator::DIV_DOUBLE:
-                assembly += "    div";
-                break;
-        }
-        if (!std::holds_alternative<ASM::Double>(ins.type) || ins.op != ASM::Binary::Operator::XOR) { // do not emit type suffix for xor of doubles
-            assembly += type_suffix(ins.type) + " ";
+        bool is_double = std::holds_alternative<ASM::Double>(ins.type);
+        if (is_double && ins.op == ASM::Binary::Operator::XOR) { // do not emit type suffix for xor of doubles
+            out.write("    xorpd ");
+        } else if (is_double && ins.op == ASM::Binary::Operator::MULT) {
+            out << "    mul" << type_suffix(ins.type) << ' ';
+        } else {
+            out << "    " << binary_mnemonics[static_cast<int>(ins.op)] << type_suffix(ins.type) << ' ';
         }
         if (ins.op == ASM::Binary::Operator::SHR || ins.op == ASM::Binary::Operator::SHL || ins.op == ASM::Binary::Operator::SAR) {
             emit_operand(ins.left, 1);
         } else {
             emit_operand(ins.left, type_reg_size(ins.type));
         }
-        assembly += ", ";
+        out.write(", ");
         emit_operand(ins.right, type_reg_size(ins.type));
-        assembly += "\n";
+        out.put('\n');
     }
 
     void emit_idiv(const ASM::Idiv &ins) {
-        assembly += "    idiv" + type_suffix(ins.type) + " ";
+        out << "    idiv" << type_suffix(ins.type) << ' ';
         emit_operand(ins.divisor, type_reg_size(ins.type));
-        assembly += "\n";
+        out.put('\n');
     }
 
     void emit_cdq(const ASM::Cdq & ins) {
         if (std::holds_alternative<ASM::LongWord>(ins.type)) {
-            assembly += "    cdq\n";
+            out.write("    cdq\n");
         } else {
-            assembly += "    cqo\n";
+            out.write("    cqo\n");
         }
     }
 
     void emit_cmp(const ASM::Cmp &ins) {
         if (std::holds_alternative<ASM::Double>(ins.type)) {
-            assembly += "    comisd ";
+            out.write("    comisd ");
         } else {
-            assembly += "    cmp" + type_suffix(ins.type) + " ";
+            out << "    cmp" << type_suffix(ins.type) << ' ';
         }
         emit_operand(ins.left, type_reg_size(ins.type));
-        assembly += ", ";
+        out.write(", ");
         emit_operand(ins.right, type_reg_size(ins.type));
-        assembly += "\n";
+        out.put('\n');
+    }
+
+    void emit_test(const ASM::Test &ins) {
+        out << "    test" << type_suffix(ins.type) << ' ';
+        emit_operand(ins.left, type_reg_size(ins.type));
+        out.write(", ");
+        emit_operand(ins.right, type_reg_size(ins.type));
+        out.put('\n');
     }
 
 
     void emit_condition_code(const ASM::ConditionCode &code) {
-        switch (code) {
-            case ASM::ConditionCode::E:
-                assembly += "e";
-                break;
-            case ASM::ConditionCode::NE:
-                assembly += "ne";
-                break;
-            case ASM::ConditionCode::L:
-                assembly += "l";
-                break;
-            case ASM::ConditionCode::GE:
-                assembly += "ge";
-                break;
-            case ASM::ConditionCode::LE:
-                assembly += "le";
-                break;
-            case ASM::ConditionCode::G:
-                assembly += "g";
-                break;
-            case ASM::ConditionCode::A:
-                assembly += "a";
-                break;
-            case ASM::ConditionCode::AE:
-                assembly += "ae";
-                break;
-            case ASM::ConditionCode::B:
-                assembly += "b";
-                break;
-            case ASM::ConditionCode::BE:
-                assembly += "be";
-                break;
-            case ASM::ConditionCode::NB:
-                assembly += "nb";
-            break;
-            case ASM::ConditionCode::P:
-                assembly += "p";
-            break;
-            case ASM::ConditionCode::NP:
-                assembly += "np";
-            break;
-        }
+        out.write(condition_codes[static_cast<int>(code)]);
     }
 
     void emit_jmp(const ASM::Jmp &ins) {
-        assembly += "    jmp " + with_local_label(ins.target) + "\n";
+        out << "    jmp " << local_label_prefix << ins.target << '\n';
     }
 
     void emit_jmpcc(const ASM::JmpCC &ins) {
-        assembly += "    j";
-        emit_condition_code(ins.cond_code);
-        assembly += " " + with_local_label(ins.target) + "\n";
+        out << "    j" << condition_codes[static_cast<int>(ins.cond_code)] << ' ' << local_label_prefix << ins.target << '\n';
     }
 
     void emit_setcc(const ASM::SetCC &ins) {
-        assembly += "    set";
-        emit_condition_code(ins.cond_code);
-        assembly += " ";
+        out << "    set" << condition_codes[static_cast<int>(ins.cond_code)] << ' ';
         emit_operand(ins.destination, 1);
-        assembly += "\n";
+        out.put('\n');
     }
 
-    void emit_label(const ASM::Label &ins) {
-        assembly += with_local_label(ins.name) + ":\n";
-    }
-    // duplicate!
-    bool is_sse_register(const ASM::Reg& reg) {
-        switch (reg.name) {
-            case ASM::Reg::Name::XMM0:
-            case ASM::Reg::Name::XMM1:
-            case ASM::Reg::Name::XMM2:
-            case ASM::Reg::Name::XMM3:
-            case ASM::Reg::Name::XMM4:
-            case ASM::Reg::Name::XMM5:
-            case ASM::Reg::Name::XMM6:
-            case ASM::Reg::Name::XMM7:
-            case ASM::Reg::Name::XMM14:
-            case ASM::Reg::Name::XMM15:
-                return true;
-            default:
-                return false;
+    void emit_jump_table(const ASM::JumpTable &ins) {
+        // entries are offsets from the table so it needs no relocations
+        out.format("    leaq {}{}(%rip), %r11\n", local_label_prefix, ins.table);
+        out.write("    movslq (%r11,");
+        emit_operand(ins.index, 8);
+        out.write(",4), %r10\n");
+        out.write("    addq %r11, %r10\n");
+        out.write("    jmp *%r10\n");
+#ifdef __APPLE__
+        out.write("    .const\n");
+#else
+        out.write("    .section .rodata\n");
+#endif
+        out.write("    .balign 4\n");
+        out.format("{}{}:\n", local_label_prefix, ins.table);
+        for (const auto &target: ins.targets) {
+            out.format("    .long {}{} - {}{}\n", local_label_prefix, target, local_label_prefix, ins.table);
         }
+        out.write("    .text\n");
     }
 
-
-    void emit_sse_register(const ASM::Reg& reg) {
-        switch (reg.name) {
-            case ASM::Reg::Name::XMM0:
-                assembly += "%xmm0";
-                break;
-            case ASM::Reg::Name::XMM1:
-                assembly += "%xmm1";
-                break;
-            case ASM::Reg::Name::XMM2:
-                assembly += "%xmm2";
-            break;
-            case ASM::Reg::Name::XMM3:
-                assembly += "%xmm3";
-            break;
-            case ASM::Reg::Name::XMM4:
-                assembly += "%xmm4";
-            break;
-            case ASM::Reg::Name::XMM5:
-                assembly += "%xmm5";
-            break;
-            case ASM::Reg::Name::XMM6:
-                assembly += "%xmm6";
-            break;
-            case ASM::Reg::Name::XMM7:
-                assembly += "%xmm7";
-            break;
-            case ASM::Reg::Name::XMM14:
-                assembly += "%xmm14";
-            break;
-            case ASM::Reg::Name::XMM15:
-                assembly += "%xmm15";
-            break;
-        }
+    void emit_label(const ASM::Label &ins) {
+        out << local_label_prefix << ins.name << ":\n";
     }
 
     void emit_indexed(const ASM::Indexed & operand) {
-        assembly += "(";
-        emit_8byte_register(operand.base);
-        assembly += ", ";
-        emit_8byte_register(operand.index);
-        assembly += ", " + std::to_string(operand.scale) + ")";
+        out << '(' << register_name(operand.base, 8) << ", " << register_name(operand.index, 8) << ", " << operand.scale << ')';
     }
 
     void emit_operand(const ASM::Operand &operand, int reg_size = 4) {
@@ -640,15 +616,7 @@ public:
                            emit_imm(operand);
                        },
                        [this, reg_size](const ASM::Reg &operand) {
-                           if (is_sse_register(operand)) {
-                               emit_sse_register(operand);
-                           } else if (reg_size == 1) {
-                               emit_1byte_register(operand);
-                           } else if (reg_size == 8) {
-                               emit_8byte_register(operand);
-                           } else {
-                               emit_4byte_register(operand);
-                           }
+                           out.write(register_name(operand, reg_size));
                        },
                        [this](const ASM::Memory &operand) {
                            emit_memory(operand);
@@ -659,157 +627,93 @@ public:
                        [this](const ASM::Indexed& operand) {
                            emit_indexed(operand);
                        } ,
-                       [this](auto &) {
-                           // TODO: panic
+                       // pseudo operands only survive until register replacement, they show up in dumps
+                       [this](const ASM::Pseudo &operand) {
+                           out.format("%{}", operand.name);
+                       },
+                       [this](const ASM::PseudoMem &operand) {
+                           out.format("{}+{}", operand.identifier, operand.offset);
                        }
                    }, operand);
     }
 
     void emit_imm(const ASM::Imm &operand) {
-        assembly += std::format("${}", operand.value);
+        out << '$' << operand.value;
     }
     void emit_data(const ASM::Data & data) {
-        if (symbols->contains(data.identifier)) {
-            auto& symbol = symbols->at(data.identifier);
-            if (std::holds_alternative<ASM::ObjectSymbol>(symbol) && std::get<ASM::ObjectSymbol>(symbol).is_constant) {
-                assembly += with_local_label(data.identifier) + "(%rip)";
+        if (auto symbol = symbols->find(data.identifier); symbol != symbols->end()) {
+            if (std::holds_alternative<ASM::ObjectSymbol>(symbol->second) && std::get<ASM::ObjectSymbol>(symbol->second).is_constant) {
+                out << local_label_prefix << data.identifier << "(%rip)";
                 return;
             }
         }
-#ifdef __APPLE__
-        assembly += "_" + data.identifier + "(%rip)";
-#else
-        assembly += data.identifier + "(%rip)";
-#endif
-    }
-
-    void emit_8byte_register(const ASM::Reg &reg) {
-        switch (reg.name) {
-            case ASM::Reg::Name::AX:
-                assembly += "%rax";
-                break;
-            case ASM::Reg::Name::DX:
-                assembly += "%rdx";
-                break;
-            case ASM::Reg::Name::CX:
-                assembly += "%rcx";
-                break;
-            case ASM::Reg::Name::DI:
-                assembly += "%rdi";
-                break;
-            case ASM::Reg::Name::SI:
-                assembly += "%rsi";
-                break;
-            case ASM::Reg::Name::R8:
-                assembly += "%r8";
-                break;
-            case ASM::Reg::Name::R9:
-                assembly += "%r9";
-                break;
-            case ASM::Reg::Name::R10:
-                assembly += "%r10";
-                break;
-            case ASM::Reg::Name::R11:
-                assembly += "%r11";
-                break;
-            case ASM::Reg::Name::SP:
-                assembly += "%rsp";
-                break;
-            case ASM::Reg::Name::BP:
-                assembly += "%rbp";
-            break;
-        }
+        out << symbol_prefix << data.identifier << "(%rip)";
     }
 
-    void emit_4byte_register(const ASM::Reg &operand) {
-        switch (operand.name) {
-            case ASM::Reg::Name::AX:
-                assembly += "%eax";
-                break;
-            case ASM::Reg::Name::DX:
-                assembly += "%edx";
-                break;
-            case ASM::Reg::Name::CX:
-                assembly += "%ecx";
-                break;
-            case ASM::Reg::Name::DI:
-                assembly += "%edi";
-                break;
-            case ASM::Reg::Name::SI:
-                assembly += "%esi";
-                break;
-            case ASM::Reg::Name::R8:
-                assembly += "%r8d";
-                break;
-            case ASM::Reg::Name::R9:
-                assembly += "%r9d";
-                break;
-            case ASM::Reg::Name::R10:
-                assembly += "%r10d";
-                break;
-            case ASM::Reg::Name::R11:
-                assembly += "%r11d";
-                break;
-            case ASM::Reg::Name::SP:
-                assembly += "%esp";
-            break;
-            case ASM::Reg::Name::BP:
-                assembly += "%ebp";
-            break;
+    std::string_view register_name(const ASM::Reg &reg, int reg_size) {
+        auto index = static_cast<int>(reg.name);
+        if (reg_size == 1) {
+            return byte_registers[index];
         }
-    }
-
-    void emit_1byte_register(const ASM::Reg &operand) {
-        switch (operand.name) {
-            case ASM::Reg::Name::AX:
-                assembly += "%al";
-            break;
-            case ASM::Reg::Name::DX:
-                assembly += "%dl";
-            break;
-            case ASM::Reg::Name::CX:
-                assembly += "%cl";
-            break;
-            case ASM::Reg::Name::DI:
-                assembly += "%dil";
-            break;
-            case ASM::Reg::Name::R8:
-                assembly += "%r8b";
-            break;
-            case ASM::Reg::Name::R9:
-                assembly += "%r9b";
-            break;
-            case ASM::Reg::Name::R10:
-                assembly += "%r10b";
-            break;
-            case ASM::Reg::Name::R11:
-                assembly += "%r11b";
-            break;
-            case ASM::Reg::Name::SP:
-                assembly += "%sp";
-            break;
-            case ASM::Reg::Name::BP:
-                assembly += "%bp";
-            break;
-            case ASM::Reg::Name::SI:
-                assembly += "%sil";
-            break;
+        if (reg_size == 8) {
+            return quad_registers[index];
         }
+        return long_registers[index];
     }
 
     void emit_memory(const ASM::Memory &operand) {
-        assembly += std::to_string(operand.offset);
-        assembly += "(";
-        emit_8byte_register(operand.reg);
-        assembly += ")";
+        out << operand.offset << '(' << register_name(operand.reg, 8) << ')';
     }
 
-
-    std::string assembly;
-
 private:
-    ASM::Program asmProgram;
+    // functions names on apple must be prefixed by an underscore
+#if __APPLE__
+    static constexpr std::string_view symbol_prefix = "_";
+    static constexpr std::string_view local_label_prefix = "L";
+#else
+    static constexpr std::string_view symbol_prefix = "";
+    static constexpr std::string_view local_label_prefix = ".L";
+#endif
+
+    // register tables are indexed by ASM::Reg::Name, sse registers have the same name in every size
+    static constexpr std::array<std::string_view, 32> quad_registers = {
+        "%rax", "%rcx", "%rdx", "%rdi", "%rsi", "%r8", "%r9", "%r10", "%r11", "%rsp", "%rbp",
+        "%rbx", "%r12", "%r13", "%r14", "%r15",
+        "%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5", "%xmm6", "%xmm7",
+        "%xmm8", "%xmm9", "%xmm10", "%xmm11", "%xmm12", "%xmm13", "%xmm14", "%xmm15"
+    };
+    static constexpr std::array<std::string_view, 32> long_registers = {
+        "%eax", "%ecx", "%edx", "%edi", "%esi", "%r8d", "%r9d", "%r10d", "%r11d", "%esp", "%ebp",
+        "%ebx", "%r12d", "%r13d", "%r14d", "%r15d",
+        "%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5", "%xmm6", "%xmm7",
+        "%xmm8", "%xmm9", "%xmm10", "%xmm11", "%xmm12", "%xmm13", "%xmm14", "%xmm15"
+    };
+    static constexpr std::array<std::string_view, 32> byte_registers = {
+        "%al", "%cl", "%dl", "%dil", "%sil", "%r8b", "%r9b", "%r10b", "%r11b", "%spl", "%bpl",
+        "%bl", "%r12b", "%r13b", "%r14b", "%r15b",
+        "%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5", "%xmm6", "%xmm7",
+        "%xmm8", "%xmm9", "%xmm10", "%xmm11", "%xmm12", "%xmm13", "%xmm14", "%xmm15"
+    };
+    static_assert(quad_registers.size() == static_cast<int>(ASM::Reg::Name::XMM15) + 1);
+
+    // indexed by ASM::ConditionCode
+    static constexpr std::array<std::string_view, 13> condition_codes = {
+        "e", "ne", "g", "ge", "l", "le", "a", "ae", "b", "be", "nb", "p", "np"
+    };
+
+    // indexed by ASM::Unary::Operator
+    static constexpr std::array<std::string_view, 5> unary_mnemonics = {"neg", "not", "shr", "inc", "dec"};
+
+    // indexed by ASM::Binary::Operator, double multiplication and xor are special cased
+    static constexpr std::array<std::string_view, 10> binary_mnemonics = {
+        "add", "sub", "imul", "and", "or", "xor", "sar", "shr", "shl", "div"
+    };
+
+    const ASM::Program *asmProgram;
     std::unordered_map<std::string, ASM::Symbol> *symbols;
+    OutputBuffer &out;
+    // of the function being emitted
+    std::span<const ASM::Reg::Name> callee_saved;
 };
 
 #endif //CODEEMITTER_H
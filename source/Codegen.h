@@ -1,25 +1,96 @@
 #ifndef CODEGEN_H
 #define CODEGEN_H
 #include <unordered_map>
+#include <unordered_set>
 #include <algorithm>
+#include <bit>
 #include <limits>
+#include <numeric>
 #include <ranges>
 
+#include "AsmLiveness.h"
 #include "AsmTree.h"
 #include "Ast.h"
 #include "IR.h"
 #include "overloaded.h"
 #include "analysis/TypeCheckerPass.h"
+#include "optimization/Operands.h"
 
 namespace codegen {
+    // multiplier and shift that turn a division by a constant into a multiplication (Granlund, Montgomery "Division
+    // by invariant integers using multiplication"; Warren "Hacker's Delight" 10)
+    struct DivisionMagic {
+        std::uint64_t multiplier;
+        int shift;
+        // the exact multiplier needs width + 1 bits, its top bit is added back after the multiplication
+        bool add;
+    };
+
+    // divisor is not a power of two and below 2^(width - 1)
+    inline DivisionMagic unsigned_division_magic(std::uint64_t divisor, int width) {
+        using u128 = unsigned __int128;
+        int log = std::bit_width(divisor - 1);
+        // floor(x * m / 2^p) is the quotient for every x below 2^width if m * d - 2^p <= 2^(p - width)
+        for (int p = width; p <= width + log; p++) {
+            u128 power = u128(1) << p;
+            u128 multiplier = (power + divisor - 1) / divisor;
+            if (multiplier >= u128(1) << width) break;
+            if (multiplier * divisor - power <= u128(1) << (p - width)) {
+                return DivisionMagic{static_cast<std::uint64_t>(multiplier), p - width, false};
+            }
+        }
+        u128 multiplier = (u128(1) << width) * ((u128(1) << log) - divisor) / divisor + 1;
+        return DivisionMagic{static_cast<std::uint64_t>(multiplier), log, true};
+    }
+
+    // divisor is positive, not a power of two and below 2^(width - 1), the multiplier is a width bit pattern and
+    // the dividend is added after the multiplication when it is negative as a signed number
+    inline DivisionMagic signed_division_magic(std::uint64_t divisor, int width) {
+        std::uint64_t mask = width == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << width) - 1;
+        std::uint64_t two = std::uint64_t(1) << (width - 1);
+        std::uint64_t anc = two - 1 - two % divisor;
+        int p = width - 1;
+        std::uint64_t q1 = two / anc;
+        std::uint64_t r1 = two - q1 * anc;
+        std::uint64_t q2 = two / divisor;
+        std::uint64_t r2 = two - q2 * divisor;
+        std::uint64_t delta;
+        do {
+            p++;
+            q1 = (q1 * 2) & mask;
+            r1 = (r1 * 2) & mask;
+            if (r1 >= anc) {
+                q1++;
+                r1 -= anc;
+            }
+            q2 = (q2 * 2) & mask;
+            r2 = (r2 * 2) & mask;
+            if (r2 >= divisor) {
+                q2++;
+                r2 -= divisor;
+            }
+            delta = divisor - r2;
+        } while (q1 < delta || (q1 == delta && r1 == 0));
+        auto multiplier = (q2 + 1) & mask;
+        return DivisionMagic{multiplier, p - width, (multiplier & two) != 0};
+    }
+
     class IRToAsmTreePass {
     public:
+        // tail_calls turns calls right before a return into jumps where the frame is not needed anymore
         IRToAsmTreePass(IR::Program IRProgram,
-                        std::unordered_map<std::string, Symbol> *symbols) : IRProgram(std::move(IRProgram)),
-                                                                            symbols(symbols) {
+                        std::unordered_map<std::string, Symbol> *symbols,
+                        bool tail_calls = false) : IRProgram(std::move(IRProgram)), symbols(symbols),
+                                                   tail_calls(tail_calls) {
+            for (const auto &item: this->IRProgram.items) {
+                if (auto function = std::get_if<IR::Function>(&item)) {
+                    vectors.insert(function->vectors.begin(), function->vectors.end());
+                }
+            }
         }
 
         ASM::Type get_type_for_identifier(const std::string &name) {
+            if (vectors.contains(name)) return ASM::Vector();
             return std::visit(overloaded{
                                   [](const AST::IntType &) -> ASM::Type {
                                       return ASM::LongWord();
@@ -119,6 +190,18 @@ namespace codegen {
 
 
 
+        // the asm type of the elements of a vector variable, which is the type of its symbol
+        ASM::Type get_lane_type(const IR::Value &value) {
+            return std::visit(overloaded{
+                                  [](const AST::IntType &) -> ASM::Type { return ASM::LongWord(); },
+                                  [](const AST::UIntType &) -> ASM::Type { return ASM::LongWord(); },
+                                  [](const AST::LongType &) -> ASM::Type { return ASM::QuadWord(); },
+                                  [](const AST::ULongType &) -> ASM::Type { return ASM::QuadWord(); },
+                                  [](const AST::DoubleType &) -> ASM::Type { return ASM::Double(); },
+                                  [](const auto &) -> ASM::Type { return ASM::Byte(); }
+                              }, *(*symbols)[std::get<IR::Variable>(value).name].type);
+        }
+
         void convert() {
             for (const auto &item: IRProgram.items) {
                 std::visit(overloaded{
@@ -135,6 +218,10 @@ namespace codegen {
             }
 
             for (const auto &[name, symbol]: *symbols) {
+                if (vectors.contains(name)) {
+                    asmSymbols[name] = ASM::ObjectSymbol{ASM::Vector(), false, false};
+                    continue;
+                }
                 bool is_constant = std::holds_alternative<ConstantAttributes>(symbol.attributes);
                 asmSymbols[name] = std::visit(overloaded{
                                                   [&symbol, is_constant](const AST::IntType &) -> ASM::Symbol {
@@ -299,7 +386,7 @@ namespace codegen {
         }
 
         ASM::StaticConstant convert_static_constant(const IR::StaticConstant & constant) {
-            return ASM::StaticConstant{constant.name, bytes_for_type(*constant.type), constant.initial};
+            return ASM::StaticConstant{constant.name, get_alignment_for_type(*constant.type), constant.initial};
         }
 
 
@@ -350,14 +437,53 @@ namespace codegen {
                                                    ASM::Pseudo(stack_params[i])));
             }
 
-            for (auto &instruction: function.instructions) {
+            bool frame_unused = tail_calls && !has_address_taken_locals(function);
+            for (std::size_t i = 0; i < function.instructions.size(); i++) {
+                const auto &instruction = function.instructions[i];
+                if (frame_unused && i + 1 < function.instructions.size() &&
+                    is_tail_call(function, instruction, function.instructions[i + 1])) {
+                    // the return is only reached from the call, nothing jumps to it
+                    convert_call(std::get<IR::Call>(instruction), instructions, true);
+                    i++;
+                    continue;
+                }
                 convert_instruction(instruction, instructions);
             }
             return ASM::Function(function.name, function.global, std::move(instructions));
         }
 
+        // a pointer into the frame may have been passed along, the frame has to outlive the call then
+        bool has_address_taken_locals(const IR::Function &function) const {
+            auto names = optimization::address_taken(function.instructions);
+            return std::ranges::any_of(names, [this](const std::string &name) {
+                return optimization::is_local(name, *symbols);
+            });
+        }
 
-        void convert_call(const IR::Call &call, std::vector<ASM::Instruction> &instructions) {
+        // the call returns its result unchanged and passes every argument in registers, our own return address and
+        // stack arguments stay where the callee expects its own
+        bool is_tail_call(const IR::Function &function, const IR::Instruction &instruction,
+                          const IR::Instruction &next) {
+            auto *call = std::get_if<IR::Call>(&instruction);
+            auto *ret = std::get_if<IR::Return>(&next);
+            if (!call || !ret) return false;
+            const auto &type = std::get<AST::FunctionType>(*symbols->at(function.name).type);
+            bool returns_void = std::holds_alternative<AST::VoidType>(*type.return_type);
+            if (ret->value && !returns_void) {
+                auto *result = std::get_if<IR::Variable>(&*ret->value);
+                auto *destination = call->destination ? std::get_if<IR::Variable>(&*call->destination) : nullptr;
+                if (!result || !destination || result->name != destination->name) return false;
+            }
+            int int_args = 0;
+            int double_args = 0;
+            for (const auto &argument: call->arguments) {
+                (std::holds_alternative<ASM::Double>(get_type_for_value(argument)) ? double_args : int_args)++;
+            }
+            return int_args <= 6 && double_args <= 8;
+        }
+
+
+        void convert_call(const IR::Call &call, std::vector<ASM::Instruction> &instructions, bool tail = false) {
             static std::vector int_registers = {
                 ASM::Reg::Name::DI, ASM::Reg::Name::SI, ASM::Reg::Name::DX, ASM::Reg::Name::CX, ASM::Reg::Name::R8,
                 ASM::Reg::Name::R9
@@ -417,7 +543,15 @@ namespace codegen {
                 }
             }
 
-            instructions.emplace_back(ASM::Call(call.name));
+            std::vector<ASM::Reg::Name> argument_registers(int_registers.begin(),
+                                                           int_registers.begin() + int_args.size());
+            argument_registers.insert(argument_registers.end(), double_registers.begin(),
+                                      double_registers.begin() + double_args.size());
+            if (tail) {
+                instructions.emplace_back(ASM::TailCall(call.name, std::move(argument_registers)));
+                return;
+            }
+            instructions.emplace_back(ASM::Call(call.name, std::move(argument_registers)));
 
             int bytes_to_remove = 8 * stack_args.size() + stack_padding;
 
@@ -633,6 +767,96 @@ namespace codegen {
             }
         }
 
+        static ASM::Binary::Operator packed_operator(IR::Binary::Operator op) {
+            switch (op) {
+                case IR::Binary::Operator::ADD:
+                    return ASM::Binary::Operator::ADD;
+                case IR::Binary::Operator::SUBTRACT:
+                    return ASM::Binary::Operator::SUB;
+                case IR::Binary::Operator::MULTIPLY:
+                    return ASM::Binary::Operator::MULT;
+                case IR::Binary::Operator::DIVIDE:
+                    return ASM::Binary::Operator::DIV_DOUBLE;
+                case IR::Binary::Operator::BITWISE_AND:
+                    return ASM::Binary::Operator::AND;
+                case IR::Binary::Operator::BITWISE_OR:
+                    return ASM::Binary::Operator::OR;
+                case IR::Binary::Operator::BITWISE_XOR:
+                    return ASM::Binary::Operator::XOR;
+                default:
+                    // the vectorizer makes no other vector arithmetic
+                    std::unreachable();
+            }
+        }
+
+        void convert_packed_binary(const IR::Binary &instruction, std::vector<ASM::Instruction> &instructions) {
+            instructions.emplace_back(ASM::Mov(ASM::Vector(), convert_value(instruction.left_source),
+                                               convert_value(instruction.destination)));
+            instructions.emplace_back(ASM::PackedBinary(packed_operator(instruction.op),
+                                                        get_lane_type(instruction.destination),
+                                                        convert_value(instruction.right_source),
+                                                        convert_value(instruction.destination)));
+        }
+
+        // the source goes into the lowest lane, pshufd copies it into the others, the vectorizer gives the source the
+        // type of the lanes
+        void convert_broadcast(const IR::Broadcast &instruction, std::vector<ASM::Instruction> &instructions) {
+            auto source = convert_value(instruction.source);
+            auto destination = convert_value(instruction.destination);
+            std::visit(overloaded{
+                           [&](const ASM::Double &) {
+                               instructions.emplace_back(ASM::Mov(ASM::Double(), source, destination));
+                               instructions.emplace_back(ASM::PackedShuffle(0x44, destination, destination));
+                           },
+                           [&](const ASM::QuadWord &) {
+                               instructions.emplace_back(ASM::MovToVector(ASM::QuadWord(), source, destination));
+                               instructions.emplace_back(ASM::PackedShuffle(0x44, destination, destination));
+                           },
+                           [&](const ASM::LongWord &) {
+                               instructions.emplace_back(ASM::MovToVector(ASM::LongWord(), source, destination));
+                               instructions.emplace_back(ASM::PackedShuffle(0, destination, destination));
+                           },
+                           [&](const ASM::Byte &) {
+                               // four copies of the byte make a 32 bit lane first
+                               auto spread = make_temporary(ASM::LongWord());
+                               if (auto *imm = std::get_if<ASM::Imm>(&source)) {
+                                   instructions.emplace_back(ASM::Mov(ASM::LongWord(),
+                                                                      ASM::Imm((imm->value & 0xff) * 0x01010101),
+                                                                      spread));
+                               } else {
+                                   instructions.emplace_back(ASM::MovZeroExtend(ASM::Byte(), ASM::LongWord(), source,
+                                                                                spread));
+                                   instructions.emplace_back(ASM::Binary(ASM::Binary::Operator::MULT,
+                                                                         ASM::LongWord(), ASM::Imm(0x01010101),
+                                                                         spread));
+                               }
+                               instructions.emplace_back(ASM::MovToVector(ASM::LongWord(), spread, destination));
+                               instructions.emplace_back(ASM::PackedShuffle(0, destination, destination));
+                           },
+                           [](const auto &) {
+                               std::unreachable();
+                           }
+                       }, get_type_for_value(instruction.source));
+        }
+
+        // the upper half is combined into the lower one until a single lane is left, the vectorizer reduces 32 and
+        // 64 bit integer lanes only
+        void convert_reduce(const IR::Reduce &instruction, std::vector<ASM::Instruction> &instructions) {
+            auto lane = get_lane_type(instruction.source);
+            auto op = packed_operator(instruction.op);
+            auto source = convert_value(instruction.source);
+            ASM::Operand half = make_temporary(ASM::Vector());
+            instructions.emplace_back(ASM::PackedShuffle(0xee, source, half));
+            instructions.emplace_back(ASM::PackedBinary(op, lane, source, half));
+            if (std::holds_alternative<ASM::LongWord>(lane)) {
+                ASM::Operand quarter = make_temporary(ASM::Vector());
+                instructions.emplace_back(ASM::PackedShuffle(0x55, half, quarter));
+                instructions.emplace_back(ASM::PackedBinary(op, lane, half, quarter));
+                half = quarter;
+            }
+            instructions.emplace_back(ASM::MovFromVector(lane, half, convert_value(instruction.destination)));
+        }
+
         void convert_instruction(const IR::Instruction &instruction, std::vector<ASM::Instruction> &instructions) {
             std::visit(overloaded{
                            [this, &instructions](const IR::Return &instruction) {
@@ -697,22 +921,36 @@ namespace codegen {
                            },
                            [this, &instructions](const IR::AddPtr &instruction) {
                                convert_add_ptr(instruction, instructions);
+                           },
+                           [this, &instructions](const IR::JumpTable &instruction) {
+                               convert_jump_table(instruction, instructions);
+                           },
+                           [this, &instructions](const IR::Broadcast &instruction) {
+                               convert_broadcast(instruction, instructions);
+                           },
+                           [this, &instructions](const IR::Reduce &instruction) {
+                               convert_reduce(instruction, instructions);
+                           },
+                           [](const IR::Phi &) {
+                               // the optimizer lowers phis to copies before leaving ssa form
+                               std::unreachable();
                            }
 
                        }, instruction);
         }
 
         void convert_return(const IR::Return &instruction, std::vector<ASM::Instruction> &instructions) {
+            std::optional<ASM::Reg::Name> value;
             if (instruction.value) {
                 if (std::holds_alternative<ASM::Double>(get_type_for_value(*instruction.value))) {
-                    instructions.emplace_back(ASM::Mov(get_type_for_value(*instruction.value),
-                                                       convert_value(*instruction.value), ASM::Reg(ASM::Reg::Name::XMM0)));
+                    value = ASM::Reg::Name::XMM0;
                 } else {
-                    instructions.emplace_back(ASM::Mov(get_type_for_value(*instruction.value),
-                                                       convert_value(*instruction.value), ASM::Reg(ASM::Reg::Name::AX)));
+                    value = ASM::Reg::Name::AX;
                 }
+                instructions.emplace_back(ASM::Mov(get_type_for_value(*instruction.value),
+                                                   convert_value(*instruction.value), ASM::Reg(*value)));
             }
-            instructions.emplace_back(ASM::Ret());
+            instructions.emplace_back(ASM::Ret(value));
         }
 
         ASM::Operand convert_value(const IR::Value &value) {
@@ -804,6 +1042,10 @@ namespace codegen {
         }
 
         void convert_binary(const IR::Binary &instruction, std::vector<ASM::Instruction> &instructions) {
+            if (std::holds_alternative<ASM::Vector>(get_type_for_value(instruction.destination))) {
+                convert_packed_binary(instruction, instructions);
+                return;
+            }
             if (instruction.op == IR::Binary::Operator::EQUAL || instruction.op == IR::Binary::Operator::GREATER ||
                 instruction.op == IR::Binary::Operator::GREATER_EQUAL || instruction.op == IR::Binary::Operator::LESS ||
                 instruction.op == IR::Binary::Operator::LESS_EQUAL || instruction.op ==
@@ -811,6 +1053,9 @@ namespace codegen {
                 convert_relational(instruction, instructions);
                 return;
             }
+            if (convert_by_constant(instruction, instructions)) {
+                return;
+            }
 
             if ((instruction.op == IR::Binary::Operator::DIVIDE && !std::holds_alternative<
                      ASM::Double>(get_type_for_value(instruction.left_source))) || instruction.op ==
@@ -861,16 +1106,205 @@ namespace codegen {
                     }
                 };
 
+                auto right = convert_value(instruction.right_source);
+                // a shift count that is not a constant has to be in cl, it is moved there before the destination is
+                // written so the count can not be overwritten by it
+                if ((instruction.op == IR::Binary::Operator::SHIFT_LEFT ||
+                     instruction.op == IR::Binary::Operator::SHIFT_RIGHT) && !std::holds_alternative<ASM::Imm>(right)) {
+                    instructions.emplace_back(ASM::Mov(get_type_for_value(instruction.right_source), right,
+                                                       ASM::Reg(ASM::Reg::Name::CX)));
+                    right = ASM::Reg(ASM::Reg::Name::CX);
+                }
                 instructions.emplace_back(ASM::Mov(get_type_for_value(instruction.left_source),
                                                    convert_value(instruction.left_source),
                                                    convert_value(instruction.destination)));
                 instructions.emplace_back(ASM::Binary(convert_op(instruction.op),
                                                       get_type_for_value(instruction.left_source),
-                                                      convert_value(instruction.right_source),
+                                                      std::move(right),
                                                       convert_value(instruction.destination)));
             }
         }
 
+        // integer multiplication, division and remainder with a constant operand, false if imul or div is used as
+        // usual
+        bool convert_by_constant(const IR::Binary &instruction, std::vector<ASM::Instruction> &instructions) {
+            if (instruction.op != IR::Binary::Operator::MULTIPLY && instruction.op != IR::Binary::Operator::DIVIDE &&
+                instruction.op != IR::Binary::Operator::REMAINDER) {
+                return false;
+            }
+            auto type = get_type_for_value(instruction.left_source);
+            if (!std::holds_alternative<ASM::LongWord>(type) && !std::holds_alternative<ASM::QuadWord>(type)) {
+                return false;
+            }
+            const auto *source = &instruction.left_source;
+            const auto *constant = std::get_if<IR::Constant>(&instruction.right_source);
+            if (!constant && instruction.op == IR::Binary::Operator::MULTIPLY) {
+                source = &instruction.right_source;
+                constant = std::get_if<IR::Constant>(&instruction.left_source);
+            }
+            if (!constant) return false;
+            int width = std::holds_alternative<ASM::LongWord>(type) ? 32 : 64;
+            std::uint64_t mask = width == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << width) - 1;
+            auto value = std::visit([](const auto &c) { return static_cast<std::uint64_t>(c.value); },
+                                    constant->constant) & mask;
+            auto destination = convert_value(instruction.destination);
+            if (instruction.op == IR::Binary::Operator::MULTIPLY) {
+                return multiply_by_constant(convert_value(*source), value, type, width, destination, instructions);
+            }
+            // a division by zero still traps
+            if (value == 0) return false;
+            auto dividend = convert_value(*source);
+            bool remainder = instruction.op == IR::Binary::Operator::REMAINDER;
+            if (is_unsigned(instruction.left_source)) {
+                unsigned_divide_by_constant(dividend, value, type, width, remainder, destination, instructions);
+            } else {
+                signed_divide_by_constant(dividend, value, type, width, remainder, destination, instructions);
+            }
+            return true;
+        }
+
+        bool multiply_by_constant(const ASM::Operand &source, std::uint64_t value, const ASM::Type &type, int width,
+                                  const ASM::Operand &destination, std::vector<ASM::Instruction> &instructions) {
+            std::uint64_t mask = width == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << width) - 1;
+            if (value == 0) {
+                instructions.emplace_back(ASM::Mov(type, ASM::Imm(0), destination));
+                return true;
+            }
+            if (value == mask) {
+                instructions.emplace_back(ASM::Mov(type, source, destination));
+                instructions.emplace_back(ASM::Unary(ASM::Unary::Operator::Neg, type, destination));
+                return true;
+            }
+            int shift = std::countr_zero(value);
+            auto odd = value >> shift;
+            if (odd != 1 && odd != 3 && odd != 5 && odd != 9) return false;
+            if (odd == 1) {
+                instructions.emplace_back(ASM::Mov(type, source, destination));
+            } else {
+                // x * 3, 5 or 9 is one lea of x + x * 2, 4 or 8, its upper half does not matter for 32 bits
+                instructions.emplace_back(ASM::Mov(type, source, ASM::Reg(ASM::Reg::Name::AX)));
+                instructions.emplace_back(ASM::Lea(ASM::Indexed(ASM::Reg(ASM::Reg::Name::AX),
+                                                                ASM::Reg(ASM::Reg::Name::AX),
+                                                                static_cast<int>(odd - 1)),
+                                                   ASM::Reg(ASM::Reg::Name::AX)));
+                instructions.emplace_back(ASM::Mov(type, ASM::Reg(ASM::Reg::Name::AX), destination));
+            }
+            if (shift) {
+                instructions.emplace_back(ASM::Binary(ASM::Binary::Operator::SHL, type, ASM::Imm(shift),
+                                                      destination));
+            }
+            return true;
+        }
+
+        void unsigned_divide_by_constant(const ASM::Operand &dividend, std::uint64_t divisor, const ASM::Type &type,
+                                         int width, bool remainder, const ASM::Operand &destination,
+                                         std::vector<ASM::Instruction> &instructions) {
+            auto binary = [&](ASM::Binary::Operator op, ASM::Operand left, const ASM::Operand &right) {
+                instructions.emplace_back(ASM::Binary(op, type, std::move(left), right));
+            };
+            if (std::has_single_bit(divisor)) {
+                instructions.emplace_back(ASM::Mov(type, dividend, destination));
+                if (remainder) {
+                    binary(ASM::Binary::Operator::AND, ASM::Imm(divisor - 1), destination);
+                } else if (divisor > 1) {
+                    binary(ASM::Binary::Operator::SHR, ASM::Imm(std::countr_zero(divisor)), destination);
+                }
+                return;
+            }
+            auto quotient = make_temporary(type);
+            if (divisor > std::uint64_t(1) << (width - 1)) {
+                // the quotient is 0 or 1
+                instructions.emplace_back(ASM::Mov(type, ASM::Imm(0), quotient));
+                instructions.emplace_back(ASM::Cmp(type, ASM::Imm(divisor), dividend));
+                instructions.emplace_back(ASM::SetCC(ASM::ConditionCode::AE, quotient));
+            } else {
+                auto magic = unsigned_division_magic(divisor, width);
+                auto high = ASM::Reg(ASM::Reg::Name::DX);
+                instructions.emplace_back(ASM::Mov(type, dividend, ASM::Reg(ASM::Reg::Name::AX)));
+                instructions.emplace_back(ASM::Mul(type, ASM::Imm(magic.multiplier), false));
+                if (!magic.add) {
+                    instructions.emplace_back(ASM::Mov(type, high, quotient));
+                    if (magic.shift) binary(ASM::Binary::Operator::SHR, ASM::Imm(magic.shift), quotient);
+                } else {
+                    // (high + (x - high) / 2) / 2^(shift - 1) does not overflow
+                    instructions.emplace_back(ASM::Mov(type, dividend, quotient));
+                    binary(ASM::Binary::Operator::SUB, high, quotient);
+                    binary(ASM::Binary::Operator::SHR, ASM::Imm(1), quotient);
+                    binary(ASM::Binary::Operator::ADD, high, quotient);
+                    binary(ASM::Binary::Operator::SHR, ASM::Imm(magic.shift - 1), quotient);
+                }
+            }
+            finish_division(dividend, divisor, type, quotient, remainder, destination, instructions);
+        }
+
+        void signed_divide_by_constant(const ASM::Operand &dividend, std::uint64_t divisor, const ASM::Type &type,
+                                       int width, bool remainder, const ASM::Operand &destination,
+                                       std::vector<ASM::Instruction> &instructions) {
+            auto binary = [&](ASM::Binary::Operator op, ASM::Operand left, const ASM::Operand &right) {
+                instructions.emplace_back(ASM::Binary(op, type, std::move(left), right));
+            };
+            std::uint64_t sign = std::uint64_t(1) << (width - 1);
+            bool negative = divisor & sign;
+            // the magnitude of the most negative divisor is 2^(width - 1), a power of two as an unsigned number
+            auto magnitude = negative ? (~divisor + 1) & (sign | (sign - 1)) : divisor;
+            if (magnitude == 1) {
+                if (remainder) {
+                    instructions.emplace_back(ASM::Mov(type, ASM::Imm(0), destination));
+                    return;
+                }
+                instructions.emplace_back(ASM::Mov(type, dividend, destination));
+                if (negative) instructions.emplace_back(ASM::Unary(ASM::Unary::Operator::Neg, type, destination));
+                return;
+            }
+            if (std::has_single_bit(magnitude)) {
+                // a negative dividend is biased by 2^k - 1 so the shift rounds toward zero
+                int k = std::countr_zero(magnitude);
+                auto bias = make_temporary(type);
+                instructions.emplace_back(ASM::Mov(type, dividend, bias));
+                if (k > 1) binary(ASM::Binary::Operator::SAR, ASM::Imm(width - 1), bias);
+                binary(ASM::Binary::Operator::SHR, ASM::Imm(width - k), bias);
+                auto result = make_temporary(type);
+                instructions.emplace_back(ASM::Mov(type, dividend, result));
+                binary(ASM::Binary::Operator::ADD, bias, result);
+                if (remainder) {
+                    binary(ASM::Binary::Operator::AND, ASM::Imm(magnitude - 1), result);
+                    binary(ASM::Binary::Operator::SUB, bias, result);
+                } else {
+                    binary(ASM::Binary::Operator::SAR, ASM::Imm(k), result);
+                    if (negative) instructions.emplace_back(ASM::Unary(ASM::Unary::Operator::Neg, type, result));
+                }
+                instructions.emplace_back(ASM::Mov(type, result, destination));
+                return;
+            }
+            auto magic = signed_division_magic(magnitude, width);
+            auto quotient = make_temporary(type);
+            instructions.emplace_back(ASM::Mov(type, dividend, ASM::Reg(ASM::Reg::Name::AX)));
+            instructions.emplace_back(ASM::Mul(type, ASM::Imm(magic.multiplier), true));
+            instructions.emplace_back(ASM::Mov(type, ASM::Reg(ASM::Reg::Name::DX), quotient));
+            if (magic.add) binary(ASM::Binary::Operator::ADD, dividend, quotient);
+            if (magic.shift) binary(ASM::Binary::Operator::SAR, ASM::Imm(magic.shift), quotient);
+            // rounds toward zero: one more for a negative dividend
+            auto sign_bit = make_temporary(type);
+            instructions.emplace_back(ASM::Mov(type, dividend, sign_bit));
+            binary(ASM::Binary::Operator::SHR, ASM::Imm(width - 1), sign_bit);
+            binary(ASM::Binary::Operator::ADD, sign_bit, quotient);
+            if (negative) instructions.emplace_back(ASM::Unary(ASM::Unary::Operator::Neg, type, quotient));
+            finish_division(dividend, divisor, type, quotient, remainder, destination, instructions);
+        }
+
+        // the quotient or x - quotient * divisor into the destination
+        void finish_division(const ASM::Operand &dividend, std::uint64_t divisor, const ASM::Type &type,
+                             const ASM::Operand &quotient, bool remainder, const ASM::Operand &destination,
+                             std::vector<ASM::Instruction> &instructions) {
+            if (!remainder) {
+                instructions.emplace_back(ASM::Mov(type, quotient, destination));
+                return;
+            }
+            instructions.emplace_back(ASM::Binary(ASM::Binary::Operator::MULT, type, ASM::Imm(divisor), quotient));
+            instructions.emplace_back(ASM::Mov(type, dividend, destination));
+            instructions.emplace_back(ASM::Binary(ASM::Binary::Operator::SUB, type, quotient, destination));
+        }
+
         void convert_relational(const IR::Binary &instruction, std::vector<ASM::Instruction> &instructions) {
             // add comment!
             bool use_alt_instructions = is_unsigned(instruction.left_source) || std::holds_alternative<ASM::Double>(
@@ -957,6 +1391,11 @@ namespace codegen {
             instructions.emplace_back(ASM::Jmp(instruction.target));
         }
 
+        void convert_jump_table(const IR::JumpTable &instruction, std::vector<ASM::Instruction> &instructions) {
+            instructions.emplace_back(ASM::JumpTable(gen_jump_label("table."), get_type_for_value(instruction.index),
+                                                     convert_value(instruction.index), instruction.targets));
+        }
+
         void convert_jump_if_zero(const IR::JumpIfZero &instruction, std::vector<ASM::Instruction> &instructions) {
             if (std::holds_alternative<ASM::Double>(get_type_for_value(instruction.condition))) {
                 instructions.emplace_back(ASM::Binary(ASM::Binary::Operator::XOR, ASM::Double(),
@@ -1002,6 +1441,12 @@ namespace codegen {
             return label;
         }
 
+        ASM::Pseudo make_temporary(const ASM::Type &type) {
+            auto name = "codegen.tmp." + std::to_string(cnt++);
+            asmSymbols[name] = ASM::ObjectSymbol(type, false, false);
+            return ASM::Pseudo(name);
+        }
+
         std::string gen_jump_label(std::string label) {
             // codegen prefix needed?
             return "codegen." + label + std::to_string(cnt++);
@@ -1016,13 +1461,19 @@ namespace codegen {
         int cnt = 0;
         IR::Program IRProgram;
         std::unordered_map<std::string, Symbol> *symbols;
+        bool tail_calls;
+        // variables of every function that hold a whole xmm register
+        std::unordered_set<std::string> vectors;
     };
 
     class ReplacePseudoRegistersPass {
     public:
+        // share_slots lets pseudos that are never live at the same time use the same stack slot
         explicit ReplacePseudoRegistersPass(ASM::Program *asmProgram,
                                             std::unordered_map<std::string, ASM::Symbol> *
-                                            symbols) : asmProgram(asmProgram), symbols(symbols) {
+                                            symbols, bool share_slots = false) : asmProgram(asmProgram),
+                                                                                 symbols(symbols),
+                                                                                 share_slots(share_slots) {
         }
 
         void process() {
@@ -1034,106 +1485,159 @@ namespace codegen {
         }
 
         void visit_function(ASM::Function &function) {
+            assign_offsets(function);
             for (auto &instruction: function.instructions) {
                 visit_instruction(instruction);
             }
             function.stack_size = offset;
-            offset = -4;
             m_offsets.clear();
         }
 
         void visit_instruction(ASM::Instruction &instruction) {
-            std::visit(overloaded{
-                           [this](ASM::Mov &mov) {
-                               replace(mov.dst);
-                               replace(mov.src);
-                           },
-                           [this](ASM::Unary &unary) {
-                               replace(unary.operand);
-                           },
-                           [this](ASM::Binary &binary) {
-                               replace(binary.left);
-                               replace(binary.right);
-                           },
-                           [this](ASM::Idiv &idiv) {
-                               replace(idiv.divisor);
-                           },
-                           [this](ASM::Cmp &cmp) {
-                               replace(cmp.left);
-                               replace(cmp.right);
-                           },
-                           [this](ASM::SetCC &mov) {
-                               replace(mov.destination);
-                           },
-                           [this](ASM::Push &push) {
-                               replace(push.value);
-                           },
-                           [this](ASM::Movsx &mov) {
-                               replace(mov.destination);
-                               replace(mov.source);
-                           },
-                           [this](ASM::Div &div) {
-                               replace(div.divisor);
-                           },
-                           [this](ASM::MovZeroExtend &movz) {
-                               replace(movz.destination);
-                               replace(movz.source);
-                           },
-                           [this](ASM::Cvtsi2sd &cvtsi2sd) {
-                               replace(cvtsi2sd.destination);
-                               replace(cvtsi2sd.source);
-                           },
-                           [this](ASM::Cvttsd2si &cvttsd2si) {
-                               replace(cvttsd2si.destination);
-                               replace(cvttsd2si.source);
-                           },
-                           [this](ASM::Lea &lea) {
-                               replace(lea.destination);
-                               replace(lea.source);
-                           },
-                           [this](auto &) {
-                           }
-                       }, instruction);
+            for_each_operand(instruction, [this](ASM::Operand &operand) { replace(operand); });
         }
 
-        int offset = -4;
+        // bottom of the last frame laid out
+        int offset = 0;
 
     private:
-        void replace(ASM::Operand &operand) {
-            std::string name;
-            int add_offset = 0;
-            if (std::holds_alternative<ASM::Pseudo>(operand)) {
-                name = std::get<ASM::Pseudo>(operand).name;
-            } else if (std::holds_alternative<ASM::PseudoMem>(operand)) {
-                name = std::get<ASM::PseudoMem>(operand).identifier;
-                add_offset = std::get<ASM::PseudoMem>(operand).offset;
-            } else {
-                return;
+        struct StackObject {
+            int size;
+            int alignment;
+            // pseudos stored in it
+            std::vector<std::string> names;
+        };
+
+        static std::pair<int, int> size_and_alignment(const ASM::Type &type) {
+            return std::visit(overloaded{
+                                  [](const ASM::Byte &) { return std::pair(1, 1); },
+                                  [](const ASM::LongWord &) { return std::pair(4, 4); },
+                                  [](const ASM::Vector &) { return std::pair(16, 16); },
+                                  [](const ASM::ByteArray &array) { return std::pair(array.size, array.alignment); },
+                                  [](const auto &) { return std::pair(8, 8); },
+                              }, type);
+        }
+
+        bool is_static(const std::string &name) {
+            auto it = symbols->find(name);
+            return it != symbols->end() && std::get<ASM::ObjectSymbol>(it->second).is_static;
+        }
+
+        ASM::Type type_of(const std::string &name) {
+            auto it = symbols->find(name);
+            return it == symbols->end() ? ASM::Type(ASM::QuadWord()) : std::get<ASM::ObjectSymbol>(it->second).type;
+        }
+
+        // the callee saved registers are pushed right below the frame pointer, everything else goes under them,
+        // largest alignment first so nothing but the end of the frame needs padding
+        void assign_offsets(ASM::Function &function) {
+            std::vector<std::string> names;
+            std::unordered_set<std::string> seen;
+            for (auto &instruction: function.instructions) {
+                for_each_operand(instruction, [&](ASM::Operand &operand) {
+                    const std::string *name = nullptr;
+                    if (auto *pseudo = std::get_if<ASM::Pseudo>(&operand)) {
+                        name = &pseudo->name;
+                    } else if (auto *pseudo_mem = std::get_if<ASM::PseudoMem>(&operand)) {
+                        name = &pseudo_mem->identifier;
+                    }
+                    if (name && !is_static(*name) && seen.insert(*name).second) {
+                        names.push_back(*name);
+                    }
+                });
             }
 
-            if (symbols->contains(name) && std::get<ASM::ObjectSymbol>((*symbols)[name]).is_static) {
-                operand = ASM::Data(name);
-            } else {
-                if (m_offsets.contains(name)) {
-                    operand = ASM::Memory(ASM::Reg(ASM::Reg::Name::BP), m_offsets[name] + add_offset);
-                } else {
+            std::vector<StackObject> objects;
+            std::unordered_set<std::string> shared;
+            if (share_slots) {
+                share(function, objects);
+                for (const auto &object: objects) {
+                    shared.insert(object.names.begin(), object.names.end());
+                }
+            }
+            // aggregates and pseudos whose address is taken get a slot of their own
+            for (const auto &name: names) {
+                if (shared.contains(name)) continue;
+                auto [size, alignment] = size_and_alignment(type_of(name));
+                objects.push_back(StackObject{size, alignment, {name}});
+            }
+
+            std::ranges::stable_sort(objects, [](const StackObject &a, const StackObject &b) {
+                return a.alignment > b.alignment;
+            });
+            offset = -8 * static_cast<int>(function.callee_saved.size());
+            for (const auto &object: objects) {
+                offset -= object.size;
+                // round down towards the next aligned address
+                offset = -((-offset + object.alignment - 1) / object.alignment * object.alignment);
+                for (const auto &name: object.names) {
                     m_offsets[name] = offset;
-                    // why we only round down in case of 8 bytes and above?
-                    auto& type = std::get<ASM::ObjectSymbol>((*symbols)[name]).type;
-                    if (std::holds_alternative<ASM::Byte>(type)) {
-                        offset -= 1;
-                    } else if (std::holds_alternative<ASM::LongWord>(type)) {
-                        offset -= 4;
-                    } else {
-                        if (std::holds_alternative<ASM::ByteArray>(type)) {
-                            offset -= std::get<ASM::ByteArray>(type).size;
-                        } else {
-                            offset -= 8;
-                        }
-                        // is it good alignment always?
-                        offset = ((offset - 15) / 16) * 16;
-                    }
-                    operand = ASM::Memory(ASM::Reg(ASM::Reg::Name::BP), (m_offsets[name] = offset) + add_offset);
+                }
+            }
+        }
+
+        // colors the interference graph of the pseudos that can share a slot, slots only hold pseudos of one size
+        void share(const ASM::Function &function, std::vector<StackObject> &objects) {
+            RegisterNodes nodes(function, *symbols, {});
+            AsmLiveness liveness(function.instructions, nodes);
+            std::vector<std::unordered_set<int> > adjacency(nodes.size());
+            liveness.walk([&](std::size_t i, const optimization::BitSet &live) {
+                int source = -1;
+                if (auto *mov = std::get_if<ASM::Mov>(&function.instructions[i])) {
+                    source = nodes.of(mov->src);
+                }
+                for (int def: liveness.defs(i)) {
+                    live.for_each([&](std::size_t other) {
+                        int node = static_cast<int>(other);
+                        if (node == def || node == source) return;
+                        adjacency[def].insert(node);
+                        adjacency[node].insert(def);
+                    });
+                }
+            });
+
+            std::vector<int> order(nodes.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::vector<int> sizes(nodes.size());
+            for (int node = 0; node < nodes.size(); node++) {
+                sizes[node] = size_and_alignment(nodes.nodes[node].type).first;
+            }
+            std::ranges::stable_sort(order, [&](int a, int b) { return sizes[a] > sizes[b]; });
+
+            std::vector<int> slot_of(nodes.size(), -1);
+            // stamps instead of clearing the taken slots for every pseudo
+            std::vector<int> taken;
+            for (int node: order) {
+                for (int neighbor: adjacency[node]) {
+                    if (slot_of[neighbor] != -1) taken[slot_of[neighbor]] = node;
+                }
+                int slot = 0;
+                while (slot < static_cast<int>(objects.size()) &&
+                       (objects[slot].size != sizes[node] || taken[slot] == node)) {
+                    slot++;
+                }
+                if (slot == static_cast<int>(objects.size())) {
+                    objects.push_back(StackObject{sizes[node], sizes[node], {}});
+                    taken.push_back(-1);
+                }
+                objects[slot].names.push_back(nodes.nodes[node].pseudo);
+                slot_of[node] = slot;
+            }
+        }
+
+        void replace(ASM::Operand &operand) {
+            if (auto *pseudo = std::get_if<ASM::Pseudo>(&operand)) {
+                if (is_static(pseudo->name)) {
+                    operand = ASM::Data(pseudo->name);
+                } else {
+                    operand = ASM::Memory(ASM::Reg(ASM::Reg::Name::BP), m_offsets.at(pseudo->name));
+                }
+            } else if (auto *pseudo_mem = std::get_if<ASM::PseudoMem>(&operand)) {
+                if (is_static(pseudo_mem->identifier)) {
+                    operand = ASM::Data(pseudo_mem->identifier);
+                } else {
+                    operand = ASM::Memory(ASM::Reg(ASM::Reg::Name::BP),
+                                          m_offsets.at(pseudo_mem->identifier) + pseudo_mem->offset);
                 }
             }
         }
@@ -1141,6 +1645,7 @@ namespace codegen {
         std::unordered_map<std::string, ASM::Symbol> *symbols;
         std::unordered_map<std::string, int> m_offsets;
         ASM::Program *asmProgram;
+        bool share_slots;
     };
 
     class FixUpInstructionsPass {
@@ -1159,7 +1664,9 @@ namespace codegen {
 
         void visit_function(ASM::Function &function) {
             std::vector<ASM::Instruction> fixed_instructions;
-            int rounded_stack_size = ((-function.stack_size + 15) / 16) * 16;
+            // the prologue already pushed the callee saved registers, which are part of the frame
+            int rounded_stack_size = ((-function.stack_size + 15) / 16) * 16 -
+                                     8 * static_cast<int>(function.callee_saved.size());
             fixed_instructions.emplace_back(ASM::Binary(ASM::Binary::Operator::SUB, ASM::QuadWord(),
                                                         ASM::Imm(rounded_stack_size), ASM::Reg(ASM::Reg::Name::SP)));
 
@@ -1196,6 +1703,12 @@ namespace codegen {
                 case ASM::Reg::Name::XMM5:
                 case ASM::Reg::Name::XMM6:
                 case ASM::Reg::Name::XMM7:
+                case ASM::Reg::Name::XMM8:
+                case ASM::Reg::Name::XMM9:
+                case ASM::Reg::Name::XMM10:
+                case ASM::Reg::Name::XMM11:
+                case ASM::Reg::Name::XMM12:
+                case ASM::Reg::Name::XMM13:
                 case ASM::Reg::Name::XMM14:
                 case ASM::Reg::Name::XMM15:
                     return true;
@@ -1284,6 +1797,59 @@ namespace codegen {
             }
         }
 
+        void fix_jump_table(ASM::JumpTable &table, std::vector<ASM::Instruction> &output) {
+            // the emitter addresses the table with the index in r10, a 32 bit move clears its upper half
+            output.emplace_back(ASM::Mov(table.type, table.index, ASM::Reg(ASM::Reg::Name::R10)));
+            table.type = ASM::QuadWord();
+            table.index = ASM::Reg(ASM::Reg::Name::R10);
+            output.emplace_back(table);
+        }
+
+        // packed instructions only read memory that is 16 byte aligned, movdqu takes any
+        void load_vector(ASM::Operand &operand, ASM::Reg::Name scratch, std::vector<ASM::Instruction> &output) {
+            if (std::holds_alternative<ASM::Reg>(operand)) return;
+            output.emplace_back(ASM::Mov(ASM::Vector(), operand, ASM::Reg(scratch)));
+            operand = ASM::Reg(scratch);
+        }
+
+        // the destination of a packed instruction is a register, xmm15 stands in for one in memory
+        template<typename Instruction>
+        void store_vector(Instruction &instruction, ASM::Operand &destination, bool read,
+                          std::vector<ASM::Instruction> &output) {
+            if (std::holds_alternative<ASM::Reg>(destination)) {
+                output.emplace_back(instruction);
+                return;
+            }
+            auto memory = destination;
+            if (read) output.emplace_back(ASM::Mov(ASM::Vector(), memory, ASM::Reg(ASM::Reg::Name::XMM15)));
+            destination = ASM::Reg(ASM::Reg::Name::XMM15);
+            output.emplace_back(instruction);
+            output.emplace_back(ASM::Mov(ASM::Vector(), ASM::Reg(ASM::Reg::Name::XMM15), memory));
+        }
+
+        void fix_packed_binary(ASM::PackedBinary &binary, std::vector<ASM::Instruction> &output) {
+            load_vector(binary.left, ASM::Reg::Name::XMM14, output);
+            store_vector(binary, binary.right, true, output);
+        }
+
+        void fix_packed_shuffle(ASM::PackedShuffle &shuffle, std::vector<ASM::Instruction> &output) {
+            load_vector(shuffle.source, ASM::Reg::Name::XMM14, output);
+            store_vector(shuffle, shuffle.destination, false, output);
+        }
+
+        void fix_mov_to_vector(ASM::MovToVector &mov, std::vector<ASM::Instruction> &output) {
+            if (std::holds_alternative<ASM::Imm>(mov.source)) {
+                output.emplace_back(ASM::Mov(mov.type, mov.source, ASM::Reg(ASM::Reg::Name::R10)));
+                mov.source = ASM::Reg(ASM::Reg::Name::R10);
+            }
+            store_vector(mov, mov.destination, false, output);
+        }
+
+        void fix_mov_from_vector(ASM::MovFromVector &mov, std::vector<ASM::Instruction> &output) {
+            load_vector(mov.source, ASM::Reg::Name::XMM15, output);
+            output.emplace_back(mov);
+        }
+
         void visit_instruction(ASM::Instruction &instruction, std::vector<ASM::Instruction> &output) {
             std::visit(overloaded{
                            [this, &output](ASM::Mov &mov) {
@@ -1307,6 +1873,9 @@ namespace codegen {
                            [this, &output](ASM::Div &div) {
                                fix_div(div, output);
                            },
+                           [this, &output](ASM::Mul &mul) {
+                               fix_mul(mul, output);
+                           },
                            [this, &output](ASM::MovZeroExtend &mov) {
                                fix_mov_zero_extend(mov, output);
                            },
@@ -1319,6 +1888,21 @@ namespace codegen {
                            [this, &output](ASM::Lea &lea) {
                                fix_lea(lea, output);
                            },
+                           [this, &output](ASM::JumpTable &table) {
+                               fix_jump_table(table, output);
+                           },
+                           [this, &output](ASM::PackedBinary &binary) {
+                               fix_packed_binary(binary, output);
+                           },
+                           [this, &output](ASM::PackedShuffle &shuffle) {
+                               fix_packed_shuffle(shuffle, output);
+                           },
+                           [this, &output](ASM::MovToVector &mov) {
+                               fix_mov_to_vector(mov, output);
+                           },
+                           [this, &output](ASM::MovFromVector &mov) {
+                               fix_mov_from_vector(mov, output);
+                           },
                            [&output](auto &instruction) {
                                output.emplace_back(instruction);
                            },
@@ -1331,7 +1915,7 @@ namespace codegen {
 
         void fix_mov(ASM::Mov &mov, std::vector<ASM::Instruction> &output) {
             if (is_memory_address(mov.src) && is_memory_address(mov.dst)) {
-                if (std::holds_alternative<ASM::Double>(mov.type)) {
+                if (std::holds_alternative<ASM::Double>(mov.type) || std::holds_alternative<ASM::Vector>(mov.type)) {
                     output.emplace_back(ASM::Mov{mov.type, mov.src, ASM::Reg(ASM::Reg::Name::XMM14)});
                     mov.src = ASM::Reg(ASM::Reg::Name::XMM14);
                 } else {
@@ -1375,9 +1959,11 @@ namespace codegen {
                     std::abort();
                 }
             } else {
+                bool count_in_cl = std::holds_alternative<ASM::Reg>(binary.left) &&
+                                   std::get<ASM::Reg>(binary.left).name == ASM::Reg::Name::CX;
                 if ((binary.op == ASM::Binary::Operator::SHR || binary.op == ASM::Binary::Operator::SHL || binary.op ==
                      ASM::Binary::Operator::SAR) &&
-                    is_memory_address(binary.right)) {
+                    !std::holds_alternative<ASM::Imm>(binary.left) && !count_in_cl) {
                     output.emplace_back(ASM::Mov{binary.type, binary.left, ASM::Reg(ASM::Reg::Name::CX)});
                     binary.left = ASM::Reg(ASM::Reg::Name::CX);
                     output.emplace_back(binary);
@@ -1418,6 +2004,14 @@ namespace codegen {
             output.emplace_back(div);
         }
 
+        void fix_mul(ASM::Mul &mul, std::vector<ASM::Instruction> &output) {
+            if (std::holds_alternative<ASM::Imm>(mul.factor)) {
+                output.emplace_back(ASM::Mov{mul.type, mul.factor, ASM::Reg(ASM::Reg::Name::R10)});
+                mul.factor = ASM::Reg(ASM::Reg::Name::R10);
+            }
+            output.emplace_back(mul);
+        }
+
         void fix_cmp(ASM::Cmp &cmp, std::vector<ASM::Instruction> &output) {
             if (std::holds_alternative<ASM::Double>(cmp.type)) {
                 if (!std::holds_alternative<ASM::Reg>(cmp.right)) {
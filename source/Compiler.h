@@ -1,8 +1,13 @@
 #ifndef COMPILER_H
 #define COMPILER_H
+#include <algorithm>
+#include <fcntl.h>
+#include <filesystem>
+#include <format>
 #include <iostream>
 #include <ostream>
 #include <string>
+#include <unistd.h>
 
 #include "AstPrinter.h"
 #include "CodeEmitter.h"
@@ -10,28 +15,39 @@
 #include "IRGenerator.h"
 #include "IRPrinter.h"
 #include "Lexer.h"
+#include "LinearScanAllocationPass.h"
 #include "Parser.h"
+#include "PeepholePass.h"
+#include "RegisterAllocationPass.h"
 #include "analysis/LabelResolutionPass.h"
 #include "analysis/LoopLabelingPass.h"
 #include "analysis/SwitchResolutionPass.h"
 #include "analysis/TypeCheckerPass.h"
 #include "analysis/VariableResolutionPass.h"
+#include "common/DumpOptions.h"
+#include "common/OutputBuffer.h"
+#include "common/StageTimings.h"
+#include "optimization/Optimizer.h"
 
 
 class Compiler {
 public:
-    std::optional<std::string> compile(const std::string &input) {
+    bool compile(const std::string &input, OutputBuffer &output) {
         Lexer lexer(input);
-        lexer.lex();
+        stage("Lexer", [&] { lexer.lex(); });
+        if (timings) {
+            timings->tokens += lexer.tokens.size();
+            timings->lines += std::ranges::count(input, '\n');
+        }
         if (!lexer.errors.empty()) {
             std::cerr << "lexing failed!" << '\n';
             for (const auto &error: lexer.errors) {
                 std::cerr << error.message << '\n';
             }
-            return {};
+            return false;
         }
         if (only_lex) {
-            return "";
+            return true;
         }
 
         // for (const auto& token : lexer.tokens) {
@@ -39,102 +55,150 @@ public:
         // }
 
         Parser parser(lexer.tokens);
-        parser.parse();
+        stage("Parser", [&] { parser.parse(); });
         if (!parser.errors.empty()) {
             std::cerr << "parsing failed!" << '\n';
             for (const auto &error: parser.errors) {
                 std::cerr << error.message << '\n';
             }
-            return {};
+            return false;
         }
 
-        AstPrinter printer;
-        printer.program(parser.program);
+        dump(DumpOptions::Stage::PARSE, [&](OutputBuffer &out) {
+            AstPrinter printer(&out);
+            printer.function_filter = dump_options.function;
+            printer.program(parser.program);
+        });
         if (only_parse) {
-            return "";
+            return true;
         }
 
         VariableResolutionPass variable_resolution_pass(&parser.program);
-        variable_resolution_pass.run();
+        stage("VariableResolutionPass", [&] { variable_resolution_pass.run(); });
         if (!variable_resolution_pass.errors.empty()) {
             std::cerr << "variable resolution failed!" << '\n';
             for (const auto &error: variable_resolution_pass.errors) {
                 std::cerr << error.message << '\n';
             }
-            return {};
+            return false;
         }
 
         TypeCheckerPass type_checker(&parser.program);
-        type_checker.run();
+        stage("TypeCheckerPass", [&] { type_checker.run(); });
         if (!type_checker.errors.empty()) {
             std::cerr << "type check failed!" << '\n';
             for (const auto &error: type_checker.errors) {
                 std::cerr << error.message << '\n';
             }
-            return {};
+            return false;
         }
 
         LabelResolutionPass label_resolution_pass(&parser.program);
-        label_resolution_pass.run();
+        stage("LabelResolutionPass", [&] { label_resolution_pass.run(); });
         if (!label_resolution_pass.errors.empty()) {
             std::cerr << "label resolution failed!" << '\n';
             for (const auto &error: label_resolution_pass.errors) {
                 std::cerr << error.message << '\n';
             }
-            return {};
+            return false;
         }
 
         LoopLabelingPass loop_labeling_pass(&parser.program);
-        loop_labeling_pass.run();
+        stage("LoopLabelingPass", [&] { loop_labeling_pass.run(); });
         if (!loop_labeling_pass.errors.empty()) {
             std::cerr << "loop labeling failed!" << '\n';
             for (const auto &error: loop_labeling_pass.errors) {
                 std::cerr << error.message << '\n';
             }
-            return {};
+            return false;
         }
 
         SwitchResolutionPass switch_resolution_pass(&parser.program);
-        switch_resolution_pass.run();
+        stage("SwitchResolutionPass", [&] { switch_resolution_pass.run(); });
         if (!switch_resolution_pass.errors.empty()) {
             std::cerr << "switch resolution failed!" << '\n';
             for (const auto &error: switch_resolution_pass.errors) {
                 std::cerr << error.message << '\n';
             }
-            return {};
+            return false;
         }
 
+        dump(DumpOptions::Stage::TYPECHECK, [&](OutputBuffer &out) {
+            AstPrinter printer(&out);
+            printer.function_filter = dump_options.function;
+            printer.program(parser.program);
+        });
         if (only_analysis) {
-            return "";
+            return true;
         }
 
         IRGenerator generator(std::move(parser.program), &type_checker.symbols);
-        generator.generate();
+        stage("IRGenerator", [&] { generator.generate(); });
+
+        dump(DumpOptions::Stage::IR, [&](OutputBuffer &out) {
+            IRPrinter printer(&generator.IRProgram, &out);
+            printer.function_filter = dump_options.function;
+            printer.print();
+        });
 
-        IRPrinter ir_printer(&generator.IRProgram);
-        ir_printer.print();
+        if (optimization.any()) {
+            optimization::Optimizer optimizer(&generator.IRProgram, &type_checker.symbols, optimization,
+                                              inlining_report);
+            stage("Optimizer", [&] { optimizer.run(); });
+            dump(DumpOptions::Stage::OPT, [&](OutputBuffer &out) {
+                IRPrinter printer(&generator.IRProgram, &out);
+                printer.function_filter = dump_options.function;
+                printer.print();
+            });
+        }
+        dump(DumpOptions::Stage::CFG, [&](OutputBuffer &out) {
+            IRPrinter printer(&generator.IRProgram, &out);
+            printer.function_filter = dump_options.function;
+            printer.print_cfg();
+        });
         if (only_ir) {
-            return "";
+            return true;
         }
 
-        codegen::IRToAsmTreePass ir_to_asm_tree_pass(std::move(generator.IRProgram), &type_checker.symbols);
-        ir_to_asm_tree_pass.convert();
+        codegen::IRToAsmTreePass ir_to_asm_tree_pass(std::move(generator.IRProgram), &type_checker.symbols,
+                                                     optimization.tail_calls);
+        stage("IRToAsmTreePass", [&] { ir_to_asm_tree_pass.convert(); });
         auto &asm_tree = ir_to_asm_tree_pass.asmProgram;
-        codegen::ReplacePseudoRegistersPass replace_pseudo_registers_pass(&asm_tree, &ir_to_asm_tree_pass.asmSymbols);
-        replace_pseudo_registers_pass.process();
+        dump(DumpOptions::Stage::ASM, [&](OutputBuffer &out) {
+            dump_asm(asm_tree, ir_to_asm_tree_pass.asmSymbols, out);
+        });
+        if (optimization.register_allocator == optimization::RegisterAllocator::LINEAR_SCAN) {
+            codegen::LinearScanAllocationPass linear_scan_allocation_pass(&asm_tree, &ir_to_asm_tree_pass.asmSymbols);
+            stage("LinearScanAllocationPass", [&] { linear_scan_allocation_pass.process(); });
+        } else if (optimization.register_allocator == optimization::RegisterAllocator::GRAPH_COLORING) {
+            codegen::RegisterAllocationPass register_allocation_pass(&asm_tree, &ir_to_asm_tree_pass.asmSymbols);
+            stage("RegisterAllocationPass", [&] { register_allocation_pass.process(); });
+        }
+        codegen::ReplacePseudoRegistersPass replace_pseudo_registers_pass(&asm_tree, &ir_to_asm_tree_pass.asmSymbols,
+                                                                          optimization.share_stack_slots);
+        stage("ReplacePseudoRegistersPass", [&] { replace_pseudo_registers_pass.process(); });
 
         int max_offset = replace_pseudo_registers_pass.offset;
 
         codegen::FixUpInstructionsPass fix_up_instructions_pass(&asm_tree, max_offset);
-        fix_up_instructions_pass.process();
+        stage("FixUpInstructionsPass", [&] { fix_up_instructions_pass.process(); });
+        dump(DumpOptions::Stage::FIXUP, [&](OutputBuffer &out) {
+            dump_asm(asm_tree, ir_to_asm_tree_pass.asmSymbols, out);
+        });
         if (only_codegen) {
-            return "";
+            return true;
+        }
+        if (optimization.peephole) {
+            codegen::PeepholePass peephole_pass(&asm_tree, peephole_statistics);
+            stage("PeepholePass", [&] { peephole_pass.process(); });
         }
 
-        CodeEmitter emitter(std::move(asm_tree), &ir_to_asm_tree_pass.asmSymbols);
-        emitter.emit();
+        CodeEmitter emitter(&asm_tree, &ir_to_asm_tree_pass.asmSymbols, &output);
+        stage("CodeEmitter", [&] { emitter.emit(); });
 
-        return emitter.assembly;
+        // the last chunk has to be written before failed() can tell whether the output is complete
+        output.flush();
+        return !output.failed();
     }
 
     bool only_lex = false;
@@ -142,6 +206,58 @@ public:
     bool only_codegen = false;
     bool only_ir = false;
     bool only_analysis = false;
+
+    optimization::OptimizationOptions optimization;
+
+    // per stage timings are collected only when set
+    StageTimings *timings = nullptr;
+    // how often each peephole pattern fired, collected only when set
+    codegen::PeepholeStatistics *peephole_statistics = nullptr;
+    // every inlining decision, collected only when set
+    optimization::InliningReport *inlining_report = nullptr;
+
+    DumpOptions dump_options;
+    // dump files are named after this path, e.g. foo.c -> foo.ir.dump
+    std::filesystem::path dump_base = "out";
+
+private:
+    // nothing is built or opened unless the stage was requested
+    template<typename F>
+    void dump(DumpOptions::Stage dump_stage, F &&print) {
+        if (!dump_options.enabled(dump_stage)) {
+            return;
+        }
+        auto path = std::filesystem::path(dump_base).replace_extension(
+            std::format(".{}.dump", DumpOptions::stage_name(dump_stage)));
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1) {
+            std::cerr << "failed to open dump file " << path.string() << '\n';
+            return;
+        }
+        {
+            OutputBuffer out(fd);
+            print(out);
+        }
+        close(fd);
+    }
+
+    void dump_asm(const ASM::Program &program, std::unordered_map<std::string, ASM::Symbol> &symbols,
+                  OutputBuffer &out) {
+        CodeEmitter emitter(&program, &symbols, &out);
+        emitter.function_filter = dump_options.function;
+        emitter.emit();
+    }
+
+    template<typename F>
+    void stage(std::string_view name, F &&run) {
+        if (!timings) {
+            run();
+            return;
+        }
+        auto start = StageTimings::Clock::now();
+        run();
+        timings->add(name, StageTimings::Clock::now() - start);
+    }
 };
 
 
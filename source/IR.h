@@ -1,6 +1,7 @@
 #ifndef IR_H
 #define IR_H
 #include <string>
+#include <unordered_set>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -10,13 +11,15 @@
 namespace IR {
     using Value = std::variant<struct Constant, struct Variable>;
     using Instruction = std::variant<struct Return, struct Unary, struct Binary, struct Copy, struct Jump, struct
-        JumpIfZero, struct JumpIfNotZero, struct Label, struct Call, struct SignExtend, struct Truncate, struct ZeroExtend, struct DoubleToInt, struct DoubleToUInt, struct IntToDouble, struct UIntToDouble, struct GetAddress, struct Load, struct Store, struct AddPtr, struct CopyToOffset>;
+        JumpIfZero, struct JumpIfNotZero, struct Label, struct Call, struct SignExtend, struct Truncate, struct ZeroExtend, struct DoubleToInt, struct DoubleToUInt, struct IntToDouble, struct UIntToDouble, struct GetAddress, struct Load, struct Store, struct AddPtr, struct CopyToOffset, struct JumpTable, struct Phi, struct Broadcast, struct Reduce>;
 
     struct Function {
         std::string name;
         bool global;
         std::vector<std::string> params;
         std::vector<Instruction> instructions;
+        // variables made by LoopVectorizationPass that hold 16 bytes of elements of their symbol's type
+        std::unordered_set<std::string> vectors = {};
     };
 
     struct StaticVariable {
@@ -111,6 +114,12 @@ namespace IR {
         std::string target;
     };
 
+    // jumps to targets[index], the index is checked to be in range before, a label can appear more than once
+    struct JumpTable {
+        Value index;
+        std::vector<std::string> targets;
+    };
+
     struct Label {
         std::string name;
     };
@@ -183,6 +192,25 @@ namespace IR {
         std::string destination;
         int offset;
     };
+
+    // only exists while a function is in ssa form, one argument per predecessor of the block in the cfg
+    struct Phi {
+        std::vector<Value> arguments;
+        Value destination;
+    };
+
+    // the vector loops of LoopVectorizationPass, a vector variable gets every lane set to source
+    struct Broadcast {
+        Value source;
+        Value destination;
+    };
+
+    // combines the lanes of a vector variable with op, which is ADD, BITWISE_AND, BITWISE_OR or BITWISE_XOR
+    struct Reduce {
+        Binary::Operator op;
+        Value source;
+        Value destination;
+    };
 }
 
 #endif //IR_H
@@ -1,5 +1,6 @@
 #ifndef IRGENERATOR_H
 #define IRGENERATOR_H
+#include <algorithm>
 #include <functional>
 
 #include "AsmTree.h"
@@ -281,20 +282,39 @@ public:
         return instructions;
     }
 
+    // a run of cases becomes a jump table when it has at least this many cases and fills at least 40% of its range
+    static constexpr std::size_t min_jump_table_cases = 4;
+    static constexpr std::uint64_t max_jump_table_range = 1 << 16;
+    // at most this many clusters are compared one after another, more are split by a binary search
+    static constexpr std::size_t max_linear_clusters = 3;
+
+    struct SwitchCase {
+        AST::Const value;
+        // value as a 64 bit pattern, differences of sorted cases are their distance in either signedness
+        std::uint64_t bits;
+        std::string label;
+    };
+
+    // cases[first..last] dispatched through one table or, when first == last, one comparison
+    struct SwitchCluster {
+        std::size_t first;
+        std::size_t last;
+        bool table;
+    };
+
     std::vector<IR::Instruction> switch_stmt(const AST::SwitchStmt &stmt) {
         std::vector<IR::Instruction> instructions;
         auto result = gen_expr_and_convert(*stmt.expr, instructions);
+        std::vector<SwitchCase> cases;
         for (const auto &[value, label]: stmt.cases) {
-            auto cmp = make_variable(get_type(*stmt.expr));
-            // TODO: check!
-            instructions.emplace_back(IR::Binary(IR::Binary::Operator::EQUAL, result, IR::Constant(value), cmp));
-            instructions.emplace_back(IR::JumpIfNotZero(cmp, label));
-        }
-        if (stmt.has_default) {
-            instructions.emplace_back(IR::Jump(stmt.label + ".default"));
-        } else {
-            instructions.emplace_back(IR::Jump(stmt.label + ".break"));
+            auto bits = std::visit([](const auto &constant) { return static_cast<std::uint64_t>(constant.value); },
+                                   value);
+            cases.push_back(SwitchCase{value, bits, label});
         }
+        auto default_label = stmt.label + (stmt.has_default ? ".default" : ".break");
+        auto clusters = cluster_cases(cases);
+        lower_clusters(result, *get_type(*stmt.expr), cases, clusters, 0, clusters.size(), default_label,
+                       instructions);
 
         auto body_instructions = gen_stmt(*stmt.body);
         instructions.insert(instructions.end(), body_instructions.begin(), body_instructions.end());
@@ -303,6 +323,98 @@ public:
         return instructions;
     }
 
+    // fewest clusters covering the sorted cases, by dynamic programming over where the last cluster starts
+    static std::vector<SwitchCluster> cluster_cases(const std::vector<SwitchCase> &cases) {
+        std::vector<std::size_t> count(cases.size() + 1, 0);
+        std::vector<SwitchCluster> last_cluster(cases.size() + 1);
+        for (std::size_t end = 1; end <= cases.size(); end++) {
+            count[end] = count[end - 1] + 1;
+            last_cluster[end] = SwitchCluster{end - 1, end - 1, false};
+            for (std::size_t first = end - 1; first-- > 0;) {
+                auto distance = cases[end - 1].bits - cases[first].bits;
+                if (distance >= max_jump_table_range) break;
+                auto size = end - first;
+                if (size < min_jump_table_cases || size * 10 < (distance + 1) * 4) continue;
+                if (count[first] + 1 < count[end]) {
+                    count[end] = count[first] + 1;
+                    last_cluster[end] = SwitchCluster{first, end - 1, true};
+                }
+            }
+        }
+        std::vector<SwitchCluster> clusters;
+        for (auto end = cases.size(); end > 0; end = clusters.back().first) {
+            clusters.push_back(last_cluster[end]);
+        }
+        std::ranges::reverse(clusters);
+        return clusters;
+    }
+
+    // few clusters are tested in order, more are halved by comparing against the lowest case of the upper half
+    void lower_clusters(const IR::Value &value, const AST::Type &type, const std::vector<SwitchCase> &cases,
+                        const std::vector<SwitchCluster> &clusters, std::size_t first, std::size_t last,
+                        const std::string &default_label, std::vector<IR::Instruction> &instructions) {
+        if (last - first <= max_linear_clusters) {
+            for (auto i = first; i < last; i++) {
+                const auto &cluster = clusters[i];
+                if (cluster.table) {
+                    // a value outside of this table may still match a later cluster
+                    auto next_label = i + 1 == last ? default_label : make_label("switch_next");
+                    lower_jump_table(value, type, cases, cluster, next_label, default_label, instructions);
+                    if (i + 1 != last) instructions.emplace_back(IR::Label(next_label));
+                } else {
+                    auto cmp = make_variable(type);
+                    const auto &[constant, bits, label] = cases[cluster.first];
+                    instructions.emplace_back(IR::Binary(IR::Binary::Operator::EQUAL, value, IR::Constant(constant),
+                                                         cmp));
+                    instructions.emplace_back(IR::JumpIfNotZero(cmp, label));
+                }
+            }
+            if (first == last || !clusters[last - 1].table) instructions.emplace_back(IR::Jump(default_label));
+            return;
+        }
+        auto middle = first + (last - first) / 2;
+        auto lower_label = make_label("switch_lower");
+        auto cmp = make_variable(type);
+        instructions.emplace_back(IR::Binary(IR::Binary::Operator::LESS, value,
+                                             IR::Constant(cases[clusters[middle].first].value), cmp));
+        instructions.emplace_back(IR::JumpIfNotZero(cmp, lower_label));
+        lower_clusters(value, type, cases, clusters, middle, last, default_label, instructions);
+        instructions.emplace_back(IR::Label(lower_label));
+        lower_clusters(value, type, cases, clusters, first, middle, default_label, instructions);
+    }
+
+    // the offset from the lowest case is computed unsigned, so one comparison rejects values on both sides
+    void lower_jump_table(const IR::Value &value, const AST::Type &type, const std::vector<SwitchCase> &cases,
+                          const SwitchCluster &cluster, const std::string &miss_label,
+                          const std::string &default_label, std::vector<IR::Instruction> &instructions) {
+        bool quad = std::holds_alternative<AST::LongType>(type) || std::holds_alternative<AST::ULongType>(type);
+        AST::Type index_type = quad ? AST::Type(AST::ULongType()) : AST::Type(AST::UIntType());
+        auto constant = [&](std::uint64_t bits) {
+            return quad
+                       ? IR::Constant(AST::ConstULong(bits))
+                       : IR::Constant(AST::ConstUInt(static_cast<unsigned int>(bits)));
+        };
+        auto low = cases[cluster.first].bits;
+        auto range = cases[cluster.last].bits - low + 1;
+
+        auto unsigned_value = value;
+        if (std::holds_alternative<AST::IntType>(type) || std::holds_alternative<AST::LongType>(type)) {
+            unsigned_value = make_variable(index_type);
+            instructions.emplace_back(IR::Copy(value, unsigned_value));
+        }
+        auto index = make_variable(index_type);
+        instructions.emplace_back(IR::Binary(IR::Binary::Operator::SUBTRACT, unsigned_value, constant(low), index));
+        auto outside = make_variable(index_type);
+        instructions.emplace_back(IR::Binary(IR::Binary::Operator::GREATER, index, constant(range - 1), outside));
+        instructions.emplace_back(IR::JumpIfNotZero(outside, miss_label));
+
+        std::vector<std::string> targets(range, default_label);
+        for (auto i = cluster.first; i <= cluster.last; i++) {
+            targets[cases[i].bits - low] = cases[i].label;
+        }
+        instructions.emplace_back(IR::JumpTable(index, std::move(targets)));
+    }
+
     std::vector<IR::Instruction> gen_stmt(const AST::Stmt &stmt) {
         return std::visit(overloaded{
                               [this](const AST::ReturnStmt &stmt) {
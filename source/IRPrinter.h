@@ -1,47 +1,90 @@
 #ifndef IRPRINTER_H
 #define IRPRINTER_H
-#include <iostream>
+#include <string>
 
 #include "IR.h"
 #include "overloaded.h"
+#include "common/OutputBuffer.h"
+#include "optimization/CFG.h"
 
 class IRPrinter {
 public:
-    explicit IRPrinter(IR::Program *program)
-        : program(program) {
+    IRPrinter(const IR::Program *program, OutputBuffer *output)
+        : program(program), out(*output) {
     }
 
     void print_static_variable(const IR::StaticVariable &item) {
-        std::cout << "StaticVariable[" << item.name << "]" << "(global=" << (item.global ? "true" : "false") <<
+        out << "StaticVariable[" << item.name << "]" << "(global=" << (item.global ? "true" : "false") <<
                 ", initial_value=" << ")\n";
     }
 
     void print_static_constant(const IR::StaticConstant &item) {
-        std::cout << "StaticConstant[" << item.name << "]\n"; // TODO
+        out << "StaticConstant[" << item.name << "]\n"; // TODO
     }
 
     void print() {
         for (const auto &item: program->items) {
             std::visit(overloaded{
                            [this](const IR::Function &item) {
-                               print_function(item);
+                               if (function_filter.empty() || item.name == function_filter) {
+                                   print_function(item);
+                               }
                            },
                            [this](const IR::StaticVariable &item) {
-                               print_static_variable(item);
+                               if (function_filter.empty()) {
+                                   print_static_variable(item);
+                               }
                            },
                            [this](const IR::StaticConstant &item) {
-                               print_static_constant(item);
+                               if (function_filter.empty()) {
+                                   print_static_constant(item);
+                               }
                            }
                        }, item);
         }
+        out.flush();
     }
 
+    // basic blocks with their edges, dominators and loop depth instead of the flat instruction list
+    void print_cfg() {
+        for (const auto &item: program->items) {
+            if (!std::holds_alternative<IR::Function>(item)) continue;
+            const auto &function = std::get<IR::Function>(item);
+            if (!function_filter.empty() && function.name != function_filter) continue;
+
+            optimization::CFG cfg(function.instructions);
+            cfg.compute_dominators();
+            cfg.compute_loops();
+            out << "Function[" << function.name << "] " << cfg.blocks.size() << " blocks, " << cfg.loops.size()
+                    << " loops\n";
+            for (int i = 0; i < static_cast<int>(cfg.blocks.size()); i++) {
+                const auto &block = cfg.blocks[i];
+                out << "block " << i << " preds=[";
+                print_list(block.predecessors);
+                out << "] succs=[";
+                print_list(block.successors);
+                out << "] idom=" << block.idom << " loop_depth=" << block.loop_depth;
+                if (!block.reachable) {
+                    out << " unreachable";
+                }
+                out << '\n';
+                for (const auto &ins: block.instructions) {
+                    print_instruction(ins);
+                }
+            }
+        }
+        out.flush();
+    }
+
+    // only the function with this name is printed when set
+    std::string function_filter;
+
     void print_function(const IR::Function &function) {
-        std::cout << "Function[" << function.name << ", global=" << function.global << "](";
+        out << "Function[" << function.name << ", global=" << function.global << "](";
         for (const auto &param: function.params) {
-            std::cout << param << " ";
+            out << param << " ";
         }
-        std::cout << ")" << '\n';
+        out << ")" << '\n';
         for (const auto &ins: function.instructions) {
             print_instruction(ins);
         }
@@ -53,110 +96,139 @@ public:
         if (ins.destination) {
             print_value(*ins.destination);
         }
-        std::cout << " = " << ins.name << " (";
+        out << " = " << ins.name << " (";
         for (const auto &arg: ins.arguments) {
             print_value(arg);
-            std::cout << " ";
+            out << " ";
         }
-        std::cout << ")\n";
+        out << ")\n";
     }
 
     void print_sign_extend(const IR::SignExtend &ins) {
         print_indent();
         print_value(ins.destination);
-        std::cout << "= sign_extend(";
+        out << "= sign_extend(";
         print_value(ins.source);
-        std::cout << ")\n";
+        out << ")\n";
     }
 
     void print_truncate(const IR::Truncate &ins) {
         print_indent();
         print_value(ins.destination);
-        std::cout << "= truncate(";
+        out << "= truncate(";
         print_value(ins.source);
-        std::cout << ")\n";
+        out << ")\n";
     }
 
     void print_zero_extend(const IR::ZeroExtend &ins) {
         print_indent();
         print_value(ins.destination);
-        std::cout << "= zero_extend(";
+        out << "= zero_extend(";
         print_value(ins.source);
-        std::cout << ")\n";
+        out << ")\n";
     }
 
     void print_int_to_double(const IR::IntToDouble &ins) {
         print_indent();
         print_value(ins.destination);
-        std::cout << "= int_to_double(";
+        out << "= int_to_double(";
         print_value(ins.source);
-        std::cout << ")\n";
+        out << ")\n";
     }
 
     void print_uint_to_double(const IR::UIntToDouble &ins) {
         print_indent();
         print_value(ins.destination);
-        std::cout << "= uint_to_double(";
+        out << "= uint_to_double(";
         print_value(ins.source);
-        std::cout << ")\n";
+        out << ")\n";
     }
 
     void print_double_to_int(const IR::DoubleToInt &ins) {
         print_indent();
         print_value(ins.destination);
-        std::cout << "= double_to_int(";
+        out << "= double_to_int(";
         print_value(ins.source);
-        std::cout << ")\n";
+        out << ")\n";
     }
 
     void print_double_to_uint(const IR::DoubleToUInt &ins) {
         print_indent();
         print_value(ins.destination);
-        std::cout << "= double_to_uint(";
+        out << "= double_to_uint(";
         print_value(ins.source);
-        std::cout << ")\n";
+        out << ")\n";
     }
 
     void print_get_address(const IR::GetAddress &ins) {
         print_indent();
         print_value(ins.destination);
-        std::cout << "= get_address(";
+        out << "= get_address(";
         print_value(ins.source);
-        std::cout << ")\n";
+        out << ")\n";
     }
 
     void print_load(const IR::Load &ins) {
         print_indent();
         print_value(ins.destination);
-        std::cout << "= load(";
+        out << "= load(";
         print_value(ins.source_ptr);
-        std::cout << ")\n";
+        out << ")\n";
     }
 
     void print_store(const IR::Store &ins) {
         // better printing!
         print_indent();
         print_value(ins.destination_ptr);
-        std::cout << "= store(";
+        out << "= store(";
         print_value(ins.source);
-        std::cout << ")\n";
+        out << ")\n";
     }
 
     void print_add_ptr(const IR::AddPtr &ins) {
         print_indent();
         print_value(ins.destination);
-        std::cout << " = ";
+        out << " = ";
         print_value(ins.ptr);
-        std::cout << " + ";
+        out << " + ";
         print_value(ins.index);
-        std::cout << " * " << ins.scale << "\n";
+        out << " * " << ins.scale << "\n";
     }
 
     void print_copy_to_offset(const IR::CopyToOffset &ins) {
         print_indent();
-        std::cout << ins.destination << "+" << ins.offset << " = ";
+        out << ins.destination << "+" << ins.offset << " = ";
         print_value(ins.source);
-        std::cout << "\n";
+        out << "\n";
+    }
+
+    void print_broadcast(const IR::Broadcast &ins) {
+        print_indent();
+        print_value(ins.destination);
+        out << " = broadcast(";
+        print_value(ins.source);
+        out << ")\n";
+    }
+
+    void print_reduce(const IR::Reduce &ins) {
+        print_indent();
+        print_value(ins.destination);
+        out << " = reduce";
+        print_operator(ins.op);
+        out << "(";
+        print_value(ins.source);
+        out << ")\n";
+    }
+
+    void print_phi(const IR::Phi &ins) {
+        print_indent();
+        print_value(ins.destination);
+        out << " = phi(";
+        for (std::size_t i = 0; i < ins.arguments.size(); i++) {
+            if (i > 0) out << ", ";
+            print_value(ins.arguments[i]);
+        }
+        out << ")\n";
     }
 
     void print_instruction(const IR::Instruction &instruction) {
@@ -182,6 +254,9 @@ public:
                        [this](const IR::JumpIfNotZero &ins) {
                            print_jump_if_not_zero(ins);
                        },
+                       [this](const IR::JumpTable &ins) {
+                           print_jump_table(ins);
+                       },
                        [this](const IR::Label &ins) {
                            print_label(ins);
                        },
@@ -223,6 +298,15 @@ public:
                        },
                        [this](const IR::CopyToOffset &ins) {
                            print_copy_to_offset(ins);
+                       },
+                       [this](const IR::Phi &ins) {
+                           print_phi(ins);
+                       },
+                       [this](const IR::Broadcast &ins) {
+                           print_broadcast(ins);
+                       },
+                       [this](const IR::Reduce &ins) {
+                           print_reduce(ins);
                        }
 
                    }, instruction);
@@ -232,136 +316,157 @@ public:
         std::visit(overloaded{
                        [this](const IR::Constant &ins) {
                            std::visit(overloaded{
-                                          [](const auto &c) {
-                                              std::cout << c.value;
+                                          [this](const auto &c) {
+                                              out << c.value;
                                           }
                                       }, ins.constant);
                        },
                        [this](const IR::Variable &ins) {
-                           std::cout << ins.name;
+                           out << ins.name;
                        }
                    }, value);
     }
 
     void print_indent() {
-        std::cout << "   ";
+        out << "   ";
     }
 
     void print_return(const IR::Return &ins) {
-        std::cout << "   return ";
+        out << "   return ";
         if (ins.value) {
             print_value(*ins.value);
         }
-        std::cout << '\n';
+        out << '\n';
     }
 
     void print_unary(const IR::Unary &ins) {
         print_indent();
         print_value(ins.destination);
-        std::cout << " = ";
+        out << " = ";
         switch (ins.op) {
             case IR::Unary::Operator::NEGATE:
-                std::cout << '-';
+                out << '-';
                 break;
             case IR::Unary::Operator::COMPLEMENT:
-                std::cout << '~';
+                out << '~';
                 break;
             case IR::Unary::Operator::LOGICAL_NOT:
-                std::cout << '!';
+                out << '!';
                 break;
         }
         print_value(ins.source);
-        std::cout << '\n';
+        out << '\n';
     }
 
-    void print_binary(const IR::Binary &ins) {
-        print_indent();
-        print_value(ins.destination);
-        std::cout << " = ";
-        print_value(ins.left_source);
-        switch (ins.op) {
+    void print_operator(IR::Binary::Operator op) {
+        switch (op) {
             case IR::Binary::Operator::ADD:
-                std::cout << '+';
+                out << '+';
                 break;
             case IR::Binary::Operator::SUBTRACT:
-                std::cout << '-';
+                out << '-';
                 break;
             case IR::Binary::Operator::MULTIPLY:
-                std::cout << '*';
+                out << '*';
                 break;
             case IR::Binary::Operator::DIVIDE:
-                std::cout << '/';
+                out << '/';
                 break;
             case IR::Binary::Operator::SHIFT_LEFT:
-                std::cout << "<<";
+                out << "<<";
                 break;
             case IR::Binary::Operator::SHIFT_RIGHT:
-                std::cout << ">>";
+                out << ">>";
                 break;
             case IR::Binary::Operator::BITWISE_AND:
-                std::cout << '&';
+                out << '&';
                 break;
             case IR::Binary::Operator::BITWISE_OR:
-                std::cout << '|';
+                out << '|';
                 break;
             case IR::Binary::Operator::BITWISE_XOR:
-                std::cout << '^';
+                out << '^';
                 break;
             case IR::Binary::Operator::EQUAL:
-                std::cout << "==";
+                out << "==";
                 break;
             case IR::Binary::Operator::NOT_EQUAL:
-                std::cout << "!=";
+                out << "!=";
                 break;
             case IR::Binary::Operator::GREATER:
-                std::cout << ">";
+                out << ">";
                 break;
             case IR::Binary::Operator::GREATER_EQUAL:
-                std::cout << ">=";
+                out << ">=";
                 break;
             case IR::Binary::Operator::LESS:
-                std::cout << "<";
+                out << "<";
                 break;
             case IR::Binary::Operator::LESS_EQUAL:
-                std::cout << "<=";
+                out << "<=";
                 break;
             case IR::Binary::Operator::REMAINDER:
-                std::cout << "%";
+                out << "%";
                 break;
         }
+    }
+
+    void print_binary(const IR::Binary &ins) {
+        print_indent();
+        print_value(ins.destination);
+        out << " = ";
+        print_value(ins.left_source);
+        print_operator(ins.op);
         print_value(ins.right_source);
-        std::cout << '\n';
+        out << '\n';
     }
 
     void print_copy(const IR::Copy &ins) {
         print_indent();
         print_value(ins.destination);
-        std::cout << " = ";
+        out << " = ";
         print_value(ins.source);
-        std::cout << '\n';
+        out << '\n';
     }
 
     void print_jump(const IR::Jump &ins) {
-        std::cout << "    jmp @" << ins.target << '\n';
+        out << "    jmp @" << ins.target << '\n';
     }
 
     void print_jump_if_zero(const IR::JumpIfZero &ins) {
-        std::cout << "    jmpz ";
+        out << "    jmpz ";
         print_value(ins.condition);
-        std::cout << " @" << ins.target << '\n';
+        out << " @" << ins.target << '\n';
     }
 
     void print_jump_if_not_zero(const IR::JumpIfNotZero &ins) {
-        std::cout << "    jmpnz ";
+        out << "    jmpnz ";
         print_value(ins.condition);
-        std::cout << " @" << ins.target << '\n';
+        out << " @" << ins.target << '\n';
+    }
+
+    void print_jump_table(const IR::JumpTable &ins) {
+        out << "    jmptable ";
+        print_value(ins.index);
+        out << " [";
+        for (std::size_t i = 0; i < ins.targets.size(); i++) {
+            out << (i ? ", @" : "@") << ins.targets[i];
+        }
+        out << "]\n";
     }
 
     void print_label(const IR::Label &ins) {
-        std::cout << "@" << ins.name << '\n';
+        out << "@" << ins.name << '\n';
     }
 
 private:
-    IR::Program *program;
+    void print_list(const std::vector<int> &list) {
+        for (std::size_t i = 0; i < list.size(); i++) {
+            out << (i ? " " : "") << list[i];
+        }
+    }
+
+    const IR::Program *program;
+    OutputBuffer &out;
 };
 #endif //IRPRINTER_H
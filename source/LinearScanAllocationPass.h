@@ -0,0 +1,201 @@
+#ifndef LINEARSCANALLOCATIONPASS_H
+#define LINEARSCANALLOCATIONPASS_H
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "AsmLiveness.h"
+#include "AsmTree.h"
+
+// linear scan register allocation (Poletto, Sarkar "Linear scan register allocation"): every pseudo gets one live
+// interval over the instruction numbering and the intervals are handed registers in order of their start, when none
+// is free the interval with the lowest spill weight stays a pseudo and ReplacePseudoRegistersPass gives it a stack
+// slot, no interference graph is built so large functions stay cheap
+
+namespace codegen {
+    class LinearScanAllocationPass {
+    public:
+        LinearScanAllocationPass(ASM::Program *asmProgram, std::unordered_map<std::string, ASM::Symbol> *symbols)
+            : asmProgram(asmProgram), symbols(symbols) {
+        }
+
+        void process() {
+            for (auto &item: asmProgram->items) {
+                if (auto *function = std::get_if<ASM::Function>(&item)) {
+                    allocate(*function);
+                }
+            }
+        }
+
+        // over all functions
+        int allocated = 0;
+        int spilled = 0;
+
+    private:
+        struct Interval {
+            int node;
+            // instruction indices, the pseudo is live from the first up to and including the last
+            std::size_t start;
+            std::size_t end;
+            double weight;
+        };
+
+        struct Active {
+            std::size_t end;
+            int node;
+            ASM::Reg::Name reg;
+            double weight;
+        };
+
+        void allocate(ASM::Function &function) {
+            RegisterNodes nodes(function, *symbols, allocatable_registers);
+            AsmLiveness liveness(function.instructions, nodes);
+            const auto &instructions = function.instructions;
+            auto weights = loop_weights(instructions);
+
+            // positions at which every register is written or still needed afterward, a pseudo can not take a
+            // register that is busy anywhere inside its interval
+            std::vector<std::vector<std::size_t> > busy(nodes.hard_count);
+            liveness.walk([&](std::size_t i, const optimization::BitSet &live) {
+                for (int node = 0; node < nodes.hard_count; node++) {
+                    if (live.test(node)) busy[node].push_back(i);
+                }
+                for (int node: liveness.defs(i)) {
+                    if (node < nodes.hard_count && !live.test(node)) busy[node].push_back(i);
+                }
+            });
+            for (auto &positions: busy) {
+                std::ranges::sort(positions);
+            }
+
+            constexpr auto unset = std::numeric_limits<std::size_t>::max();
+            std::vector<std::size_t> start(nodes.size(), unset);
+            std::vector<std::size_t> end(nodes.size(), 0);
+            std::vector<double> cost(nodes.size(), 0);
+            auto extend = [&](int node, std::size_t position) {
+                if (node < nodes.hard_count) return;
+                start[node] = std::min(start[node], position);
+                end[node] = std::max(end[node], position);
+            };
+            // hints: the other side of every move, so both ends can end up in the same register
+            std::vector<std::vector<int> > partners(nodes.size());
+            for (std::size_t i = 0; i < instructions.size(); i++) {
+                for (int node: liveness.uses(i)) {
+                    extend(node, i);
+                    cost[node] += weights[i];
+                }
+                for (int node: liveness.defs(i)) {
+                    extend(node, i);
+                    cost[node] += weights[i];
+                }
+                if (auto *mov = std::get_if<ASM::Mov>(&instructions[i])) {
+                    int source = nodes.of(mov->src);
+                    int destination = nodes.of(mov->dst);
+                    if (source != -1 && destination != -1 && source != destination) {
+                        partners[source].push_back(destination);
+                        partners[destination].push_back(source);
+                    }
+                }
+            }
+            for (std::size_t b = 0; b < liveness.blocks.size(); b++) {
+                const auto &block = liveness.blocks[b];
+                if (block.first == block.last) continue;
+                liveness.live_in[b].for_each([&](std::size_t node) { extend(static_cast<int>(node), block.first); });
+                liveness.live_out[b].for_each([&](std::size_t node) { extend(static_cast<int>(node), block.last); });
+            }
+
+            std::vector<Interval> intervals;
+            for (int node = nodes.hard_count; node < nodes.size(); node++) {
+                if (start[node] == unset) continue;
+                intervals.push_back(Interval{
+                    node, start[node], end[node], cost[node] / static_cast<double>(end[node] - start[node] + 1)
+                });
+            }
+            std::ranges::sort(intervals, [](const Interval &a, const Interval &b) {
+                return a.start != b.start ? a.start < b.start : a.node < b.node;
+            });
+
+            // a register is busy for a pseudo if it is written or needed after any instruction from the one that
+            // defines the pseudo up to the one before its last use, the last use may read it while the register
+            // gets its next value
+            auto blocked = [&](ASM::Reg::Name name, const Interval &interval) {
+                const auto &positions = busy[nodes.of(name)];
+                auto it = std::ranges::lower_bound(positions, interval.start);
+                return it != positions.end() && *it < std::max(interval.end, interval.start + 1);
+            };
+
+            std::vector<int> assigned(nodes.size(), -1);
+            for (int node = 0; node < nodes.hard_count; node++) {
+                assigned[node] = static_cast<int>(nodes.nodes[node].reg);
+            }
+            std::array<bool, static_cast<int>(ASM::Reg::Name::XMM15) + 1> held{};
+            std::vector<Active> active;
+            for (const auto &interval: intervals) {
+                std::erase_if(active, [&](const Active &other) {
+                    if (other.end > interval.start) return false;
+                    held[static_cast<int>(other.reg)] = false;
+                    return true;
+                });
+
+                auto register_class = nodes.nodes[interval.node].register_class;
+                auto usable = [&](ASM::Reg::Name name) {
+                    return codegen::register_class(name) == register_class && !held[static_cast<int>(name)] &&
+                           !blocked(name, interval);
+                };
+                int chosen = -1;
+                for (int partner: partners[interval.node]) {
+                    if (assigned[partner] != -1 && usable(static_cast<ASM::Reg::Name>(assigned[partner]))) {
+                        chosen = assigned[partner];
+                        break;
+                    }
+                }
+                for (auto name: allocatable_registers) {
+                    if (chosen != -1) break;
+                    if (usable(name)) chosen = static_cast<int>(name);
+                }
+
+                if (chosen == -1) {
+                    // the cheapest interval that holds a register this one could use gives it up, if it is cheaper
+                    // than this one
+                    auto victim = active.end();
+                    for (auto it = active.begin(); it != active.end(); ++it) {
+                        if (codegen::register_class(it->reg) != register_class || blocked(it->reg, interval)) continue;
+                        if (victim == active.end() || it->weight < victim->weight) victim = it;
+                    }
+                    if (victim == active.end() || victim->weight >= interval.weight) {
+                        spilled++;
+                        continue;
+                    }
+                    chosen = static_cast<int>(victim->reg);
+                    assigned[victim->node] = -1;
+                    active.erase(victim);
+                    allocated--;
+                    spilled++;
+                }
+
+                assigned[interval.node] = chosen;
+                held[chosen] = true;
+                active.push_back(Active{interval.end, interval.node, static_cast<ASM::Reg::Name>(chosen),
+                                        interval.weight});
+                allocated++;
+            }
+
+            std::unordered_map<std::string, ASM::Operand> replacements;
+            for (int node = nodes.hard_count; node < nodes.size(); node++) {
+                if (assigned[node] != -1) {
+                    replacements.emplace(nodes.nodes[node].pseudo,
+                                         ASM::Reg(static_cast<ASM::Reg::Name>(assigned[node])));
+                }
+            }
+            replace_pseudos(function, replacements);
+        }
+
+        ASM::Program *asmProgram;
+        std::unordered_map<std::string, ASM::Symbol> *symbols;
+    };
+}
+
+#endif //LINEARSCANALLOCATIONPASS_H
@@ -0,0 +1,403 @@
+#ifndef PEEPHOLEPASS_H
+#define PEEPHOLEPASS_H
+#include <array>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "AsmLiveness.h"
+#include "AsmTree.h"
+#include "overloaded.h"
+
+// rewrites short windows of the final instruction stream (after FixUpInstructionsPass) by a table of patterns, a
+// pattern gets the instructions from the start of its window to the end of the function and returns what replaces
+// the window, the table is applied until nothing fires anymore
+
+namespace codegen {
+    // over all compiled functions
+    struct PeepholeStatistics {
+        // pattern name and how often it fired, in table order
+        std::vector<std::pair<std::string_view, int> > fired;
+        std::size_t instructions_before = 0;
+        std::size_t instructions_after = 0;
+        // jumps retargeted past a label that only jumps on, blocks removed as unreachable afterward
+        int threaded_jumps = 0;
+        int removed_blocks = 0;
+    };
+
+    namespace peephole {
+        using Replacement = std::optional<std::vector<ASM::Instruction> >;
+
+        inline bool same_reg(const ASM::Reg &a, const ASM::Reg &b) {
+            return a.name == b.name;
+        }
+
+        inline bool same_operand(const ASM::Operand &a, const ASM::Operand &b) {
+            if (a.index() != b.index()) return false;
+            return std::visit(overloaded{
+                                  [&](const ASM::Imm &x) { return x.value == std::get<ASM::Imm>(b).value; },
+                                  [&](const ASM::Reg &x) { return same_reg(x, std::get<ASM::Reg>(b)); },
+                                  [&](const ASM::Memory &x) {
+                                      const auto &y = std::get<ASM::Memory>(b);
+                                      return same_reg(x.reg, y.reg) && x.offset == y.offset;
+                                  },
+                                  [&](const ASM::Data &x) {
+                                      return x.identifier == std::get<ASM::Data>(b).identifier;
+                                  },
+                                  [&](const ASM::Indexed &x) {
+                                      const auto &y = std::get<ASM::Indexed>(b);
+                                      return same_reg(x.base, y.base) && same_reg(x.index, y.index) &&
+                                             x.scale == y.scale;
+                                  },
+                                  [](const auto &) { return false; },
+                              }, a);
+        }
+
+        inline bool is_memory(const ASM::Operand &operand) {
+            return std::holds_alternative<ASM::Memory>(operand) || std::holds_alternative<ASM::Data>(operand) ||
+                   std::holds_alternative<ASM::Indexed>(operand);
+        }
+
+        inline bool is_imm(const ASM::Operand &operand, std::uint64_t value) {
+            auto *imm = std::get_if<ASM::Imm>(&operand);
+            return imm && imm->value == value;
+        }
+
+        // whether the register is used to address memory in operand
+        inline bool addresses_with(const ASM::Operand &operand, const ASM::Operand &reg) {
+            auto *r = std::get_if<ASM::Reg>(&reg);
+            if (!r) return false;
+            if (auto *memory = std::get_if<ASM::Memory>(&operand)) return same_reg(memory->reg, *r);
+            if (auto *indexed = std::get_if<ASM::Indexed>(&operand)) {
+                return same_reg(indexed->base, *r) || same_reg(indexed->index, *r);
+            }
+            return false;
+        }
+
+        inline bool is_integer(const ASM::Type &type) {
+            return std::holds_alternative<ASM::LongWord>(type) || std::holds_alternative<ASM::QuadWord>(type);
+        }
+
+        // whether the flags may be read before they are written again after the first instruction of code, control
+        // flow other than calls and returns ends the search with a yes
+        inline bool flags_live_after(std::span<const ASM::Instruction> code) {
+            enum { READ, WRITTEN, NEITHER };
+            for (const auto &instruction: code.subspan(1)) {
+                auto effect = std::visit(overloaded{
+                                             [](const ASM::Cmp &) { return WRITTEN; },
+                                             [](const ASM::Test &) { return WRITTEN; },
+                                             [](const ASM::Binary &ins) {
+                                                 // sse arithmetic leaves the flags alone, a shift by cl may too
+                                                 if (std::holds_alternative<ASM::Double>(ins.type)) return NEITHER;
+                                                 bool shift = ins.op == ASM::Binary::Operator::SAR ||
+                                                              ins.op == ASM::Binary::Operator::SHR ||
+                                                              ins.op == ASM::Binary::Operator::SHL;
+                                                 return shift && !std::holds_alternative<ASM::Imm>(ins.left)
+                                                            ? NEITHER
+                                                            : WRITTEN;
+                                             },
+                                             [](const ASM::Unary &ins) {
+                                                 // not leaves the flags, inc and dec keep the carry
+                                                 return ins.op == ASM::Unary::Operator::Neg ||
+                                                        ins.op == ASM::Unary::Operator::Shr
+                                                            ? WRITTEN
+                                                            : NEITHER;
+                                             },
+                                             [](const ASM::Idiv &) { return WRITTEN; },
+                                             [](const ASM::Div &) { return WRITTEN; },
+                                             [](const ASM::Mul &) { return WRITTEN; },
+                                             [](const ASM::Call &) { return WRITTEN; },
+                                             [](const ASM::Ret &) { return WRITTEN; },
+                                             [](const ASM::TailCall &) { return WRITTEN; },
+                                             [](const ASM::SetCC &) { return READ; },
+                                             [](const ASM::JmpCC &) { return READ; },
+                                             [](const ASM::Jmp &) { return READ; },
+                                             [](const ASM::JumpTable &) { return READ; },
+                                             [](const ASM::Label &) { return READ; },
+                                             [](const auto &) { return NEITHER; },
+                                         }, instruction);
+                if (effect != NEITHER) return effect == READ;
+            }
+            return false;
+        }
+
+        // jmp or jcc to the label right after it
+        inline Replacement jump_to_next(std::span<const ASM::Instruction> code) {
+            auto *label = std::get_if<ASM::Label>(&code[1]);
+            if (!label) return {};
+            const std::string *target = nullptr;
+            if (auto *jump = std::get_if<ASM::Jmp>(&code[0])) target = &jump->target;
+            if (auto *jump = std::get_if<ASM::JmpCC>(&code[0])) target = &jump->target;
+            if (!target || *target != label->name) return {};
+            return std::vector<ASM::Instruction>{code[1]};
+        }
+
+        // mov a, b; mov b, a: the second one copies back what is already there
+        inline Replacement move_back(std::span<const ASM::Instruction> code) {
+            auto *first = std::get_if<ASM::Mov>(&code[0]);
+            auto *second = std::get_if<ASM::Mov>(&code[1]);
+            if (!first || !second || first->type.index() != second->type.index()) return {};
+            if (!same_operand(first->dst, second->src) || !same_operand(first->src, second->dst)) return {};
+            if (addresses_with(first->src, first->dst)) return {};
+            // a 32 bit move into a register also clears its upper half
+            if (std::holds_alternative<ASM::LongWord>(first->type) && std::holds_alternative<ASM::Reg>(first->src)) {
+                return {};
+            }
+            return std::vector<ASM::Instruction>{code[0]};
+        }
+
+        // mov reg, mem; mov mem, x: x is loaded from the register that was just stored
+        inline Replacement store_reload(std::span<const ASM::Instruction> code) {
+            auto *store = std::get_if<ASM::Mov>(&code[0]);
+            auto *load = std::get_if<ASM::Mov>(&code[1]);
+            if (!store || !load || store->type.index() != load->type.index()) return {};
+            if (!std::holds_alternative<ASM::Reg>(store->src) || !is_memory(store->dst) ||
+                !same_operand(store->dst, load->src) || is_memory(load->dst)) {
+                return {};
+            }
+            if (same_operand(store->src, load->dst)) {
+                if (std::holds_alternative<ASM::LongWord>(store->type)) return {};
+                return std::vector<ASM::Instruction>{code[0]};
+            }
+            return std::vector<ASM::Instruction>{code[0], ASM::Mov(load->type, store->src, load->dst)};
+        }
+
+        // a move of a register to itself, except 32 bit ones which clear the upper half
+        inline Replacement self_move(std::span<const ASM::Instruction> code) {
+            auto *mov = std::get_if<ASM::Mov>(&code[0]);
+            if (!mov || std::holds_alternative<ASM::LongWord>(mov->type) || !std::holds_alternative<ASM::Reg>(mov->src)
+                || !same_operand(mov->src, mov->dst)) {
+                return {};
+            }
+            return std::vector<ASM::Instruction>{};
+        }
+
+        // a scratch register of the fix up pass loaded but not read before the end of the block or its next write
+        inline Replacement dead_scratch_load(std::span<const ASM::Instruction> code) {
+            auto *mov = std::get_if<ASM::Mov>(&code[0]);
+            if (!mov) return {};
+            auto *reg = std::get_if<ASM::Reg>(&mov->dst);
+            if (!reg || (reg->name != ASM::Reg::Name::R10 && reg->name != ASM::Reg::Name::R11 &&
+                         reg->name != ASM::Reg::Name::XMM14 && reg->name != ASM::Reg::Name::XMM15)) {
+                return {};
+            }
+            for (const auto &instruction: code.subspan(1)) {
+                bool read = false;
+                bool written = false;
+                auto matches = [&](const ASM::Operand &operand) {
+                    auto *other = std::get_if<ASM::Reg>(&operand);
+                    return other && other->name == reg->name;
+                };
+                for_each_register(instruction, [&](const ASM::Operand &operand) { read |= matches(operand); },
+                                  [&](const ASM::Operand &operand) { written |= matches(operand); });
+                if (read) return {};
+                if (written) return std::vector<ASM::Instruction>{};
+                // the fix up pass never keeps a scratch register across a jump or a label
+                if (std::holds_alternative<ASM::Label>(instruction) || std::holds_alternative<ASM::Jmp>(instruction) ||
+                    std::holds_alternative<ASM::JmpCC>(instruction) ||
+                    std::holds_alternative<ASM::JumpTable>(instruction) || std::holds_alternative<ASM::Ret>(instruction) ||
+                    std::holds_alternative<ASM::TailCall>(instruction)) {
+                    return std::vector<ASM::Instruction>{};
+                }
+            }
+            return std::vector<ASM::Instruction>{};
+        }
+
+        // mov $0, reg -> xor reg, reg when the flags it clobbers are not needed, the 32 bit form clears all 64 bits
+        inline Replacement zero_with_xor(std::span<const ASM::Instruction> code) {
+            auto *mov = std::get_if<ASM::Mov>(&code[0]);
+            if (!mov || !is_integer(mov->type) || !is_imm(mov->src, 0) || !std::holds_alternative<ASM::Reg>(mov->dst)) {
+                return {};
+            }
+            if (flags_live_after(code)) return {};
+            return std::vector<ASM::Instruction>{
+                ASM::Binary(ASM::Binary::Operator::XOR, ASM::LongWord(), mov->dst, mov->dst)
+            };
+        }
+
+        // cmp $0, reg -> test reg, reg, the flags come out the same
+        inline Replacement compare_zero_with_test(std::span<const ASM::Instruction> code) {
+            auto *cmp = std::get_if<ASM::Cmp>(&code[0]);
+            if (!cmp || std::holds_alternative<ASM::Double>(cmp->type) || !is_imm(cmp->left, 0) ||
+                !std::holds_alternative<ASM::Reg>(cmp->right)) {
+                return {};
+            }
+            return std::vector<ASM::Instruction>{ASM::Test(cmp->type, cmp->right, cmp->right)};
+        }
+
+        // add $1 -> inc, sub $1 -> dec, as long as nothing reads the flags. add $0 stays, a 32 bit add into a register
+        // also clears its upper half
+        inline Replacement add_constant(std::span<const ASM::Instruction> code) {
+            auto *binary = std::get_if<ASM::Binary>(&code[0]);
+            if (!binary || !is_integer(binary->type) ||
+                (binary->op != ASM::Binary::Operator::ADD && binary->op != ASM::Binary::Operator::SUB)) {
+                return {};
+            }
+            if (!is_imm(binary->left, 1) || flags_live_after(code)) return {};
+            auto op = binary->op == ASM::Binary::Operator::ADD ? ASM::Unary::Operator::Inc : ASM::Unary::Operator::Dec;
+            return std::vector<ASM::Instruction>{ASM::Unary(op, binary->type, binary->right)};
+        }
+
+        // a jump to a label that only jumps on goes to the final target right away, e.g. a loop's back edge through
+        // the edge block SSADestruction made for copies the register allocator coalesced away, returns how many
+        inline int thread_jumps(std::vector<ASM::Instruction> &instructions) {
+            std::unordered_map<std::string, std::string> forward;
+            for (std::size_t i = 0; i < instructions.size(); i++) {
+                auto *label = std::get_if<ASM::Label>(&instructions[i]);
+                if (!label) continue;
+                auto next = i + 1;
+                while (next < instructions.size() && std::holds_alternative<ASM::Label>(instructions[next])) next++;
+                if (next == instructions.size()) continue;
+                if (auto *jump = std::get_if<ASM::Jmp>(&instructions[next]); jump && jump->target != label->name) {
+                    forward[label->name] = jump->target;
+                }
+            }
+            auto resolve = [&](const std::string &target) {
+                auto final = target;
+                // bounded, a chain of labels jumping to each other in a cycle never ends
+                for (std::size_t steps = 0; steps < forward.size(); steps++) {
+                    auto it = forward.find(final);
+                    if (it == forward.end()) break;
+                    final = it->second;
+                }
+                return final;
+            };
+            int threaded = 0;
+            auto retarget = [&](std::string &target) {
+                auto final = resolve(target);
+                if (final == target) return;
+                target = std::move(final);
+                threaded++;
+            };
+            for (auto &instruction: instructions) {
+                if (auto *jump = std::get_if<ASM::Jmp>(&instruction)) retarget(jump->target);
+                if (auto *jump = std::get_if<ASM::JmpCC>(&instruction)) retarget(jump->target);
+            }
+            return threaded;
+        }
+
+        // a label nothing jumps to after an instruction that never falls through starts code that never runs, up to
+        // the next label, returns how many such blocks were removed
+        inline int remove_unreachable_blocks(std::vector<ASM::Instruction> &instructions) {
+            std::unordered_set<std::string> targets;
+            for (const auto &instruction: instructions) {
+                if (auto *jump = std::get_if<ASM::Jmp>(&instruction)) targets.insert(jump->target);
+                if (auto *jump = std::get_if<ASM::JmpCC>(&instruction)) targets.insert(jump->target);
+                if (auto *table = std::get_if<ASM::JumpTable>(&instruction)) {
+                    targets.insert(table->targets.begin(), table->targets.end());
+                }
+            }
+            std::vector<ASM::Instruction> output;
+            output.reserve(instructions.size());
+            int removed = 0;
+            bool unreachable = false;
+            for (auto &instruction: instructions) {
+                if (auto *label = std::get_if<ASM::Label>(&instruction)) {
+                    bool falls_in = !output.empty() && !std::holds_alternative<ASM::Jmp>(output.back()) &&
+                                    !std::holds_alternative<ASM::Ret>(output.back()) &&
+                                    !std::holds_alternative<ASM::TailCall>(output.back()) &&
+                                    !std::holds_alternative<ASM::JumpTable>(output.back());
+                    unreachable = !falls_in && !output.empty() && !targets.contains(label->name);
+                    if (unreachable) removed++;
+                }
+                if (!unreachable) output.push_back(std::move(instruction));
+            }
+            instructions = std::move(output);
+            return removed;
+        }
+
+        struct Pattern {
+            std::string_view name;
+            std::size_t window;
+            Replacement (*rewrite)(std::span<const ASM::Instruction> code);
+        };
+
+        // tried in order at every instruction, new patterns go here
+        inline constexpr std::array patterns = {
+            Pattern{"jump-to-next", 2, jump_to_next},
+            Pattern{"move-back", 2, move_back},
+            Pattern{"store-reload", 2, store_reload},
+            Pattern{"self-move", 1, self_move},
+            Pattern{"dead-scratch-load", 1, dead_scratch_load},
+            Pattern{"zero-with-xor", 1, zero_with_xor},
+            Pattern{"compare-zero-with-test", 1, compare_zero_with_test},
+            Pattern{"add-constant", 1, add_constant},
+        };
+    }
+
+    class PeepholePass {
+    public:
+        PeepholePass(ASM::Program *asmProgram, PeepholeStatistics *statistics = nullptr)
+            : asmProgram(asmProgram), statistics(statistics) {
+        }
+
+        void process() {
+            for (auto &item: asmProgram->items) {
+                if (auto *function = std::get_if<ASM::Function>(&item)) {
+                    visit_function(*function);
+                }
+            }
+            if (!statistics) return;
+            if (statistics->fired.empty()) {
+                for (const auto &pattern: peephole::patterns) {
+                    statistics->fired.emplace_back(pattern.name, 0);
+                }
+            }
+            for (std::size_t p = 0; p < fired.size(); p++) {
+                statistics->fired[p].second += fired[p];
+            }
+        }
+
+    private:
+        void visit_function(ASM::Function &function) {
+            if (statistics) statistics->instructions_before += function.instructions.size();
+            int threaded = peephole::thread_jumps(function.instructions);
+            int removed = threaded > 0 ? peephole::remove_unreachable_blocks(function.instructions) : 0;
+            if (statistics) {
+                statistics->threaded_jumps += threaded;
+                statistics->removed_blocks += removed;
+            }
+            // one rewrite can expose another, e.g. a removed move leaves a dead load of a scratch register
+            while (run(function.instructions)) {
+            }
+            if (statistics) statistics->instructions_after += function.instructions.size();
+        }
+
+        bool run(std::vector<ASM::Instruction> &instructions) {
+            std::vector<ASM::Instruction> output;
+            output.reserve(instructions.size());
+            std::span<const ASM::Instruction> code(instructions);
+            bool changed = false;
+            for (std::size_t i = 0; i < code.size();) {
+                bool matched = false;
+                for (std::size_t p = 0; p < peephole::patterns.size() && !matched; p++) {
+                    const auto &pattern = peephole::patterns[p];
+                    if (code.size() - i < pattern.window) continue;
+                    auto replacement = pattern.rewrite(code.subspan(i));
+                    if (!replacement) continue;
+                    std::ranges::move(*replacement, std::back_inserter(output));
+                    i += pattern.window;
+                    fired[p]++;
+                    matched = true;
+                }
+                if (!matched) {
+                    output.push_back(code[i++]);
+                }
+                changed |= matched;
+            }
+            instructions = std::move(output);
+            return changed;
+        }
+
+        ASM::Program *asmProgram;
+        PeepholeStatistics *statistics;
+        std::array<int, peephole::patterns.size()> fired{};
+    };
+}
+
+#endif //PEEPHOLEPASS_H
@@ -0,0 +1,289 @@
+#ifndef REGISTERALLOCATIONPASS_H
+#define REGISTERALLOCATIONPASS_H
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "AsmLiveness.h"
+#include "AsmTree.h"
+
+// graph coloring register allocation (Chaitin; Briggs, Cooper, Torczon "Improvements to graph coloring register
+// allocation"; George, Appel "Iterated register coalescing"): copies are coalesced conservatively, then the
+// interference graph is colored optimistically, pseudos that get no color stay pseudos and ReplacePseudoRegistersPass
+// gives them a stack slot
+
+namespace codegen {
+    class RegisterAllocationPass {
+    public:
+        RegisterAllocationPass(ASM::Program *asmProgram, std::unordered_map<std::string, ASM::Symbol> *symbols)
+            : asmProgram(asmProgram), symbols(symbols) {
+        }
+
+        void process() {
+            for (auto &item: asmProgram->items) {
+                if (auto *function = std::get_if<ASM::Function>(&item)) {
+                    allocate(*function);
+                }
+            }
+        }
+
+        // over all functions
+        int colored = 0;
+        int spilled = 0;
+        int coalesced = 0;
+
+    private:
+        struct Move {
+            int destination;
+            int source;
+            double weight;
+        };
+
+        struct Graph {
+            std::vector<std::unordered_set<int> > adjacency;
+            std::vector<Move> moves;
+            std::vector<double> spill_costs;
+        };
+
+        void allocate(ASM::Function &function) {
+            // coalescing shortens the code, so liveness and the graph are rebuilt until nothing more is merged
+            while (true) {
+                RegisterNodes nodes(function, *symbols, allocatable_registers);
+                AsmLiveness liveness(function.instructions, nodes);
+                auto graph = build(function.instructions, nodes, liveness);
+                if (!coalesce(function, nodes, graph)) {
+                    color(function, nodes, graph);
+                    return;
+                }
+            }
+        }
+
+        Graph build(const std::vector<ASM::Instruction> &instructions, const RegisterNodes &nodes,
+                    const AsmLiveness &liveness) {
+            Graph graph;
+            graph.adjacency.resize(nodes.size());
+            graph.spill_costs.assign(nodes.size(), 0);
+            auto weights = loop_weights(instructions);
+            liveness.walk([&](std::size_t i, const optimization::BitSet &live) {
+                // the source of a move does not interfere with its destination, they may share a register
+                int source = -1;
+                if (auto *mov = std::get_if<ASM::Mov>(&instructions[i])) {
+                    source = nodes.of(mov->src);
+                    int destination = nodes.of(mov->dst);
+                    if (source != -1 && destination != -1 && movable(nodes, destination, source)) {
+                        graph.moves.push_back(Move{destination, source, weights[i]});
+                    }
+                }
+                for (int def: liveness.defs(i)) {
+                    live.for_each([&](std::size_t other) {
+                        int node = static_cast<int>(other);
+                        if (node == def || node == source ||
+                            nodes.nodes[node].register_class != nodes.nodes[def].register_class) {
+                            return;
+                        }
+                        add_edge(graph, nodes, def, node);
+                    });
+                }
+                for (int node: liveness.uses(i)) graph.spill_costs[node] += weights[i];
+                for (int node: liveness.defs(i)) graph.spill_costs[node] += weights[i];
+            });
+            return graph;
+        }
+
+        static bool movable(const RegisterNodes &nodes, int destination, int source) {
+            const auto &a = nodes.nodes[destination];
+            const auto &b = nodes.nodes[source];
+            if (destination == source || a.register_class != b.register_class || (a.hard && b.hard)) return false;
+            // a pseudo keeps one type for its whole life
+            return a.hard || b.hard || a.type.index() == b.type.index();
+        }
+
+        static void add_edge(Graph &graph, const RegisterNodes &nodes, int a, int b) {
+            // hardware registers always interfere with each other, that is not stored
+            if (nodes.nodes[a].hard && nodes.nodes[b].hard) return;
+            graph.adjacency[a].insert(b);
+            graph.adjacency[b].insert(a);
+        }
+
+        static bool interferes(const Graph &graph, const RegisterNodes &nodes, int a, int b) {
+            if (nodes.nodes[a].hard && nodes.nodes[b].hard) return a != b;
+            return graph.adjacency[a].contains(b);
+        }
+
+        static int registers_in(const RegisterNodes &nodes, RegisterClass register_class) {
+            int count = 0;
+            for (int i = 0; i < nodes.hard_count; i++) {
+                count += nodes.nodes[i].register_class == register_class;
+            }
+            return count;
+        }
+
+        // merges move related nodes that do not interfere while the graph stays as colorable as before, returns
+        // whether anything was merged, the code is rewritten then
+        bool coalesce(ASM::Function &function, const RegisterNodes &nodes, Graph &graph) {
+            std::array<int, 2> k = {
+                registers_in(nodes, RegisterClass::GENERAL), registers_in(nodes, RegisterClass::XMM)
+            };
+            auto significant = [&](int node) {
+                const auto &n = nodes.nodes[node];
+                return n.hard || static_cast<int>(graph.adjacency[node].size()) >= k[static_cast<int>(n.
+                           register_class)];
+            };
+
+            std::vector<int> parent(nodes.size());
+            std::iota(parent.begin(), parent.end(), 0);
+            auto find = [&](int node) {
+                while (parent[node] != node) {
+                    node = parent[node] = parent[parent[node]];
+                }
+                return node;
+            };
+
+            std::ranges::stable_sort(graph.moves, [](const Move &a, const Move &b) { return a.weight > b.weight; });
+            int merged = 0;
+            for (const auto &move: graph.moves) {
+                int a = find(move.destination);
+                int b = find(move.source);
+                if (nodes.nodes[b].hard) std::swap(a, b);
+                if (a == b || nodes.nodes[b].hard || interferes(graph, nodes, a, b)) continue;
+                int limit = k[static_cast<int>(nodes.nodes[a].register_class)];
+                bool safe;
+                if (nodes.nodes[a].hard) {
+                    // George: every neighbor of the pseudo already interferes with the register or is trivially
+                    // colorable
+                    safe = std::ranges::all_of(graph.adjacency[b], [&](int t) {
+                        return interferes(graph, nodes, t, a) || !significant(t);
+                    });
+                } else {
+                    // Briggs: the merged node has fewer than k neighbors of significant degree
+                    int count = 0;
+                    for (int t: graph.adjacency[a]) count += significant(t);
+                    for (int t: graph.adjacency[b]) count += !graph.adjacency[a].contains(t) && significant(t);
+                    safe = count < limit;
+                }
+                if (!safe) continue;
+
+                for (int t: graph.adjacency[b]) {
+                    graph.adjacency[t].erase(b);
+                    add_edge(graph, nodes, a, t);
+                }
+                graph.adjacency[b].clear();
+                parent[b] = a;
+                merged++;
+            }
+            if (!merged) return false;
+            coalesced += merged;
+
+            std::unordered_map<std::string, ASM::Operand> replacements;
+            for (int node = nodes.hard_count; node < nodes.size(); node++) {
+                int representative = find(node);
+                if (representative == node) continue;
+                const auto &target = nodes.nodes[representative];
+                replacements.emplace(nodes.nodes[node].pseudo,
+                                     target.hard ? ASM::Operand(ASM::Reg(target.reg)) : ASM::Pseudo(target.pseudo));
+            }
+            replace_pseudos(function, replacements);
+            return true;
+        }
+
+        void color(ASM::Function &function, const RegisterNodes &nodes, const Graph &graph) {
+            std::array<int, 2> k = {
+                registers_in(nodes, RegisterClass::GENERAL), registers_in(nodes, RegisterClass::XMM)
+            };
+            auto limit = [&](int node) { return k[static_cast<int>(nodes.nodes[node].register_class)]; };
+
+            // simplify: nodes with fewer than k neighbors can always be colored, when there are none the cheapest to
+            // spill goes on the stack anyway and may still get a color (optimistic coloring)
+            std::vector<int> degree(nodes.size());
+            std::vector<bool> removed(nodes.size(), false);
+            std::vector<int> low_degree;
+            int remaining = 0;
+            for (int node = nodes.hard_count; node < nodes.size(); node++) {
+                degree[node] = static_cast<int>(graph.adjacency[node].size());
+                if (degree[node] < limit(node)) low_degree.push_back(node);
+                remaining++;
+            }
+            std::vector<int> stack;
+            stack.reserve(remaining);
+            while (remaining > 0) {
+                int node = -1;
+                while (!low_degree.empty() && node == -1) {
+                    node = low_degree.back();
+                    low_degree.pop_back();
+                    if (removed[node]) node = -1;
+                }
+                if (node == -1) {
+                    double best = 0;
+                    for (int candidate = nodes.hard_count; candidate < nodes.size(); candidate++) {
+                        if (removed[candidate]) continue;
+                        double cost = graph.spill_costs[candidate] / std::max(degree[candidate], 1);
+                        if (node == -1 || cost < best) {
+                            node = candidate;
+                            best = cost;
+                        }
+                    }
+                }
+                removed[node] = true;
+                stack.push_back(node);
+                remaining--;
+                for (int t: graph.adjacency[node]) {
+                    if (nodes.nodes[t].hard || removed[t]) continue;
+                    if (degree[t]-- == limit(t)) low_degree.push_back(t);
+                }
+            }
+
+            std::vector<std::vector<int> > partners(nodes.size());
+            for (const auto &move: graph.moves) {
+                partners[move.destination].push_back(move.source);
+                partners[move.source].push_back(move.destination);
+            }
+
+            // select: hardware registers are colored with themselves, a pseudo prefers the register of a move partner
+            // so the move disappears
+            constexpr int none = -1;
+            std::vector<int> colors(nodes.size(), none);
+            for (int node = 0; node < nodes.hard_count; node++) {
+                colors[node] = static_cast<int>(nodes.nodes[node].reg);
+            }
+            std::unordered_map<std::string, ASM::Operand> replacements;
+            while (!stack.empty()) {
+                int node = stack.back();
+                stack.pop_back();
+                std::array<bool, static_cast<int>(ASM::Reg::Name::XMM15) + 1> taken{};
+                for (int t: graph.adjacency[node]) {
+                    if (colors[t] != none) taken[colors[t]] = true;
+                }
+                auto register_class = nodes.nodes[node].register_class;
+                for (int partner: partners[node]) {
+                    if (colors[partner] != none && !taken[colors[partner]]) {
+                        colors[node] = colors[partner];
+                        break;
+                    }
+                }
+                for (auto name: allocatable_registers) {
+                    if (colors[node] != none) break;
+                    if (codegen::register_class(name) == register_class && !taken[static_cast<int>(name)]) {
+                        colors[node] = static_cast<int>(name);
+                    }
+                }
+                if (colors[node] == none) {
+                    spilled++;
+                    continue;
+                }
+                colored++;
+                replacements.emplace(nodes.nodes[node].pseudo,
+                                     ASM::Reg(static_cast<ASM::Reg::Name>(colors[node])));
+            }
+            replace_pseudos(function, replacements);
+        }
+
+        ASM::Program *asmProgram;
+        std::unordered_map<std::string, ASM::Symbol> *symbols;
+    };
+}
+
+#endif //REGISTERALLOCATIONPASS_H
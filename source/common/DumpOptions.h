@@ -0,0 +1,56 @@
+#ifndef DUMPOPTIONS_H
+#define DUMPOPTIONS_H
+
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Which intermediate forms are written out with --dump-after, checking a stage is a single bit test.
+class DumpOptions {
+public:
+    enum class Stage {
+        PARSE,
+        TYPECHECK,
+        IR,
+        OPT,
+        CFG,
+        ASM,
+        FIXUP,
+    };
+
+    static constexpr std::array stage_names = {"parse", "typecheck", "ir", "opt", "cfg", "asm", "fixup"};
+
+    static std::optional<Stage> parse_stage(std::string_view name) {
+        for (std::size_t i = 0; i < stage_names.size(); i++) {
+            if (stage_names[i] == name) {
+                return static_cast<Stage>(i);
+            }
+        }
+        return {};
+    }
+
+    static std::string_view stage_name(Stage stage) {
+        return stage_names[static_cast<int>(stage)];
+    }
+
+    void enable(Stage stage) {
+        mask |= 1u << static_cast<int>(stage);
+    }
+
+    bool enabled(Stage stage) const {
+        return mask & 1u << static_cast<int>(stage);
+    }
+
+    bool any() const {
+        return mask != 0;
+    }
+
+    // only this function is dumped when set
+    std::string function;
+
+private:
+    unsigned mask = 0;
+};
+
+#endif //DUMPOPTIONS_H
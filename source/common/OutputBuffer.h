@@ -0,0 +1,157 @@
+#ifndef OUTPUTBUFFER_H
+#define OUTPUTBUFFER_H
+
+#include <cerrno>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <unistd.h>
+
+// Fixed size chunk that is flushed to a file descriptor every time it fills up,
+// so the emitted text never has to sit in memory as a whole.
+// A buffer without a file descriptor (-1) only counts the bytes it was given.
+class OutputBuffer {
+public:
+    static constexpr std::size_t chunk_size = 64 * 1024;
+
+    // output iterator used as the std::format_to target
+    class Iterator {
+    public:
+        using iterator_category = std::output_iterator_tag;
+        using value_type = void;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = void;
+
+        explicit Iterator(OutputBuffer *buffer) : buffer(buffer) {
+        }
+
+        Iterator &operator=(char c) {
+            buffer->put(c);
+            return *this;
+        }
+
+        Iterator &operator*() { return *this; }
+        Iterator &operator++() { return *this; }
+        Iterator &operator++(int) { return *this; }
+
+    private:
+        OutputBuffer *buffer;
+    };
+
+    explicit OutputBuffer(int fd = -1) : fd(fd), chunk(new char[chunk_size]) {
+    }
+
+    OutputBuffer(const OutputBuffer &) = delete;
+    OutputBuffer &operator=(const OutputBuffer &) = delete;
+
+    // writes what is left, a failure here goes unnoticed, so callers that check failed() flush first
+    ~OutputBuffer() {
+        flush();
+    }
+
+    void put(char c) {
+        if (m_size == chunk_size) {
+            flush();
+        }
+        chunk[m_size++] = c;
+    }
+
+    void write(std::string_view str) {
+        if (m_size + str.size() > chunk_size) {
+            flush();
+            if (str.size() >= chunk_size) {
+                write_to_fd(str.data(), str.size());
+                return;
+            }
+        }
+        std::memcpy(chunk.get() + m_size, str.data(), str.size());
+        m_size += str.size();
+    }
+
+    template<typename... Args>
+    void format(std::format_string<Args...> fmt, Args &&... args) {
+        // format straight into the chunk, falling back to the character iterator only when the text does not fit
+        if (chunk_size - m_size >= inline_format_space) {
+            auto result = std::format_to_n(chunk.get() + m_size, chunk_size - m_size, fmt, std::forward<Args>(args)...);
+            if (static_cast<std::size_t>(result.size) <= chunk_size - m_size) {
+                m_size += result.size;
+                return;
+            }
+        }
+        std::format_to(Iterator(this), fmt, std::forward<Args>(args)...);
+    }
+
+    OutputBuffer &operator<<(std::string_view str) {
+        write(str);
+        return *this;
+    }
+
+    OutputBuffer &operator<<(char c) {
+        put(c);
+        return *this;
+    }
+
+    template<typename T> requires std::is_floating_point_v<T> || std::is_same_v<T, bool>
+    OutputBuffer &operator<<(T value) {
+        format("{}", value);
+        return *this;
+    }
+
+    // integers skip format string parsing, they are the most common thing written after names
+    template<typename T> requires std::is_integral_v<T> && (!std::is_same_v<T, bool>)
+    OutputBuffer &operator<<(T value) {
+        if (chunk_size - m_size < max_integer_size) {
+            flush();
+        }
+        m_size = std::to_chars(chunk.get() + m_size, chunk.get() + chunk_size, value).ptr - chunk.get();
+        return *this;
+    }
+
+    void flush() {
+        write_to_fd(chunk.get(), m_size);
+        m_size = 0;
+    }
+
+    // total number of bytes handed to the buffer so far
+    std::size_t size() const {
+        return m_flushed + m_size;
+    }
+
+    bool failed() const {
+        return m_failed;
+    }
+
+private:
+    static constexpr std::size_t inline_format_space = 256;
+    // digits of the longest 64 bit integer and its sign
+    static constexpr std::size_t max_integer_size = 21;
+
+    void write_to_fd(const char *data, std::size_t size) {
+        m_flushed += size;
+        if (fd < 0 || m_failed) return;
+        while (size > 0) {
+            auto written = ::write(fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                m_failed = true;
+                return;
+            }
+            data += written;
+            size -= written;
+        }
+    }
+
+    int fd;
+    std::unique_ptr<char[]> chunk;
+    std::size_t m_size = 0;
+    std::size_t m_flushed = 0;
+    bool m_failed = false;
+};
+
+#endif //OUTPUTBUFFER_H
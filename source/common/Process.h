@@ -0,0 +1,171 @@
+#ifndef PROCESS_H
+#define PROCESS_H
+
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <optional>
+#include <spawn.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+extern char **environ;
+
+// Both ends are close-on-exec, children only ever see the end that was explicitly handed to them,
+// otherwise a reader would never observe end of file while another child keeps a copy of the write end.
+struct Pipe {
+    int read_end = -1;
+    int write_end = -1;
+
+    static std::optional<Pipe> create() {
+        int fds[2];
+        if (pipe(fds) != 0) return {};
+        fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+        fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+        return Pipe{fds[0], fds[1]};
+    }
+};
+
+inline void close_fd(int &fd) {
+    if (fd != -1) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+// reads from fd until end of file
+inline std::optional<std::string> read_all(int fd) {
+    std::string result;
+    char buffer[64 * 1024];
+    while (true) {
+        auto n = read(fd, buffer, sizeof(buffer));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return {};
+        }
+        if (n == 0) break;
+        result.append(buffer, n);
+    }
+    return result;
+}
+
+// Child process started with posix_spawnp, the program is looked up in PATH.
+// Every child leads a process group of its own, so kill() also stops the assembler gcc runs for it, which would
+// otherwise go on reading its input and write an object from whatever it got. The terminal only interrupts the
+// driver's group, forward_termination_signals() passes interrupts on to the children.
+class Process {
+public:
+    // -1 leaves the corresponding stream inherited from the parent
+    static std::optional<Process> spawn(const std::vector<std::string> &args, int stdin_fd = -1, int stdout_fd = -1) {
+        std::vector<char *> argv;
+        for (const auto &arg: args) {
+            argv.push_back(const_cast<char *>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        if (stdin_fd != -1) {
+            posix_spawn_file_actions_adddup2(&actions, stdin_fd, STDIN_FILENO);
+        }
+        if (stdout_fd != -1) {
+            posix_spawn_file_actions_adddup2(&actions, stdout_fd, STDOUT_FILENO);
+        }
+        posix_spawnattr_t attributes;
+        posix_spawnattr_init(&attributes);
+        posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+        posix_spawnattr_setpgroup(&attributes, 0);
+        pid_t pid;
+        int result = posix_spawnp(&pid, argv[0], &actions, &attributes, argv.data(), environ);
+        posix_spawnattr_destroy(&attributes);
+        posix_spawn_file_actions_destroy(&actions);
+        if (result != 0) return {};
+        running_groups().add(pid);
+        return Process(pid);
+    }
+
+    // the children's groups get the same signal before the driver dies from SIGINT, SIGTERM or SIGHUP
+    static void forward_termination_signals() {
+        for (int signal: {SIGINT, SIGTERM, SIGHUP}) {
+            std::signal(signal, [](int received) {
+                running_groups().signal_all(received);
+                std::signal(received, SIG_DFL);
+                std::raise(received);
+            });
+        }
+    }
+
+    // returns true if the process exited with status 0
+    bool wait() {
+        if (pid == -1) return exited_successfully;
+        int status;
+        while (waitpid(pid, &status, 0) == -1) {
+            if (errno != EINTR) {
+                running_groups().remove(pid);
+                pid = -1;
+                return false;
+            }
+        }
+        running_groups().remove(pid);
+        pid = -1;
+        exited_successfully = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        return exited_successfully;
+    }
+
+    void kill() {
+        if (pid != -1) {
+            ::kill(-pid, SIGTERM);
+            wait();
+            exited_successfully = false;
+        }
+    }
+
+private:
+    // slots are only ever claimed and cleared, never moved, so the signal handler can walk them at any time, children
+    // past the last slot are not forwarded to
+    class Groups {
+    public:
+        void add(pid_t pid) {
+            for (auto &slot: slots) {
+                if (slot == 0) {
+                    slot = pid;
+                    return;
+                }
+            }
+        }
+
+        void remove(pid_t pid) {
+            for (auto &slot: slots) {
+                if (slot == pid) {
+                    slot = 0;
+                }
+            }
+        }
+
+        void signal_all(int signal) const {
+            for (pid_t pid: slots) {
+                if (pid != 0) {
+                    ::kill(-pid, signal);
+                }
+            }
+        }
+
+    private:
+        volatile sig_atomic_t slots[256] = {};
+    };
+
+    static Groups &running_groups() {
+        static Groups groups;
+        return groups;
+    }
+
+    explicit Process(pid_t pid) : pid(pid) {
+    }
+
+    pid_t pid;
+    bool exited_successfully = false;
+};
+
+#endif //PROCESS_H
@@ -0,0 +1,54 @@
+#ifndef STAGETIMINGS_H
+#define STAGETIMINGS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Wall clock time spent in every compiler stage, accumulated over all compiled inputs.
+class StageTimings {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stage {
+        std::string name;
+        Clock::duration time{};
+    };
+
+    void add(std::string_view name, Clock::duration time) {
+        auto it = std::ranges::find(stages, name, &Stage::name);
+        if (it == stages.end()) {
+            stages.push_back({std::string(name), time});
+        } else {
+            it->time += time;
+        }
+    }
+
+    Clock::duration total() const {
+        Clock::duration result{};
+        for (const auto &stage: stages) {
+            result += stage.time;
+        }
+        return result;
+    }
+
+    void clear() {
+        stages.clear();
+        tokens = 0;
+        lines = 0;
+    }
+
+    // stages in order of their first execution
+    std::vector<Stage> stages;
+    std::size_t tokens = 0;
+    std::size_t lines = 0;
+};
+
+inline double to_milliseconds(StageTimings::Clock::duration time) {
+    return std::chrono::duration<double, std::milli>(time).count();
+}
+
+#endif //STAGETIMINGS_H
@@ -1,23 +1,51 @@
 #include <iostream>
+#include <charconv>
 #include <filesystem>
 #include <format>
-#include <sstream>
-#include <fstream>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "Compiler.h"
+#include "common/OutputBuffer.h"
+#include "common/Process.h"
+#include "common/StageTimings.h"
 
+// external tools are spawned directly, preprocessed source and assembly only ever travel through pipes
+static std::vector<std::string> gcc_command() {
+    // temp arch only in macOS?
+#if __APPLE__
+    return {"arch", "-x86_64", "gcc"};
+#else
+    return {"gcc"};
+#endif
+}
+
+struct Input {
+    std::filesystem::path path;
+    std::optional<Process> preprocessor = std::nullopt;
+    int preprocessed_fd = -1;
+};
 
 int main(int argc, char *argv[]) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <filename>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <filename>..." << std::endl;
+        return -1;
     }
 
-    std::string file_path_string;
-
     Compiler compiler;
     bool generate_object_file = false;
     bool generate_asm = false;
-    std::string args_to_assembler;
+    StageTimings timings;
+    codegen::PeepholeStatistics peephole_statistics;
+    optimization::InliningReport inlining_report;
+    std::vector<std::string> args_to_linker;
+    std::vector<Input> inputs;
+    int optimization_level = 0;
+    optimization::OptimizationOptions extra_optimizations;
+    // overrides the one picked by the level
+    std::optional<optimization::RegisterAllocator> register_allocator;
     for (int i = 1; i < argc; i++) {
         if (std::string(argv[i]) == "--lex") {
             compiler.only_lex = true;
@@ -31,63 +59,286 @@ int main(int argc, char *argv[]) {
             compiler.only_ir = true;
         } else if (std::string(argv[i]) == "--validate") {
             compiler.only_analysis = true;
+        } else if (std::string_view(argv[i]).starts_with("--dump-after=")) {
+            // comma separated list of stages
+            std::string_view stages = std::string_view(argv[i]).substr(std::strlen("--dump-after="));
+            while (!stages.empty()) {
+                auto end = stages.find(',');
+                auto name = stages.substr(0, end);
+                auto stage = DumpOptions::parse_stage(name);
+                if (!stage) {
+                    std::cerr << "Unknown dump stage " << name << ", expected one of:";
+                    for (auto stage_name: DumpOptions::stage_names) {
+                        std::cerr << " " << stage_name;
+                    }
+                    std::cerr << std::endl;
+                    return -1;
+                }
+                compiler.dump_options.enable(*stage);
+                stages = end == std::string_view::npos ? std::string_view() : stages.substr(end + 1);
+            }
+        } else if (std::string_view(argv[i]).starts_with("--dump-function=")) {
+            compiler.dump_options.function = std::string_view(argv[i]).substr(std::strlen("--dump-function="));
+        } else if (std::string_view(argv[i]).size() == 3 && std::string_view(argv[i]).starts_with("-O") &&
+                   argv[i][2] >= '0' && argv[i][2] <= '3') {
+            optimization_level = argv[i][2] - '0';
+        } else if (std::string(argv[i]) == "--fold-constants") {
+            extra_optimizations.fold_constants = true;
+        } else if (std::string(argv[i]) == "--propagate-copies") {
+            extra_optimizations.propagate_copies = true;
+        } else if (std::string(argv[i]) == "--eliminate-dead-stores") {
+            extra_optimizations.eliminate_dead_stores = true;
+        } else if (std::string(argv[i]) == "--eliminate-unreachable-code") {
+            extra_optimizations.eliminate_unreachable_code = true;
+        } else if (std::string(argv[i]) == "--rotate-loops") {
+            extra_optimizations.rotate_loops = true;
+        } else if (std::string(argv[i]) == "--vectorize-loops") {
+            extra_optimizations.vectorize_loops = true;
+        } else if (std::string(argv[i]) == "--unroll-loops") {
+            extra_optimizations.unroll_loops = true;
+        } else if (std::string(argv[i]) == "--sccp") {
+            extra_optimizations.sparse_conditional_constants = true;
+        } else if (std::string(argv[i]) == "--gvn") {
+            extra_optimizations.global_value_numbering = true;
+        } else if (std::string(argv[i]) == "--licm") {
+            extra_optimizations.hoist_loop_invariants = true;
+        } else if (std::string(argv[i]) == "--strength-reduce") {
+            extra_optimizations.reduce_induction_variables = true;
+        } else if (std::string(argv[i]) == "--eliminate-tail-recursion") {
+            extra_optimizations.eliminate_tail_recursion = true;
+        } else if (std::string(argv[i]) == "--tail-calls") {
+            extra_optimizations.tail_calls = true;
+        } else if (std::string(argv[i]) == "--inline") {
+            extra_optimizations.inline_functions = true;
+        } else if (std::string_view(argv[i]).starts_with("--inline-threshold=")) {
+            std::string_view value = std::string_view(argv[i]).substr(std::strlen("--inline-threshold="));
+            int threshold = 0;
+            auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), threshold);
+            if (value.empty() || error != std::errc() || end != value.data() + value.size() || threshold < 0) {
+                std::cerr << "Invalid inline threshold " << value << ", expected a non-negative integer" << std::endl;
+                return -1;
+            }
+            extra_optimizations.inline_functions = true;
+            extra_optimizations.inline_threshold = threshold;
+        } else if (std::string(argv[i]) == "--share-stack-slots") {
+            extra_optimizations.share_stack_slots = true;
+        } else if (std::string(argv[i]) == "--peephole") {
+            extra_optimizations.peephole = true;
+        } else if (std::string(argv[i]) == "--register-allocator=none") {
+            register_allocator = optimization::RegisterAllocator::NONE;
+        } else if (std::string(argv[i]) == "--register-allocator=linear-scan") {
+            register_allocator = optimization::RegisterAllocator::LINEAR_SCAN;
+        } else if (std::string(argv[i]) == "--register-allocator=graph-coloring") {
+            register_allocator = optimization::RegisterAllocator::GRAPH_COLORING;
+        } else if (std::string(argv[i]) == "--time-passes") {
+            compiler.timings = &timings;
+        } else if (std::string(argv[i]) == "--peephole-stats") {
+            compiler.peephole_statistics = &peephole_statistics;
+        } else if (std::string(argv[i]) == "--inline-report") {
+            compiler.inlining_report = &inlining_report;
         } else if (std::string(argv[i]) == "-c") {
             generate_object_file = true;
         } else if (std::string(argv[i]).starts_with("-l")) {
-            args_to_assembler += std::string(argv[i]) + " ";
+            args_to_linker.emplace_back(argv[i]);
         } else {
-            file_path_string = argv[i];
+            inputs.push_back({argv[i]});
         }
     }
+    compiler.optimization = optimization::OptimizationOptions::for_level(optimization_level);
+    compiler.optimization.merge(extra_optimizations);
+    if (register_allocator) {
+        compiler.optimization.register_allocator = *register_allocator;
+    }
 
-    std::filesystem::path file_path = file_path_string;
-    auto preprocessed_path = std::filesystem::path(file_path).replace_extension(".i");
-    system(std::format("gcc -E -P {} -o {}", file_path.string(), preprocessed_path.string()).c_str());
+    if (inputs.empty()) {
+        std::cerr << "No input files" << std::endl;
+        return -1;
+    }
 
-    std::ifstream input_file(preprocessed_path);
-    std::stringstream stream;
-    stream << input_file.rdbuf();
-    std::string content = stream.str();
+    // a crashed assembler should surface as a write error, not kill the driver
+    signal(SIGPIPE, SIG_IGN);
+    Process::forward_termination_signals();
 
-    std::filesystem::remove(preprocessed_path);
+    // every preprocessor is started up front so they run while earlier inputs are being compiled
+    for (auto &input: inputs) {
+        auto pipe = Pipe::create();
+        if (!pipe) {
+            std::cerr << "Failed to create pipe" << std::endl;
+            return -1;
+        }
+        auto command = gcc_command();
+        command.insert(command.end(), {"-E", "-P", input.path.string()});
+        input.preprocessor = Process::spawn(command, -1, pipe->write_end);
+        close_fd(pipe->write_end);
+        if (!input.preprocessor) {
+            std::cerr << "Failed to run preprocessor" << std::endl;
+            return -1;
+        }
+        input.preprocessed_fd = pipe->read_end;
+    }
 
-    auto compiled = compiler.compile(content);
+    bool stop_before_emission = compiler.only_lex || compiler.only_parse || compiler.only_codegen || compiler.only_ir ||
+                                compiler.only_analysis;
+    bool link = !stop_before_emission && !generate_asm && !generate_object_file;
 
-    if (!compiled) {
-        return -1;
+    // when linking, the assembly of every input is handed to a single gcc invocation as /dev/fd/N,
+    // gcc assembles its inputs in order so each pipe is drained right after it is written
+    std::vector<int> link_fds;
+    std::optional<Process> linker;
+    if (link) {
+        auto command = gcc_command();
+        command.insert(command.end(), {"-x", "assembler"});
+        std::vector<int> read_ends;
+        for (std::size_t i = 0; i < inputs.size(); i++) {
+            auto pipe = Pipe::create();
+            if (!pipe) {
+                std::cerr << "Failed to create pipe" << std::endl;
+                return -1;
+            }
+            // the read end has to survive the exec
+            fcntl(pipe->read_end, F_SETFD, 0);
+            command.push_back("/dev/fd/" + std::to_string(pipe->read_end));
+            read_ends.push_back(pipe->read_end);
+            link_fds.push_back(pipe->write_end);
+        }
+        command.insert(command.end(), {"-o", std::filesystem::path(inputs.front().path).replace_extension("").string()});
+        command.insert(command.end(), args_to_linker.begin(), args_to_linker.end());
+        linker = Process::spawn(command);
+        for (auto &fd: read_ends) {
+            close_fd(fd);
+        }
+        if (!linker) {
+            std::cerr << "Failed to run linker" << std::endl;
+            return -1;
+        }
     }
 
-    if (compiler.only_lex || compiler.only_parse || compiler.only_codegen || compiler.only_ir) {
-        return 0;
-    }
-    auto assembly_path = std::filesystem::path(file_path).replace_extension(".s");
-    std::ofstream assembly_file(assembly_path);
-    assembly_file << *compiled;
-    assembly_file.close();
-    if (generate_asm) {
-        return 0;
+    bool failed = false;
+    // with -c every input gets its own assembler, they keep running while the next input is compiled
+    std::vector<std::pair<Process, std::filesystem::path> > assemblers;
+    for (std::size_t i = 0; i < inputs.size(); i++) {
+        auto &input = inputs[i];
+        auto content = read_all(input.preprocessed_fd);
+        close_fd(input.preprocessed_fd);
+        if (!input.preprocessor->wait() || !content) {
+            failed = true;
+            continue;
+        }
+
+        int output_fd = -1;
+        bool assembly_file_created = false;
+        std::optional<Process> assembler;
+        auto assembly_path = std::filesystem::path(input.path).replace_extension(".s");
+        auto object_path = std::filesystem::path(input.path).replace_extension(".o");
+        if (failed || stop_before_emission) {
+            // only diagnostics are wanted
+        } else if (generate_asm) {
+            output_fd = open(assembly_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (output_fd == -1) {
+                std::cerr << "Failed to open " << assembly_path.string() << std::endl;
+                failed = true;
+                continue;
+            }
+            assembly_file_created = true;
+        } else if (generate_object_file) {
+            auto pipe = Pipe::create();
+            if (pipe) {
+                auto command = gcc_command();
+                command.insert(command.end(), {"-x", "assembler", "-c", "-", "-o", object_path.string()});
+                assembler = Process::spawn(command, pipe->read_end);
+                close_fd(pipe->read_end);
+                if (assembler) {
+                    output_fd = pipe->write_end;
+                } else {
+                    close_fd(pipe->write_end);
+                }
+            }
+            if (!assembler) {
+                std::cerr << "Failed to run assembler" << std::endl;
+                failed = true;
+                continue;
+            }
+        } else {
+            output_fd = link_fds[i];
+            link_fds[i] = -1;
+        }
+
+        bool compiled;
+        {
+            // assembly is streamed to its consumer while it is emitted
+            OutputBuffer assembly(output_fd);
+            compiler.dump_base = input.path;
+            compiled = compiler.compile(*content, assembly);
+        }
+        if (!compiled && assembler) {
+            // killed while its input is still open, at end of input it would assemble the partial assembly
+            assembler->kill();
+        }
+        close_fd(output_fd);
+
+        if (!compiled) {
+            failed = true;
+            if (assembly_file_created) {
+                std::filesystem::remove(assembly_path);
+            }
+            if (assembler) {
+                std::filesystem::remove(object_path);
+            }
+        } else if (assembler) {
+            assemblers.emplace_back(std::move(*assembler), object_path);
+        }
     }
 
-    if (generate_object_file) {
-        auto output_path = std::filesystem::path(file_path).replace_extension(".o");
-        // temp arch only in macOS?
-#if __APPLE__
-        system(std::format("arch -x86_64 gcc -c {} -o {}", assembly_path.string(), output_path.string()).c_str());
-#else
-        system(std::format("gcc -c {} -o {}", assembly_path.string(), output_path.string()).c_str());
-#endif
-    } else {
-        auto output_path = std::filesystem::path(file_path).replace_extension("");
-        // temp arch only in macOS?
-#if __APPLE__
-        system(std::format("arch -x86_64 gcc {} -o {} {}", assembly_path.string(), output_path.string(), args_to_assembler).c_str());
-#else
-        system(std::format("gcc {} -o {} {}", assembly_path.string(), output_path.string(), args_to_assembler).c_str());
+    // the same for the linker, which reads the assembly of every input
+    if (failed && linker) {
+        linker->kill();
+        linker.reset();
+    }
+    for (auto &fd: link_fds) {
+        close_fd(fd);
+    }
 
-#endif
+    for (auto &[assembler, object_path]: assemblers) {
+        if (!assembler.wait()) {
+            failed = true;
+        }
+    }
+    if (linker && !linker->wait()) {
+        failed = true;
     }
 
-    std::filesystem::remove(assembly_path);
+    if (compiler.timings) {
+        auto total = to_milliseconds(timings.total());
+        std::cerr << std::format("{:<28} {:>10} {:>7}\n", "stage", "ms", "%");
+        for (const auto &stage: timings.stages) {
+            auto time = to_milliseconds(stage.time);
+            std::cerr << std::format("{:<28} {:>10.3f} {:>6.1f}%\n", stage.name, time, total > 0 ? time / total * 100 : 0);
+        }
+        std::cerr << std::format("{:<28} {:>10.3f}\n", "total", total);
+        std::cerr << std::format("{} tokens, {} lines\n", timings.tokens, timings.lines);
+    }
+    if (compiler.peephole_statistics) {
+        std::cerr << std::format("{:<28} {:>10}\n", "peephole pattern", "fired");
+        for (const auto &[name, fired]: peephole_statistics.fired) {
+            std::cerr << std::format("{:<28} {:>10}\n", name, fired);
+        }
+        std::cerr << std::format("{} jumps threaded, {} unreachable blocks removed\n",
+                                 peephole_statistics.threaded_jumps, peephole_statistics.removed_blocks);
+        std::cerr << std::format("{} instructions before, {} after\n", peephole_statistics.instructions_before,
+                                 peephole_statistics.instructions_after);
+    }
+    if (compiler.inlining_report) {
+        std::cerr << std::format("{:<24} {:<24} {:>6} {:>8}  {}\n", "caller", "callee", "size", "benefit",
+                                 "decision");
+        for (const auto &decision: inlining_report.decisions) {
+            std::cerr << std::format("{:<24} {:<24} {:>6} {:>8}  {} ({})\n", decision.caller, decision.callee,
+                                     decision.size, decision.benefit, decision.inlined ? "inlined" : "kept",
+                                     decision.reason);
+        }
+        for (const auto &name: inlining_report.removed) {
+            std::cerr << std::format("removed {}\n", name);
+        }
+    }
 
-    return 0;
+    return failed ? -1 : 0;
 }
@@ -0,0 +1,89 @@
+#ifndef BITSET_H
+#define BITSET_H
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// dense fixed size set of small integers for dataflow facts, one per block
+
+namespace optimization {
+    class BitSet {
+    public:
+        BitSet() = default;
+
+        explicit BitSet(std::size_t size, bool value = false)
+            : words((size + 63) / 64, value ? ~std::uint64_t{0} : 0), m_size(size) {
+            clear_tail();
+        }
+
+        std::size_t size() const {
+            return m_size;
+        }
+
+        bool test(std::size_t i) const {
+            return words[i / 64] >> (i % 64) & 1;
+        }
+
+        void set(std::size_t i) {
+            words[i / 64] |= std::uint64_t{1} << (i % 64);
+        }
+
+        void reset(std::size_t i) {
+            words[i / 64] &= ~(std::uint64_t{1} << (i % 64));
+        }
+
+        void fill(bool value) {
+            std::ranges::fill(words, value ? ~std::uint64_t{0} : 0);
+            clear_tail();
+        }
+
+        BitSet &operator|=(const BitSet &other) {
+            for (std::size_t i = 0; i < words.size(); i++) words[i] |= other.words[i];
+            return *this;
+        }
+
+        BitSet &operator&=(const BitSet &other) {
+            for (std::size_t i = 0; i < words.size(); i++) words[i] &= other.words[i];
+            return *this;
+        }
+
+        // removes every element of other
+        BitSet &subtract(const BitSet &other) {
+            for (std::size_t i = 0; i < words.size(); i++) words[i] &= ~other.words[i];
+            return *this;
+        }
+
+        bool operator==(const BitSet &other) const = default;
+
+        bool none() const {
+            for (auto word: words) {
+                if (word) return false;
+            }
+            return true;
+        }
+
+        // calls f with every element in increasing order
+        template<typename F>
+        void for_each(F &&f) const {
+            for (std::size_t i = 0; i < words.size(); i++) {
+                for (auto word = words[i]; word; word &= word - 1) {
+                    f(i * 64 + std::countr_zero(word));
+                }
+            }
+        }
+
+    private:
+        void clear_tail() {
+            if (m_size % 64) {
+                words.back() &= (std::uint64_t{1} << (m_size % 64)) - 1;
+            }
+        }
+
+        std::vector<std::uint64_t> words;
+        std::size_t m_size = 0;
+    };
+}
+
+#endif //BITSET_H
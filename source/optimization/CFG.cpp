@@ -0,0 +1,332 @@
+#include "CFG.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "../overloaded.h"
+
+namespace optimization {
+    const std::string *jump_target(const IR::Instruction &instruction) {
+        return std::visit(overloaded{
+                              [](const IR::Jump &ins) { return &ins.target; },
+                              [](const IR::JumpIfZero &ins) { return &ins.target; },
+                              [](const IR::JumpIfNotZero &ins) { return &ins.target; },
+                              [](const auto &) -> const std::string * { return nullptr; }
+                          }, instruction);
+    }
+
+    std::string *jump_target(IR::Instruction &instruction) {
+        return const_cast<std::string *>(jump_target(std::as_const(instruction)));
+    }
+
+    bool ends_block(const IR::Instruction &instruction) {
+        return std::holds_alternative<IR::Jump>(instruction) || std::holds_alternative<IR::JumpTable>(instruction) ||
+               std::holds_alternative<IR::Return>(instruction);
+    }
+
+    CFG::CFG(std::vector<IR::Instruction> instructions) {
+        split(std::move(instructions));
+        rebuild_edges();
+    }
+
+    void CFG::split(std::vector<IR::Instruction> instructions) {
+        // block boundaries are found first so every instruction is moved exactly once
+        std::vector<std::size_t> starts{0};
+        for (std::size_t i = 0; i < instructions.size(); i++) {
+            const auto &instruction = instructions[i];
+            if (std::holds_alternative<IR::Label>(instruction) && starts.back() != i) {
+                starts.push_back(i);
+            }
+            if (jump_target(instruction) || ends_block(instruction)) {
+                starts.push_back(i + 1);
+            }
+        }
+        if (starts.size() > 1 && starts.back() == instructions.size()) {
+            starts.pop_back();
+        }
+        starts.push_back(instructions.size());
+
+        blocks.resize(starts.size() - 1);
+        for (std::size_t i = 0; i + 1 < starts.size(); i++) {
+            auto &block = blocks[i].instructions;
+            block.reserve(starts[i + 1] - starts[i]);
+            std::move(instructions.begin() + starts[i], instructions.begin() + starts[i + 1],
+                      std::back_inserter(block));
+        }
+    }
+
+    std::vector<IR::Instruction> CFG::linearize() {
+        std::size_t size = 0;
+        for (const auto &block: blocks) {
+            size += block.instructions.size();
+        }
+        std::vector<IR::Instruction> instructions;
+        instructions.reserve(size);
+        for (auto &block: blocks) {
+            std::ranges::move(block.instructions, std::back_inserter(instructions));
+        }
+        blocks.clear();
+        loops.clear();
+        return instructions;
+    }
+
+    int CFG::block_of_label(const std::string &label) const {
+        auto it = label_to_block.find(label);
+        return it == label_to_block.end() ? -1 : it->second;
+    }
+
+    void CFG::add_edge(int from, int to) {
+        auto &successors = blocks[from].successors;
+        if (std::ranges::find(successors, to) != successors.end()) return;
+        successors.push_back(to);
+        blocks[to].predecessors.push_back(from);
+    }
+
+    void CFG::rebuild_edges() {
+        label_to_block.clear();
+        label_to_block.reserve(blocks.size());
+        for (int i = 0; i < static_cast<int>(blocks.size()); i++) {
+            auto &block = blocks[i];
+            block.predecessors.clear();
+            block.successors.clear();
+            if (!block.instructions.empty() && std::holds_alternative<IR::Label>(block.instructions.front())) {
+                label_to_block[std::get<IR::Label>(block.instructions.front()).name] = i;
+            }
+        }
+        for (int i = 0; i < static_cast<int>(blocks.size()); i++) {
+            const auto &instructions = blocks[i].instructions;
+            if (!instructions.empty()) {
+                for_each_jump_target(instructions.back(), [&](const std::string &target) {
+                    add_edge(i, label_to_block.at(target));
+                });
+                if (ends_block(instructions.back())) continue;
+            }
+            if (i + 1 < static_cast<int>(blocks.size())) {
+                add_edge(i, i + 1);
+            }
+        }
+        compute_reverse_postorder();
+    }
+
+    void CFG::compute_reverse_postorder() {
+        rpo.clear();
+        rpo_index.assign(blocks.size(), -1);
+        for (auto &block: blocks) {
+            block.reachable = false;
+        }
+        if (blocks.empty()) return;
+
+        // iterative dfs, recursion would overflow on long chains of blocks
+        std::vector<std::pair<int, std::size_t> > stack;
+        blocks[entry].reachable = true;
+        stack.emplace_back(entry, 0);
+        while (!stack.empty()) {
+            auto &[block, next] = stack.back();
+            const auto &successors = blocks[block].successors;
+            if (next < successors.size()) {
+                int successor = successors[next++];
+                if (!blocks[successor].reachable) {
+                    blocks[successor].reachable = true;
+                    stack.emplace_back(successor, 0);
+                }
+            } else {
+                rpo.push_back(block);
+                stack.pop_back();
+            }
+        }
+        std::ranges::reverse(rpo);
+        for (int i = 0; i < static_cast<int>(rpo.size()); i++) {
+            rpo_index[rpo[i]] = i;
+        }
+    }
+
+    void CFG::compute_dominators() {
+        std::vector<int> idom(blocks.size(), -1);
+        if (!blocks.empty()) {
+            idom[entry] = entry;
+        }
+        auto intersect = [&](int a, int b) {
+            while (a != b) {
+                while (rpo_index[a] > rpo_index[b]) a = idom[a];
+                while (rpo_index[b] > rpo_index[a]) b = idom[b];
+            }
+            return a;
+        };
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int block: rpo) {
+                if (block == entry) continue;
+                int new_idom = -1;
+                for (int predecessor: blocks[block].predecessors) {
+                    if (idom[predecessor] == -1) continue;
+                    new_idom = new_idom == -1 ? predecessor : intersect(predecessor, new_idom);
+                }
+                if (idom[block] != new_idom) {
+                    idom[block] = new_idom;
+                    changed = true;
+                }
+            }
+        }
+
+        for (auto &block: blocks) {
+            block.dominated.clear();
+        }
+        for (int i = 0; i < static_cast<int>(blocks.size()); i++) {
+            blocks[i].idom = i == entry ? -1 : idom[i];
+            if (blocks[i].idom != -1) {
+                blocks[blocks[i].idom].dominated.push_back(i);
+            }
+        }
+
+        // number the dominator tree so dominance queries are two comparisons
+        dom_enter.assign(blocks.size(), -1);
+        dom_exit.assign(blocks.size(), -1);
+        if (blocks.empty()) return;
+        int counter = 0;
+        std::vector<std::pair<int, std::size_t> > stack;
+        dom_enter[entry] = counter++;
+        stack.emplace_back(entry, 0);
+        while (!stack.empty()) {
+            auto &[block, next] = stack.back();
+            if (next < blocks[block].dominated.size()) {
+                int child = blocks[block].dominated[next++];
+                dom_enter[child] = counter++;
+                stack.emplace_back(child, 0);
+            } else {
+                dom_exit[block] = counter++;
+                stack.pop_back();
+            }
+        }
+    }
+
+    bool CFG::dominates(int dominator, int block) const {
+        if (dom_enter[dominator] == -1 || dom_enter[block] == -1) return false;
+        return dom_enter[dominator] <= dom_enter[block] && dom_exit[block] <= dom_exit[dominator];
+    }
+
+    void CFG::compute_dominance_frontiers() {
+        // every join point is in the frontier of the blocks between its predecessors and its immediate dominator
+        for (auto &block: blocks) {
+            block.frontier.clear();
+        }
+        for (int block: rpo) {
+            if (blocks[block].predecessors.size() < 2) continue;
+            for (int runner: blocks[block].predecessors) {
+                if (!blocks[runner].reachable) continue;
+                while (runner != blocks[block].idom && runner != -1) {
+                    auto &frontier = blocks[runner].frontier;
+                    if (frontier.empty() || frontier.back() != block) {
+                        frontier.push_back(block);
+                    }
+                    runner = blocks[runner].idom;
+                }
+            }
+        }
+    }
+
+    void CFG::compute_loops() {
+        loops.clear();
+        std::unordered_map<int, int> loop_of_header;
+        for (int block: rpo) {
+            for (int successor: blocks[block].successors) {
+                if (!dominates(successor, block)) continue;
+                auto [it, inserted] = loop_of_header.try_emplace(successor, loops.size());
+                if (inserted) {
+                    loops.push_back(Loop{successor, {}, {}});
+                }
+                loops[it->second].latches.push_back(block);
+            }
+        }
+
+        // body: everything that reaches a latch without passing through the header
+        std::vector<int> mark(blocks.size(), -1);
+        for (int i = 0; i < static_cast<int>(loops.size()); i++) {
+            auto &loop = loops[i];
+            mark[loop.header] = i;
+            loop.blocks.push_back(loop.header);
+            std::vector<int> worklist;
+            for (int latch: loop.latches) {
+                if (mark[latch] != i) {
+                    mark[latch] = i;
+                    loop.blocks.push_back(latch);
+                    worklist.push_back(latch);
+                }
+            }
+            while (!worklist.empty()) {
+                int block = worklist.back();
+                worklist.pop_back();
+                for (int predecessor: blocks[block].predecessors) {
+                    if (mark[predecessor] != i && blocks[predecessor].reachable) {
+                        mark[predecessor] = i;
+                        loop.blocks.push_back(predecessor);
+                        worklist.push_back(predecessor);
+                    }
+                }
+            }
+            std::ranges::sort(loop.blocks);
+        }
+
+        // natural loops with different headers are nested or disjoint, so going from the largest to the smallest
+        // every block ends up pointing at its innermost loop and every header at its parent before that
+        std::ranges::sort(loops, std::greater{}, [](const Loop &loop) { return loop.blocks.size(); });
+        for (auto &block: blocks) {
+            block.loop = -1;
+            block.loop_depth = 0;
+        }
+        for (int i = 0; i < static_cast<int>(loops.size()); i++) {
+            auto &loop = loops[i];
+            loop.parent = blocks[loop.header].loop;
+            loop.depth = loop.parent == -1 ? 1 : loops[loop.parent].depth + 1;
+            for (int block: loop.blocks) {
+                blocks[block].loop = i;
+                blocks[block].loop_depth = loop.depth;
+            }
+        }
+    }
+
+    bool CFG::insert_preheaders() {
+        // jumps are retargeted first, the blocks go in afterward from the back so the indices stay valid
+        std::vector<std::pair<int, std::string> > preheaders;
+        for (const auto &loop: loops) {
+            int header = loop.header;
+            const auto &front = blocks[header].instructions.front();
+            if (!std::holds_alternative<IR::Label>(front)) continue;
+            // a latch falling through into the header would fall into the preheader instead
+            if (header > 0 && std::ranges::binary_search(loop.blocks, header - 1) &&
+                !ends_block(blocks[header - 1].instructions.back())) {
+                continue;
+            }
+            const auto &label = std::get<IR::Label>(front).name;
+            auto preheader = label + ".preheader";
+            for (int predecessor: blocks[header].predecessors) {
+                if (std::ranges::binary_search(loop.blocks, predecessor)) continue;
+                for_each_jump_target(blocks[predecessor].instructions.back(), [&](std::string &target) {
+                    if (target == label) target = preheader;
+                });
+            }
+            preheaders.emplace_back(header, std::move(preheader));
+        }
+        if (preheaders.empty()) return false;
+        std::ranges::sort(preheaders, std::greater{}, [](const auto &preheader) { return preheader.first; });
+        for (auto &[header, label]: preheaders) {
+            BasicBlock block;
+            block.instructions.emplace_back(IR::Label(std::move(label)));
+            blocks.insert(blocks.begin() + header, std::move(block));
+        }
+        loops.clear();
+        rebuild_edges();
+        return true;
+    }
+
+    int CFG::preheader(const Loop &loop) const {
+        int outside = -1;
+        for (int predecessor: blocks[loop.header].predecessors) {
+            if (std::ranges::binary_search(loop.blocks, predecessor)) continue;
+            if (outside != -1) return -1;
+            outside = predecessor;
+        }
+        if (outside == -1 || blocks[outside].successors.size() != 1) return -1;
+        return outside;
+    }
+}
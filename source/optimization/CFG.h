@@ -0,0 +1,109 @@
+#ifndef CFG_H
+#define CFG_H
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../IR.h"
+
+// ir function body -> basic blocks and back
+
+namespace optimization {
+    struct BasicBlock {
+        // a block starts at a label or after a jump/return, its label (if any) is the first instruction
+        std::vector<IR::Instruction> instructions;
+        std::vector<int> predecessors;
+        std::vector<int> successors;
+
+        bool reachable = false;
+        // immediate dominator, -1 for the entry block and unreachable blocks
+        int idom = -1;
+        // children in the dominator tree
+        std::vector<int> dominated;
+        // dominance frontier, requires compute_dominance_frontiers()
+        std::vector<int> frontier;
+        // innermost loop containing the block, -1 outside of loops
+        int loop = -1;
+        int loop_depth = 0;
+    };
+
+    // natural loop, all back edges into the same header form one loop
+    struct Loop {
+        int header;
+        std::vector<int> latches;
+        // sorted, includes the header
+        std::vector<int> blocks;
+        // enclosing loop, -1 for outermost loops
+        int parent = -1;
+        int depth = 1;
+    };
+
+    class CFG {
+    public:
+        // takes ownership of the instructions, give them back with linearize()
+        explicit CFG(std::vector<IR::Instruction> instructions);
+
+        // blocks in their current order, the order is what fall through edges were built from
+        std::vector<IR::Instruction> linearize();
+
+        // rebuilds edges after instructions were changed in place, keeps the block contents
+        void rebuild_edges();
+
+        // Cooper, Harvey, Kennedy "A Simple, Fast Dominance Algorithm"
+        void compute_dominators();
+        bool dominates(int dominator, int block) const;
+        // requires dominators
+        void compute_dominance_frontiers();
+
+        // requires dominators
+        void compute_loops();
+        // gives every loop header a block of its own in front of it that all edges from outside the loop go through,
+        // requires loops and invalidates them and the dominators, true if any block was added
+        bool insert_preheaders();
+        // the only predecessor of the loop header outside the loop if it has no other successor, -1 otherwise
+        int preheader(const Loop &loop) const;
+
+        // reachable blocks only
+        const std::vector<int> &reverse_postorder() const {
+            return rpo;
+        }
+
+        // -1 if no block starts with the label
+        int block_of_label(const std::string &label) const;
+
+        std::vector<BasicBlock> blocks;
+        std::vector<Loop> loops;
+
+        static constexpr int entry = 0;
+
+    private:
+        void split(std::vector<IR::Instruction> instructions);
+        void add_edge(int from, int to);
+        void compute_reverse_postorder();
+
+        std::unordered_map<std::string, int> label_to_block;
+        std::vector<int> rpo;
+        // position of every block in rpo, -1 for unreachable blocks
+        std::vector<int> rpo_index;
+        // preorder interval of every block in the dominator tree
+        std::vector<int> dom_enter;
+        std::vector<int> dom_exit;
+    };
+
+    // label a jump instruction transfers control to, nullptr for everything else
+    const std::string *jump_target(const IR::Instruction &instruction);
+    std::string *jump_target(IR::Instruction &instruction);
+    // calls f with every label the instruction may transfer control to, a jump table can name a label more than once
+    template<typename Instruction, typename F>
+    void for_each_jump_target(Instruction &instruction, F &&f) {
+        if (auto *table = std::get_if<IR::JumpTable>(&instruction)) {
+            for (auto &target: table->targets) f(target);
+        } else if (auto *target = jump_target(instruction)) {
+            f(*target);
+        }
+    }
+    // true for instructions after which control never falls through
+    bool ends_block(const IR::Instruction &instruction);
+}
+
+#endif //CFG_H
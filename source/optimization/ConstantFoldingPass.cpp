@@ -0,0 +1,352 @@
+#include "ConstantFoldingPass.h"
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include "CFG.h"
+#include "../overloaded.h"
+
+namespace optimization {
+    namespace {
+        template<typename T>
+        AST::Const make_constant(T value) {
+            if constexpr (std::is_same_v<T, int>) {
+                return AST::ConstInt(value);
+            } else if constexpr (std::is_same_v<T, std::int64_t>) {
+                return AST::ConstLong(value);
+            } else if constexpr (std::is_same_v<T, unsigned int>) {
+                return AST::ConstUInt(value);
+            } else if constexpr (std::is_same_v<T, std::uint64_t>) {
+                return AST::ConstULong(value);
+            } else if constexpr (std::is_same_v<T, double>) {
+                return AST::ConstDouble(value);
+            } else if constexpr (std::is_same_v<T, char>) {
+                return AST::ConstChar(value);
+            } else {
+                static_assert(std::is_same_v<T, unsigned char>);
+                return AST::ConstUChar(value);
+            }
+        }
+
+        // integer -> integer wraps (C++20 conversions are modular), double -> integer truncates and is only defined
+        // when the truncated value fits
+        template<typename To, typename From>
+        std::optional<To> cast_to(From value) {
+            if constexpr (std::is_floating_point_v<From> && std::is_integral_v<To>) {
+                if (std::isnan(value)) return {};
+                double truncated = std::trunc(value);
+                double limit = std::ldexp(1.0, std::numeric_limits<To>::digits);
+                double lower = std::is_signed_v<To> ? -limit : 0.0;
+                if (truncated < lower || truncated >= limit) return {};
+                return static_cast<To>(truncated);
+            } else {
+                return static_cast<To>(value);
+            }
+        }
+
+        template<typename To>
+        std::optional<AST::Const> convert_value(const AST::Const &constant) {
+            return std::visit([](const auto &constant) -> std::optional<AST::Const> {
+                auto value = cast_to<To>(constant.value);
+                if (!value) return {};
+                return make_constant(*value);
+            }, constant);
+        }
+
+        // integer promotion, arithmetic only ever happens in int, long, uint, ulong and double
+        AST::Const promote(const AST::Const &constant) {
+            return std::visit(overloaded{
+                                  [](const AST::ConstChar &constant) -> AST::Const {
+                                      return AST::ConstInt(constant.value);
+                                  },
+                                  [](const AST::ConstUChar &constant) -> AST::Const {
+                                      return AST::ConstInt(constant.value);
+                                  },
+                                  [](const auto &constant) -> AST::Const {
+                                      return constant;
+                                  }
+                              }, constant);
+        }
+
+        template<typename T>
+        std::optional<AST::Const> unary_on(IR::Unary::Operator op, T value) {
+            switch (op) {
+                case IR::Unary::Operator::NEGATE:
+                    if constexpr (std::is_floating_point_v<T>) {
+                        return make_constant<T>(-value);
+                    } else {
+                        // negating the minimum wraps instead of overflowing
+                        return make_constant(static_cast<T>(-static_cast<std::make_unsigned_t<T> >(value)));
+                    }
+                case IR::Unary::Operator::COMPLEMENT:
+                    if constexpr (std::is_floating_point_v<T>) {
+                        return {};
+                    } else {
+                        return make_constant(static_cast<T>(~value));
+                    }
+                case IR::Unary::Operator::LOGICAL_NOT:
+                    return AST::ConstInt(value == 0);
+            }
+            std::unreachable();
+        }
+
+        template<typename T>
+        std::optional<AST::Const> binary_on(IR::Binary::Operator op, T lhs, T rhs) {
+            // comparisons are int in C, NaN compares unequal to everything including itself
+            switch (op) {
+                case IR::Binary::Operator::EQUAL:
+                    return AST::ConstInt(lhs == rhs);
+                case IR::Binary::Operator::NOT_EQUAL:
+                    return AST::ConstInt(lhs != rhs);
+                case IR::Binary::Operator::LESS:
+                    return AST::ConstInt(lhs < rhs);
+                case IR::Binary::Operator::LESS_EQUAL:
+                    return AST::ConstInt(lhs <= rhs);
+                case IR::Binary::Operator::GREATER:
+                    return AST::ConstInt(lhs > rhs);
+                case IR::Binary::Operator::GREATER_EQUAL:
+                    return AST::ConstInt(lhs >= rhs);
+                default:
+                    break;
+            }
+
+            if constexpr (std::is_floating_point_v<T>) {
+                switch (op) {
+                    case IR::Binary::Operator::ADD:
+                        return make_constant<T>(lhs + rhs);
+                    case IR::Binary::Operator::SUBTRACT:
+                        return make_constant<T>(lhs - rhs);
+                    case IR::Binary::Operator::MULTIPLY:
+                        return make_constant<T>(lhs * rhs);
+                    case IR::Binary::Operator::DIVIDE:
+                        return make_constant<T>(lhs / rhs);
+                    default:
+                        return {};
+                }
+            } else {
+                // signed overflow wraps like the generated add/imul, so it is done in the unsigned type
+                using U = std::make_unsigned_t<T>;
+                constexpr T bits = sizeof(T) * 8;
+                switch (op) {
+                    case IR::Binary::Operator::ADD:
+                        return make_constant(static_cast<T>(static_cast<U>(lhs) + static_cast<U>(rhs)));
+                    case IR::Binary::Operator::SUBTRACT:
+                        return make_constant(static_cast<T>(static_cast<U>(lhs) - static_cast<U>(rhs)));
+                    case IR::Binary::Operator::MULTIPLY:
+                        return make_constant(static_cast<T>(static_cast<U>(lhs) * static_cast<U>(rhs)));
+                    case IR::Binary::Operator::DIVIDE:
+                    case IR::Binary::Operator::REMAINDER:
+                        // division by zero and INT_MIN / -1 trap at runtime, that is left to the program
+                        if (rhs == 0) return {};
+                        if constexpr (std::is_signed_v<T>) {
+                            if (lhs == std::numeric_limits<T>::min() && rhs == -1) return {};
+                        }
+                        return make_constant<T>(op == IR::Binary::Operator::DIVIDE ? lhs / rhs : lhs % rhs);
+                    case IR::Binary::Operator::SHIFT_LEFT:
+                    case IR::Binary::Operator::SHIFT_RIGHT:
+                        // the hardware masks the count, C leaves it undefined, neither is worth guessing
+                        if (rhs < 0 || rhs >= bits) return {};
+                        if (op == IR::Binary::Operator::SHIFT_LEFT) {
+                            return make_constant(static_cast<T>(static_cast<U>(lhs) << rhs));
+                        }
+                        // arithmetic for signed types, like sar
+                        return make_constant(static_cast<T>(lhs >> rhs));
+                    case IR::Binary::Operator::BITWISE_AND:
+                        return make_constant(static_cast<T>(lhs & rhs));
+                    case IR::Binary::Operator::BITWISE_XOR:
+                        return make_constant(static_cast<T>(lhs ^ rhs));
+                    case IR::Binary::Operator::BITWISE_OR:
+                        return make_constant(static_cast<T>(lhs | rhs));
+                    default:
+                        return {};
+                }
+            }
+        }
+
+        const AST::Const *constant_of(const IR::Value &value) {
+            if (auto *constant = std::get_if<IR::Constant>(&value)) {
+                return &constant->constant;
+            }
+            return nullptr;
+        }
+
+        // for conditional jumps on a constant, whether the jump is always taken
+        std::optional<bool> branch_taken(const IR::Instruction &instruction) {
+            return std::visit(overloaded{
+                                  [](const IR::JumpIfZero &jump) -> std::optional<bool> {
+                                      if (auto *condition = constant_of(jump.condition)) return is_zero(*condition);
+                                      return {};
+                                  },
+                                  [](const IR::JumpIfNotZero &jump) -> std::optional<bool> {
+                                      if (auto *condition = constant_of(jump.condition)) return !is_zero(*condition);
+                                      return {};
+                                  },
+                                  [](const auto &) -> std::optional<bool> {
+                                      return {};
+                                  }
+                              }, instruction);
+        }
+    }
+
+    std::optional<AST::Const> convert_constant(const AST::Const &constant, const AST::Type &type) {
+        return std::visit(overloaded{
+                              [&](const AST::IntType &) { return convert_value<int>(constant); },
+                              [&](const AST::LongType &) { return convert_value<std::int64_t>(constant); },
+                              [&](const AST::UIntType &) { return convert_value<unsigned int>(constant); },
+                              [&](const AST::ULongType &) { return convert_value<std::uint64_t>(constant); },
+                              [&](const AST::PointerType &) { return convert_value<std::uint64_t>(constant); },
+                              [&](const AST::DoubleType &) { return convert_value<double>(constant); },
+                              [&](const AST::CharType &) { return convert_value<char>(constant); },
+                              [&](const AST::SignedCharType &) { return convert_value<char>(constant); },
+                              [&](const AST::UCharType &) { return convert_value<unsigned char>(constant); },
+                              [](const auto &) -> std::optional<AST::Const> { return {}; }
+                          }, type);
+    }
+
+    std::optional<AST::Const> evaluate_unary(IR::Unary::Operator op, const AST::Const &source,
+                                             const AST::Type &result_type) {
+        auto result = std::visit([&](const auto &constant) {
+            return unary_on(op, constant.value);
+        }, promote(source));
+        if (!result) return {};
+        return convert_constant(*result, result_type);
+    }
+
+    std::optional<AST::Const> evaluate_binary(IR::Binary::Operator op, const AST::Const &left,
+                                              const AST::Const &right, const AST::Type &result_type) {
+        auto lhs = promote(left);
+        auto rhs = promote(right);
+        // the type checker converts both operands to a common type
+        if (lhs.index() != rhs.index()) return {};
+        auto result = std::visit([&](const auto &constant) {
+            using ConstType = std::decay_t<decltype(constant)>;
+            return binary_on(op, constant.value, std::get<ConstType>(rhs).value);
+        }, lhs);
+        if (!result) return {};
+        return convert_constant(*result, result_type);
+    }
+
+    bool same_constant(const AST::Const &lhs, const AST::Const &rhs) {
+        if (lhs.index() != rhs.index()) return false;
+        return std::visit([&](const auto &constant) {
+            using ConstType = std::decay_t<decltype(constant)>;
+            if constexpr (std::is_same_v<ConstType, AST::ConstDouble>) {
+                return std::bit_cast<std::uint64_t>(constant.value) ==
+                       std::bit_cast<std::uint64_t>(std::get<ConstType>(rhs).value);
+            } else {
+                return constant.value == std::get<ConstType>(rhs).value;
+            }
+        }, lhs);
+    }
+
+    bool is_zero(const AST::Const &constant) {
+        return std::visit([](const auto &constant) { return constant.value == 0; }, constant);
+    }
+
+    bool ConstantFoldingPass::run() {
+        bool changed = false;
+        auto &instructions = function->instructions;
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < instructions.size(); i++) {
+            auto &instruction = instructions[i];
+            if (auto taken = branch_taken(instruction)) {
+                changed = true;
+                if (!*taken) continue;
+                std::string target = *jump_target(instruction);
+                instruction = IR::Jump(std::move(target));
+            } else if (auto folded = fold(instruction)) {
+                instruction = std::move(*folded);
+                changed = true;
+            }
+            if (kept != i) {
+                instructions[kept] = std::move(instruction);
+            }
+            kept++;
+        }
+        instructions.erase(instructions.begin() + static_cast<std::ptrdiff_t>(kept), instructions.end());
+        return changed;
+    }
+
+    std::optional<IR::Instruction> ConstantFoldingPass::fold(const IR::Instruction &instruction) {
+        return std::visit(overloaded{
+                              [this](const IR::Unary &unary) { return fold_unary(unary); },
+                              [this](const IR::Binary &binary) { return fold_binary(binary); },
+                              [this](const IR::Copy &copy) { return fold_copy(copy); },
+                              [this](const IR::SignExtend &ins) { return fold_conversion(ins.source, ins.destination); },
+                              [this](const IR::ZeroExtend &ins) { return fold_conversion(ins.source, ins.destination); },
+                              [this](const IR::Truncate &ins) { return fold_conversion(ins.source, ins.destination); },
+                              [this](const IR::IntToDouble &ins) { return fold_conversion(ins.source, ins.destination); },
+                              [this](const IR::UIntToDouble &ins) {
+                                  return fold_conversion(ins.source, ins.destination);
+                              },
+                              [this](const IR::DoubleToInt &ins) { return fold_conversion(ins.source, ins.destination); },
+                              [this](const IR::DoubleToUInt &ins) {
+                                  return fold_conversion(ins.source, ins.destination);
+                              },
+                              [](const IR::JumpTable &table) -> std::optional<IR::Instruction> {
+                                  auto *index = constant_of(table.index);
+                                  if (!index) return {};
+                                  auto position = std::visit([](const auto &constant) {
+                                      return static_cast<std::uint64_t>(constant.value);
+                                  }, *index);
+                                  if (position >= table.targets.size()) return {};
+                                  return IR::Jump(table.targets[position]);
+                              },
+                              [](const auto &) -> std::optional<IR::Instruction> { return {}; }
+                          }, instruction);
+    }
+
+    std::optional<IR::Instruction> ConstantFoldingPass::fold_unary(const IR::Unary &unary) {
+        auto *source = constant_of(unary.source);
+        auto *type = type_of(unary.destination);
+        if (!source || !type) return {};
+        auto result = evaluate_unary(unary.op, *source, *type);
+        if (!result) return {};
+        return IR::Copy(IR::Constant(*result), unary.destination);
+    }
+
+    std::optional<IR::Instruction> ConstantFoldingPass::fold_binary(const IR::Binary &binary) {
+        auto *left = constant_of(binary.left_source);
+        auto *right = constant_of(binary.right_source);
+        auto *type = type_of(binary.destination);
+        if (!left || !right || !type) return {};
+        auto result = evaluate_binary(binary.op, *left, *right, *type);
+        if (!result) return {};
+        return IR::Copy(IR::Constant(*result), binary.destination);
+    }
+
+    std::optional<IR::Instruction> ConstantFoldingPass::fold_conversion(const IR::Value &source,
+                                                                        const IR::Value &destination) {
+        auto *constant = constant_of(source);
+        auto *type = type_of(destination);
+        if (!constant || !type) return {};
+        auto converted = convert_constant(*constant, *type);
+        if (!converted) return {};
+        return IR::Copy(IR::Constant(*converted), destination);
+    }
+
+    std::optional<IR::Instruction> ConstantFoldingPass::fold_copy(const IR::Copy &copy) {
+        // same size reinterpreting copies (int -> uint, long -> pointer) get a constant of the destination type,
+        // so code reading the constant later sees the right signedness
+        auto *constant = constant_of(copy.source);
+        auto *type = type_of(copy.destination);
+        if (!constant || !type) return {};
+        if (std::holds_alternative<AST::ConstDouble>(*constant) || std::holds_alternative<AST::DoubleType>(*type)) {
+            return {};
+        }
+        auto converted = convert_constant(*constant, *type);
+        if (!converted || converted->index() == constant->index()) return {};
+        return IR::Copy(IR::Constant(*converted), copy.destination);
+    }
+
+    const AST::Type *ConstantFoldingPass::type_of(const IR::Value &value) const {
+        auto *variable = std::get_if<IR::Variable>(&value);
+        if (!variable) return nullptr;
+        auto it = symbols->find(variable->name);
+        if (it == symbols->end()) return nullptr;
+        return &*it->second.type;
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef CONSTANTFOLDINGPASS_H
+#define CONSTANTFOLDINGPASS_H
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "../IR.h"
+
+// evaluates instructions whose operands are all constants, with the semantics the generated code would have
+
+namespace optimization {
+    // the constant converted to type like a C cast would, nullopt when the conversion is undefined
+    // (out of range double -> integer) or the type has no constants; pointers are ulong
+    std::optional<AST::Const> convert_constant(const AST::Const &constant, const AST::Type &type);
+
+    // result of the operation converted to result_type, nullopt when it has to be left for runtime
+    // (division by zero, INT_MIN / -1, shift counts out of range)
+    std::optional<AST::Const> evaluate_unary(IR::Unary::Operator op, const AST::Const &source,
+                                             const AST::Type &result_type);
+    std::optional<AST::Const> evaluate_binary(IR::Binary::Operator op, const AST::Const &left,
+                                              const AST::Const &right, const AST::Type &result_type);
+
+    // same type and value, doubles compare by bits so 0.0 and -0.0 differ
+    bool same_constant(const AST::Const &lhs, const AST::Const &rhs);
+
+    // 0 and -0.0 are zero, NaN is not
+    bool is_zero(const AST::Const &constant);
+
+    class ConstantFoldingPass {
+    public:
+        ConstantFoldingPass(IR::Function *function, std::unordered_map<std::string, Symbol> *symbols)
+            : function(function), symbols(symbols) {
+        }
+
+        // true if any instruction changed
+        bool run();
+
+    private:
+        // replacement for the instruction, nullopt to keep it as it is
+        std::optional<IR::Instruction> fold(const IR::Instruction &instruction);
+
+        std::optional<IR::Instruction> fold_unary(const IR::Unary &unary);
+        std::optional<IR::Instruction> fold_binary(const IR::Binary &binary);
+        std::optional<IR::Instruction> fold_conversion(const IR::Value &source, const IR::Value &destination);
+        std::optional<IR::Instruction> fold_copy(const IR::Copy &copy);
+
+        const AST::Type *type_of(const IR::Value &value) const;
+
+        IR::Function *function;
+        std::unordered_map<std::string, Symbol> *symbols;
+    };
+}
+
+#endif //CONSTANTFOLDINGPASS_H
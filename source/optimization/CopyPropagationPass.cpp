@@ -0,0 +1,204 @@
+#include "CopyPropagationPass.h"
+
+#include <optional>
+
+#include "ConstantFoldingPass.h"
+#include "Operands.h"
+#include "../overloaded.h"
+
+namespace optimization {
+    namespace {
+        bool same_value(const IR::Value &lhs, const IR::Value &rhs) {
+            if (lhs.index() != rhs.index()) return false;
+            if (auto *variable = std::get_if<IR::Variable>(&lhs)) {
+                return variable->name == std::get<IR::Variable>(rhs).name;
+            }
+            return same_constant(std::get<IR::Constant>(lhs).constant, std::get<IR::Constant>(rhs).constant);
+        }
+    }
+
+    bool CopyPropagationPass::run() {
+        CFG cfg(std::move(function->instructions));
+        collect_copies(cfg);
+
+        auto &blocks = cfg.blocks;
+        std::vector<BitSet> out(blocks.size(), BitSet(copies.size(), true));
+        auto in_of = [&](int block) {
+            BitSet in(copies.size(), block != CFG::entry);
+            if (block == CFG::entry) return in;
+            for (int predecessor: blocks[block].predecessors) {
+                if (blocks[predecessor].reachable) in &= out[predecessor];
+            }
+            return in;
+        };
+
+        // reverse postorder visits every predecessor outside of back edges first
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int block: cfg.reverse_postorder()) {
+                auto facts = in_of(block);
+                for (const auto &instruction: blocks[block].instructions) {
+                    transfer(instruction, facts);
+                }
+                if (facts != out[block]) {
+                    out[block] = std::move(facts);
+                    changed = true;
+                }
+            }
+        }
+
+        bool rewritten = false;
+        for (int block: cfg.reverse_postorder()) {
+            rewritten |= rewrite(blocks[block], in_of(block));
+        }
+        function->instructions = cfg.linearize();
+        return rewritten;
+    }
+
+    void CopyPropagationPass::collect_copies(const CFG &cfg) {
+        copies.clear();
+        copies_to.clear();
+        copies_mentioning.clear();
+        address_taken = optimization::address_taken(cfg);
+        for (const auto &block: cfg.blocks) {
+            for (const auto &instruction: block.instructions) {
+                auto *copy = std::get_if<IR::Copy>(&instruction);
+                if (!copy || copy_id(*copy) != -1) continue;
+                auto *destination = std::get_if<IR::Variable>(&copy->destination);
+                if (!destination) continue;
+                auto symbol = symbols->find(destination->name);
+                if (symbol == symbols->end()) continue;
+
+                std::optional<IR::Value> source;
+                if (auto *constant = std::get_if<IR::Constant>(&copy->source)) {
+                    // the constant stands in for the destination, so it takes the destination's type
+                    if (auto converted = convert_constant(constant->constant, *symbol->second.type)) {
+                        source = IR::Constant(*converted);
+                    }
+                } else {
+                    const auto &name = std::get<IR::Variable>(copy->source).name;
+                    // int -> uint and similar casts are copies too, but the value would change its signedness
+                    if (name != destination->name && same_type(name, destination->name)) {
+                        source = copy->source;
+                    }
+                }
+                if (!source) continue;
+
+                int id = static_cast<int>(copies.size());
+                copies.push_back({*source, destination->name});
+                copies_to[destination->name].push_back(id);
+                copies_mentioning[destination->name].push_back(id);
+                if (auto *variable = std::get_if<IR::Variable>(&*source)) {
+                    copies_mentioning[variable->name].push_back(id);
+                }
+            }
+        }
+
+        aliased = BitSet(copies.size());
+        auto is_aliased = [&](const std::string &name) {
+            return address_taken.contains(name) || !is_local(name, *symbols);
+        };
+        for (int id = 0; id < static_cast<int>(copies.size()); id++) {
+            auto *source = std::get_if<IR::Variable>(&copies[id].source);
+            if (is_aliased(copies[id].destination) || (source && is_aliased(source->name))) {
+                aliased.set(id);
+            }
+        }
+    }
+
+    int CopyPropagationPass::copy_id(const IR::Copy &copy) const {
+        auto *destination = std::get_if<IR::Variable>(&copy.destination);
+        if (!destination) return -1;
+        auto it = copies_to.find(destination->name);
+        if (it == copies_to.end()) return -1;
+
+        IR::Value source = copy.source;
+        if (auto *constant = std::get_if<IR::Constant>(&source)) {
+            auto converted = convert_constant(constant->constant, *symbols->at(destination->name).type);
+            if (!converted) return -1;
+            source = IR::Constant(*converted);
+        }
+        for (int id: it->second) {
+            if (same_value(copies[id].source, source)) return id;
+        }
+        return -1;
+    }
+
+    void CopyPropagationPass::kill_variable(const std::string &name, BitSet &facts) const {
+        auto it = copies_mentioning.find(name);
+        if (it == copies_mentioning.end()) return;
+        for (int id: it->second) {
+            facts.reset(id);
+        }
+    }
+
+    void CopyPropagationPass::transfer(const IR::Instruction &instruction, BitSet &facts) const {
+        // the callee or the pointer may write any variable whose address escaped
+        if (std::holds_alternative<IR::Call>(instruction) || std::holds_alternative<IR::Store>(instruction)) {
+            facts.subtract(aliased);
+        }
+        if (auto *name = defined_variable(instruction)) {
+            kill_variable(*name, facts);
+        }
+        if (auto *copy = std::get_if<IR::Copy>(&instruction)) {
+            int id = copy_id(*copy);
+            if (id != -1) facts.set(id);
+        }
+    }
+
+    bool CopyPropagationPass::rewrite(BasicBlock &block, BitSet facts) {
+        bool changed = false;
+        std::vector<IR::Instruction> instructions;
+        instructions.reserve(block.instructions.size());
+        for (auto &instruction: block.instructions) {
+            // x = y where x already holds y
+            if (auto *copy = std::get_if<IR::Copy>(&instruction); copy && is_redundant(*copy, facts)) {
+                changed = true;
+                continue;
+            }
+            for_each_use(instruction, [&](IR::Value &value) {
+                auto *variable = std::get_if<IR::Variable>(&value);
+                if (!variable) return;
+                if (auto *known = known_value(variable->name, facts)) {
+                    value = *known;
+                    changed = true;
+                }
+            });
+            transfer(instruction, facts);
+            instructions.push_back(std::move(instruction));
+        }
+        block.instructions = std::move(instructions);
+        return changed;
+    }
+
+    const IR::Value *CopyPropagationPass::known_value(const std::string &name, const BitSet &facts) const {
+        auto it = copies_to.find(name);
+        if (it == copies_to.end()) return nullptr;
+        for (int id: it->second) {
+            if (facts.test(id)) return &copies[id].source;
+        }
+        return nullptr;
+    }
+
+    bool CopyPropagationPass::is_redundant(const IR::Copy &copy, const BitSet &facts) const {
+        auto *destination = std::get_if<IR::Variable>(&copy.destination);
+        if (!destination) return false;
+        if (is_variable(copy.source, destination->name)) return true;
+        int id = copy_id(copy);
+        if (id != -1 && facts.test(id)) return true;
+        // y = x right after x = y
+        if (auto *source = std::get_if<IR::Variable>(&copy.source)) {
+            auto *known = known_value(source->name, facts);
+            return known && is_variable(*known, destination->name);
+        }
+        return false;
+    }
+
+    bool CopyPropagationPass::same_type(const std::string &lhs, const std::string &rhs) const {
+        auto left = symbols->find(lhs);
+        auto right = symbols->find(rhs);
+        if (left == symbols->end() || right == symbols->end()) return false;
+        return left->second.type->index() == right->second.type->index();
+    }
+}
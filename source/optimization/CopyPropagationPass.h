@@ -0,0 +1,55 @@
+#ifndef COPYPROPAGATIONPASS_H
+#define COPYPROPAGATIONPASS_H
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "BitSet.h"
+#include "CFG.h"
+#include "../IR.h"
+
+// replaces reads of variables with the value last copied into them, using the copies that reach each
+// instruction on every path (forward dataflow, meet is intersection)
+
+namespace optimization {
+    class CopyPropagationPass {
+    public:
+        CopyPropagationPass(IR::Function *function, std::unordered_map<std::string, Symbol> *symbols)
+            : function(function), symbols(symbols) {
+        }
+
+        // true if any instruction changed
+        bool run();
+
+    private:
+        struct CopyFact {
+            IR::Value source;
+            std::string destination;
+        };
+
+        void collect_copies(const CFG &cfg);
+        // facts a copy instruction creates, -1 if its value can not stand in for the destination
+        int copy_id(const IR::Copy &copy) const;
+        void kill_variable(const std::string &name, BitSet &facts) const;
+        void transfer(const IR::Instruction &instruction, BitSet &facts) const;
+        bool rewrite(BasicBlock &block, BitSet facts);
+        // value the variable is known to hold, nullptr if none
+        const IR::Value *known_value(const std::string &name, const BitSet &facts) const;
+        bool is_redundant(const IR::Copy &copy, const BitSet &facts) const;
+        bool same_type(const std::string &lhs, const std::string &rhs) const;
+
+        IR::Function *function;
+        std::unordered_map<std::string, Symbol> *symbols;
+
+        std::vector<CopyFact> copies;
+        // copy facts by destination, and by every variable they mention
+        std::unordered_map<std::string, std::vector<int> > copies_to;
+        std::unordered_map<std::string, std::vector<int> > copies_mentioning;
+        // facts that calls and stores through pointers invalidate: static variables and locals whose address is taken
+        BitSet aliased;
+        std::unordered_set<std::string> address_taken;
+    };
+}
+
+#endif //COPYPROPAGATIONPASS_H
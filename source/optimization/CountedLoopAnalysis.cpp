@@ -0,0 +1,241 @@
+#include "CountedLoopAnalysis.h"
+
+#include <limits>
+#include <span>
+
+#include "Operands.h"
+#include "../overloaded.h"
+
+namespace optimization {
+    namespace {
+        std::optional<std::int64_t> integer_value(const IR::Value &value) {
+            auto *constant = std::get_if<IR::Constant>(&value);
+            if (!constant) return std::nullopt;
+            return std::visit(overloaded{
+                                  [](const AST::ConstDouble &) -> std::optional<std::int64_t> { return std::nullopt; },
+                                  [](const auto &c) -> std::optional<std::int64_t> {
+                                      return static_cast<std::int64_t>(c.value);
+                                  }
+                              }, constant->constant);
+        }
+
+        // the same test with its operands swapped
+        IR::Binary::Operator swapped(IR::Binary::Operator op) {
+            switch (op) {
+                case IR::Binary::Operator::LESS:
+                    return IR::Binary::Operator::GREATER;
+                case IR::Binary::Operator::LESS_EQUAL:
+                    return IR::Binary::Operator::GREATER_EQUAL;
+                case IR::Binary::Operator::GREATER:
+                    return IR::Binary::Operator::LESS;
+                case IR::Binary::Operator::GREATER_EQUAL:
+                    return IR::Binary::Operator::LESS_EQUAL;
+                default:
+                    return op;
+            }
+        }
+
+        // once the test fails it keeps failing, so passing it later means it passed on the way
+        bool counts_toward(IR::Binary::Operator op, std::int64_t step) {
+            switch (op) {
+                case IR::Binary::Operator::LESS:
+                case IR::Binary::Operator::LESS_EQUAL:
+                    return step > 0;
+                case IR::Binary::Operator::GREATER:
+                case IR::Binary::Operator::GREATER_EQUAL:
+                    return step < 0;
+                default:
+                    return false;
+            }
+        }
+
+        bool fits(std::int64_t value, bool wide) {
+            return wide || (value >= std::numeric_limits<int>::min() && value <= std::numeric_limits<int>::max());
+        }
+
+        IR::Value integer_constant(std::int64_t value, bool wide) {
+            if (wide) return IR::Constant(AST::ConstLong(value));
+            return IR::Constant(AST::ConstInt(static_cast<int>(value)));
+        }
+    }
+
+    CountedLoopAnalysis::CountedLoopAnalysis(const IR::Function &function,
+                                             std::unordered_map<std::string, Symbol> *symbols)
+        : symbols(symbols), address_taken(optimization::address_taken(function.instructions)) {
+    }
+
+    std::optional<CountedLoop> CountedLoopAnalysis::analyze(const BasicBlock &block, bool computed_bound) const {
+        const auto &instructions = block.instructions;
+        if (instructions.size() < 4 || !std::holds_alternative<IR::Label>(instructions.front())) return std::nullopt;
+        const auto &label = std::get<IR::Label>(instructions.front()).name;
+        auto *jump = std::get_if<IR::JumpIfNotZero>(&instructions.back());
+        auto *test = std::get_if<IR::Binary>(&instructions[instructions.size() - 2]);
+        if (!jump || jump->target != label || !test || !std::holds_alternative<IR::Variable>(test->destination) ||
+            !is_variable(jump->condition, std::get<IR::Variable>(test->destination).name)) {
+            return std::nullopt;
+        }
+        const auto &condition = std::get<IR::Variable>(test->destination).name;
+
+        auto body = std::span(instructions).subspan(1, instructions.size() - 3);
+        std::unordered_map<std::string, int> definitions;
+        // position in the body of the last definition
+        std::unordered_map<std::string, std::size_t> definition;
+        bool reads_condition = false;
+        for (std::size_t i = 0; i < body.size(); i++) {
+            if (auto *name = defined_variable(body[i])) {
+                definitions[*name]++;
+                definition[*name] = i;
+            }
+            for_each_use(body[i], [&](const IR::Value &value) {
+                reads_condition |= is_variable(value, condition);
+            });
+        }
+        if (reads_condition || definitions.contains(condition)) return std::nullopt;
+        auto defined_once = [&](const std::string &name) {
+            auto found = definitions.find(name);
+            return found != definitions.end() && found->second == 1 && is_unaliased_local(name);
+        };
+
+        // the tested value is counter + step or counter - step and nothing else writes it, counter is the tested
+        // value itself or a copy of it made afterward (i -= 3 is tmp = i - 3, i = tmp), and is written nowhere else
+        auto counter_of = [&](const IR::Value &value) -> std::optional<std::pair<std::string, std::int64_t> > {
+            auto *variable = std::get_if<IR::Variable>(&value);
+            if (!variable || !defined_once(variable->name)) return std::nullopt;
+            const auto &type = *symbols->at(variable->name).type;
+            if (!std::holds_alternative<AST::IntType>(type) && !std::holds_alternative<AST::LongType>(type)) {
+                return std::nullopt;
+            }
+            auto position = definition.at(variable->name);
+            auto *binary = std::get_if<IR::Binary>(&body[position]);
+            auto *counter = binary ? std::get_if<IR::Variable>(&binary->left_source) : nullptr;
+            auto step = binary ? integer_value(binary->right_source) : std::nullopt;
+            if (!counter || !step) return std::nullopt;
+            if (counter->name != variable->name) {
+                if (!defined_once(counter->name) || definition.at(counter->name) < position ||
+                    symbols->at(counter->name).type->index() != type.index()) {
+                    return std::nullopt;
+                }
+                auto *copy = std::get_if<IR::Copy>(&body[definition.at(counter->name)]);
+                if (!copy || !is_variable(copy->source, variable->name)) return std::nullopt;
+            }
+            if (binary->op == IR::Binary::Operator::ADD) return std::pair{counter->name, *step};
+            if (binary->op == IR::Binary::Operator::SUBTRACT) return std::pair{counter->name, -*step};
+            return std::nullopt;
+        };
+        CountedLoop counted;
+        if (auto counter = counter_of(test->left_source)) {
+            counted = {
+                std::get<IR::Variable>(test->left_source).name, counter->first, counter->second, test->op,
+                test->right_source, body.size()
+            };
+        } else if (auto counter = counter_of(test->right_source)) {
+            counted = {
+                std::get<IR::Variable>(test->right_source).name, counter->first, counter->second,
+                swapped(test->op), test->left_source, body.size()
+            };
+        } else {
+            return std::nullopt;
+        }
+        // small steps keep the arithmetic on limits far away from overflowing
+        constexpr std::int64_t max_step = std::int64_t{1} << 20;
+        if (!counts_toward(counted.op, counted.step) || counted.step > max_step || counted.step < -max_step) {
+            return std::nullopt;
+        }
+        // a pure computation, of values that are the same every iteration
+        auto invariant = [&](const IR::Instruction &instruction) {
+            bool pure = std::holds_alternative<IR::Binary>(instruction) ||
+                        std::holds_alternative<IR::Unary>(instruction) ||
+                        std::holds_alternative<IR::Copy>(instruction) ||
+                        std::holds_alternative<IR::SignExtend>(instruction) ||
+                        std::holds_alternative<IR::Truncate>(instruction) ||
+                        std::holds_alternative<IR::ZeroExtend>(instruction);
+            for_each_use(instruction, [&](const IR::Value &value) {
+                auto *variable = std::get_if<IR::Variable>(&value);
+                pure &= !variable || (!definitions.contains(variable->name) && is_unaliased_local(variable->name));
+            });
+            return pure;
+        };
+        if (auto *bound = std::get_if<IR::Variable>(&counted.bound)) {
+            if (definitions.contains(bound->name) &&
+                (!computed_bound || !defined_once(bound->name) || !invariant(body[definition.at(bound->name)]))) {
+                return std::nullopt;
+            }
+            if (!is_unaliased_local(bound->name) ||
+                symbols->at(bound->name).type->index() != symbols->at(counted.counter).type->index()) {
+                return std::nullopt;
+            }
+        } else if (!integer_value(counted.bound)) {
+            return std::nullopt;
+        }
+        return counted;
+    }
+
+    std::optional<CountedLoopAnalysis::AdvancedTest> CountedLoopAnalysis::advanced_test(
+        const CountedLoop &loop, std::int64_t distance, bool guarded) {
+        bool wide = is_long(loop.counter);
+        AdvancedTest test;
+        bool extend = !wide;
+        if (auto bound = integer_value(loop.bound)) {
+            std::int64_t value;
+            if (__builtin_sub_overflow(*bound, distance, &value)) return std::nullopt;
+            extend = !fits(value, wide);
+            test.limit = integer_constant(value, wide || extend);
+        } else if (!wide) {
+            const auto &bound_name = std::get<IR::Variable>(loop.bound).name;
+            auto wide_bound = fresh(bound_name, ".wide", AST::LongType());
+            auto limit = fresh(bound_name, ".limit", AST::LongType());
+            test.setup.emplace_back(IR::SignExtend(loop.bound, IR::Variable(wide_bound)));
+            test.setup.emplace_back(IR::Binary(IR::Binary::Operator::SUBTRACT, IR::Variable(wide_bound),
+                                               integer_constant(distance, true), IR::Variable(limit)));
+            test.limit = IR::Variable(limit);
+        } else {
+            if (!guarded) return std::nullopt;
+            // bound - distance stays in range if bound >= min + distance when counting up, bound <= max + distance
+            // when counting down
+            const auto &bound_name = std::get<IR::Variable>(loop.bound).name;
+            auto limit = fresh(bound_name, ".limit", AST::LongType());
+            auto guard = fresh(bound_name, ".guard", AST::IntType());
+            auto edge = distance > 0
+                            ? std::numeric_limits<std::int64_t>::min() + distance
+                            : std::numeric_limits<std::int64_t>::max() + distance;
+            test.setup.emplace_back(IR::Binary(distance > 0
+                                                   ? IR::Binary::Operator::GREATER_EQUAL
+                                                   : IR::Binary::Operator::LESS_EQUAL, loop.bound,
+                                               integer_constant(edge, true), IR::Variable(guard)));
+            test.setup.emplace_back(IR::Binary(IR::Binary::Operator::SUBTRACT, loop.bound,
+                                               integer_constant(distance, true), IR::Variable(limit)));
+            test.limit = IR::Variable(limit);
+            test.guard = IR::Variable(guard);
+        }
+        if (extend) test.wide_counter = fresh(loop.counter, ".wide", AST::LongType());
+        return test;
+    }
+
+    void CountedLoopAnalysis::AdvancedTest::emit(const CountedLoop &loop, const std::string &condition,
+                                                 std::vector<IR::Instruction> &code) const {
+        IR::Value value = IR::Variable(loop.counter);
+        if (!wide_counter.empty()) {
+            code.emplace_back(IR::SignExtend(value, IR::Variable(wide_counter)));
+            value = IR::Variable(wide_counter);
+        }
+        code.emplace_back(IR::Binary(loop.op, value, limit, IR::Variable(condition)));
+    }
+
+    bool CountedLoopAnalysis::is_unaliased_local(const std::string &name) const {
+        return !address_taken.contains(name) && is_local(name, *symbols) &&
+               !std::holds_alternative<AST::ArrayType>(*symbols->at(name).type);
+    }
+
+    bool CountedLoopAnalysis::is_long(const std::string &name) const {
+        return std::holds_alternative<AST::LongType>(*symbols->at(name).type);
+    }
+
+    std::string CountedLoopAnalysis::fresh(const std::string &name, std::string_view suffix, AST::Type type) {
+        auto result = name + std::string(suffix);
+        for (int i = 1; symbols->contains(result); i++) {
+            result = name + std::string(suffix) + "." + std::to_string(i);
+        }
+        (*symbols)[result] = Symbol{AST::TypeHandle(std::move(type)), LocalAttributes{}};
+        return result;
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef COUNTEDLOOPANALYSIS_H
+#define COUNTEDLOOPANALYSIS_H
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "CFG.h"
+#include "../IR.h"
+
+// loops of a single block as LoopRotationPass leaves them that count a local by a constant and test it last against
+// a constant or a local the loop does not write (i < n, i <= n, i > n, i >= n), shared by the passes that rewrite
+// such loops as a whole
+
+namespace optimization {
+    struct CountedLoop {
+        // the value tested, counter after the step, which the body leaves in counter as well
+        std::string tested;
+        std::string counter;
+        std::int64_t step;
+        // tested op bound continues the loop
+        IR::Binary::Operator op;
+        IR::Value bound;
+        // the block's instructions between its label and the test
+        std::size_t body_size;
+    };
+
+    class CountedLoopAnalysis {
+    public:
+        CountedLoopAnalysis(const IR::Function &function, std::unordered_map<std::string, Symbol> *symbols);
+
+        // with computed_bound the bound may also be computed in the body from constants and locals it does not write,
+        // as rotation leaves i < n - 1, the caller has to compute it in front of the loop as well
+        std::optional<CountedLoop> analyze(const BasicBlock &block, bool computed_bound = false) const;
+
+        // whether the loop runs distance / step more times, counter + distance op bound, which is compared as
+        // counter op limit with limit = bound - distance, in long for an int counter so nothing overflows
+        struct AdvancedTest {
+            // computes the limit once in front of the tests
+            std::vector<IR::Instruction> setup;
+            IR::Value limit;
+            // when the limit of a long counter could overflow, the tests only hold if this is nonzero
+            std::optional<IR::Value> guard;
+            // a long copy of an int counter compared with a long limit
+            std::string wide_counter;
+
+            void emit(const CountedLoop &loop, const std::string &condition, std::vector<IR::Instruction> &code) const;
+        };
+
+        // nullopt if the limit would overflow, or may overflow and guarded is false
+        std::optional<AdvancedTest> advanced_test(const CountedLoop &loop, std::int64_t distance, bool guarded);
+
+        // a variable the loop cannot change other than by name
+        bool is_unaliased_local(const std::string &name) const;
+        bool is_long(const std::string &name) const;
+        // a new variable of the given type, named after name
+        std::string fresh(const std::string &name, std::string_view suffix, AST::Type type);
+
+    private:
+        std::unordered_map<std::string, Symbol> *symbols;
+        // locals a store through a pointer could change
+        std::unordered_set<std::string> address_taken;
+    };
+}
+
+#endif //COUNTEDLOOPANALYSIS_H
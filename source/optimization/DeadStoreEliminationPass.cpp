@@ -0,0 +1,54 @@
+#include "DeadStoreEliminationPass.h"
+
+#include <ranges>
+
+#include "Liveness.h"
+#include "Operands.h"
+
+namespace optimization {
+    namespace {
+        // calls, stores and partial writes to aggregates stay even when their result is dead
+        bool has_side_effects(const IR::Instruction &instruction) {
+            return std::holds_alternative<IR::Call>(instruction) || std::holds_alternative<IR::Store>(instruction) ||
+                   std::holds_alternative<IR::CopyToOffset>(instruction);
+        }
+    }
+
+    bool DeadStoreEliminationPass::run() {
+        CFG cfg(std::move(function->instructions));
+        address_taken = optimization::address_taken(cfg);
+
+        Liveness liveness(cfg);
+        bool changed = false;
+        for (int i = 0; i < static_cast<int>(cfg.blocks.size()); i++) {
+            auto &instructions = cfg.blocks[i].instructions;
+            auto live = liveness.live_out[i];
+            std::vector<bool> dead(instructions.size());
+            for (int j = static_cast<int>(instructions.size()) - 1; j >= 0; j--) {
+                const auto &instruction = instructions[j];
+                auto *name = defined_variable(instruction);
+                if (name && !has_side_effects(instruction) && !live.test(liveness.index_of(*name)) &&
+                    !is_observable(*name)) {
+                    // skipping the transfer keeps the operands of a dead instruction from being live
+                    dead[j] = true;
+                    changed = true;
+                    continue;
+                }
+                liveness.transfer(instruction, live);
+            }
+            if (std::ranges::find(dead, true) == dead.end()) continue;
+            std::vector<IR::Instruction> kept;
+            kept.reserve(instructions.size());
+            for (std::size_t j = 0; j < instructions.size(); j++) {
+                if (!dead[j]) kept.push_back(std::move(instructions[j]));
+            }
+            instructions = std::move(kept);
+        }
+        function->instructions = cfg.linearize();
+        return changed;
+    }
+
+    bool DeadStoreEliminationPass::is_observable(const std::string &name) const {
+        return address_taken.contains(name) || !is_local(name, *symbols);
+    }
+}
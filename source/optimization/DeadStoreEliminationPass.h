@@ -0,0 +1,32 @@
+#ifndef DEADSTOREELIMINATIONPASS_H
+#define DEADSTOREELIMINATIONPASS_H
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "CFG.h"
+#include "../IR.h"
+
+// removes instructions without side effects whose result is never read
+
+namespace optimization {
+    class DeadStoreEliminationPass {
+    public:
+        DeadStoreEliminationPass(IR::Function *function, std::unordered_map<std::string, Symbol> *symbols)
+            : function(function), symbols(symbols) {
+        }
+
+        // true if any instruction was removed
+        bool run();
+
+    private:
+        // writes to static variables and address taken locals can be observed through other names
+        bool is_observable(const std::string &name) const;
+
+        IR::Function *function;
+        std::unordered_map<std::string, Symbol> *symbols;
+        std::unordered_set<std::string> address_taken;
+    };
+}
+
+#endif //DEADSTOREELIMINATIONPASS_H
@@ -0,0 +1,243 @@
+#include "GlobalValueNumberingPass.h"
+
+#include <bit>
+
+#include "ConstantFoldingPass.h"
+#include "Operands.h"
+#include "SSA.h"
+#include "../overloaded.h"
+
+namespace optimization {
+    namespace {
+        bool commutative(IR::Binary::Operator op) {
+            switch (op) {
+                case IR::Binary::Operator::ADD:
+                case IR::Binary::Operator::MULTIPLY:
+                case IR::Binary::Operator::BITWISE_AND:
+                case IR::Binary::Operator::BITWISE_XOR:
+                case IR::Binary::Operator::BITWISE_OR:
+                case IR::Binary::Operator::EQUAL:
+                case IR::Binary::Operator::NOT_EQUAL:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+    }
+
+    bool GlobalValueNumberingPass::run() {
+        auto &blocks = cfg->blocks;
+        if (blocks.empty()) return false;
+        cfg->compute_dominators();
+        dead.resize(blocks.size());
+        for (std::size_t i = 0; i < blocks.size(); i++) {
+            dead[i].assign(blocks[i].instructions.size(), false);
+        }
+
+        // iterative walk of the dominator tree, expressions a block made available are forgotten when it is left
+        struct Frame {
+            int block;
+            std::size_t next_child;
+            std::vector<std::string> inserted;
+        };
+        std::vector<Frame> stack;
+        stack.push_back(Frame{CFG::entry, 0, {}});
+        number_block(CFG::entry, stack.back().inserted);
+        while (!stack.empty()) {
+            auto &frame = stack.back();
+            const auto &dominated = blocks[frame.block].dominated;
+            if (frame.next_child < dominated.size()) {
+                int child = dominated[frame.next_child++];
+                stack.push_back(Frame{child, 0, {}});
+                number_block(child, stack.back().inserted);
+                continue;
+            }
+            for (const auto &key: frame.inserted) {
+                available.erase(key);
+            }
+            stack.pop_back();
+        }
+
+        if (removed == 0) return false;
+        rewrite();
+        return true;
+    }
+
+    void GlobalValueNumberingPass::number_block(int block, std::vector<std::string> &inserted) {
+        auto &instructions = cfg->blocks[block].instructions;
+        for (std::size_t i = 0; i < instructions.size(); i++) {
+            auto &instruction = instructions[i];
+            // operands are numbered before the instruction, phi arguments may come from blocks not seen yet
+            if (!std::holds_alternative<IR::Phi>(instruction)) {
+                for_each_use(instruction, [&](IR::Value &value) { value = canonical(value); });
+            }
+            auto *name = defined_variable(instruction);
+            if (!name || !values->contains(*name)) continue;
+
+            if (auto *phi = std::get_if<IR::Phi>(&instruction)) {
+                // a phi whose arguments are all the same value (or the phi itself) is that value
+                std::optional<IR::Value> same;
+                bool unique = true;
+                for (const auto &argument: phi->arguments) {
+                    auto value = canonical(argument);
+                    if (is_variable(value, *name)) continue;
+                    if (!same) {
+                        same = std::move(value);
+                    } else if (operand_key(*same) != operand_key(value) || !operand_key(value)) {
+                        unique = false;
+                        break;
+                    }
+                }
+                if (unique && same && is_value(*same)) {
+                    replace(*name, std::move(*same), block, i);
+                    continue;
+                }
+            } else if (auto *copy = std::get_if<IR::Copy>(&instruction)) {
+                const auto &type = *symbols->at(*name).type;
+                if (auto *constant = std::get_if<IR::Constant>(&copy->source)) {
+                    if (auto converted = convert_constant(constant->constant, type)) {
+                        replace(*name, IR::Constant(*converted), block, i);
+                        continue;
+                    }
+                } else if (is_value(copy->source) &&
+                           symbols->at(std::get<IR::Variable>(copy->source).name).type->index() == type.index()) {
+                    replace(*name, copy->source, block, i);
+                    continue;
+                }
+            }
+
+            auto key = key_of(instruction, block);
+            if (!key) continue;
+            if (auto it = available.find(*key); it != available.end()) {
+                replace(*name, IR::Variable(it->second), block, i);
+                continue;
+            }
+            available.emplace(*key, *name);
+            inserted.push_back(std::move(*key));
+        }
+    }
+
+    std::optional<std::string> GlobalValueNumberingPass::key_of(const IR::Instruction &instruction, int block) const {
+        std::optional<std::string> key;
+        auto with_operands = [&](std::string opcode, const IR::Value &destination,
+                                 std::initializer_list<const IR::Value *> operands) {
+            auto type = symbols->at(std::get<IR::Variable>(destination).name).type->index();
+            std::string result = std::move(opcode) + ":" + std::to_string(type);
+            for (auto *operand: operands) {
+                auto part = operand_key(*operand);
+                if (!part) return;
+                result += "," + *part;
+            }
+            key = std::move(result);
+        };
+        auto conversion = [&](std::string opcode, const auto &ins) {
+            with_operands(std::move(opcode), ins.destination, {&ins.source});
+        };
+        std::visit(overloaded{
+                       [&](const IR::Unary &ins) {
+                           with_operands("unary" + std::to_string(static_cast<int>(ins.op)), ins.destination,
+                                         {&ins.source});
+                       },
+                       [&](const IR::Binary &ins) {
+                           auto opcode = "binary" + std::to_string(static_cast<int>(ins.op));
+                           const auto *lhs = &ins.left_source;
+                           const auto *rhs = &ins.right_source;
+                           // a + b and b + a are the same value
+                           if (commutative(ins.op) && operand_key(*rhs) < operand_key(*lhs)) {
+                               std::swap(lhs, rhs);
+                           }
+                           with_operands(std::move(opcode), ins.destination, {lhs, rhs});
+                       },
+                       [&](const IR::Copy &ins) { conversion("copy", ins); },
+                       [&](const IR::SignExtend &ins) { conversion("sext", ins); },
+                       [&](const IR::ZeroExtend &ins) { conversion("zext", ins); },
+                       [&](const IR::Truncate &ins) { conversion("trunc", ins); },
+                       [&](const IR::IntToDouble &ins) { conversion("itod", ins); },
+                       [&](const IR::UIntToDouble &ins) { conversion("utod", ins); },
+                       [&](const IR::DoubleToInt &ins) { conversion("dtoi", ins); },
+                       [&](const IR::DoubleToUInt &ins) { conversion("dtou", ins); },
+                       [&](const IR::GetAddress &ins) {
+                           // the address of a variable never changes, whatever is stored in it
+                           if (auto *variable = std::get_if<IR::Variable>(&ins.source)) {
+                               key = "address:" + variable->name;
+                           }
+                       },
+                       [&](const IR::AddPtr &ins) {
+                           with_operands("addptr" + std::to_string(ins.scale), ins.destination, {&ins.ptr, &ins.index});
+                       },
+                       [&](const IR::Phi &ins) {
+                           // phis in the same block with the same arguments
+                           std::string result = "phi" + std::to_string(block);
+                           for (const auto &argument: ins.arguments) {
+                               auto part = operand_key(canonical(argument));
+                               if (!part) return;
+                               result += "," + *part;
+                           }
+                           with_operands(std::move(result), ins.destination, {});
+                       },
+                       // loads and calls depend on memory
+                       [](const auto &) {
+                       }
+                   }, instruction);
+        return key;
+    }
+
+    std::optional<std::string> GlobalValueNumberingPass::operand_key(const IR::Value &value) const {
+        if (!is_value(value)) return std::nullopt;
+        return std::visit(overloaded{
+                              [](const IR::Variable &variable) { return "%" + variable.name; },
+                              [](const IR::Constant &constant) {
+                                  // the alternative keeps 1 and 1L apart, doubles are compared bitwise
+                                  auto prefix = "$" + std::to_string(constant.constant.index()) + ":";
+                                  return std::visit(overloaded{
+                                                        [&](const AST::ConstDouble &c) {
+                                                            return prefix + std::to_string(
+                                                                       std::bit_cast<std::uint64_t>(c.value));
+                                                        },
+                                                        [&](const auto &c) {
+                                                            return prefix + std::to_string(c.value);
+                                                        }
+                                                    }, constant.constant);
+                              }
+                          }, value);
+    }
+
+    IR::Value GlobalValueNumberingPass::canonical(const IR::Value &value) const {
+        const auto *current = &value;
+        while (auto *variable = std::get_if<IR::Variable>(current)) {
+            auto it = replacements.find(variable->name);
+            if (it == replacements.end()) break;
+            current = &it->second;
+        }
+        return *current;
+    }
+
+    bool GlobalValueNumberingPass::is_value(const IR::Value &value) const {
+        auto *variable = std::get_if<IR::Variable>(&value);
+        return !variable || values->contains(variable->name);
+    }
+
+    void GlobalValueNumberingPass::replace(const std::string &name, IR::Value value, int block, std::size_t index) {
+        replacements.emplace(name, std::move(value));
+        dead[block][index] = true;
+        removed++;
+    }
+
+    void GlobalValueNumberingPass::rewrite() {
+        auto &blocks = cfg->blocks;
+        for (std::size_t i = 0; i < blocks.size(); i++) {
+            auto &instructions = blocks[i].instructions;
+            std::size_t kept = 0;
+            for (std::size_t j = 0; j < instructions.size(); j++) {
+                if (dead[i][j]) continue;
+                // every replacement dominates the uses of the value it replaces, phi arguments included
+                for_each_use(instructions[j], [&](IR::Value &value) { value = canonical(value); });
+                if (kept != j) {
+                    instructions[kept] = std::move(instructions[j]);
+                }
+                kept++;
+            }
+            instructions.erase(instructions.begin() + static_cast<std::ptrdiff_t>(kept), instructions.end());
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef GLOBALVALUENUMBERINGPASS_H
+#define GLOBALVALUENUMBERINGPASS_H
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "CFG.h"
+#include "../IR.h"
+
+// dominator based value numbering on a cfg in ssa form (Briggs, Cooper, Simpson "Value Numbering"): a pure
+// instruction that computes what an instruction in a dominating block already computed is removed and its value
+// replaced with the earlier one, same type copies and phis with identical arguments are folded into their source
+
+namespace optimization {
+    class GlobalValueNumberingPass {
+    public:
+        // values are the ssa names from SSAConstruction
+        GlobalValueNumberingPass(CFG *cfg, std::unordered_map<std::string, Symbol> *symbols,
+                                 const std::unordered_set<std::string> *values)
+            : cfg(cfg), symbols(symbols), values(values) {
+        }
+
+        // true if any instruction was removed
+        bool run();
+
+        // number of removed instructions
+        int removed = 0;
+
+    private:
+        void number_block(int block, std::vector<std::string> &inserted);
+        std::optional<std::string> key_of(const IR::Instruction &instruction, int block) const;
+        std::optional<std::string> operand_key(const IR::Value &value) const;
+        IR::Value canonical(const IR::Value &value) const;
+        bool is_value(const IR::Value &value) const;
+        void replace(const std::string &name, IR::Value value, int block, std::size_t index);
+        void rewrite();
+
+        CFG *cfg;
+        std::unordered_map<std::string, Symbol> *symbols;
+        const std::unordered_set<std::string> *values;
+
+        // expression -> ssa value computing it, scoped to the dominator tree walk
+        std::unordered_map<std::string, std::string> available;
+        // removed ssa value -> value that replaces it
+        std::unordered_map<std::string, IR::Value> replacements;
+        std::vector<std::vector<bool> > dead;
+    };
+}
+
+#endif //GLOBALVALUENUMBERINGPASS_H
@@ -0,0 +1,631 @@
+#include "InductionVariablePass.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "ConstantFoldingPass.h"
+#include "Operands.h"
+#include "SSA.h"
+#include "../overloaded.h"
+
+namespace optimization {
+    namespace {
+        std::optional<std::int64_t> integer_value(const IR::Value &value) {
+            auto *constant = std::get_if<IR::Constant>(&value);
+            if (!constant) return std::nullopt;
+            return std::visit(overloaded{
+                                  [](const AST::ConstDouble &) -> std::optional<std::int64_t> { return std::nullopt; },
+                                  [](const auto &c) -> std::optional<std::int64_t> {
+                                      return static_cast<std::int64_t>(c.value);
+                                  }
+                              }, constant->constant);
+        }
+
+        // steps wrap around like the generated code does
+        std::int64_t wrapping_add(std::int64_t lhs, std::int64_t rhs) {
+            return static_cast<std::int64_t>(static_cast<std::uint64_t>(lhs) + static_cast<std::uint64_t>(rhs));
+        }
+
+        std::int64_t wrapping_multiply(std::int64_t lhs, std::int64_t rhs) {
+            return static_cast<std::int64_t>(static_cast<std::uint64_t>(lhs) * static_cast<std::uint64_t>(rhs));
+        }
+
+        // the linear form gives up long before anything could overflow
+        bool is_small(std::int64_t value) {
+            constexpr std::int64_t limit = std::int64_t{1} << 31;
+            return value > -limit && value < limit;
+        }
+
+        bool is_comparison(IR::Binary::Operator op) {
+            switch (op) {
+                case IR::Binary::Operator::EQUAL:
+                case IR::Binary::Operator::NOT_EQUAL:
+                case IR::Binary::Operator::LESS:
+                case IR::Binary::Operator::LESS_EQUAL:
+                case IR::Binary::Operator::GREATER:
+                case IR::Binary::Operator::GREATER_EQUAL:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        // in front of the jump that ends the block, if there is one
+        std::vector<IR::Instruction>::iterator end_of(std::vector<IR::Instruction> &instructions) {
+            auto position = instructions.end();
+            if (!instructions.empty() && (jump_target(instructions.back()) || ends_block(instructions.back()))) {
+                --position;
+            }
+            return position;
+        }
+
+        bool same_value(const IR::Value &lhs, const IR::Value &rhs) {
+            if (auto *left = std::get_if<IR::Variable>(&lhs)) return is_variable(rhs, left->name);
+            auto *right = std::get_if<IR::Constant>(&rhs);
+            return right && same_constant(std::get<IR::Constant>(lhs).constant, right->constant);
+        }
+    }
+
+    bool InductionVariablePass::run() {
+        if (cfg->blocks.empty()) return false;
+        cfg->compute_dominators();
+        cfg->compute_loops();
+        bool changed = false;
+        // loops are sorted from the largest to the smallest, so inner loops come after the loops around them
+        for (int i = static_cast<int>(cfg->loops.size()) - 1; i >= 0; i--) {
+            const auto &loop = cfg->loops[i];
+            int preheader = cfg->preheader(loop);
+            if (preheader != -1) changed |= reduce(loop, preheader);
+        }
+        if (changed) remove_dead_values();
+        return changed;
+    }
+
+    bool InductionVariablePass::reduce(const Loop &loop, int preheader) {
+        bool changed = merge_basic_variables(loop, preheader);
+        if (changed) find_basic_variables(loop, preheader);
+        if (basic.empty()) return changed;
+        find_derived_values(loop);
+
+        // everything is computed before anything changes, materialize() reads the original definitions
+        std::vector<Reduction> reductions;
+        std::vector<IR::Instruction> code;
+        std::unordered_map<std::string, IR::Value> initial_values;
+        for (int block: loop.blocks) {
+            for (const auto &instruction: cfg->blocks[block].instructions) {
+                if (!std::holds_alternative<IR::AddPtr>(instruction)) continue;
+                const auto &name = *defined_variable(instruction);
+                auto found = derived.find(name);
+                if (found == derived.end() || found->second.step == 0) continue;
+                const auto &induction = found->second;
+                // pointers that step the same share a phi when they start the same, a[i] and a[j] for counters
+                // merged above, or a constant distance apart, a[i] and a[i + 1] in an unrolled loop
+                auto same = reductions.end();
+                std::int64_t offset = 0;
+                for (auto it = reductions.begin(); it != reductions.end() && same == reductions.end(); ++it) {
+                    const auto &other = derived.at(it->value);
+                    if (!it->owner || other.step != induction.step) continue;
+                    if (other.basic == induction.basic && other.linear && induction.linear && other.root &&
+                        induction.root && same_value(*other.root, *induction.root) &&
+                        other.scale == induction.scale) {
+                        same = it;
+                        offset = induction.offset - other.offset;
+                    }
+                }
+                if (same != reductions.end()) {
+                    reductions.push_back({name, same->phi, same->initial, false, offset});
+                    continue;
+                }
+                auto initial = materialize(name, basic.at(induction.basic).initial, initial_values, code);
+                same = std::ranges::find_if(reductions, [&](const Reduction &reduction) {
+                    return reduction.owner && derived.at(reduction.value).step == induction.step &&
+                           same_value(reduction.initial, initial);
+                });
+                if (same != reductions.end()) {
+                    reductions.push_back({name, same->phi, std::move(initial), false});
+                } else {
+                    reductions.push_back({name, fresh(name, ".iv"), std::move(initial), true});
+                }
+            }
+        }
+        struct Test {
+            IR::Value *counter;
+            IR::Value *bound;
+            std::string pointer;
+            std::string limit;
+        };
+        std::vector<Test> tests;
+        std::unordered_map<std::string, std::string> limits;
+        for (int block: loop.blocks) {
+            for (auto &instruction: cfg->blocks[block].instructions) {
+                auto *binary = std::get_if<IR::Binary>(&instruction);
+                if (!binary || !is_comparison(binary->op)) continue;
+                for (auto [counter, bound]: {std::pair{&binary->left_source, &binary->right_source},
+                                             std::pair{&binary->right_source, &binary->left_source}}) {
+                    auto *variable = std::get_if<IR::Variable>(counter);
+                    auto found = variable ? derived.find(variable->name) : derived.end();
+                    if (found == derived.end()) continue;
+                    auto replacement = replacement_test(variable->name, found->second, *bound, reductions);
+                    if (!replacement) continue;
+                    auto [pointer, offset] = std::move(*replacement);
+                    auto key = pointer.phi + ":" + std::to_string(offset);
+                    auto limit = limits.find(key);
+                    if (limit == limits.end()) {
+                        auto name = fresh(pointer.phi, ".limit");
+                        code.emplace_back(IR::AddPtr{pointer.root, IR::Constant(AST::ConstLong(offset)), 1,
+                                                     IR::Variable(name)});
+                        limit = limits.emplace(std::move(key), std::move(name)).first;
+                    }
+                    tests.push_back({counter, bound, std::move(pointer.phi), limit->second});
+                    break;
+                }
+            }
+        }
+
+        if (reductions.empty() && tests.empty()) return changed;
+        // the positions of the tests are only valid until instructions are inserted
+        for (auto &test: tests) {
+            *test.counter = IR::Variable(test.pointer);
+            *test.bound = IR::Variable(test.limit);
+            replaced_tests++;
+        }
+        for (const auto &reduction: reductions) {
+            for (int block: loop.blocks) {
+                for (auto &instruction: cfg->blocks[block].instructions) {
+                    auto *name = defined_variable(instruction);
+                    if (!name || *name != reduction.value) continue;
+                    if (reduction.offset != 0) {
+                        instruction = IR::AddPtr{IR::Variable(reduction.phi), IR::Constant(AST::ConstLong(
+                                                     reduction.offset)), 1, IR::Variable(reduction.value)};
+                    } else {
+                        instruction = IR::Copy(IR::Variable(reduction.phi), IR::Variable(reduction.value));
+                    }
+                }
+            }
+            if (!reduction.owner) continue;
+            auto step = derived.at(reduction.value).step;
+            auto &header = cfg->blocks[loop.header];
+            std::vector<IR::Value> arguments;
+            for (int predecessor: header.predecessors) {
+                if (predecessor == preheader) {
+                    arguments.push_back(reduction.initial);
+                    continue;
+                }
+                auto next = fresh(reduction.value, ".iv.next");
+                auto &instructions = cfg->blocks[predecessor].instructions;
+                instructions.insert(end_of(instructions), IR::AddPtr{
+                                        IR::Variable(reduction.phi), IR::Constant(AST::ConstLong(step)), 1,
+                                        IR::Variable(next)
+                                    });
+                arguments.emplace_back(IR::Variable(std::move(next)));
+            }
+            auto position = header.instructions.begin() + static_cast<std::ptrdiff_t>(phi_range(header).second);
+            header.instructions.insert(position, IR::Phi(std::move(arguments), IR::Variable(reduction.phi)));
+            reduced++;
+        }
+        auto &instructions = cfg->blocks[preheader].instructions;
+        instructions.insert(end_of(instructions), std::make_move_iterator(code.begin()),
+                            std::make_move_iterator(code.end()));
+        return true;
+    }
+
+    bool InductionVariablePass::merge_basic_variables(const Loop &loop, int preheader) {
+        find_basic_variables(loop, preheader);
+        // duplicate -> the earlier phi computing the same sequence
+        std::vector<std::pair<std::string, std::string> > merged;
+        std::vector<std::string> kept;
+        auto &header = cfg->blocks[loop.header];
+        auto [first, last] = phi_range(header);
+        for (auto i = first; i < last; i++) {
+            const auto &name = *defined_variable(header.instructions[i]);
+            auto found = basic.find(name);
+            if (found == basic.end()) continue;
+            auto same = std::ranges::find_if(kept, [&](const std::string &other) {
+                const auto &variable = basic.at(other);
+                return variable.step == found->second.step && same_value(variable.initial, found->second.initial) &&
+                       symbols->at(other).type->index() == symbols->at(name).type->index();
+            });
+            if (same == kept.end()) {
+                kept.push_back(name);
+            } else {
+                merged.emplace_back(name, *same);
+            }
+        }
+        if (merged.empty()) return false;
+        for (const auto &[duplicate, original]: merged) {
+            std::erase_if(header.instructions, [&](const IR::Instruction &instruction) {
+                auto *phi = std::get_if<IR::Phi>(&instruction);
+                return phi && is_variable(phi->destination, duplicate);
+            });
+            auto position = header.instructions.begin() + static_cast<std::ptrdiff_t>(phi_range(header).second);
+            header.instructions.insert(position, IR::Copy(IR::Variable(original), IR::Variable(duplicate)));
+        }
+        return true;
+    }
+
+    void InductionVariablePass::find_basic_variables(const Loop &loop, int preheader) {
+        defined.clear();
+        definitions.clear();
+        basic.clear();
+        derived.clear();
+        for (int block: loop.blocks) {
+            for (const auto &instruction: cfg->blocks[block].instructions) {
+                auto *name = defined_variable(instruction);
+                if (!name || !values->contains(*name)) continue;
+                defined.insert(*name);
+                definitions[*name] = &instruction;
+            }
+        }
+
+        // the constant a latch value adds to the phi, through copies and further additions (an unrolled loop
+        // advances its counter once per copy of the body)
+        auto step_of = [&](const std::string &next, const std::string &phi) -> std::optional<std::int64_t> {
+            const auto *current = &next;
+            std::int64_t total = 0;
+            // the variable the step is added to, done when it is the phi
+            auto add = [&](const IR::Value &value, std::int64_t step) {
+                total = wrapping_add(total, step);
+                current = &std::get<IR::Variable>(value).name;
+                return *current == phi;
+            };
+            while (true) {
+                auto found = definitions.find(*current);
+                if (found == definitions.end()) return std::nullopt;
+                if (auto *copy = std::get_if<IR::Copy>(found->second)) {
+                    auto *source = std::get_if<IR::Variable>(&copy->source);
+                    if (!source || symbols->at(source->name).type->index() != symbols->at(*current).type->index()) {
+                        return std::nullopt;
+                    }
+                    current = &source->name;
+                    continue;
+                }
+                if (auto *add_ptr = std::get_if<IR::AddPtr>(found->second)) {
+                    auto step = integer_value(add_ptr->index);
+                    if (!step || !std::holds_alternative<IR::Variable>(add_ptr->ptr)) return std::nullopt;
+                    if (add(add_ptr->ptr, wrapping_multiply(*step, add_ptr->scale))) return total;
+                    continue;
+                }
+                auto *binary = std::get_if<IR::Binary>(found->second);
+                if (!binary) return std::nullopt;
+                auto left = integer_value(binary->left_source);
+                auto right = integer_value(binary->right_source);
+                if (binary->op == IR::Binary::Operator::ADD && right &&
+                    std::holds_alternative<IR::Variable>(binary->left_source)) {
+                    if (add(binary->left_source, *right)) return total;
+                } else if (binary->op == IR::Binary::Operator::ADD && left &&
+                           std::holds_alternative<IR::Variable>(binary->right_source)) {
+                    if (add(binary->right_source, *left)) return total;
+                } else if (binary->op == IR::Binary::Operator::SUBTRACT && right &&
+                           std::holds_alternative<IR::Variable>(binary->left_source)) {
+                    if (add(binary->left_source, wrapping_multiply(*right, -1))) return total;
+                } else {
+                    return std::nullopt;
+                }
+            }
+        };
+
+        const auto &header = cfg->blocks[loop.header];
+        auto [first, last] = phi_range(header);
+        for (auto i = first; i < last; i++) {
+            const auto &phi = std::get<IR::Phi>(header.instructions[i]);
+            const auto &name = std::get<IR::Variable>(phi.destination).name;
+            bool pointer = std::holds_alternative<AST::PointerType>(*symbols->at(name).type);
+            if (!pointer && !is_integer(name)) continue;
+            std::optional<IR::Value> initial;
+            const std::string *next = nullptr;
+            bool valid = true;
+            for (std::size_t k = 0; k < phi.arguments.size() && valid; k++) {
+                if (header.predecessors[k] == preheader) {
+                    initial = phi.arguments[k];
+                    continue;
+                }
+                auto *variable = std::get_if<IR::Variable>(&phi.arguments[k]);
+                valid = variable && (!next || *next == variable->name);
+                if (valid) next = &variable->name;
+            }
+            if (!valid || !initial || !next) continue;
+            auto step = step_of(*next, name);
+            if (!step) continue;
+            basic.emplace(name, BasicVariable{*initial, *step, pointer});
+        }
+    }
+
+    void InductionVariablePass::find_derived_values(const Loop &loop) {
+        for (const auto &[name, variable]: basic) {
+            if (!variable.pointer) derived.emplace(name, Induction{name, variable.step});
+        }
+        // a definition can come before the values it reads in block order
+        bool progress = true;
+        while (progress) {
+            progress = false;
+            for (int block: loop.blocks) {
+                for (const auto &instruction: cfg->blocks[block].instructions) {
+                    auto *name = defined_variable(instruction);
+                    if (!name || !defined.contains(*name) || derived.contains(*name)) continue;
+                    if (auto induction = derive(instruction)) {
+                        derived.emplace(*name, std::move(*induction));
+                        progress = true;
+                    }
+                }
+            }
+        }
+    }
+
+    std::optional<InductionVariablePass::Induction> InductionVariablePass::derive(
+        const IR::Instruction &instruction) const {
+        auto induction_of = [&](const IR::Value &value) -> const Induction * {
+            auto *variable = std::get_if<IR::Variable>(&value);
+            if (!variable) return nullptr;
+            auto found = derived.find(variable->name);
+            return found == derived.end() ? nullptr : &found->second;
+        };
+        auto type_of = [&](const IR::Value &value) -> const AST::Type & {
+            return *symbols->at(std::get<IR::Variable>(value).name).type;
+        };
+        auto finish = [](Induction induction) {
+            induction.linear = induction.linear && is_small(induction.scale) && is_small(induction.offset);
+            return induction;
+        };
+        // adds the invariant addend, scaled
+        auto add = [&](Induction induction, const IR::Value &addend, std::int64_t scale) {
+            auto constant = integer_value(addend);
+            if (constant && is_small(*constant)) {
+                induction.offset += *constant * scale;
+            } else {
+                induction.linear = false;
+            }
+            return finish(std::move(induction));
+        };
+
+        return std::visit(overloaded{
+                              [&](const IR::Copy &ins) -> std::optional<Induction> {
+                                  // long and unsigned long have the same bits, an unsigned index becomes a long one
+                                  auto is_long = [](const AST::Type &type) {
+                                      return std::holds_alternative<AST::LongType>(type) ||
+                                             std::holds_alternative<AST::ULongType>(type);
+                                  };
+                                  auto *source = induction_of(ins.source);
+                                  const auto &from = type_of(ins.source);
+                                  const auto &to = type_of(ins.destination);
+                                  if (!source || (from.index() != to.index() && !(is_long(from) && is_long(to)))) {
+                                      return std::nullopt;
+                                  }
+                                  return *source;
+                              },
+                              [&](const IR::SignExtend &ins) -> std::optional<Induction> {
+                                  // signed overflow is undefined, so the extension of x + 1 is the extension of x
+                                  // plus one
+                                  auto *source = induction_of(ins.source);
+                                  if (!source || !std::holds_alternative<AST::IntType>(type_of(ins.source))) {
+                                      return std::nullopt;
+                                  }
+                                  return *source;
+                              },
+                              [&](const IR::Binary &ins) -> std::optional<Induction> {
+                                  if (!is_integer(std::get<IR::Variable>(ins.destination).name)) return std::nullopt;
+                                  auto *left = induction_of(ins.left_source);
+                                  auto *right = induction_of(ins.right_source);
+                                  if ((left && left->root) || (right && right->root) || (left && right)) {
+                                      return std::nullopt;
+                                  }
+                                  switch (ins.op) {
+                                      case IR::Binary::Operator::ADD:
+                                          if (left && is_invariant(ins.right_source)) {
+                                              return add(*left, ins.right_source, 1);
+                                          }
+                                          if (right && is_invariant(ins.left_source)) {
+                                              return add(*right, ins.left_source, 1);
+                                          }
+                                          return std::nullopt;
+                                      case IR::Binary::Operator::SUBTRACT:
+                                          if (left && is_invariant(ins.right_source)) {
+                                              return add(*left, ins.right_source, -1);
+                                          }
+                                          return std::nullopt;
+                                      case IR::Binary::Operator::MULTIPLY: {
+                                          const auto *source = left ? left : right;
+                                          auto factor = integer_value(left ? ins.right_source : ins.left_source);
+                                          if (!source || !factor) return std::nullopt;
+                                          auto induction = *source;
+                                          induction.step = wrapping_multiply(induction.step, *factor);
+                                          if (is_small(*factor)) {
+                                              induction.scale *= *factor;
+                                              induction.offset *= *factor;
+                                          } else {
+                                              induction.linear = false;
+                                          }
+                                          return finish(std::move(induction));
+                                      }
+                                      default:
+                                          return std::nullopt;
+                                  }
+                              },
+                              [&](const IR::AddPtr &ins) -> std::optional<Induction> {
+                                  auto *pointer = induction_of(ins.ptr);
+                                  auto *index = induction_of(ins.index);
+                                  if (pointer && !index && is_invariant(ins.index)) {
+                                      return add(*pointer, ins.index, ins.scale);
+                                  }
+                                  if (!index || pointer || index->root || !is_invariant(ins.ptr)) return std::nullopt;
+                                  auto induction = *index;
+                                  induction.step = wrapping_multiply(induction.step, ins.scale);
+                                  induction.root = ins.ptr;
+                                  induction.scale *= ins.scale;
+                                  induction.offset *= ins.scale;
+                                  return finish(std::move(induction));
+                              },
+                              [](const auto &) -> std::optional<Induction> { return std::nullopt; }
+                          }, instruction);
+    }
+
+    IR::Value InductionVariablePass::materialize(const std::string &name, const IR::Value &basic_value,
+                                                 std::unordered_map<std::string, IR::Value> &materialized,
+                                                 std::vector<IR::Instruction> &code) {
+        if (basic.contains(name)) return basic_value;
+        if (auto found = materialized.find(name); found != materialized.end()) return found->second;
+        auto instruction = *definitions.at(name);
+        for_each_use(instruction, [&](IR::Value &operand) {
+            auto *variable = std::get_if<IR::Variable>(&operand);
+            if (!variable || !derived.contains(variable->name)) return;
+            auto value = materialize(variable->name, basic_value, materialized, code);
+            operand = std::move(value);
+        });
+
+        // a constant start folds right away
+        const auto &type = *symbols->at(name).type;
+        auto constant_of = [](const IR::Value &value) { return std::get_if<IR::Constant>(&value); };
+        auto folded = std::visit(overloaded{
+                                     [&](const IR::Copy &ins) -> std::optional<IR::Value> {
+                                         auto *source = constant_of(ins.source);
+                                         if (!source) return std::nullopt;
+                                         auto converted = convert_constant(source->constant, type);
+                                         if (!converted) return std::nullopt;
+                                         return IR::Constant(*converted);
+                                     },
+                                     [&](const IR::SignExtend &ins) -> std::optional<IR::Value> {
+                                         auto *source = constant_of(ins.source);
+                                         if (!source) return std::nullopt;
+                                         auto converted = convert_constant(source->constant, type);
+                                         if (!converted) return std::nullopt;
+                                         return IR::Constant(*converted);
+                                     },
+                                     [&](const IR::Binary &ins) -> std::optional<IR::Value> {
+                                         auto *left = constant_of(ins.left_source);
+                                         auto *right = constant_of(ins.right_source);
+                                         if (!left || !right) return std::nullopt;
+                                         auto result = evaluate_binary(ins.op, left->constant, right->constant, type);
+                                         if (!result) return std::nullopt;
+                                         return IR::Constant(*result);
+                                     },
+                                     [&](const IR::AddPtr &ins) -> std::optional<IR::Value> {
+                                         if (integer_value(ins.index) != 0) return std::nullopt;
+                                         return ins.ptr;
+                                     },
+                                     [](const auto &) -> std::optional<IR::Value> { return std::nullopt; }
+                                 }, instruction);
+        if (!folded) {
+            auto start = fresh(name, ".iv.start");
+            *defined_variable(instruction) = start;
+            code.push_back(std::move(instruction));
+            folded = IR::Variable(std::move(start));
+        }
+        materialized.emplace(name, *folded);
+        return *folded;
+    }
+
+    std::optional<std::pair<InductionVariablePass::Candidate, std::int64_t> >
+    InductionVariablePass::replacement_test(const std::string &name, const Induction &counter,
+                                            const IR::Value &bound, const std::vector<Reduction> &reductions) const {
+        // the counter has to be x + offset for the basic variable x, counting up from a known start
+        if (counter.root || !counter.linear || counter.scale != 1) return std::nullopt;
+        const auto &variable = basic.at(counter.basic);
+        auto start = integer_value(variable.initial);
+        auto limit = integer_value(bound);
+        constexpr auto max = std::numeric_limits<std::int32_t>::max();
+        if (variable.step <= 0 || !start || !limit || *start < 0 || *start > max || *limit < 0 || *limit > max) {
+            return std::nullopt;
+        }
+        // an unsigned counter below zero wraps around to the top of its range, where the pointer does not go
+        if (std::holds_alternative<AST::ULongType>(*symbols->at(name).type) && *start + counter.offset < 0) {
+            return std::nullopt;
+        }
+        std::vector<Candidate> candidates;
+        for (const auto &reduction: reductions) {
+            const auto &pointer = derived.at(reduction.value);
+            if (!reduction.owner || pointer.basic != counter.basic || !pointer.root || !pointer.linear) continue;
+            candidates.push_back({reduction.phi, *pointer.root, pointer.scale, pointer.offset});
+        }
+        // pointer phis left by an earlier run, p = start of p + step of p / step of x * (x - start of x)
+        for (const auto &[name, pointer]: basic) {
+            if (!pointer.pointer || pointer.step <= 0 || pointer.step % variable.step != 0) continue;
+            auto scale = pointer.step / variable.step;
+            if (!is_small(scale)) continue;
+            candidates.push_back({name, pointer.initial, scale, -scale * *start});
+        }
+        // counter op bound is x op bound - offset, and for p = root + scale * x + c with a positive scale that is
+        // p op the address at bound - offset, as long as no address from the start on wraps around: the offsets
+        // from root at the start and at the bound are not negative and the one at the bound fits a displacement
+        std::ranges::sort(candidates, {}, &Candidate::phi);
+        for (auto &candidate: candidates) {
+            if (candidate.scale <= 0) continue;
+            auto first = candidate.scale * *start + candidate.offset;
+            auto last = candidate.scale * (*limit - counter.offset) + candidate.offset;
+            if (first < 0 || last < 0 || last > max) continue;
+            return std::pair{std::move(candidate), last};
+        }
+        return std::nullopt;
+    }
+
+    bool InductionVariablePass::is_invariant(const IR::Value &value) const {
+        auto *variable = std::get_if<IR::Variable>(&value);
+        return !variable || (values->contains(variable->name) && !defined.contains(variable->name));
+    }
+
+    bool InductionVariablePass::is_integer(const std::string &name) const {
+        const auto &type = *symbols->at(name).type;
+        return std::holds_alternative<AST::IntType>(type) || std::holds_alternative<AST::LongType>(type) ||
+               std::holds_alternative<AST::ULongType>(type);
+    }
+
+    std::string InductionVariablePass::fresh(const std::string &name, std::string_view suffix) {
+        auto result = name + std::string(suffix);
+        for (int i = 1; symbols->contains(result); i++) {
+            result = name + std::string(suffix) + "." + std::to_string(i);
+        }
+        auto type = symbols->at(name).type;
+        (*symbols)[result] = Symbol{std::move(type), LocalAttributes{}};
+        values->insert(result);
+        return result;
+    }
+
+    bool InductionVariablePass::remove_dead_values() {
+        auto removable = [&](const IR::Instruction &instruction) {
+            auto *name = defined_variable(instruction);
+            if (!name || !values->contains(*name)) return false;
+            return std::visit(overloaded{
+                                  [](const IR::Binary &ins) {
+                                      return ins.op != IR::Binary::Operator::DIVIDE &&
+                                             ins.op != IR::Binary::Operator::REMAINDER;
+                                  },
+                                  [](const IR::Copy &) { return true; },
+                                  [](const IR::SignExtend &) { return true; },
+                                  [](const IR::AddPtr &) { return true; },
+                                  [](const IR::Phi &) { return true; },
+                                  [](const auto &) { return false; }
+                              }, instruction);
+        };
+        // whatever the other instructions read is live, and so is whatever a live value is computed from
+        std::unordered_map<std::string, const IR::Instruction *> computations;
+        for (const auto &block: cfg->blocks) {
+            for (const auto &instruction: block.instructions) {
+                if (removable(instruction)) computations[*defined_variable(instruction)] = &instruction;
+            }
+        }
+        std::unordered_set<std::string> live;
+        std::vector<const IR::Instruction *> worklist;
+        auto use = [&](const IR::Value &value) {
+            auto *variable = std::get_if<IR::Variable>(&value);
+            if (!variable || !live.insert(variable->name).second) return;
+            if (auto found = computations.find(variable->name); found != computations.end()) {
+                worklist.push_back(found->second);
+            }
+        };
+        for (const auto &block: cfg->blocks) {
+            for (const auto &instruction: block.instructions) {
+                if (!removable(instruction)) for_each_use(instruction, use);
+            }
+        }
+        while (!worklist.empty()) {
+            const auto *instruction = worklist.back();
+            worklist.pop_back();
+            for_each_use(*instruction, use);
+        }
+        std::size_t removed = 0;
+        for (auto &block: cfg->blocks) {
+            removed += std::erase_if(block.instructions, [&](const IR::Instruction &instruction) {
+                return removable(instruction) && !live.contains(*defined_variable(instruction));
+            });
+        }
+        return removed > 0;
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef INDUCTIONVARIABLEPASS_H
+#define INDUCTIONVARIABLEPASS_H
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "CFG.h"
+#include "../IR.h"
+
+// induction variable strength reduction on a cfg in ssa form, inner loops first
+//
+// a basic induction variable is a phi in the loop header that every latch advances by the same constant, values
+// computed from an integer one with additions of invariants, multiplications by constants and sign extensions are
+// derived from it, derived pointers (the AddPtr of an array index) become phis of their own that step by a constant
+// number of bytes instead of being recomputed from the index every iteration
+//
+// a test of the counter against a constant bound is replaced by a test of a pointer phi stepping along with it (one
+// of those, or one from an earlier run) against its address at the bound when no address involved can wrap around,
+// basic variables with the same start and step are merged, and whatever nothing uses anymore afterward is removed
+//
+// pointers a constant distance apart that step the same share one phi, the others are computed from it
+
+namespace optimization {
+    class InductionVariablePass {
+    public:
+        // values are the ssa names from SSAConstruction, the new phis and pointers are added to them
+        InductionVariablePass(CFG *cfg, std::unordered_map<std::string, Symbol> *symbols,
+                              std::unordered_set<std::string> *values)
+            : cfg(cfg), symbols(symbols), values(values) {
+        }
+
+        // true if anything changed
+        bool run();
+
+        // pointers turned into phis, loop tests rewritten to compare pointers
+        int reduced = 0;
+        int replaced_tests = 0;
+
+    private:
+        struct BasicVariable {
+            // value on entry from the preheader
+            IR::Value initial;
+            // in bytes for pointers
+            std::int64_t step;
+            bool pointer;
+        };
+
+        // a value derived from a basic induction variable x, scale * x + offset (+ root for pointers) when linear
+        struct Induction {
+            std::string basic;
+            // change per iteration, in bytes for pointers
+            std::int64_t step = 0;
+            bool linear = true;
+            std::optional<IR::Value> root = std::nullopt;
+            std::int64_t scale = 1;
+            std::int64_t offset = 0;
+        };
+
+        struct Reduction {
+            std::string value;
+            std::string phi;
+            IR::Value initial;
+            // false if the phi belongs to another reduction
+            bool owner;
+            // bytes from the phi to the value
+            std::int64_t offset = 0;
+        };
+
+        bool reduce(const Loop &loop, int preheader);
+        bool merge_basic_variables(const Loop &loop, int preheader);
+        void find_basic_variables(const Loop &loop, int preheader);
+        void find_derived_values(const Loop &loop);
+        std::optional<Induction> derive(const IR::Instruction &instruction) const;
+        // the value of name in the iteration where the basic variable is basic_value, computed in front of the loop
+        IR::Value materialize(const std::string &name, const IR::Value &basic_value,
+                              std::unordered_map<std::string, IR::Value> &materialized,
+                              std::vector<IR::Instruction> &code);
+        // a pointer phi stepping along with a counter, root + scale * x + offset for the counter's basic variable x
+        struct Candidate {
+            std::string phi;
+            IR::Value root;
+            std::int64_t scale;
+            std::int64_t offset;
+        };
+
+        // the pointer to test instead of the counter name and its offset from the root at bound, if the test can be
+        // replaced
+        std::optional<std::pair<Candidate, std::int64_t> > replacement_test(
+            const std::string &name, const Induction &counter, const IR::Value &bound,
+            const std::vector<Reduction> &reductions) const;
+        bool is_invariant(const IR::Value &value) const;
+        bool is_integer(const std::string &name) const;
+        // a new ssa value of the same type as name
+        std::string fresh(const std::string &name, std::string_view suffix);
+        // removes pure instructions whose value is never used, cycles of phis included
+        bool remove_dead_values();
+
+        CFG *cfg;
+        std::unordered_map<std::string, Symbol> *symbols;
+        std::unordered_set<std::string> *values;
+
+        // per loop
+        std::unordered_set<std::string> defined;
+        std::unordered_map<std::string, const IR::Instruction *> definitions;
+        std::unordered_map<std::string, BasicVariable> basic;
+        std::unordered_map<std::string, Induction> derived;
+    };
+}
+
+#endif //INDUCTIONVARIABLEPASS_H
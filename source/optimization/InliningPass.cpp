@@ -0,0 +1,229 @@
+#include "InliningPass.h"
+
+#include <algorithm>
+
+#include "CFG.h"
+#include "Operands.h"
+
+namespace optimization {
+    InliningPass::InliningPass(IR::Program *program, std::unordered_map<std::string, Symbol> *symbols,
+                               int threshold, InliningReport *report)
+        : program(program), symbols(symbols), threshold(threshold), report(report) {
+        build_call_graph();
+        find_recursive_functions();
+    }
+
+    void InliningPass::build_call_graph() {
+        for (auto &item: program->items) {
+            if (auto *function = std::get_if<IR::Function>(&item)) {
+                functions[function->name] = function;
+            }
+        }
+        for (auto &item: program->items) {
+            auto *function = std::get_if<IR::Function>(&item);
+            if (!function) continue;
+            auto &called = callees[function->name];
+            for (const auto &instruction: function->instructions) {
+                if (auto *call = std::get_if<IR::Call>(&instruction)) {
+                    call_sites[call->name]++;
+                    if (functions.contains(call->name)) called.push_back(call->name);
+                }
+            }
+            for (const auto &name: optimization::address_taken(function->instructions)) {
+                if (functions.contains(name)) address_taken.insert(name);
+            }
+        }
+    }
+
+    void InliningPass::find_recursive_functions() {
+        // Tarjan's strongly connected components, a component is finished only after everything it calls, which is
+        // the order the functions get optimized in
+        struct Component {
+            InliningPass &pass;
+            std::unordered_map<std::string, int> index = {};
+            std::unordered_map<std::string, int> low = {};
+            std::vector<std::string> stack = {};
+            std::unordered_set<std::string> on_stack = {};
+
+            void visit(const std::string &name) {
+                int number = static_cast<int>(index.size());
+                index[name] = number;
+                low[name] = number;
+                stack.push_back(name);
+                on_stack.insert(name);
+                for (const auto &callee: pass.callees[name]) {
+                    if (!index.contains(callee)) {
+                        visit(callee);
+                        low[name] = std::min(low[name], low[callee]);
+                    } else if (on_stack.contains(callee)) {
+                        low[name] = std::min(low[name], index[callee]);
+                    }
+                }
+                if (low[name] != index[name]) return;
+                auto first = std::ranges::find(stack, name);
+                const auto &called = pass.callees[name];
+                bool cycle = stack.end() - first > 1 || std::ranges::find(called, name) != called.end();
+                for (auto member = first; member != stack.end(); ++member) {
+                    if (cycle) pass.recursive.insert(*member);
+                    on_stack.erase(*member);
+                    pass.order.push_back(pass.functions[*member]);
+                }
+                stack.erase(first, stack.end());
+            }
+        } components{*this};
+
+        for (auto &item: program->items) {
+            auto *function = std::get_if<IR::Function>(&item);
+            if (function && !components.index.contains(function->name)) components.visit(function->name);
+        }
+    }
+
+    bool InliningPass::run(IR::Function &function) {
+        bool changed = false;
+        int caller_size = size_of(function);
+        std::vector<IR::Instruction> output;
+        output.reserve(function.instructions.size());
+        for (auto &instruction: function.instructions) {
+            auto *call = std::get_if<IR::Call>(&instruction);
+            const IR::Function *callee = call ? should_inline(function, *call, caller_size) : nullptr;
+            if (!callee) {
+                output.push_back(std::move(instruction));
+                continue;
+            }
+            inline_call(*call, *callee, function, output);
+            caller_size += size_of(*callee);
+            changed = true;
+        }
+        function.instructions = std::move(output);
+        return changed;
+    }
+
+    const IR::Function *InliningPass::should_inline(const IR::Function &caller, const IR::Call &call,
+                                                    int caller_size) {
+        auto found = functions.find(call.name);
+        // only declared here
+        if (found == functions.end()) return nullptr;
+        const auto &callee = *found->second;
+        int size = size_of(callee);
+        int gain = benefit(call);
+        bool inlined = false;
+        std::string_view reason;
+        if (recursive.contains(callee.name)) {
+            reason = "recursive";
+        } else if (!callee.global && !address_taken.contains(callee.name) && call_sites[callee.name] == 1) {
+            // the body is dropped afterward, so the copy does not grow the program
+            inlined = true;
+            reason = "only call site";
+        } else if (size - gain > threshold) {
+            reason = "too large";
+        } else if (caller_size + size > max_caller_size) {
+            reason = "caller too large";
+        } else {
+            inlined = true;
+            reason = "small";
+        }
+        if (report) {
+            report->decisions.push_back({caller.name, callee.name, size, gain, inlined, reason});
+        }
+        return inlined ? &callee : nullptr;
+    }
+
+    void InliningPass::inline_call(const IR::Call &call, const IR::Function &callee, IR::Function &caller,
+                                   std::vector<IR::Instruction> &output) {
+        // locals, parameters and temporaries get fresh names per copy, static variables are shared by all of them
+        auto suffix = ".inline." + std::to_string(copies++);
+        std::unordered_map<std::string, std::string> renamed;
+        auto rename = [&](std::string &name) {
+            if (auto found = renamed.find(name); found != renamed.end()) {
+                name = found->second;
+                return;
+            }
+            if (!is_local(name, *symbols)) return;
+            auto copy = symbols->at(name);
+            auto fresh = name + suffix;
+            (*symbols)[fresh] = std::move(copy);
+            if (callee.vectors.contains(name)) caller.vectors.insert(fresh);
+            renamed.emplace(name, fresh);
+            name = std::move(fresh);
+        };
+        auto rename_value = [&](IR::Value &value) {
+            if (auto *variable = std::get_if<IR::Variable>(&value)) rename(variable->name);
+        };
+
+        call_sites[callee.name]--;
+        // arguments were converted to the parameter types at the call
+        for (std::size_t i = 0; i < callee.params.size(); i++) {
+            auto param = callee.params[i];
+            rename(param);
+            output.emplace_back(IR::Copy(call.arguments[i], IR::Variable(param)));
+        }
+        auto end_label = callee.name + ".return" + suffix;
+        for (auto instruction: callee.instructions) {
+            if (auto *ret = std::get_if<IR::Return>(&instruction)) {
+                if (ret->value && call.destination) {
+                    auto value = *ret->value;
+                    rename_value(value);
+                    output.emplace_back(IR::Copy(std::move(value), *call.destination));
+                }
+                output.emplace_back(IR::Jump(end_label));
+                continue;
+            }
+            for_each_use(instruction, rename_value);
+            if (auto *name = defined_variable(instruction)) rename(*name);
+            if (auto *get_address = std::get_if<IR::GetAddress>(&instruction)) rename_value(get_address->source);
+            if (auto *label = std::get_if<IR::Label>(&instruction)) label->name += suffix;
+            for_each_jump_target(instruction, [&](std::string &target) { target += suffix; });
+            if (auto *inner = std::get_if<IR::Call>(&instruction)) call_sites[inner->name]++;
+            output.push_back(std::move(instruction));
+        }
+        if (auto *jump = std::get_if<IR::Jump>(&output.back()); jump && jump->target == end_label) {
+            output.pop_back();
+        }
+        output.emplace_back(IR::Label(end_label));
+    }
+
+    void InliningPass::remove_unreferenced_functions() {
+        std::unordered_set<std::string> reachable;
+        std::vector<std::string> worklist;
+        auto reach = [&](const std::string &name) {
+            if (functions.contains(name) && reachable.insert(name).second) worklist.push_back(name);
+        };
+        for (const auto &[name, function]: functions) {
+            if (function->global) reach(name);
+        }
+        while (!worklist.empty()) {
+            auto name = std::move(worklist.back());
+            worklist.pop_back();
+            for (const auto &instruction: functions[name]->instructions) {
+                if (auto *call = std::get_if<IR::Call>(&instruction)) {
+                    reach(call->name);
+                } else if (auto *get_address = std::get_if<IR::GetAddress>(&instruction)) {
+                    if (auto *variable = std::get_if<IR::Variable>(&get_address->source)) reach(variable->name);
+                }
+            }
+        }
+        // the function pointers die with the items
+        functions.clear();
+        order.clear();
+        std::erase_if(program->items, [&](const auto &item) {
+            auto *function = std::get_if<IR::Function>(&item);
+            if (!function || reachable.contains(function->name)) return false;
+            if (report) report->removed.push_back(function->name);
+            return true;
+        });
+    }
+
+    int InliningPass::size_of(const IR::Function &function) {
+        return static_cast<int>(std::ranges::count_if(function.instructions, [](const IR::Instruction &instruction) {
+            return !std::holds_alternative<IR::Label>(instruction);
+        }));
+    }
+
+    int InliningPass::benefit(const IR::Call &call) {
+        int constants = static_cast<int>(std::ranges::count_if(call.arguments, [](const IR::Value &argument) {
+            return std::holds_alternative<IR::Constant>(argument);
+        }));
+        return call_overhead + argument_benefit * static_cast<int>(call.arguments.size()) +
+               constant_argument_benefit * constants;
+    }
+}
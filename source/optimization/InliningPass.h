@@ -0,0 +1,83 @@
+#ifndef INLININGPASS_H
+#define INLININGPASS_H
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../IR.h"
+
+// replaces calls to small functions defined in the same translation unit with a copy of their body, functions
+// are visited callees first so every body is already optimized when it gets copied
+
+namespace optimization {
+    struct InliningDecision {
+        std::string caller;
+        std::string callee;
+        // instructions the copy adds and what the call it replaces costs, see InliningPass::benefit
+        int size;
+        int benefit;
+        bool inlined;
+        std::string_view reason;
+    };
+
+    // collected only when requested
+    struct InliningReport {
+        std::vector<InliningDecision> decisions;
+        // static functions dropped because nothing refers to them anymore
+        std::vector<std::string> removed;
+    };
+
+    class InliningPass {
+    public:
+        InliningPass(IR::Program *program, std::unordered_map<std::string, Symbol> *symbols, int threshold,
+                     InliningReport *report = nullptr);
+
+        // defined functions, callees before their callers (members of a cycle in no particular order)
+        const std::vector<IR::Function *> &bottom_up_order() const {
+            return order;
+        }
+
+        // inlines the calls of one function, true if any was
+        bool run(IR::Function &function);
+
+        // drops static functions no longer reachable from a global one
+        void remove_unreferenced_functions();
+
+    private:
+        // calls cost an instruction plus the argument moves, the frame setup and the spills around them, constant
+        // arguments usually let the copy fold further
+        static constexpr int call_overhead = 6;
+        static constexpr int argument_benefit = 2;
+        static constexpr int constant_argument_benefit = 6;
+        // callers stop growing past this many instructions, register allocation is superlinear in it
+        static constexpr int max_caller_size = 3000;
+
+        void build_call_graph();
+        void find_recursive_functions();
+        // decides and records one call site, nullptr if the call stays
+        const IR::Function *should_inline(const IR::Function &caller, const IR::Call &call, int caller_size);
+        void inline_call(const IR::Call &call, const IR::Function &callee, IR::Function &caller,
+                         std::vector<IR::Instruction> &output);
+        static int size_of(const IR::Function &function);
+        static int benefit(const IR::Call &call);
+
+        IR::Program *program;
+        std::unordered_map<std::string, Symbol> *symbols;
+        int threshold;
+        InliningReport *report;
+
+        std::unordered_map<std::string, IR::Function *> functions;
+        std::unordered_map<std::string, std::vector<std::string>> callees;
+        std::unordered_set<std::string> recursive;
+        // functions whose address is taken can be called from anywhere
+        std::unordered_set<std::string> address_taken;
+        // calls to each function across the whole program, kept up to date while inlining
+        std::unordered_map<std::string, int> call_sites;
+        std::vector<IR::Function *> order;
+        int copies = 0;
+    };
+}
+
+#endif //INLININGPASS_H
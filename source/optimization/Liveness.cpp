@@ -0,0 +1,71 @@
+#include "Liveness.h"
+
+#include "Operands.h"
+
+namespace optimization {
+    Liveness::Liveness(const CFG &cfg) {
+        number_variables(cfg);
+        const auto &blocks = cfg.blocks;
+        live_in.assign(blocks.size(), BitSet(variables.size()));
+        live_out.assign(blocks.size(), BitSet(variables.size()));
+
+        // blocks are visited last to first, which is close to postorder for the generator's layout
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int block = static_cast<int>(blocks.size()) - 1; block >= 0; block--) {
+                BitSet live(variables.size());
+                for (int successor: blocks[block].successors) {
+                    live |= live_in[successor];
+                }
+                live_out[block] = live;
+                for (auto it = blocks[block].instructions.rbegin(); it != blocks[block].instructions.rend(); ++it) {
+                    transfer(*it, live);
+                }
+                if (live != live_in[block]) {
+                    live_in[block] = std::move(live);
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    int Liveness::index_of(const std::string &name) const {
+        auto it = indices.find(name);
+        return it == indices.end() ? -1 : it->second;
+    }
+
+    void Liveness::transfer(const IR::Instruction &instruction, BitSet &live) const {
+        // CopyToOffset writes only part of its destination, the rest stays live
+        if (!std::holds_alternative<IR::CopyToOffset>(instruction)) {
+            if (auto *name = defined_variable(instruction)) {
+                live.reset(index_of(*name));
+            }
+        }
+        for_each_use(instruction, [&](const IR::Value &value) {
+            if (auto *variable = std::get_if<IR::Variable>(&value)) {
+                live.set(index_of(variable->name));
+            }
+        });
+    }
+
+    void Liveness::number_variables(const CFG &cfg) {
+        auto add = [&](const std::string &name) {
+            if (indices.try_emplace(name, static_cast<int>(variables.size())).second) {
+                variables.push_back(name);
+            }
+        };
+        for (const auto &block: cfg.blocks) {
+            for (const auto &instruction: block.instructions) {
+                if (auto *name = defined_variable(instruction)) {
+                    add(*name);
+                }
+                for_each_use(instruction, [&](const IR::Value &value) {
+                    if (auto *variable = std::get_if<IR::Variable>(&value)) {
+                        add(variable->name);
+                    }
+                });
+            }
+        }
+    }
+}
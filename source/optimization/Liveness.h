@@ -0,0 +1,34 @@
+#ifndef LIVENESS_H
+#define LIVENESS_H
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BitSet.h"
+#include "CFG.h"
+
+// variables whose current value may still be read, per block boundary (backward dataflow, meet is union)
+
+namespace optimization {
+    class Liveness {
+    public:
+        explicit Liveness(const CFG &cfg);
+
+        // -1 for names the function never mentions
+        int index_of(const std::string &name) const;
+
+        // moves live from after the instruction to before it
+        void transfer(const IR::Instruction &instruction, BitSet &live) const;
+
+        std::vector<std::string> variables;
+        std::vector<BitSet> live_in;
+        std::vector<BitSet> live_out;
+
+    private:
+        void number_variables(const CFG &cfg);
+
+        std::unordered_map<std::string, int> indices;
+    };
+}
+
+#endif //LIVENESS_H
@@ -0,0 +1,130 @@
+#include "LoopInvariantCodeMotionPass.h"
+
+#include <algorithm>
+
+#include "Operands.h"
+#include "../overloaded.h"
+
+namespace optimization {
+    bool LoopInvariantCodeMotionPass::run() {
+        if (cfg->blocks.empty()) return false;
+        local_address_taken = optimization::address_taken(*cfg);
+        cfg->compute_dominators();
+        cfg->compute_loops();
+        // loops are sorted from the largest to the smallest, so inner loops come after the loops around them
+        bool changed = false;
+        for (int i = static_cast<int>(cfg->loops.size()) - 1; i >= 0; i--) {
+            changed |= hoist(cfg->loops[i]);
+        }
+        return changed;
+    }
+
+    bool LoopInvariantCodeMotionPass::hoist(const Loop &loop) {
+        int target = cfg->preheader(loop);
+        if (target == -1) return false;
+        auto effects = effects_of(loop);
+        auto &destination = cfg->blocks[target].instructions;
+        bool changed = false;
+        bool progress = true;
+        // an instruction can become invariant once the ones computing its operands moved
+        while (progress) {
+            progress = false;
+            for (int block: loop.blocks) {
+                auto &instructions = cfg->blocks[block].instructions;
+                for (std::size_t i = 0; i < instructions.size();) {
+                    if (!can_hoist(instructions[i], block, effects)) {
+                        i++;
+                        continue;
+                    }
+                    effects.defined.erase(*defined_variable(instructions[i]));
+                    auto position = destination.end();
+                    if (jump_target(destination.back()) || ends_block(destination.back())) --position;
+                    destination.insert(position, std::move(instructions[i]));
+                    instructions.erase(instructions.begin() + static_cast<std::ptrdiff_t>(i));
+                    hoisted++;
+                    progress = true;
+                    changed = true;
+                }
+            }
+        }
+        return changed;
+    }
+
+    LoopInvariantCodeMotionPass::LoopEffects LoopInvariantCodeMotionPass::effects_of(const Loop &loop) const {
+        LoopEffects effects;
+        for (int block: loop.blocks) {
+            for (const auto &instruction: cfg->blocks[block].instructions) {
+                if (auto *name = defined_variable(instruction)) {
+                    (values->contains(*name) ? effects.defined : effects.written).insert(*name);
+                }
+                effects.calls |= std::holds_alternative<IR::Call>(instruction);
+                effects.stores |= std::holds_alternative<IR::Store>(instruction);
+            }
+            // returning leaves the loop as well
+            const auto &instructions = cfg->blocks[block].instructions;
+            const auto &successors = cfg->blocks[block].successors;
+            if ((!instructions.empty() && std::holds_alternative<IR::Return>(instructions.back())) ||
+                std::ranges::any_of(successors, [&](int successor) {
+                    return !std::ranges::binary_search(loop.blocks, successor);
+                })) {
+                effects.exits.push_back(block);
+            }
+        }
+        return effects;
+    }
+
+    bool LoopInvariantCodeMotionPass::is_invariant(const IR::Value &value, const LoopEffects &effects) const {
+        auto *variable = std::get_if<IR::Variable>(&value);
+        if (!variable) return true;
+        const auto &name = variable->name;
+        if (values->contains(name)) return !effects.defined.contains(name);
+        // a variable in memory, calls can change statics and anything whose address got out, stores anything whose
+        // address is taken
+        if (effects.written.contains(name) || effects.calls) return false;
+        return !effects.stores || (!address_taken->contains(name) && !local_address_taken.contains(name));
+    }
+
+    bool LoopInvariantCodeMotionPass::can_hoist(const IR::Instruction &instruction, int block,
+                                                const LoopEffects &effects) const {
+        auto *name = defined_variable(instruction);
+        if (!name || !values->contains(*name)) return false;
+        bool pure = std::visit(overloaded{
+                                   [](const IR::Call &) { return false; },
+                                   [](const IR::CopyToOffset &) { return false; },
+                                   [](const IR::Phi &) { return false; },
+                                   [](const auto &) { return true; }
+                               }, instruction);
+        if (!pure) return false;
+        bool invariant = true;
+        for_each_use(instruction, [&](const IR::Value &value) { invariant = invariant && is_invariant(value, effects); });
+        if (!invariant) return false;
+
+        if (std::holds_alternative<IR::Load>(instruction)) {
+            return !effects.calls && !effects.stores && always_runs(block, effects);
+        }
+        if (auto *binary = std::get_if<IR::Binary>(&instruction)) {
+            if (binary->op != IR::Binary::Operator::DIVIDE && binary->op != IR::Binary::Operator::REMAINDER) {
+                return true;
+            }
+            // integer division by zero and the most negative number divided by -1 trap
+            if (auto *divisor = std::get_if<IR::Constant>(&binary->right_source)) {
+                bool safe = std::visit(overloaded{
+                                           [](const AST::ConstDouble &) { return true; },
+                                           [](const auto &c) {
+                                               auto value = static_cast<std::int64_t>(c.value);
+                                               return value != 0 && value != -1;
+                                           }
+                                       }, divisor->constant);
+                if (safe) return true;
+            }
+            return !effects.calls && always_runs(block, effects);
+        }
+        return true;
+    }
+
+    bool LoopInvariantCodeMotionPass::always_runs(int block, const LoopEffects &effects) const {
+        return !effects.exits.empty() && std::ranges::all_of(effects.exits, [&](int exit) {
+            return cfg->dominates(block, exit);
+        });
+    }
+}
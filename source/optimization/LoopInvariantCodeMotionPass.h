@@ -0,0 +1,63 @@
+#ifndef LOOPINVARIANTCODEMOTIONPASS_H
+#define LOOPINVARIANTCODEMOTIONPASS_H
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "CFG.h"
+#include "../IR.h"
+
+// moves pure instructions whose operands do not change inside a loop into the loop's preheader (see
+// CFG::insert_preheaders), on a cfg in ssa form, inner loops first so an invariant can leave a whole nest
+//
+// reads of statics and address taken locals stay put if the loop writes them, calls anything or stores through a
+// pointer to them, loads only move if no store or call is in the loop, and instructions that can trap (loads,
+// divisions by a variable) only if the loop calls nothing and they run before every way out of the loop
+
+namespace optimization {
+    class LoopInvariantCodeMotionPass {
+    public:
+        // values are the ssa names from SSAConstruction, address_taken the statics whose address is taken anywhere
+        // in the program
+        LoopInvariantCodeMotionPass(CFG *cfg, std::unordered_map<std::string, Symbol> *symbols,
+                                    const std::unordered_set<std::string> *values,
+                                    const std::unordered_set<std::string> *address_taken)
+            : cfg(cfg), symbols(symbols), values(values), address_taken(address_taken) {
+        }
+
+        // true if any instruction moved
+        bool run();
+
+        // number of moved instructions
+        int hoisted = 0;
+
+    private:
+        struct LoopEffects {
+            // ssa values defined in the loop and not moved yet
+            std::unordered_set<std::string> defined;
+            // statics and address taken locals written by name
+            std::unordered_set<std::string> written;
+            bool calls = false;
+            bool stores = false;
+            // blocks with a successor outside the loop
+            std::vector<int> exits;
+        };
+
+        bool hoist(const Loop &loop);
+        LoopEffects effects_of(const Loop &loop) const;
+        bool is_invariant(const IR::Value &value, const LoopEffects &effects) const;
+        bool can_hoist(const IR::Instruction &instruction, int block, const LoopEffects &effects) const;
+        // the block runs before the loop is left, however it is left
+        bool always_runs(int block, const LoopEffects &effects) const;
+
+        CFG *cfg;
+        std::unordered_map<std::string, Symbol> *symbols;
+        const std::unordered_set<std::string> *values;
+        const std::unordered_set<std::string> *address_taken;
+        // address taken locals of this function
+        std::unordered_set<std::string> local_address_taken;
+    };
+}
+
+#endif //LOOPINVARIANTCODEMOTIONPASS_H
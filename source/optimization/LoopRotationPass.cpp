@@ -0,0 +1,76 @@
+#include "LoopRotationPass.h"
+
+#include <algorithm>
+
+namespace optimization {
+    bool LoopRotationPass::run() {
+        CFG cfg(std::move(function->instructions));
+        cfg.compute_dominators();
+        cfg.compute_loops();
+
+        struct Rotation {
+            int header;
+            std::vector<int> latches;
+            int inside;
+            int outside;
+        };
+        // found up front, rotating one loop only adds to latches and labels, which no other loop depends on
+        std::vector<Rotation> rotations;
+        for (const auto &loop: cfg.loops) {
+            const auto &header = cfg.blocks[loop.header].instructions;
+            if (!std::holds_alternative<IR::Label>(header.front()) ||
+                (!std::holds_alternative<IR::JumpIfZero>(header.back()) &&
+                 !std::holds_alternative<IR::JumpIfNotZero>(header.back()))) {
+                continue;
+            }
+            int inside = -1;
+            int outside = -1;
+            for (int successor: cfg.blocks[loop.header].successors) {
+                (std::ranges::binary_search(loop.blocks, successor) ? inside : outside) = successor;
+            }
+            if (inside == -1 || outside == -1) continue;
+            // the copy takes the place of the jump back
+            bool jumps_back = std::ranges::all_of(loop.latches, [&](int latch) {
+                return std::holds_alternative<IR::Jump>(cfg.blocks[latch].instructions.back());
+            });
+            if (!jumps_back || header.size() * loop.latches.size() > max_copied) continue;
+            rotations.push_back({loop.header, loop.latches, inside, outside});
+        }
+        if (rotations.empty()) {
+            function->instructions = cfg.linearize();
+            return false;
+        }
+
+        auto label_of = [&](int block, const std::string &name) {
+            auto &instructions = cfg.blocks[block].instructions;
+            if (auto *label = std::get_if<IR::Label>(&instructions.front())) return label->name;
+            instructions.insert(instructions.begin(), IR::Label(name));
+            return name;
+        };
+        for (const auto &rotation: rotations) {
+            const auto &header = cfg.blocks[rotation.header].instructions;
+            const auto &name = std::get<IR::Label>(header.front()).name;
+            auto inside = label_of(rotation.inside, name + ".body");
+            auto outside = label_of(rotation.outside, name + ".exit");
+            // taken to stay in the loop
+            auto test = header.back();
+            bool jumps_out = jump_target(test) && *jump_target(test) == outside;
+            if (auto *jump_if_zero = std::get_if<IR::JumpIfZero>(&test); jump_if_zero && jumps_out) {
+                test = IR::JumpIfNotZero(jump_if_zero->condition, inside);
+            } else if (auto *jump_if_not_zero = std::get_if<IR::JumpIfNotZero>(&test); jump_if_not_zero && jumps_out) {
+                test = IR::JumpIfZero(jump_if_not_zero->condition, inside);
+            }
+            for (int latch: rotation.latches) {
+                auto &instructions = cfg.blocks[latch].instructions;
+                instructions.pop_back();
+                instructions.insert(instructions.end(), header.begin() + 1, header.end() - 1);
+                instructions.push_back(test);
+                // dropped again by the cleanup when the exit comes next
+                instructions.emplace_back(IR::Jump(outside));
+            }
+            rotated++;
+        }
+        function->instructions = cfg.linearize();
+        return true;
+    }
+}
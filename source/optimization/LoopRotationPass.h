@@ -0,0 +1,32 @@
+#ifndef LOOPROTATIONPASS_H
+#define LOOPROTATIONPASS_H
+
+#include "CFG.h"
+#include "../IR.h"
+
+// turns loops tested at the top (while and for) into loops tested at the bottom: the header's test is copied to
+// the end of every latch as a conditional jump back into the body, so an iteration takes one branch instead of the
+// test and the jump back, and the header stays in place as the guard that runs once in front of the loop
+//
+// blocks are not moved, the body stays contiguous and the latch falls through to the exit when it is next
+
+namespace optimization {
+    class LoopRotationPass {
+    public:
+        explicit LoopRotationPass(IR::Function *function) : function(function) {
+        }
+
+        // true if any loop was rotated
+        bool run();
+
+        int rotated = 0;
+
+    private:
+        // instructions a loop may copy into its latches all together
+        static constexpr std::size_t max_copied = 16;
+
+        IR::Function *function;
+    };
+}
+
+#endif //LOOPROTATIONPASS_H
@@ -0,0 +1,175 @@
+#include "LoopUnrollingPass.h"
+
+#include <algorithm>
+#include <limits>
+#include <span>
+#include <unordered_map>
+
+#include "Operands.h"
+#include "../overloaded.h"
+
+namespace optimization {
+    namespace {
+        std::optional<std::int64_t> integer_value(const IR::Value &value) {
+            auto *constant = std::get_if<IR::Constant>(&value);
+            if (!constant) return std::nullopt;
+            return std::visit(overloaded{
+                                  [](const AST::ConstDouble &) -> std::optional<std::int64_t> { return std::nullopt; },
+                                  [](const auto &c) -> std::optional<std::int64_t> {
+                                      return static_cast<std::int64_t>(c.value);
+                                  }
+                              }, constant->constant);
+        }
+
+        bool holds(IR::Binary::Operator op, std::int64_t lhs, std::int64_t rhs) {
+            switch (op) {
+                case IR::Binary::Operator::LESS:
+                    return lhs < rhs;
+                case IR::Binary::Operator::LESS_EQUAL:
+                    return lhs <= rhs;
+                case IR::Binary::Operator::GREATER:
+                    return lhs > rhs;
+                case IR::Binary::Operator::GREATER_EQUAL:
+                    return lhs >= rhs;
+                default:
+                    return false;
+            }
+        }
+
+        bool fits(std::int64_t value, bool wide) {
+            return wide || (value >= std::numeric_limits<int>::min() && value <= std::numeric_limits<int>::max());
+        }
+
+        // the label a block starts with, one named name is added if it has none
+        std::string label_of(BasicBlock &block, const std::string &name) {
+            auto &instructions = block.instructions;
+            if (!instructions.empty()) {
+                if (auto *label = std::get_if<IR::Label>(&instructions.front())) return label->name;
+            }
+            instructions.insert(instructions.begin(), IR::Label(name));
+            return name;
+        }
+    }
+
+    bool LoopUnrollingPass::run() {
+        CFG cfg(std::move(function->instructions));
+        cfg.compute_dominators();
+        cfg.compute_loops();
+
+        // the loops are single blocks, unrolling one only adds a label to the block after it, which is not in the
+        // loop and keeps its label if it already has one
+        bool changed = false;
+        for (const auto &loop: cfg.loops) {
+            if (loop.blocks.size() != 1) continue;
+            auto counted = analyze(cfg.blocks[loop.header]);
+            if (!counted) continue;
+            if (auto trips = trip_count(cfg, loop, *counted)) {
+                unroll_fully(cfg.blocks[loop.header], *trips);
+                fully_unrolled++;
+                changed = true;
+                continue;
+            }
+            int factor = max_factor;
+            while (factor > 1 && static_cast<std::size_t>(factor) * counted->body_size > max_unrolled_size) {
+                factor /= 2;
+            }
+            if (factor > 1 && unroll_partially(cfg, loop.header, *counted, factor)) {
+                partially_unrolled++;
+                changed = true;
+            }
+        }
+        function->instructions = cfg.linearize();
+        return changed;
+    }
+
+    std::optional<CountedLoop> LoopUnrollingPass::analyze(const BasicBlock &block) const {
+        const auto &instructions = block.instructions;
+        if (instructions.empty() || !std::holds_alternative<IR::Label>(instructions.front())) return std::nullopt;
+        const auto &label = std::get<IR::Label>(instructions.front()).name;
+        // loops made by unrolling or vectorizing are not unrolled again when the function is optimized once more
+        // after inlining
+        for (auto made: {".unrolled", ".remainder", ".vector", ".scalar"}) {
+            if (label.find(made) != std::string::npos) return std::nullopt;
+        }
+        return loops.analyze(block);
+    }
+
+    std::optional<std::int64_t> LoopUnrollingPass::trip_count(const CFG &cfg, const Loop &loop,
+                                                              const CountedLoop &counted) const {
+        auto bound = integer_value(counted.bound);
+        int preheader = cfg.preheader(loop);
+        if (!bound || preheader == -1) return std::nullopt;
+        // the last value the block in front of the loop gives the counter
+        std::optional<std::int64_t> start;
+        const auto &instructions = cfg.blocks[preheader].instructions;
+        for (auto it = instructions.rbegin(); it != instructions.rend(); ++it) {
+            auto *name = defined_variable(*it);
+            if (!name || *name != counted.counter) continue;
+            if (auto *copy = std::get_if<IR::Copy>(&*it)) start = integer_value(copy->source);
+            break;
+        }
+        if (!start) return std::nullopt;
+
+        bool wide = loops.is_long(counted.counter);
+        auto value = *start;
+        // the body runs once before the first test, and the test is copied along with it
+        for (std::int64_t trips = 1; trips * (counted.body_size + 1) <= max_unrolled_size; trips++) {
+            if (__builtin_add_overflow(value, counted.step, &value) || !fits(value, wide)) return std::nullopt;
+            if (!holds(counted.op, value, *bound)) return trips;
+        }
+        return std::nullopt;
+    }
+
+    void LoopUnrollingPass::unroll_fully(BasicBlock &block, std::int64_t trips) {
+        auto &instructions = block.instructions;
+        std::vector<IR::Instruction> unrolled;
+        unrolled.reserve(1 + trips * (instructions.size() - 2));
+        // the label stays until the cleanup finds it unused, the last test falls through to the exit
+        unrolled.push_back(std::move(instructions.front()));
+        for (std::int64_t trip = 0; trip < trips; trip++) {
+            unrolled.insert(unrolled.end(), instructions.begin() + 1, instructions.end() - 1);
+        }
+        instructions = std::move(unrolled);
+    }
+
+    bool LoopUnrollingPass::unroll_partially(CFG &cfg, int index, const CountedLoop &counted, int factor) {
+        if (index + 1 >= static_cast<int>(cfg.blocks.size())) return false;
+        // factor more iterations pass the test if the first and the last of them do
+        auto test = loops.advanced_test(counted, (factor - 1) * counted.step, false);
+        if (!test) return false;
+
+        auto &instructions = cfg.blocks[index].instructions;
+        const auto &label = std::get<IR::Label>(instructions.front()).name;
+        const auto &original_test = instructions[instructions.size() - 2];
+        const auto &condition = std::get<IR::Variable>(std::get<IR::Binary>(original_test).destination).name;
+        auto unrolled_condition = loops.fresh(condition, ".unrolled", *symbols->at(condition).type);
+        auto unrolled_label = label + ".unrolled";
+        auto remainder_label = label + ".remainder";
+        auto exit = label_of(cfg.blocks[index + 1], label + ".exit");
+        auto body_begin = instructions.begin() + 1;
+        auto body_end = instructions.end() - 2;
+
+        // entered like the loop was, so the body runs at least once either way
+        std::vector<IR::Instruction> code;
+        code.reserve(test->setup.size() + (factor + 1) * counted.body_size + 16);
+        code.push_back(instructions.front());
+        std::ranges::move(test->setup, std::back_inserter(code));
+        test->emit(counted, unrolled_condition, code);
+        code.emplace_back(IR::JumpIfZero(IR::Variable(unrolled_condition), remainder_label));
+        code.emplace_back(IR::Label(unrolled_label));
+        for (int copy = 0; copy < factor; copy++) {
+            code.insert(code.end(), body_begin, body_end);
+        }
+        test->emit(counted, unrolled_condition, code);
+        code.emplace_back(IR::JumpIfNotZero(IR::Variable(unrolled_condition), unrolled_label));
+        // the test of the last copy, which the remainder needs to have passed
+        code.push_back(original_test);
+        code.emplace_back(IR::JumpIfZero(IR::Variable(condition), exit));
+        code.emplace_back(IR::Label(remainder_label));
+        code.insert(code.end(), body_begin, body_end);
+        code.push_back(original_test);
+        code.emplace_back(IR::JumpIfNotZero(IR::Variable(condition), remainder_label));
+        instructions = std::move(code);
+        return true;
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef LOOPUNROLLINGPASS_H
+#define LOOPUNROLLINGPASS_H
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "CFG.h"
+#include "CountedLoopAnalysis.h"
+#include "../IR.h"
+
+// unrolls the counted loops CountedLoopAnalysis finds, except the ones LoopVectorizationPass made
+//
+// with a known start and bound the whole trip is simulated and the loop replaced by that many copies of its body,
+// otherwise the body is copied factor times into a loop that runs while factor more iterations are certain to pass
+// the test, followed by the original loop for the rest, copies of the test inside the unrolled body are left out
+//
+// everything stays within max_unrolled_size instructions, the cleanup afterward folds the copies together
+
+namespace optimization {
+    class LoopUnrollingPass {
+    public:
+        LoopUnrollingPass(IR::Function *function, std::unordered_map<std::string, Symbol> *symbols)
+            : function(function), symbols(symbols), loops(*function, symbols) {
+        }
+
+        // true if any loop was unrolled
+        bool run();
+
+        int fully_unrolled = 0;
+        int partially_unrolled = 0;
+
+    private:
+        // instructions the copies of one loop body may add up to
+        static constexpr std::size_t max_unrolled_size = 64;
+        static constexpr int max_factor = 4;
+
+        std::optional<CountedLoop> analyze(const BasicBlock &block) const;
+        // number of times the body runs, if the counter's start value is known and the trip is short enough
+        std::optional<std::int64_t> trip_count(const CFG &cfg, const Loop &loop, const CountedLoop &counted) const;
+        static void unroll_fully(BasicBlock &block, std::int64_t trips);
+        // false if the limit of the unrolled loop cannot be computed without overflowing
+        bool unroll_partially(CFG &cfg, int index, const CountedLoop &counted, int factor);
+
+        IR::Function *function;
+        std::unordered_map<std::string, Symbol> *symbols;
+        CountedLoopAnalysis loops;
+    };
+}
+
+#endif //LOOPUNROLLINGPASS_H
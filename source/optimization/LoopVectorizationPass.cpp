@@ -0,0 +1,598 @@
+#include "LoopVectorizationPass.h"
+
+#include <algorithm>
+#include <initializer_list>
+#include <span>
+#include <string_view>
+#include <unordered_set>
+
+#include "ConstantFoldingPass.h"
+#include "Operands.h"
+#include "../overloaded.h"
+
+namespace optimization {
+    namespace {
+        std::optional<std::int64_t> integer_value(const IR::Value &value) {
+            auto *constant = std::get_if<IR::Constant>(&value);
+            if (!constant) return std::nullopt;
+            return std::visit(overloaded{
+                                  [](const AST::ConstDouble &) -> std::optional<std::int64_t> { return std::nullopt; },
+                                  [](const auto &c) -> std::optional<std::int64_t> {
+                                      return static_cast<std::int64_t>(c.value);
+                                  }
+                              }, constant->constant);
+        }
+
+        // the label a block starts with, one named name is added if it has none
+        std::string label_of(BasicBlock &block, const std::string &name) {
+            auto &instructions = block.instructions;
+            if (!instructions.empty()) {
+                if (auto *label = std::get_if<IR::Label>(&instructions.front())) return label->name;
+            }
+            instructions.insert(instructions.begin(), IR::Label(name));
+            return name;
+        }
+
+        // loops made by vectorizing or unrolling are left alone when the function is optimized once more after
+        // inlining
+        bool made_by_pass(const std::string &label) {
+            return std::ranges::any_of(std::initializer_list<std::string_view>{
+                                           ".vector", ".scalar", ".unrolled", ".remainder"
+                                       }, [&](std::string_view made) { return label.find(made) != std::string::npos; });
+        }
+
+        bool is_integer(const AST::Type &type) {
+            return std::holds_alternative<AST::IntType>(type) || std::holds_alternative<AST::UIntType>(type) ||
+                   std::holds_alternative<AST::LongType>(type) || std::holds_alternative<AST::ULongType>(type) ||
+                   std::holds_alternative<AST::CharType>(type) || std::holds_alternative<AST::UCharType>(type) ||
+                   std::holds_alternative<AST::SignedCharType>(type);
+        }
+
+        std::int64_t size_of(const AST::Const &constant) {
+            return std::visit(overloaded{
+                                  [](const AST::ConstChar &) -> std::int64_t { return 1; },
+                                  [](const AST::ConstUChar &) -> std::int64_t { return 1; },
+                                  [](const AST::ConstInt &) -> std::int64_t { return 4; },
+                                  [](const AST::ConstUInt &) -> std::int64_t { return 4; },
+                                  [](const auto &) -> std::int64_t { return 8; }
+                              }, constant);
+        }
+
+        // the elements of vector variables, integers of any signedness are added and stored the same way
+        AST::Type element_type(std::int64_t size, bool floating) {
+            if (floating) return AST::DoubleType();
+            if (size == 1) return AST::CharType();
+            if (size == 4) return AST::IntType();
+            return AST::LongType();
+        }
+
+        // the operation that combines the elements of a reduction, the total is subtracted once at the end
+        IR::Binary::Operator combining(IR::Binary::Operator op) {
+            return op == IR::Binary::Operator::SUBTRACT ? IR::Binary::Operator::ADD : op;
+        }
+
+        bool same_value(const IR::Value &lhs, const IR::Value &rhs) {
+            auto *left = std::get_if<IR::Constant>(&lhs);
+            auto *right = std::get_if<IR::Constant>(&rhs);
+            if (left || right) return left && right && same_constant(left->constant, right->constant);
+            return std::get<IR::Variable>(lhs).name == std::get<IR::Variable>(rhs).name;
+        }
+    }
+
+    bool LoopVectorizationPass::run() {
+        CFG cfg(std::move(function->instructions));
+        cfg.compute_dominators();
+        cfg.compute_loops();
+
+        // like unrolling, vectorizing a loop only adds a label to the block after it
+        bool changed = false;
+        for (const auto &loop: cfg.loops) {
+            if (loop.blocks.size() != 1) continue;
+            const auto &block = cfg.blocks[loop.header];
+            if (block.instructions.empty() || !std::holds_alternative<IR::Label>(block.instructions.front()) ||
+                made_by_pass(std::get<IR::Label>(block.instructions.front()).name)) {
+                continue;
+            }
+            auto counted = loops.analyze(block, true);
+            if (!counted || counted->step != 1) continue;
+            auto plan = this->plan(cfg, loop.header, *counted);
+            if (!plan) continue;
+            std::vector<std::pair<const Stream *, const Stream *> > checks;
+            if (!alias_checks(*plan, checks) || checks.size() > max_checks) continue;
+            if (vectorize(cfg, loop.header, *counted, *plan, checks)) {
+                vectorized++;
+                changed = true;
+            }
+        }
+        function->instructions = cfg.linearize();
+        return changed;
+    }
+
+    std::optional<LoopVectorizationPass::Plan> LoopVectorizationPass::plan(const CFG &cfg, int index,
+                                                                           const CountedLoop &counted) const {
+        if (index + 1 >= static_cast<int>(cfg.blocks.size())) return std::nullopt;
+        const auto &instructions = cfg.blocks[index].instructions;
+        auto body = std::span(instructions).subspan(1, counted.body_size);
+
+        Plan plan;
+        std::unordered_map<std::string, int> definitions;
+        std::unordered_map<std::string, int> uses;
+        for (std::size_t i = 0; i < body.size(); i++) {
+            if (auto *name = defined_variable(body[i])) {
+                definitions[*name]++;
+                if (*name == counted.tested) plan.step = i;
+                if (*name == counted.counter) plan.copy = i;
+            }
+            for_each_use(body[i], [&](const IR::Value &value) {
+                if (auto *variable = std::get_if<IR::Variable>(&value)) uses[variable->name]++;
+            });
+        }
+        plan.affine[counted.counter] = {0, loops.is_long(counted.counter)};
+        auto type_of = [&](const std::string &name) -> const AST::Type & { return *symbols->at(name).type; };
+        auto name_of = [](const IR::Value &value) -> const std::string * {
+            auto *variable = std::get_if<IR::Variable>(&value);
+            return variable ? &variable->name : nullptr;
+        };
+        // all elements have the same size
+        auto sized = [&](std::int64_t size) {
+            if (plan.element_size == 0) plan.element_size = size;
+            return plan.element_size == size;
+        };
+        // written before the loop and not by it, or computed from such values in the body
+        auto is_invariant = [&](const IR::Value &value) {
+            auto *name = name_of(value);
+            if (!name) return true;
+            if (definitions.contains(*name)) return plan.invariant.contains(*name);
+            return loops.is_unaliased_local(*name);
+        };
+        auto affine_of = [&](const IR::Value &value) -> const Plan::Affine * {
+            auto *name = name_of(value);
+            auto found = name ? plan.affine.find(*name) : plan.affine.end();
+            return found == plan.affine.end() ? nullptr : &found->second;
+        };
+        auto vector_of = [&](const IR::Value &value) -> const AST::Type * {
+            auto *name = name_of(value);
+            auto found = name ? plan.vectors.find(*name) : plan.vectors.end();
+            return found == plan.vectors.end() ? nullptr : &*found->second;
+        };
+        auto stream_of = [&](const IR::Value &value) -> const Stream * {
+            auto *name = name_of(value);
+            auto found = name ? plan.pointers.find(*name) : plan.pointers.end();
+            return found == plan.pointers.end() ? nullptr : &found->second;
+        };
+        auto object_of = [&](const std::string &pointer) {
+            if (auto found = plan.invariant.find(pointer); found != plan.invariant.end()) {
+                auto *get_address = std::get_if<IR::GetAddress>(&body[found->second]);
+                if (get_address && name_of(get_address->source)) return "&" + *name_of(get_address->source);
+            }
+            return pointer;
+        };
+        auto count = [](const std::unordered_map<std::string, int> &counts, const std::string &name) {
+            auto found = counts.find(name);
+            return found == counts.end() ? 0 : found->second;
+        };
+        // the accumulator of a reduction, read only by the update
+        auto reduced = [&](const IR::Value &value) {
+            auto *name = name_of(value);
+            return name && *name != counted.counter && *name != counted.tested && count(definitions, *name) == 1 &&
+                   count(uses, *name) == 1 && loops.is_unaliased_local(*name) && is_integer(type_of(*name));
+        };
+
+        bool stores = false;
+        for (std::size_t i = 0; i < body.size(); i++) {
+            if (i == plan.step || i == plan.copy ||
+                std::ranges::find(plan.skipped, i) != plan.skipped.end()) {
+                continue;
+            }
+            const auto &instruction = body[i];
+            auto *name = defined_variable(instruction);
+            if (name && (count(definitions, *name) != 1 || !loops.is_unaliased_local(*name))) return std::nullopt;
+
+            bool invariant = name && !std::holds_alternative<IR::Load>(instruction) &&
+                             !std::holds_alternative<IR::Call>(instruction) &&
+                             !std::holds_alternative<IR::CopyToOffset>(instruction);
+            for_each_use(instruction, [&](const IR::Value &value) { invariant &= is_invariant(value); });
+            if (invariant) {
+                plan.invariant[*name] = i;
+                continue;
+            }
+            // only invariants follow the step, nothing sees the counter advanced
+            if (i > plan.step) return std::nullopt;
+
+            bool accepted = std::visit(overloaded{
+                                           [&](const IR::Copy &ins) {
+                                               if (auto *affine = affine_of(ins.source)) {
+                                                   plan.affine[*name] = *affine;
+                                               } else if (auto *vector = vector_of(ins.source)) {
+                                                   plan.vectors[*name] = *vector;
+                                               } else {
+                                                   return false;
+                                               }
+                                               return true;
+                                           },
+                                           [&](const IR::SignExtend &ins) {
+                                               auto *affine = affine_of(ins.source);
+                                               if (affine && !affine->wide) {
+                                                   plan.affine[*name] = {affine->offset, true};
+                                                   return true;
+                                               }
+                                               auto *vector = vector_of(ins.source);
+                                               if (!vector || !is_integer(*vector)) return false;
+                                               plan.vectors[*name] = type_of(*name);
+                                               return true;
+                                           },
+                                           [&](const IR::ZeroExtend &ins) {
+                                               auto *vector = vector_of(ins.source);
+                                               if (!vector || !is_integer(*vector)) return false;
+                                               plan.vectors[*name] = type_of(*name);
+                                               return true;
+                                           },
+                                           [&](const IR::Truncate &ins) {
+                                               auto *vector = vector_of(ins.source);
+                                               const auto &type = type_of(*name);
+                                               if (!vector || !is_integer(*vector) || !is_integer(type) ||
+                                                   static_cast<std::int64_t>(bytes_for_type(type)) <
+                                                   plan.element_size) {
+                                                   return false;
+                                               }
+                                               plan.vectors[*name] = type;
+                                               return true;
+                                           },
+                                           [&](const IR::AddPtr &ins) {
+                                               auto *base = name_of(ins.ptr);
+                                               auto *affine = affine_of(ins.index);
+                                               auto constant = integer_value(ins.index);
+                                               if (base && is_invariant(ins.ptr) && affine && affine->wide) {
+                                                   plan.pointers[*name] = {
+                                                       ins.ptr, object_of(*base), affine->offset * ins.scale, ins.scale,
+                                                       false
+                                                   };
+                                                   return true;
+                                               }
+                                               auto *stream = stream_of(ins.ptr);
+                                               if (!stream || !constant) return false;
+                                               auto moved = *stream;
+                                               moved.offset += *constant * ins.scale;
+                                               plan.pointers[*name] = moved;
+                                               return true;
+                                           },
+                                           [&](const IR::Load &ins) {
+                                               auto *stream = stream_of(ins.source_ptr);
+                                               const auto &type = type_of(*name);
+                                               if (!stream || (!is_integer(type) &&
+                                                               !std::holds_alternative<AST::DoubleType>(type) &&
+                                                               !std::holds_alternative<AST::PointerType>(type)) ||
+                                                   static_cast<std::int64_t>(bytes_for_type(type)) != stream->stride ||
+                                                   !sized(stream->stride)) {
+                                                   return false;
+                                               }
+                                               plan.vectors[*name] = type;
+                                               plan.streams.push_back(*stream);
+                                               return true;
+                                           },
+                                           [&](const IR::Store &ins) {
+                                               auto *stream = stream_of(ins.destination_ptr);
+                                               if (!stream || !sized(stream->stride)) return false;
+                                               std::int64_t size;
+                                               if (auto *vector = vector_of(ins.source)) {
+                                                   size = static_cast<std::int64_t>(bytes_for_type(*vector));
+                                               } else if (auto *constant = std::get_if<IR::Constant>(&ins.source)) {
+                                                   size = size_of(constant->constant);
+                                               } else if (is_invariant(ins.source)) {
+                                                   size = static_cast<std::int64_t>(bytes_for_type(
+                                                       type_of(*name_of(ins.source))));
+                                               } else {
+                                                   return false;
+                                               }
+                                               if (size != stream->stride) return false;
+                                               plan.streams.push_back(*stream);
+                                               plan.streams.back().store = true;
+                                               stores = true;
+                                               return true;
+                                           },
+                                           [&](const IR::Binary &ins) {
+                                               using Operator = IR::Binary::Operator;
+                                               // counter + c, counter - c and c + counter
+                                               auto *affine = affine_of(ins.left_source);
+                                               auto constant = integer_value(ins.right_source);
+                                               if (!affine && ins.op == Operator::ADD) {
+                                                   affine = affine_of(ins.right_source);
+                                                   constant = integer_value(ins.left_source);
+                                               }
+                                               if (affine && constant && affine->wide == loops.is_long(*name) &&
+                                                   (ins.op == Operator::ADD || ins.op == Operator::SUBTRACT)) {
+                                                   auto offset = affine->offset + (ins.op == Operator::ADD
+                                                                                       ? *constant
+                                                                                       : -*constant);
+                                                   constexpr std::int64_t max_offset = std::int64_t{1} << 20;
+                                                   if (offset > max_offset || offset < -max_offset) return false;
+                                                   plan.affine[*name] = {offset, affine->wide};
+                                                   return true;
+                                               }
+                                               const auto &type = type_of(*name);
+                                               bool floating = std::holds_alternative<AST::DoubleType>(type);
+                                               bool bitwise = ins.op == Operator::BITWISE_AND ||
+                                                              ins.op == Operator::BITWISE_OR ||
+                                                              ins.op == Operator::BITWISE_XOR;
+                                               bool additive = ins.op == Operator::ADD ||
+                                                               ins.op == Operator::SUBTRACT;
+                                               if (floating
+                                                       ? !additive && ins.op != Operator::MULTIPLY &&
+                                                         ins.op != Operator::DIVIDE
+                                                       : !is_integer(type) || (!additive && !bitwise)) {
+                                                   return false;
+                                               }
+                                               // s = s op x, or t = s op x followed by s = t
+                                               auto reduction = [&](const IR::Value &scalar, const IR::Value &value) {
+                                                   if (floating || !reduced(scalar) ||
+                                                       (!vector_of(value) && !is_invariant(value))) {
+                                                       return false;
+                                                   }
+                                                   const auto &accumulator = *name_of(scalar);
+                                                   if (*name != accumulator) {
+                                                       auto *copy = i + 1 < plan.step
+                                                                        ? std::get_if<IR::Copy>(&body[i + 1])
+                                                                        : nullptr;
+                                                       if (!copy || !is_variable(copy->source, *name) ||
+                                                           !is_variable(copy->destination, accumulator) ||
+                                                           count(uses, *name) != 1) {
+                                                           return false;
+                                                       }
+                                                       plan.skipped.push_back(i + 1);
+                                                   }
+                                                   if (!sized(static_cast<std::int64_t>(bytes_for_type(type)))) {
+                                                       return false;
+                                                   }
+                                                   plan.reductions[i] = {accumulator, ins.op};
+                                                   return true;
+                                               };
+                                               if (reduction(ins.left_source, ins.right_source) ||
+                                                   (ins.op != Operator::SUBTRACT &&
+                                                    reduction(ins.right_source, ins.left_source))) {
+                                                   return true;
+                                               }
+                                               // the low bits of a sum, a difference or a bitwise operation only
+                                               // depend on the low bits of its operands
+                                               auto operand = [&](const IR::Value &value) {
+                                                   if (is_invariant(value)) return true;
+                                                   auto *vector = vector_of(value);
+                                                   return vector && vector->index() == type.index();
+                                               };
+                                               if ((!vector_of(ins.left_source) && !vector_of(ins.right_source)) ||
+                                                   !operand(ins.left_source) || !operand(ins.right_source) ||
+                                                   (floating
+                                                        ? plan.element_size != 8
+                                                        : static_cast<std::int64_t>(bytes_for_type(type)) <
+                                                          plan.element_size)) {
+                                                   return false;
+                                               }
+                                               plan.vectors[*name] = type;
+                                               return true;
+                                           },
+                                           [](const auto &) { return false; }
+                                       }, instruction);
+            if (!accepted) return std::nullopt;
+        }
+        if ((!stores && plan.reductions.empty()) || plan.element_size == 0) return std::nullopt;
+
+        // the vector loop leaves the values of the body behind as they were for its first element, only the counter,
+        // the reduced scalars and the invariants come out of it as the loop would have left them
+        std::unordered_set<std::string> inside;
+        for (const auto &[variable, count]: definitions) {
+            if (variable == counted.counter || variable == counted.tested || plan.invariant.contains(variable)) {
+                continue;
+            }
+            if (std::ranges::any_of(plan.reductions, [&](const auto &entry) {
+                return entry.second.scalar == variable;
+            })) {
+                continue;
+            }
+            inside.insert(variable);
+        }
+        for (int other = 0; other < static_cast<int>(cfg.blocks.size()); other++) {
+            if (other == index) continue;
+            for (const auto &instruction: cfg.blocks[other].instructions) {
+                auto *name = defined_variable(instruction);
+                bool seen = name && inside.contains(*name);
+                for_each_use(instruction, [&](const IR::Value &value) {
+                    auto *variable = name_of(value);
+                    seen |= variable && inside.contains(*variable);
+                });
+                if (seen) return std::nullopt;
+            }
+        }
+        return plan;
+    }
+
+    bool LoopVectorizationPass::alias_checks(const Plan &plan,
+                                             std::vector<std::pair<const Stream *, const Stream *> > &checks) {
+        const auto &streams = plan.streams;
+        for (std::size_t i = 0; i < streams.size(); i++) {
+            for (std::size_t j = i + 1; j < streams.size(); j++) {
+                const auto &a = streams[i];
+                const auto &b = streams[j];
+                if (!a.store && !b.store) continue;
+                // the same pointer, each iteration reads what it writes itself
+                if (a.object == b.object) {
+                    if (a.offset != b.offset) return false;
+                    continue;
+                }
+                if (a.object.starts_with('&') && b.object.starts_with('&')) continue;
+                bool checked = std::ranges::any_of(checks, [&](const auto &check) {
+                    return check.first->object == a.object && check.second->object == b.object &&
+                           check.first->offset - check.second->offset == a.offset - b.offset;
+                });
+                if (!checked) checks.emplace_back(&a, &b);
+            }
+        }
+        return true;
+    }
+
+    bool LoopVectorizationPass::vectorize(CFG &cfg, int index, const CountedLoop &counted, const Plan &plan,
+                                          const std::vector<std::pair<const Stream *, const Stream *> > &checks) {
+        using Operator = IR::Binary::Operator;
+        auto lanes = vector_size / plan.element_size;
+        // the elements of a vector iteration all pass the test if the last one does
+        auto test = loops.advanced_test(counted, lanes - 1, true);
+        if (!test) return false;
+
+        auto &instructions = cfg.blocks[index].instructions;
+        const auto &label = std::get<IR::Label>(instructions.front()).name;
+        auto body = std::span(instructions).subspan(1, counted.body_size);
+        const auto &original_test = instructions[instructions.size() - 2];
+        const auto &condition = std::get<IR::Variable>(std::get<IR::Binary>(original_test).destination).name;
+        auto vector_condition = loops.fresh(condition, ".vector", *symbols->at(condition).type);
+        auto vector_label = label + ".vector";
+        auto scalar_label = label + ".scalar";
+        auto exit = label_of(cfg.blocks[index + 1], label + ".exit");
+
+        // entered like the loop was, so the body runs at least once either way
+        std::vector<IR::Instruction> code;
+        code.push_back(instructions.front());
+        for (std::size_t i = 0; i < body.size(); i++) {
+            auto *name = defined_variable(body[i]);
+            if (name && plan.invariant.contains(*name)) code.push_back(body[i]);
+        }
+        // the elements one vector iteration accesses through two pointers do not overlap if their addresses are 16
+        // bytes or more apart
+        for (const auto &[a, b]: checks) {
+            IR::Variable distance(loops.fresh(label, ".distance", AST::LongType()));
+            IR::Variable after(loops.fresh(label, ".after", AST::IntType()));
+            IR::Variable before(loops.fresh(label, ".before", AST::IntType()));
+            code.emplace_back(IR::Binary(Operator::SUBTRACT, a->base, b->base, distance));
+            if (a->offset != b->offset) {
+                code.emplace_back(IR::Binary(Operator::ADD, distance,
+                                             IR::Constant(AST::ConstLong(a->offset - b->offset)), distance));
+            }
+            code.emplace_back(IR::Binary(Operator::GREATER_EQUAL, distance, IR::Constant(AST::ConstLong(vector_size)),
+                                         after));
+            code.emplace_back(IR::Binary(Operator::LESS_EQUAL, distance, IR::Constant(AST::ConstLong(-vector_size)),
+                                         before));
+            code.emplace_back(IR::Binary(Operator::BITWISE_OR, after, before, after));
+            code.emplace_back(IR::JumpIfZero(after, scalar_label));
+        }
+        std::ranges::move(test->setup, std::back_inserter(code));
+        if (test->guard) code.emplace_back(IR::JumpIfZero(*test->guard, scalar_label));
+        test->emit(counted, vector_condition, code);
+        code.emplace_back(IR::JumpIfZero(IR::Variable(vector_condition), scalar_label));
+
+        auto new_vector = [&](const std::string &name, std::string_view suffix, bool floating) {
+            auto vector = loops.fresh(name, suffix, element_type(plan.element_size, floating));
+            function->vectors.insert(vector);
+            return vector;
+        };
+        // invariant operands get a vector of copies in front of the loop
+        std::vector<std::pair<IR::Value, std::string> > broadcasts;
+        auto broadcast = [&](const IR::Value &value) -> IR::Value {
+            for (const auto &[source, vector]: broadcasts) {
+                if (same_value(source, value)) return IR::Variable(vector);
+            }
+            auto *variable = std::get_if<IR::Variable>(&value);
+            bool floating = variable
+                                ? std::holds_alternative<AST::DoubleType>(*symbols->at(variable->name).type)
+                                : std::holds_alternative<AST::ConstDouble>(std::get<IR::Constant>(value).constant);
+            auto element = element_type(plan.element_size, floating);
+            IR::Value source = value;
+            if (!variable) {
+                source = IR::Constant(*convert_constant(std::get<IR::Constant>(value).constant, element));
+            } else if (static_cast<std::int64_t>(bytes_for_type(*symbols->at(variable->name).type)) >
+                       plan.element_size) {
+                // only the low bits of a wider integer end up in the elements
+                source = IR::Variable(loops.fresh(variable->name, ".element", element));
+                code.emplace_back(IR::Truncate(value, source));
+            }
+            auto vector = new_vector(variable ? variable->name : label, ".broadcast", floating);
+            code.emplace_back(IR::Broadcast(source, IR::Variable(vector)));
+            broadcasts.emplace_back(value, vector);
+            return IR::Variable(vector);
+        };
+        std::unordered_map<std::string, std::string> renamed;
+        auto vector_variable = [&](const std::string &name) -> IR::Value {
+            auto [found, inserted] = renamed.try_emplace(name);
+            if (inserted) {
+                bool floating = std::holds_alternative<AST::DoubleType>(*plan.vectors.at(name));
+                found->second = new_vector(name, ".vector", floating);
+            }
+            return IR::Variable(found->second);
+        };
+        auto operand = [&](const IR::Value &value) -> IR::Value {
+            auto *variable = std::get_if<IR::Variable>(&value);
+            if (variable && plan.vectors.contains(variable->name)) return vector_variable(variable->name);
+            return broadcast(value);
+        };
+        // every element starts at the identity of the operation
+        std::unordered_map<std::size_t, std::string> accumulators;
+        for (const auto &[position, reduction]: plan.reductions) {
+            auto element = element_type(plan.element_size, false);
+            auto identity = convert_constant(AST::ConstInt(reduction.op == Operator::BITWISE_AND ? -1 : 0), element);
+            accumulators[position] = new_vector(reduction.scalar, ".vector", false);
+            code.emplace_back(IR::Broadcast(IR::Constant(*identity), IR::Variable(accumulators[position])));
+        }
+
+        // the vector loop, scalars that follow the counter keep their value for the first element
+        std::vector<IR::Instruction> loop;
+        loop.emplace_back(IR::Label(vector_label));
+        for (std::size_t i = 0; i < body.size(); i++) {
+            const auto &instruction = body[i];
+            if (i == plan.step || i == plan.copy || std::ranges::find(plan.skipped, i) != plan.skipped.end()) {
+                continue;
+            }
+            if (auto found = plan.reductions.find(i); found != plan.reductions.end()) {
+                const auto &binary = std::get<IR::Binary>(instruction);
+                const auto &value = is_variable(binary.left_source, found->second.scalar)
+                                        ? binary.right_source
+                                        : binary.left_source;
+                IR::Variable accumulator(accumulators.at(i));
+                loop.emplace_back(IR::Binary(combining(found->second.op), accumulator, operand(value), accumulator));
+                continue;
+            }
+            auto *name = defined_variable(instruction);
+            if (name && plan.invariant.contains(*name)) continue;
+            if (name && (plan.affine.contains(*name) || plan.pointers.contains(*name))) {
+                loop.push_back(instruction);
+                continue;
+            }
+            if (auto *load = std::get_if<IR::Load>(&instruction)) {
+                loop.emplace_back(IR::Load(load->source_ptr, vector_variable(*name)));
+            } else if (auto *store = std::get_if<IR::Store>(&instruction)) {
+                loop.emplace_back(IR::Store(operand(store->source), store->destination_ptr));
+            } else if (auto *binary = std::get_if<IR::Binary>(&instruction)) {
+                loop.emplace_back(IR::Binary(binary->op, operand(binary->left_source), operand(binary->right_source),
+                                             vector_variable(*name)));
+            } else {
+                // copies and conversions, the elements stay as they are
+                const IR::Value *source = nullptr;
+                for_each_use(instruction, [&](const IR::Value &value) { source = &value; });
+                loop.emplace_back(IR::Copy(operand(*source), vector_variable(*name)));
+            }
+        }
+        auto step = std::get<IR::Binary>(body[plan.step]);
+        auto scaled = *integer_value(step.right_source) * lanes;
+        step.right_source = loops.is_long(counted.counter)
+                                ? IR::Constant(AST::ConstLong(scaled))
+                                : IR::Constant(AST::ConstInt(static_cast<int>(scaled)));
+        loop.emplace_back(std::move(step));
+        if (plan.copy != plan.step) loop.push_back(body[plan.copy]);
+        test->emit(counted, vector_condition, loop);
+        loop.emplace_back(IR::JumpIfNotZero(IR::Variable(vector_condition), vector_label));
+        // the elements are combined into the scalars the original loop continues with
+        for (const auto &[position, reduction]: plan.reductions) {
+            IR::Variable total(loops.fresh(reduction.scalar, ".total", *symbols->at(reduction.scalar).type));
+            loop.emplace_back(IR::Reduce(combining(reduction.op), IR::Variable(accumulators.at(position)), total));
+            loop.emplace_back(IR::Binary(reduction.op, IR::Variable(reduction.scalar), total,
+                                         IR::Variable(reduction.scalar)));
+        }
+        // the test of the last element, which the rest has to have passed
+        loop.push_back(original_test);
+        loop.emplace_back(IR::JumpIfZero(IR::Variable(condition), exit));
+        loop.emplace_back(IR::Label(scalar_label));
+        loop.insert(loop.end(), body.begin(), body.end());
+        loop.push_back(original_test);
+        loop.emplace_back(IR::JumpIfNotZero(IR::Variable(condition), scalar_label));
+
+        code.reserve(code.size() + loop.size());
+        std::ranges::move(loop, std::back_inserter(code));
+        instructions = std::move(code);
+        return true;
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef LOOPVECTORIZATIONPASS_H
+#define LOOPVECTORIZATIONPASS_H
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CFG.h"
+#include "CountedLoopAnalysis.h"
+#include "../IR.h"
+
+// runs the counted loops of CountedLoopAnalysis that count up by one over arrays 16 bytes at a time, before they are
+// unrolled
+//
+// the body may load and store elements a constant distance from the counter through pointers it does not change,
+// combine them element-wise (double + - * /, integer + - & | ^, narrower integers in the low bits of wider ones) and
+// fold them into an integer sum, and, or or xor; every value has to come in elements of the same size, which picks
+// how many iterations one vector iteration does
+//
+// the vector loop runs while that many iterations are certain to pass the test, the original loop does the rest or
+// all of it when pointers that are not known to point into different objects turn out closer than 16 bytes apart;
+// floating point sums are left alone since adding in another order changes the result
+
+namespace optimization {
+    class LoopVectorizationPass {
+    public:
+        LoopVectorizationPass(IR::Function *function, std::unordered_map<std::string, Symbol> *symbols)
+            : function(function), symbols(symbols), loops(*function, symbols) {
+        }
+
+        // true if any loop was vectorized
+        bool run();
+
+        int vectorized = 0;
+
+    private:
+        // counter * stride + offset bytes from base, object is &name for the address of a named object and the name of
+        // the pointer otherwise
+        struct Stream {
+            IR::Value base;
+            std::string object;
+            std::int64_t offset;
+            std::int64_t stride;
+            bool store;
+        };
+
+        // scalar op= value every iteration
+        struct Reduction {
+            std::string scalar;
+            IR::Binary::Operator op;
+        };
+
+        // what the body computes, by the variables it defines
+        struct Plan {
+            // counter + offset, in long if wide
+            struct Affine {
+                std::int64_t offset;
+                bool wide;
+            };
+
+            std::unordered_map<std::string, Affine> affine;
+            // the same every iteration, computed once in front of the vector loop
+            std::unordered_map<std::string, std::size_t> invariant;
+            std::unordered_map<std::string, Stream> pointers;
+            // type of the scalar value each element stands for, wider than the elements for integers whose low bits
+            // are all that is needed
+            std::unordered_map<std::string, AST::TypeHandle> vectors;
+            std::vector<Stream> streams;
+            // by the position of the instruction updating it
+            std::map<std::size_t, Reduction> reductions;
+            // copies into a reduced scalar, left out of the vector loop
+            std::vector<std::size_t> skipped;
+            // positions of the step and of the copy of the tested value into the counter, the same if it is tested
+            // itself
+            std::size_t step = 0;
+            std::size_t copy = 0;
+            std::int64_t element_size = 0;
+        };
+
+        std::optional<Plan> plan(const CFG &cfg, int index, const CountedLoop &counted) const;
+        // pairs of streams to check for overlap at run time, false if some pair overlaps for certain
+        static bool alias_checks(const Plan &plan, std::vector<std::pair<const Stream *, const Stream *> > &checks);
+        // false if the limit of the vector loop cannot be computed
+        bool vectorize(CFG &cfg, int index, const CountedLoop &counted, const Plan &plan,
+                       const std::vector<std::pair<const Stream *, const Stream *> > &checks);
+
+        // checks more than this many pairs of pointers cost more than the loop saves on short trips
+        static constexpr std::size_t max_checks = 6;
+        static constexpr std::int64_t vector_size = 16;
+
+        IR::Function *function;
+        std::unordered_map<std::string, Symbol> *symbols;
+        CountedLoopAnalysis loops;
+    };
+}
+
+#endif //LOOPVECTORIZATIONPASS_H
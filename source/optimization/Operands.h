@@ -0,0 +1,121 @@
+#ifndef OPERANDS_H
+#define OPERANDS_H
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "CFG.h"
+#include "../IR.h"
+#include "../overloaded.h"
+
+// what an ir instruction reads and writes, shared by the dataflow passes
+
+namespace optimization {
+    inline bool is_variable(const IR::Value &value, const std::string &name) {
+        auto *variable = std::get_if<IR::Variable>(&value);
+        return variable && variable->name == name;
+    }
+
+    // locals, parameters and temporaries, which nothing outside the function can reach unless their address is taken;
+    // parameters are entered without attributes of their own, so anything not static, constant or a function counts
+    inline bool is_local(const std::string &name, const std::unordered_map<std::string, Symbol> &symbols) {
+        auto symbol = symbols.find(name);
+        if (symbol == symbols.end() || std::holds_alternative<AST::FunctionType>(*symbol->second.type)) return false;
+        return !std::holds_alternative<StaticAttributes>(symbol->second.attributes) &&
+               !std::holds_alternative<ConstantAttributes>(symbol->second.attributes);
+    }
+
+    // names GetAddress takes the address of, stores through pointers and calls may change these
+    inline void add_address_taken(const std::vector<IR::Instruction> &instructions,
+                                  std::unordered_set<std::string> &names) {
+        for (const auto &instruction: instructions) {
+            auto *get_address = std::get_if<IR::GetAddress>(&instruction);
+            if (!get_address) continue;
+            if (auto *variable = std::get_if<IR::Variable>(&get_address->source)) {
+                names.insert(variable->name);
+            }
+        }
+    }
+
+    inline std::unordered_set<std::string> address_taken(const std::vector<IR::Instruction> &instructions) {
+        std::unordered_set<std::string> names;
+        add_address_taken(instructions, names);
+        return names;
+    }
+
+    inline std::unordered_set<std::string> address_taken(const CFG &cfg) {
+        std::unordered_set<std::string> names;
+        for (const auto &block: cfg.blocks) {
+            add_address_taken(block.instructions, names);
+        }
+        return names;
+    }
+
+    // variable the instruction writes, nullptr if it writes none (stores through pointers do not count)
+    inline const std::string *defined_variable(const IR::Instruction &instruction) {
+        auto name_of = [](const IR::Value &value) -> const std::string * {
+            if (auto *variable = std::get_if<IR::Variable>(&value)) return &variable->name;
+            return nullptr;
+        };
+        return std::visit(overloaded{
+                              [&](const IR::Call &ins) -> const std::string * {
+                                  return ins.destination ? name_of(*ins.destination) : nullptr;
+                              },
+                              [](const IR::CopyToOffset &ins) { return &ins.destination; },
+                              [](const IR::Return &) -> const std::string * { return nullptr; },
+                              [](const IR::Jump &) -> const std::string * { return nullptr; },
+                              [](const IR::JumpIfZero &) -> const std::string * { return nullptr; },
+                              [](const IR::JumpIfNotZero &) -> const std::string * { return nullptr; },
+                              [](const IR::JumpTable &) -> const std::string * { return nullptr; },
+                              [](const IR::Label &) -> const std::string * { return nullptr; },
+                              [](const IR::Store &) -> const std::string * { return nullptr; },
+                              [&](const auto &ins) { return name_of(ins.destination); }
+                          }, instruction);
+    }
+
+    inline std::string *defined_variable(IR::Instruction &instruction) {
+        return const_cast<std::string *>(defined_variable(std::as_const(instruction)));
+    }
+
+    // calls f with every operand the instruction reads, the address taken by GetAddress is not a read
+    template<typename Instruction, typename F>
+    void for_each_use(Instruction &instruction, F &&f) {
+        std::visit(overloaded{
+                       [&](auto &ins) {
+                           using T = std::decay_t<decltype(ins)>;
+                           if constexpr (std::is_same_v<T, IR::Return>) {
+                               if (ins.value) f(*ins.value);
+                           } else if constexpr (std::is_same_v<T, IR::Binary>) {
+                               f(ins.left_source);
+                               f(ins.right_source);
+                           } else if constexpr (std::is_same_v<T, IR::JumpIfZero> || std::is_same_v<T,
+                                                    IR::JumpIfNotZero>) {
+                               f(ins.condition);
+                           } else if constexpr (std::is_same_v<T, IR::JumpTable>) {
+                               f(ins.index);
+                           } else if constexpr (std::is_same_v<T, IR::Call>) {
+                               for (auto &argument: ins.arguments) f(argument);
+                           } else if constexpr (std::is_same_v<T, IR::Load>) {
+                               f(ins.source_ptr);
+                           } else if constexpr (std::is_same_v<T, IR::Store>) {
+                               f(ins.source);
+                               f(ins.destination_ptr);
+                           } else if constexpr (std::is_same_v<T, IR::AddPtr>) {
+                               f(ins.ptr);
+                               f(ins.index);
+                           } else if constexpr (std::is_same_v<T, IR::Phi>) {
+                               for (auto &argument: ins.arguments) f(argument);
+                           } else if constexpr (std::is_same_v<T, IR::Jump> || std::is_same_v<T, IR::Label> ||
+                                                std::is_same_v<T, IR::GetAddress>) {
+                           } else {
+                               f(ins.source);
+                           }
+                       }
+                   }, instruction);
+    }
+}
+
+#endif //OPERANDS_H
@@ -0,0 +1,126 @@
+#include "Optimizer.h"
+
+#include "ConstantFoldingPass.h"
+#include "CopyPropagationPass.h"
+#include "DeadStoreEliminationPass.h"
+#include "GlobalValueNumberingPass.h"
+#include "InductionVariablePass.h"
+#include "InliningPass.h"
+#include "LoopInvariantCodeMotionPass.h"
+#include "LoopRotationPass.h"
+#include "LoopUnrollingPass.h"
+#include "LoopVectorizationPass.h"
+#include "Operands.h"
+#include "SparseConditionalConstantPropagationPass.h"
+#include "SSA.h"
+#include "TailRecursionEliminationPass.h"
+#include "UnreachableCodeEliminationPass.h"
+
+namespace optimization {
+    void Optimizer::run() {
+        for (const auto &item: program->items) {
+            auto *function = std::get_if<IR::Function>(&item);
+            if (function) add_address_taken(function->instructions, address_taken);
+        }
+        if (!options.inline_functions) {
+            for (auto &item: program->items) {
+                if (auto *function = std::get_if<IR::Function>(&item)) {
+                    optimize_function(*function);
+                }
+            }
+            return;
+        }
+        // callees are optimized before they are copied into their callers, the copies get optimized again in
+        // their new context
+        InliningPass inlining(program, symbols, options.inline_threshold, inlining_report);
+        for (auto *function: inlining.bottom_up_order()) {
+            inlining.run(*function);
+            optimize_function(*function);
+        }
+        inlining.remove_unreferenced_functions();
+    }
+
+    void Optimizer::optimize_function(IR::Function &function) {
+        // before the cleanup, which could move the return away from the call
+        if (options.eliminate_tail_recursion) {
+            TailRecursionEliminationPass(&function, symbols).run();
+        }
+        clean_up(function);
+        // on the cleaned up loop tests, the copies of the test get cleaned up in turn
+        if (options.rotate_loops && LoopRotationPass(&function).run()) {
+            clean_up(function);
+        }
+        // before unrolling, which would leave the vector loop fewer iterations to cover
+        if (options.vectorize_loops && LoopVectorizationPass(&function, symbols).run()) {
+            clean_up(function);
+        }
+        // the cleanup folds the copies of the counter into constants and offsets
+        if (options.unroll_loops && LoopUnrollingPass(&function, symbols).run()) {
+            clean_up(function);
+        }
+        // out of ssa leaves copies on the edges for the cleanup to propagate
+        if (optimize_ssa(function)) {
+            clean_up(function);
+        }
+    }
+
+    bool Optimizer::optimize_ssa(IR::Function &function) {
+        if (!options.sparse_conditional_constants && !options.global_value_numbering &&
+            !options.hoist_loop_invariants && !options.reduce_induction_variables) {
+            return false;
+        }
+        CFG cfg(std::move(function.instructions));
+        bool changed = false;
+        if (options.hoist_loop_invariants || options.reduce_induction_variables) {
+            // the preheaders have to exist before the phis are placed
+            cfg.compute_dominators();
+            cfg.compute_loops();
+            changed |= cfg.insert_preheaders();
+        }
+        SSAConstruction construction(&cfg, symbols, &function.vectors);
+        construction.run();
+        if (options.sparse_conditional_constants) {
+            changed |= SparseConditionalConstantPropagationPass(&cfg, symbols, &construction.values).run();
+        }
+        if (options.hoist_loop_invariants) {
+            changed |= LoopInvariantCodeMotionPass(&cfg, symbols, &construction.values, &address_taken).run();
+        }
+        if (options.global_value_numbering) {
+            changed |= GlobalValueNumberingPass(&cfg, symbols, &construction.values).run();
+        }
+        // after numbering, so the same index or base computed twice is one induction variable
+        if (options.reduce_induction_variables &&
+            InductionVariablePass(&cfg, symbols, &construction.values).run()) {
+            changed = true;
+            // the start values and limits of inner loops are often invariant in the loops around them
+            if (options.hoist_loop_invariants) {
+                LoopInvariantCodeMotionPass(&cfg, symbols, &construction.values, &address_taken).run();
+            }
+        }
+        SSADestruction(&cfg, symbols, function.name).run();
+        function.instructions = cfg.linearize();
+        return changed;
+    }
+
+    void Optimizer::clean_up(IR::Function &function) {
+        // each pass exposes work for the others (propagated constants fold, folded branches cut paths
+        // copies had to agree on, propagated copies leave dead stores behind), so they run until none of them
+        // changes anything
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            if (options.fold_constants) {
+                changed |= ConstantFoldingPass(&function, symbols).run();
+            }
+            if (options.eliminate_unreachable_code) {
+                changed |= UnreachableCodeEliminationPass(&function).run();
+            }
+            if (options.propagate_copies) {
+                changed |= CopyPropagationPass(&function, symbols).run();
+            }
+            if (options.eliminate_dead_stores) {
+                changed |= DeadStoreEliminationPass(&function, symbols).run();
+            }
+        }
+    }
+}
@@ -0,0 +1,128 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "InliningPass.h"
+#include "../IR.h"
+
+// which ir optimizations run, -O<level> picks a preset and the individual flags add to it
+
+namespace optimization {
+    enum class RegisterAllocator {
+        // every pseudo gets a stack slot
+        NONE,
+        // fast, for -O1
+        LINEAR_SCAN,
+        GRAPH_COLORING,
+    };
+
+    struct OptimizationOptions {
+        bool fold_constants = false;
+        bool propagate_copies = false;
+        bool eliminate_dead_stores = false;
+        bool eliminate_unreachable_code = false;
+        bool rotate_loops = false;
+        // the rotated ones
+        bool vectorize_loops = false;
+        bool unroll_loops = false;
+        // on ssa form
+        bool sparse_conditional_constants = false;
+        bool global_value_numbering = false;
+        bool hoist_loop_invariants = false;
+        bool reduce_induction_variables = false;
+        bool eliminate_tail_recursion = false;
+        bool inline_functions = false;
+        // how much larger than the call it replaces an inlined body may be, see InliningPass
+        int inline_threshold = 0;
+        // on the asm tree, not counted by any()
+        RegisterAllocator register_allocator = RegisterAllocator::NONE;
+        bool share_stack_slots = false;
+        bool peephole = false;
+        // calls right before a return become jumps
+        bool tail_calls = false;
+
+        static OptimizationOptions for_level(int level) {
+            OptimizationOptions options;
+            options.fold_constants = level >= 1;
+            options.propagate_copies = level >= 1;
+            options.eliminate_dead_stores = level >= 1;
+            options.eliminate_unreachable_code = level >= 1;
+            options.rotate_loops = level >= 1;
+            options.vectorize_loops = level >= 2;
+            options.unroll_loops = level >= 2;
+            options.sparse_conditional_constants = level >= 2;
+            options.global_value_numbering = level >= 2;
+            options.hoist_loop_invariants = level >= 2;
+            options.reduce_induction_variables = level >= 2;
+            options.eliminate_tail_recursion = level >= 1;
+            options.inline_functions = level >= 1;
+            options.inline_threshold = level >= 2 ? 20 : 0;
+            options.register_allocator = level >= 2
+                                             ? RegisterAllocator::GRAPH_COLORING
+                                             : level == 1
+                                                   ? RegisterAllocator::LINEAR_SCAN
+                                                   : RegisterAllocator::NONE;
+            options.share_stack_slots = level >= 1;
+            options.peephole = level >= 1;
+            options.tail_calls = level >= 1;
+            return options;
+        }
+
+        // everything enabled in either
+        void merge(const OptimizationOptions &other) {
+            fold_constants |= other.fold_constants;
+            propagate_copies |= other.propagate_copies;
+            eliminate_dead_stores |= other.eliminate_dead_stores;
+            eliminate_unreachable_code |= other.eliminate_unreachable_code;
+            rotate_loops |= other.rotate_loops;
+            vectorize_loops |= other.vectorize_loops;
+            unroll_loops |= other.unroll_loops;
+            sparse_conditional_constants |= other.sparse_conditional_constants;
+            global_value_numbering |= other.global_value_numbering;
+            hoist_loop_invariants |= other.hoist_loop_invariants;
+            reduce_induction_variables |= other.reduce_induction_variables;
+            eliminate_tail_recursion |= other.eliminate_tail_recursion;
+            inline_functions |= other.inline_functions;
+            inline_threshold = std::max(inline_threshold, other.inline_threshold);
+            share_stack_slots |= other.share_stack_slots;
+            peephole |= other.peephole;
+            tail_calls |= other.tail_calls;
+        }
+
+        bool any() const {
+            return fold_constants || propagate_copies || eliminate_dead_stores || eliminate_unreachable_code ||
+                   rotate_loops || vectorize_loops || unroll_loops || sparse_conditional_constants ||
+                   global_value_numbering || hoist_loop_invariants || reduce_induction_variables ||
+                   eliminate_tail_recursion || inline_functions;
+        }
+    };
+
+    class Optimizer {
+    public:
+        Optimizer(IR::Program *program, std::unordered_map<std::string, Symbol> *symbols,
+                  OptimizationOptions options, InliningReport *inlining_report = nullptr)
+            : program(program), symbols(symbols), options(options), inlining_report(inlining_report) {
+        }
+
+        void run();
+
+    private:
+        void optimize_function(IR::Function &function);
+        // runs the non ssa passes until they stop changing anything
+        void clean_up(IR::Function &function);
+        // true if anything changed
+        bool optimize_ssa(IR::Function &function);
+
+        IR::Program *program;
+        std::unordered_map<std::string, Symbol> *symbols;
+        OptimizationOptions options;
+        // variables whose address is taken somewhere in the program, stores through pointers may change them
+        std::unordered_set<std::string> address_taken;
+        InliningReport *inlining_report;
+    };
+}
+
+#endif //OPTIMIZER_H
@@ -0,0 +1,326 @@
+#include "SSA.h"
+
+#include <algorithm>
+#include <map>
+#include <optional>
+
+#include "Liveness.h"
+#include "Operands.h"
+
+namespace optimization {
+    std::pair<std::size_t, std::size_t> phi_range(const BasicBlock &block) {
+        const auto &instructions = block.instructions;
+        std::size_t first = !instructions.empty() && std::holds_alternative<IR::Label>(instructions.front()) ? 1 : 0;
+        std::size_t last = first;
+        while (last < instructions.size() && std::holds_alternative<IR::Phi>(instructions[last])) {
+            last++;
+        }
+        return {first, last};
+    }
+
+    void SSAConstruction::run() {
+        // a loop back to the first instruction needs somewhere for the phis of the values coming from the caller,
+        // an empty block in front is that edge and disappears again in linearize()
+        if (!cfg->blocks.empty() && !cfg->blocks[CFG::entry].predecessors.empty()) {
+            cfg->blocks.insert(cfg->blocks.begin(), BasicBlock{});
+            cfg->rebuild_edges();
+        }
+        cfg->compute_dominators();
+        cfg->compute_dominance_frontiers();
+        find_candidates();
+        place_phis();
+        rename();
+    }
+
+    void SSAConstruction::find_candidates() {
+        auto aliased = address_taken(*cfg);
+        std::unordered_set<std::string> mentioned;
+        for (const auto &block: cfg->blocks) {
+            for (const auto &instruction: block.instructions) {
+                if (auto *name = defined_variable(instruction)) {
+                    mentioned.insert(*name);
+                }
+                for_each_use(instruction, [&](const IR::Value &value) {
+                    if (auto *variable = std::get_if<IR::Variable>(&value)) {
+                        mentioned.insert(variable->name);
+                    }
+                });
+            }
+        }
+        for (const auto &name: mentioned) {
+            if (aliased.contains(name) || vectors->contains(name) || !is_local(name, *symbols)) continue;
+            if (std::holds_alternative<AST::ArrayType>(*symbols->at(name).type)) continue;
+            candidates.insert(name);
+            values.insert(name);
+        }
+    }
+
+    void SSAConstruction::place_phis() {
+        auto &blocks = cfg->blocks;
+        Liveness liveness(*cfg);
+
+        // ordered, so phis are always placed in the same order
+        std::map<std::string, std::vector<int> > definitions;
+        for (int block: cfg->reverse_postorder()) {
+            for (const auto &instruction: blocks[block].instructions) {
+                auto *name = defined_variable(instruction);
+                if (!name || !candidates.contains(*name)) continue;
+                auto &sites = definitions[*name];
+                if (sites.empty() || sites.back() != block) {
+                    sites.push_back(block);
+                }
+            }
+        }
+
+        phi_variables.assign(blocks.size(), {});
+        // stamps instead of clearing per variable sets
+        std::vector<int> visited(blocks.size(), -1);
+        std::vector<int> queued(blocks.size(), -1);
+        int stamp = 0;
+        for (auto &[name, sites]: definitions) {
+            int index = liveness.index_of(name);
+            std::vector<int> worklist = sites;
+            for (int site: sites) {
+                queued[site] = stamp;
+            }
+            while (!worklist.empty()) {
+                int block = worklist.back();
+                worklist.pop_back();
+                for (int join: blocks[block].frontier) {
+                    if (visited[join] == stamp) continue;
+                    visited[join] = stamp;
+                    // pruned: a phi for a value that is dead at the join would only be removed again
+                    if (!liveness.live_in[join].test(index)) continue;
+                    phi_variables[join].push_back(name);
+                    if (queued[join] != stamp) {
+                        queued[join] = stamp;
+                        worklist.push_back(join);
+                    }
+                }
+            }
+            stamp++;
+        }
+
+        for (int i = 0; i < static_cast<int>(blocks.size()); i++) {
+            if (phi_variables[i].empty()) continue;
+            auto &instructions = blocks[i].instructions;
+            auto position = instructions.begin() + static_cast<std::ptrdiff_t>(phi_range(blocks[i]).first);
+            std::vector<IR::Instruction> phis;
+            for (const auto &name: phi_variables[i]) {
+                phis.emplace_back(IR::Phi(std::vector<IR::Value>(blocks[i].predecessors.size(), IR::Variable(name)),
+                                          IR::Variable(name)));
+            }
+            instructions.insert(position, std::make_move_iterator(phis.begin()), std::make_move_iterator(phis.end()));
+        }
+    }
+
+    void SSAConstruction::rename() {
+        auto &blocks = cfg->blocks;
+        std::unordered_map<std::string, std::vector<std::string> > stacks;
+        auto current = [&](const std::string &name) -> const std::string & {
+            auto it = stacks.find(name);
+            return it == stacks.end() || it->second.empty() ? name : it->second.back();
+        };
+
+        // iterative walk of the dominator tree, every block pops the versions it pushed when it is left
+        struct Frame {
+            int block;
+            std::size_t next_child;
+            std::vector<std::string> pushed;
+        };
+        std::vector<Frame> stack;
+        auto enter = [&](int block) {
+            Frame frame{block, 0, {}};
+            for (auto &instruction: blocks[block].instructions) {
+                if (!std::holds_alternative<IR::Phi>(instruction)) {
+                    for_each_use(instruction, [&](IR::Value &value) {
+                        auto *variable = std::get_if<IR::Variable>(&value);
+                        if (variable && candidates.contains(variable->name)) {
+                            variable->name = current(variable->name);
+                        }
+                    });
+                }
+                auto *name = defined_variable(instruction);
+                if (name && candidates.contains(*name)) {
+                    auto version = new_version(*name);
+                    stacks[*name].push_back(version);
+                    frame.pushed.push_back(*name);
+                    *name = std::move(version);
+                }
+            }
+            for (int successor: blocks[block].successors) {
+                const auto &predecessors = blocks[successor].predecessors;
+                auto argument = std::ranges::find(predecessors, block) - predecessors.begin();
+                auto first = phi_range(blocks[successor]).first;
+                for (std::size_t k = 0; k < phi_variables[successor].size(); k++) {
+                    auto &phi = std::get<IR::Phi>(blocks[successor].instructions[first + k]);
+                    phi.arguments[argument] = IR::Variable(current(phi_variables[successor][k]));
+                }
+            }
+            stack.push_back(std::move(frame));
+        };
+
+        if (blocks.empty()) return;
+        enter(CFG::entry);
+        while (!stack.empty()) {
+            auto &frame = stack.back();
+            const auto &dominated = blocks[frame.block].dominated;
+            if (frame.next_child < dominated.size()) {
+                enter(dominated[frame.next_child++]);
+                continue;
+            }
+            for (const auto &name: frame.pushed) {
+                stacks[name].pop_back();
+            }
+            stack.pop_back();
+        }
+    }
+
+    std::string SSAConstruction::new_version(const std::string &name) {
+        auto version = name + "." + std::to_string(versions[name]++);
+        auto type = symbols->at(name).type;
+        (*symbols)[version] = Symbol{std::move(type), LocalAttributes{}};
+        values.insert(version);
+        return version;
+    }
+
+    void SSADestruction::run() {
+        auto &blocks = cfg->blocks;
+        // copies for the fall through edge of a conditional jump go into a block of their own right after it
+        std::vector<std::vector<IR::Instruction> > fall_through_copies(blocks.size());
+        std::vector<BasicBlock> edge_blocks;
+
+        // only needed once a taken edge has copies
+        std::optional<Liveness> liveness;
+        // the copies may run before the conditional jump when the other edge reads none of the phis they write, and
+        // neither does the jump
+        auto copies_fit_before_jump = [&](int predecessor, int target, const ParallelCopy &copies) {
+            const auto &successors = blocks[predecessor].successors;
+            if (std::ranges::count(successors, target) != 1 || successors.size() != 2) return false;
+            int other = successors[0] == target ? successors[1] : successors[0];
+            if (!liveness) liveness.emplace(*cfg);
+            bool read_by_jump = false;
+            for_each_use(blocks[predecessor].instructions.back(), [&](const IR::Value &value) {
+                read_by_jump |= std::ranges::any_of(copies, [&](const auto &copy) {
+                    return is_variable(value, copy.first);
+                });
+            });
+            return !read_by_jump && std::ranges::none_of(copies, [&](const auto &copy) {
+                int index = liveness->index_of(copy.first);
+                return index != -1 && liveness->live_in[other].test(index);
+            });
+        };
+
+        for (int i = 0; i < static_cast<int>(blocks.size()); i++) {
+            auto [first, last] = phi_range(blocks[i]);
+            if (first == last) continue;
+            const auto &predecessors = blocks[i].predecessors;
+            for (std::size_t j = 0; j < predecessors.size(); j++) {
+                int predecessor = predecessors[j];
+                if (!blocks[predecessor].reachable) continue;
+                ParallelCopy copies;
+                for (auto k = first; k < last; k++) {
+                    const auto &phi = std::get<IR::Phi>(blocks[i].instructions[k]);
+                    copies.emplace_back(std::get<IR::Variable>(phi.destination).name, phi.arguments[j]);
+                }
+
+                auto &instructions = blocks[predecessor].instructions;
+                auto *terminator = instructions.empty() ? nullptr : &instructions.back();
+                if (terminator && std::holds_alternative<IR::Jump>(*terminator)) {
+                    std::vector<IR::Instruction> sequence;
+                    sequentialize(std::move(copies), sequence);
+                    instructions.insert(instructions.end() - 1, std::make_move_iterator(sequence.begin()),
+                                        std::make_move_iterator(sequence.end()));
+                } else if (terminator && jump_target(*terminator)) {
+                    // the copies must not run on the other edge
+                    const auto &front = blocks[i].instructions.front();
+                    auto label = std::holds_alternative<IR::Label>(front) ? std::get<IR::Label>(front).name : "";
+                    if (!label.empty() && *jump_target(*terminator) == label &&
+                        copies_fit_before_jump(predecessor, i, copies)) {
+                        // a rotated loop's back edge stays a single conditional jump into the body
+                        std::vector<IR::Instruction> sequence;
+                        sequentialize(std::move(copies), sequence);
+                        instructions.insert(instructions.end() - 1, std::make_move_iterator(sequence.begin()),
+                                            std::make_move_iterator(sequence.end()));
+                        continue;
+                    }
+                    if (!label.empty() && *jump_target(*terminator) == label) {
+                        auto edge_label = label_prefix + ".phi." + std::to_string(labels++);
+                        BasicBlock edge;
+                        edge.instructions.emplace_back(IR::Label(edge_label));
+                        sequentialize(copies, edge.instructions);
+                        edge.instructions.emplace_back(IR::Jump(label));
+                        edge_blocks.push_back(std::move(edge));
+                        *jump_target(*terminator) = edge_label;
+                    }
+                    if (predecessor + 1 == i) {
+                        sequentialize(std::move(copies), fall_through_copies[predecessor]);
+                    }
+                } else if (terminator && std::holds_alternative<IR::JumpTable>(*terminator)) {
+                    // every entry for this block goes through one edge block, a table never falls through
+                    const auto &label = std::get<IR::Label>(blocks[i].instructions.front()).name;
+                    auto edge_label = label_prefix + ".phi." + std::to_string(labels++);
+                    BasicBlock edge;
+                    edge.instructions.emplace_back(IR::Label(edge_label));
+                    sequentialize(std::move(copies), edge.instructions);
+                    edge.instructions.emplace_back(IR::Jump(label));
+                    edge_blocks.push_back(std::move(edge));
+                    for (auto &target: std::get<IR::JumpTable>(*terminator).targets) {
+                        if (target == label) target = edge_label;
+                    }
+                } else {
+                    sequentialize(std::move(copies), instructions);
+                }
+            }
+        }
+
+        for (auto &block: blocks) {
+            auto [first, last] = phi_range(block);
+            block.instructions.erase(block.instructions.begin() + static_cast<std::ptrdiff_t>(first),
+                                     block.instructions.begin() + static_cast<std::ptrdiff_t>(last));
+        }
+
+        std::vector<BasicBlock> laid_out;
+        laid_out.reserve(blocks.size() + edge_blocks.size());
+        for (std::size_t i = 0; i < blocks.size(); i++) {
+            laid_out.push_back(std::move(blocks[i]));
+            if (!fall_through_copies[i].empty()) {
+                BasicBlock edge;
+                edge.instructions = std::move(fall_through_copies[i]);
+                laid_out.push_back(std::move(edge));
+            }
+        }
+        // every edge block ends with a jump, so after the last block nothing falls into them
+        std::ranges::move(edge_blocks, std::back_inserter(laid_out));
+        blocks = std::move(laid_out);
+        cfg->rebuild_edges();
+    }
+
+    void SSADestruction::sequentialize(ParallelCopy copies, std::vector<IR::Instruction> &instructions) {
+        std::erase_if(copies, [](const auto &copy) { return is_variable(copy.second, copy.first); });
+        while (!copies.empty()) {
+            // a copy can go first when no other copy still reads its destination
+            auto ready = std::ranges::find_if(copies, [&](const auto &copy) {
+                return std::ranges::none_of(copies, [&](const auto &other) {
+                    return is_variable(other.second, copy.first);
+                });
+            });
+            if (ready != copies.end()) {
+                instructions.emplace_back(IR::Copy(std::move(ready->second), IR::Variable(ready->first)));
+                copies.erase(ready);
+                continue;
+            }
+            // only cycles are left (a swap), one destination moves aside first
+            auto name = copies.front().first;
+            auto temporary = name + ".swap." + std::to_string(temporaries++);
+            auto type = symbols->at(name).type;
+            (*symbols)[temporary] = Symbol{std::move(type), LocalAttributes{}};
+            instructions.emplace_back(IR::Copy(IR::Variable(name), IR::Variable(temporary)));
+            for (auto &copy: copies) {
+                if (is_variable(copy.second, name)) {
+                    copy.second = IR::Variable(temporary);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef SSA_H
+#define SSA_H
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "CFG.h"
+#include "../IR.h"
+
+// conversion of a function's cfg into ssa form and back
+//
+// only scalar locals and temporaries whose address is never taken are renamed, statics, arrays and address taken
+// locals keep their names and are never known to hold a particular value
+
+namespace optimization {
+    class SSAConstruction {
+    public:
+        // vectors are left as they are, a new version would not be known as one
+        SSAConstruction(CFG *cfg, std::unordered_map<std::string, Symbol> *symbols,
+                        const std::unordered_set<std::string> *vectors)
+            : cfg(cfg), symbols(symbols), vectors(vectors) {
+        }
+
+        // places phis on the iterated dominance frontier of the definitions (pruned by liveness) and renames every
+        // definition, reads before any definition keep the original name, which is never written afterward
+        void run();
+
+        // names that hold a single value for the whole function: every version and the original names of renamed
+        // variables (parameters and reads of uninitialized variables)
+        std::unordered_set<std::string> values;
+
+    private:
+        void find_candidates();
+        void place_phis();
+        void rename();
+        std::string new_version(const std::string &name);
+
+        CFG *cfg;
+        std::unordered_map<std::string, Symbol> *symbols;
+        const std::unordered_set<std::string> *vectors;
+        std::unordered_set<std::string> candidates;
+        // original variable of every phi, in the order the phis appear at the start of each block
+        std::vector<std::vector<std::string> > phi_variables;
+        std::unordered_map<std::string, int> versions;
+    };
+
+    class SSADestruction {
+    public:
+        SSADestruction(CFG *cfg, std::unordered_map<std::string, Symbol> *symbols, std::string label_prefix)
+            : cfg(cfg), symbols(symbols), label_prefix(std::move(label_prefix)) {
+        }
+
+        // replaces phis with copies at the end of each predecessor, edges from blocks with two successors get a block
+        // of their own unless the copies are dead on the other edge, and the copies of one edge happen as if in
+        // parallel
+        void run();
+
+    private:
+        using ParallelCopy = std::vector<std::pair<std::string, IR::Value> >;
+
+        void sequentialize(ParallelCopy copies, std::vector<IR::Instruction> &instructions);
+
+        CFG *cfg;
+        std::unordered_map<std::string, Symbol> *symbols;
+        std::string label_prefix;
+        int labels = 0;
+        int temporaries = 0;
+    };
+
+    // [first, last) indices of the phis at the start of the block, right after its label
+    std::pair<std::size_t, std::size_t> phi_range(const BasicBlock &block);
+}
+
+#endif //SSA_H
@@ -0,0 +1,268 @@
+#include "SparseConditionalConstantPropagationPass.h"
+
+#include <algorithm>
+
+#include "ConstantFoldingPass.h"
+#include "Operands.h"
+#include "SSA.h"
+#include "../overloaded.h"
+
+namespace optimization {
+    bool SparseConditionalConstantPropagationPass::run() {
+        initialize();
+        while (!block_worklist.empty() || !value_worklist.empty()) {
+            while (!block_worklist.empty()) {
+                int block = block_worklist.back();
+                block_worklist.pop_back();
+                // a new edge only changes the phis, everything else is evaluated the first time the block is reached
+                auto [first, last] = phi_range(cfg->blocks[block]);
+                for (auto i = first; i < last; i++) {
+                    visit_instruction(block, i);
+                }
+                if (visited[block]) continue;
+                visited[block] = true;
+                for (auto i = last; i < cfg->blocks[block].instructions.size(); i++) {
+                    visit_instruction(block, i);
+                }
+                visit_terminator(block);
+            }
+            while (!value_worklist.empty()) {
+                auto name = std::move(value_worklist.back());
+                value_worklist.pop_back();
+                for (auto [block, index]: uses[name]) {
+                    if (!visited[block]) continue;
+                    visit_instruction(block, index);
+                    if (index + 1 == cfg->blocks[block].instructions.size()) {
+                        visit_terminator(block);
+                    }
+                }
+            }
+        }
+        return rewrite();
+    }
+
+    void SparseConditionalConstantPropagationPass::initialize() {
+        const auto &blocks = cfg->blocks;
+        visited.assign(blocks.size(), false);
+        executable.resize(blocks.size());
+        for (std::size_t i = 0; i < blocks.size(); i++) {
+            executable[i].assign(blocks[i].predecessors.size(), false);
+        }
+
+        // values without a definition come from outside (parameters) or are never initialized
+        for (const auto &name: *values) {
+            lattice[name] = overdefined();
+        }
+        for (int block = 0; block < static_cast<int>(blocks.size()); block++) {
+            const auto &instructions = blocks[block].instructions;
+            for (std::size_t i = 0; i < instructions.size(); i++) {
+                if (auto *name = defined_variable(instructions[i]); name && values->contains(*name)) {
+                    lattice[*name] = Lattice{};
+                }
+                for_each_use(instructions[i], [&](const IR::Value &value) {
+                    auto *variable = std::get_if<IR::Variable>(&value);
+                    if (variable && values->contains(variable->name)) {
+                        uses[variable->name].emplace_back(block, i);
+                    }
+                });
+            }
+        }
+        if (!blocks.empty()) {
+            block_worklist.push_back(CFG::entry);
+        }
+    }
+
+    SparseConditionalConstantPropagationPass::Lattice SparseConditionalConstantPropagationPass::meet(
+        const Lattice &lhs, const Lattice &rhs) {
+        if (lhs.state == Lattice::State::UNDEFINED) return rhs;
+        if (rhs.state == Lattice::State::UNDEFINED) return lhs;
+        if (lhs.state == Lattice::State::OVERDEFINED || rhs.state == Lattice::State::OVERDEFINED) {
+            return overdefined();
+        }
+        return same_constant(lhs.constant, rhs.constant) ? lhs : overdefined();
+    }
+
+    SparseConditionalConstantPropagationPass::Lattice SparseConditionalConstantPropagationPass::overdefined() {
+        return Lattice{Lattice::State::OVERDEFINED};
+    }
+
+    SparseConditionalConstantPropagationPass::Lattice SparseConditionalConstantPropagationPass::value_of(
+        const IR::Value &value) const {
+        return std::visit(overloaded{
+                              [](const IR::Constant &constant) {
+                                  return Lattice{Lattice::State::CONSTANT, constant.constant};
+                              },
+                              [this](const IR::Variable &variable) {
+                                  // statics, arrays and address taken locals can change behind our back
+                                  auto it = lattice.find(variable.name);
+                                  return it == lattice.end() ? overdefined() : it->second;
+                              }
+                          }, value);
+    }
+
+    SparseConditionalConstantPropagationPass::Lattice SparseConditionalConstantPropagationPass::convert(
+        const Lattice &value, const IR::Value &destination) const {
+        if (value.state != Lattice::State::CONSTANT) return value;
+        auto converted = convert_constant(value.constant,
+                                          *symbols->at(std::get<IR::Variable>(destination).name).type);
+        if (!converted) return overdefined();
+        return Lattice{Lattice::State::CONSTANT, *converted};
+    }
+
+    SparseConditionalConstantPropagationPass::Lattice SparseConditionalConstantPropagationPass::evaluate(
+        const IR::Instruction &instruction, int block) const {
+        auto type_of = [this](const IR::Value &destination) -> const AST::Type & {
+            return *symbols->at(std::get<IR::Variable>(destination).name).type;
+        };
+        return std::visit(overloaded{
+                              [&](const IR::Phi &phi) {
+                                  // arguments from edges that can not execute yet do not count
+                                  Lattice result;
+                                  for (std::size_t i = 0; i < phi.arguments.size(); i++) {
+                                      if (executable[block][i]) result = meet(result, value_of(phi.arguments[i]));
+                                  }
+                                  return result;
+                              },
+                              [&](const IR::Copy &ins) { return convert(value_of(ins.source), ins.destination); },
+                              [&](const IR::SignExtend &ins) {
+                                  return convert(value_of(ins.source), ins.destination);
+                              },
+                              [&](const IR::ZeroExtend &ins) {
+                                  return convert(value_of(ins.source), ins.destination);
+                              },
+                              [&](const IR::Truncate &ins) { return convert(value_of(ins.source), ins.destination); },
+                              [&](const IR::IntToDouble &ins) {
+                                  return convert(value_of(ins.source), ins.destination);
+                              },
+                              [&](const IR::UIntToDouble &ins) {
+                                  return convert(value_of(ins.source), ins.destination);
+                              },
+                              [&](const IR::DoubleToInt &ins) {
+                                  return convert(value_of(ins.source), ins.destination);
+                              },
+                              [&](const IR::DoubleToUInt &ins) {
+                                  return convert(value_of(ins.source), ins.destination);
+                              },
+                              [&](const IR::Unary &ins) {
+                                  auto source = value_of(ins.source);
+                                  if (source.state != Lattice::State::CONSTANT) return source;
+                                  auto result = evaluate_unary(ins.op, source.constant, type_of(ins.destination));
+                                  return result ? Lattice{Lattice::State::CONSTANT, *result} : overdefined();
+                              },
+                              [&](const IR::Binary &ins) {
+                                  auto lhs = value_of(ins.left_source);
+                                  auto rhs = value_of(ins.right_source);
+                                  if (lhs.state == Lattice::State::OVERDEFINED ||
+                                      rhs.state == Lattice::State::OVERDEFINED) {
+                                      return overdefined();
+                                  }
+                                  if (lhs.state == Lattice::State::UNDEFINED || rhs.state ==
+                                      Lattice::State::UNDEFINED) {
+                                      return Lattice{};
+                                  }
+                                  auto result = evaluate_binary(ins.op, lhs.constant, rhs.constant,
+                                                                type_of(ins.destination));
+                                  return result ? Lattice{Lattice::State::CONSTANT, *result} : overdefined();
+                              },
+                              // loads, calls and addresses
+                              [](const auto &) { return overdefined(); }
+                          }, instruction);
+    }
+
+    void SparseConditionalConstantPropagationPass::visit_instruction(int block, std::size_t index) {
+        const auto &instruction = cfg->blocks[block].instructions[index];
+        auto *name = defined_variable(instruction);
+        if (!name || !values->contains(*name)) return;
+        lower(*name, evaluate(instruction, block));
+    }
+
+    void SparseConditionalConstantPropagationPass::visit_terminator(int block) {
+        const auto &instructions = cfg->blocks[block].instructions;
+        auto all_successors = [&] {
+            for (int successor: cfg->blocks[block].successors) {
+                mark_edge(block, successor);
+            }
+        };
+        if (instructions.empty()) {
+            all_successors();
+            return;
+        }
+        std::visit(overloaded{
+                       [&](const IR::Jump &jump) {
+                           mark_edge(block, cfg->block_of_label(jump.target));
+                       },
+                       [](const IR::Return &) {
+                       },
+                       [&](const IR::JumpTable &table) {
+                           auto index = value_of(table.index);
+                           if (index.state == Lattice::State::UNDEFINED) return;
+                           if (index.state == Lattice::State::CONSTANT) {
+                               auto position = std::visit([](const auto &constant) {
+                                   return static_cast<std::uint64_t>(constant.value);
+                               }, index.constant);
+                               if (position < table.targets.size()) {
+                                   mark_edge(block, cfg->block_of_label(table.targets[position]));
+                                   return;
+                               }
+                           }
+                           all_successors();
+                       },
+                       [&](const auto &ins) {
+                           using T = std::decay_t<decltype(ins)>;
+                           if constexpr (std::is_same_v<T, IR::JumpIfZero> || std::is_same_v<T, IR::JumpIfNotZero>) {
+                               auto condition = value_of(ins.condition);
+                               if (condition.state == Lattice::State::UNDEFINED) return;
+                               if (condition.state == Lattice::State::OVERDEFINED) {
+                                   all_successors();
+                                   return;
+                               }
+                               bool taken = is_zero(condition.constant) == std::is_same_v<T, IR::JumpIfZero>;
+                               if (taken) {
+                                   mark_edge(block, cfg->block_of_label(ins.target));
+                               } else if (block + 1 < static_cast<int>(cfg->blocks.size())) {
+                                   mark_edge(block, block + 1);
+                               }
+                           } else {
+                               all_successors();
+                           }
+                       }
+                   }, instructions.back());
+    }
+
+    void SparseConditionalConstantPropagationPass::mark_edge(int from, int to) {
+        const auto &predecessors = cfg->blocks[to].predecessors;
+        auto index = std::ranges::find(predecessors, from) - predecessors.begin();
+        if (executable[to][index]) return;
+        executable[to][index] = true;
+        block_worklist.push_back(to);
+    }
+
+    void SparseConditionalConstantPropagationPass::lower(const std::string &name, const Lattice &value) {
+        auto &current = lattice[name];
+        if (current.state == value.state &&
+            (value.state != Lattice::State::CONSTANT || same_constant(current.constant, value.constant))) {
+            return;
+        }
+        current = value;
+        value_worklist.push_back(name);
+    }
+
+    bool SparseConditionalConstantPropagationPass::rewrite() {
+        bool changed = false;
+        for (std::size_t block = 0; block < cfg->blocks.size(); block++) {
+            if (!visited[block]) continue;
+            for (auto &instruction: cfg->blocks[block].instructions) {
+                for_each_use(instruction, [&](IR::Value &value) {
+                    auto *variable = std::get_if<IR::Variable>(&value);
+                    if (!variable) return;
+                    auto it = lattice.find(variable->name);
+                    if (it != lattice.end() && it->second.state == Lattice::State::CONSTANT) {
+                        value = IR::Constant(it->second.constant);
+                        changed = true;
+                    }
+                });
+            }
+        }
+        return changed;
+    }
+}
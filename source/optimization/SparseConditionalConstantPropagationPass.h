@@ -0,0 +1,68 @@
+#ifndef SPARSECONDITIONALCONSTANTPROPAGATIONPASS_H
+#define SPARSECONDITIONALCONSTANTPROPAGATIONPASS_H
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "CFG.h"
+#include "../IR.h"
+
+// Wegman, Zadeck "Constant Propagation with Conditional Branches" on a cfg in ssa form: values are only taken
+// from edges that can execute given the constants found so far, so constants survive branches that never go the
+// other way, then every read of a constant ssa value is replaced with the constant
+
+namespace optimization {
+    class SparseConditionalConstantPropagationPass {
+    public:
+        // values are the ssa names from SSAConstruction
+        SparseConditionalConstantPropagationPass(CFG *cfg, std::unordered_map<std::string, Symbol> *symbols,
+                                                 const std::unordered_set<std::string> *values)
+            : cfg(cfg), symbols(symbols), values(values) {
+        }
+
+        // true if any read was replaced
+        bool run();
+
+    private:
+        struct Lattice {
+            enum class State {
+                UNDEFINED,
+                CONSTANT,
+                OVERDEFINED,
+            };
+
+            State state = State::UNDEFINED;
+            AST::Const constant = AST::ConstInt(0);
+        };
+
+        static Lattice meet(const Lattice &lhs, const Lattice &rhs);
+        static Lattice overdefined();
+
+        void initialize();
+        Lattice value_of(const IR::Value &value) const;
+        Lattice evaluate(const IR::Instruction &instruction, int block) const;
+        Lattice convert(const Lattice &value, const IR::Value &destination) const;
+        void visit_instruction(int block, std::size_t index);
+        void visit_terminator(int block);
+        void mark_edge(int from, int to);
+        void lower(const std::string &name, const Lattice &value);
+        bool rewrite();
+
+        CFG *cfg;
+        std::unordered_map<std::string, Symbol> *symbols;
+        const std::unordered_set<std::string> *values;
+
+        std::unordered_map<std::string, Lattice> lattice;
+        // every instruction reading an ssa value, as block and index
+        std::unordered_map<std::string, std::vector<std::pair<int, std::size_t> > > uses;
+        std::vector<bool> visited;
+        // parallel to the predecessors of every block
+        std::vector<std::vector<bool> > executable;
+        std::vector<int> block_worklist;
+        std::vector<std::string> value_worklist;
+    };
+}
+
+#endif //SPARSECONDITIONALCONSTANTPROPAGATIONPASS_H
@@ -0,0 +1,96 @@
+#include "TailRecursionEliminationPass.h"
+
+#include <algorithm>
+
+#include "Operands.h"
+
+namespace optimization {
+    bool TailRecursionEliminationPass::run() {
+        auto &instructions = function->instructions;
+        std::unordered_map<std::string, std::size_t> labels;
+        for (std::size_t i = 0; i < instructions.size(); i++) {
+            if (auto *label = std::get_if<IR::Label>(&instructions[i])) labels[label->name] = i;
+        }
+        std::vector<bool> tail_calls(instructions.size());
+        bool found = false;
+        for (std::size_t i = 0; i < instructions.size(); i++) {
+            auto *call = std::get_if<IR::Call>(&instructions[i]);
+            if (call && call->name == function->name && is_tail_call(i, labels)) {
+                tail_calls[i] = true;
+                found = true;
+            }
+        }
+        if (!found || has_address_taken_locals()) return false;
+
+        // every argument is evaluated before the first parameter changes, they may read the old values
+        std::vector<std::string> next;
+        for (const auto &param: function->params) {
+            auto name = param + ".next";
+            (*symbols)[name] = Symbol{symbols->at(param).type, LocalAttributes{}};
+            next.push_back(std::move(name));
+        }
+        auto start = function->name + ".tail_recursion";
+        std::vector<IR::Instruction> output;
+        output.reserve(instructions.size() + 1);
+        output.emplace_back(IR::Label(start));
+        for (std::size_t i = 0; i < instructions.size(); i++) {
+            if (!tail_calls[i]) {
+                output.push_back(std::move(instructions[i]));
+                continue;
+            }
+            auto &call = std::get<IR::Call>(instructions[i]);
+            for (std::size_t j = 0; j < next.size(); j++) {
+                output.emplace_back(IR::Copy(std::move(call.arguments[j]), IR::Variable(next[j])));
+            }
+            for (std::size_t j = 0; j < next.size(); j++) {
+                output.emplace_back(IR::Copy(IR::Variable(next[j]), IR::Variable(function->params[j])));
+            }
+            output.emplace_back(IR::Jump(start));
+        }
+        instructions = std::move(output);
+        return true;
+    }
+
+    bool TailRecursionEliminationPass::has_address_taken_locals() const {
+        return std::ranges::any_of(address_taken(function->instructions), [&](const std::string &name) {
+            return is_local(name, *symbols);
+        });
+    }
+
+    bool TailRecursionEliminationPass::is_tail_call(std::size_t index,
+                                                    const std::unordered_map<std::string, std::size_t> &labels) const {
+        const auto &instructions = function->instructions;
+        const auto &call = std::get<IR::Call>(instructions[index]);
+        const std::string *result = nullptr;
+        if (auto *destination = call.destination ? std::get_if<IR::Variable>(&*call.destination) : nullptr) {
+            result = &destination->name;
+        }
+        const auto &type = std::get<AST::FunctionType>(*symbols->at(function->name).type);
+        bool returns_void = std::holds_alternative<AST::VoidType>(*type.return_type);
+        // jumps can go in circles, a tail call is never far from its return
+        auto position = index + 1;
+        for (int steps = 0; steps < 16 && position < instructions.size(); steps++) {
+            const auto &instruction = instructions[position];
+            if (std::holds_alternative<IR::Label>(instruction)) {
+                position++;
+            } else if (auto *jump = std::get_if<IR::Jump>(&instruction)) {
+                position = labels.at(jump->target) + 1;
+            } else if (auto *copy = std::get_if<IR::Copy>(&instruction)) {
+                // the copy is skipped, so its destination must not be visible anywhere but in the return
+                auto *destination = std::get_if<IR::Variable>(&copy->destination);
+                if (!result || !is_variable(copy->source, *result) || !destination ||
+                    !is_local(destination->name, *symbols)) {
+                    return false;
+                }
+                result = &destination->name;
+                position++;
+            } else if (auto *ret = std::get_if<IR::Return>(&instruction)) {
+                if (!ret->value || returns_void) return true;
+                return result && is_variable(*ret->value, *result);
+            } else {
+                return false;
+            }
+        }
+        return false;
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef TAILRECURSIONELIMINATIONPASS_H
+#define TAILRECURSIONELIMINATIONPASS_H
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../IR.h"
+
+// a function calling itself right before returning the result reassigns its parameters and jumps back to the start
+// instead, so the recursion runs in constant stack space
+
+namespace optimization {
+    class TailRecursionEliminationPass {
+    public:
+        TailRecursionEliminationPass(IR::Function *function, std::unordered_map<std::string, Symbol> *symbols)
+            : function(function), symbols(symbols) {
+        }
+
+        // true if any call was replaced
+        bool run();
+
+    private:
+        // a pointer into the frame could still be in use by the call, the frame is not reused then
+        bool has_address_taken_locals() const;
+        // the call at index returns straight into a return, possibly through copies of its result and jumps
+        bool is_tail_call(std::size_t index, const std::unordered_map<std::string, std::size_t> &labels) const;
+
+        IR::Function *function;
+        std::unordered_map<std::string, Symbol> *symbols;
+    };
+}
+
+#endif //TAILRECURSIONELIMINATIONPASS_H
@@ -0,0 +1,151 @@
+#include "UnreachableCodeEliminationPass.h"
+
+#include <unordered_set>
+
+namespace optimization {
+    namespace {
+        bool only_label(const BasicBlock &block) {
+            return block.instructions.size() == 1 && std::holds_alternative<IR::Label>(block.instructions.front());
+        }
+    }
+
+    bool UnreachableCodeEliminationPass::run() {
+        CFG cfg(std::move(function->instructions));
+        bool changed = remove_unreachable_blocks(cfg);
+        changed |= thread_jumps(cfg);
+        changed |= remove_jumps_to_next(cfg);
+        changed |= invert_branches_over_jumps(cfg);
+        changed |= remove_unused_labels(cfg);
+        function->instructions = cfg.linearize();
+        return changed;
+    }
+
+    bool UnreachableCodeEliminationPass::remove_unreachable_blocks(CFG &cfg) {
+        // the blocks stay, emptied, so block indices and the label map remain valid for the other steps
+        bool changed = false;
+        for (auto &block: cfg.blocks) {
+            if (!block.reachable && !block.instructions.empty()) {
+                block.instructions.clear();
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    bool UnreachableCodeEliminationPass::thread_jumps(CFG &cfg) {
+        bool changed = false;
+        for (auto &block: cfg.blocks) {
+            if (block.instructions.empty()) continue;
+            for_each_jump_target(block.instructions.back(), [&](std::string &target) {
+                auto final = final_target(cfg, target);
+                if (final != target) {
+                    target = std::move(final);
+                    changed = true;
+                }
+            });
+        }
+        return changed;
+    }
+
+    std::string UnreachableCodeEliminationPass::final_target(const CFG &cfg, const std::string &label) const {
+        std::string target = label;
+        // a chain can loop back on itself (for (;;);), it is never longer than the number of blocks
+        for (std::size_t steps = 0; steps < cfg.blocks.size(); steps++) {
+            int block = cfg.block_of_label(target);
+            if (block == -1) break;
+            const auto &instructions = cfg.blocks[block].instructions;
+            const std::string *next = nullptr;
+            if (instructions.size() == 2 && std::holds_alternative<IR::Jump>(instructions.back())) {
+                next = &std::get<IR::Jump>(instructions.back()).target;
+            } else if (instructions.size() == 1) {
+                int following = next_nonempty(cfg, block + 1);
+                if (following == static_cast<int>(cfg.blocks.size())) break;
+                const auto &first = cfg.blocks[following].instructions.front();
+                if (!std::holds_alternative<IR::Label>(first)) break;
+                next = &std::get<IR::Label>(first).name;
+            }
+            if (!next || *next == target) break;
+            target = *next;
+        }
+        return target;
+    }
+
+    bool UnreachableCodeEliminationPass::remove_jumps_to_next(CFG &cfg) {
+        bool changed = false;
+        for (int i = 0; i < static_cast<int>(cfg.blocks.size()); i++) {
+            auto &instructions = cfg.blocks[i].instructions;
+            if (instructions.empty()) continue;
+            auto *target = jump_target(instructions.back());
+            if (!target) continue;
+            if (falls_through_to(cfg, i, cfg.block_of_label(*target))) {
+                instructions.pop_back();
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    bool UnreachableCodeEliminationPass::invert_branches_over_jumps(CFG &cfg) {
+        // jmpz c L1; jmp L2; L1: -> jmpnz c L2; L1:
+        bool changed = false;
+        for (int i = 0; i < static_cast<int>(cfg.blocks.size()); i++) {
+            auto &instructions = cfg.blocks[i].instructions;
+            if (instructions.empty()) continue;
+            auto &branch = instructions.back();
+            if (!std::holds_alternative<IR::JumpIfZero>(branch) && !std::holds_alternative<IR::JumpIfNotZero>(branch)) {
+                continue;
+            }
+            int next = next_nonempty(cfg, i + 1);
+            if (next == static_cast<int>(cfg.blocks.size())) continue;
+            auto &skipped = cfg.blocks[next].instructions;
+            if (skipped.size() != 1 || !std::holds_alternative<IR::Jump>(skipped.front())) continue;
+            if (!falls_through_to(cfg, next, cfg.block_of_label(*jump_target(branch)))) continue;
+
+            auto target = std::get<IR::Jump>(skipped.front()).target;
+            if (auto *jump = std::get_if<IR::JumpIfZero>(&branch)) {
+                branch = IR::JumpIfNotZero(std::move(jump->condition), std::move(target));
+            } else {
+                auto &jump_if = std::get<IR::JumpIfNotZero>(branch);
+                branch = IR::JumpIfZero(std::move(jump_if.condition), std::move(target));
+            }
+            skipped.clear();
+            changed = true;
+        }
+        return changed;
+    }
+
+    bool UnreachableCodeEliminationPass::falls_through_to(const CFG &cfg, int block, int target_block) const {
+        int next = next_nonempty(cfg, block + 1);
+        while (next < target_block && only_label(cfg.blocks[next])) {
+            next = next_nonempty(cfg, next + 1);
+        }
+        return next == target_block;
+    }
+
+    bool UnreachableCodeEliminationPass::remove_unused_labels(CFG &cfg) {
+        std::unordered_set<std::string> targets;
+        for (const auto &block: cfg.blocks) {
+            if (block.instructions.empty()) continue;
+            for_each_jump_target(block.instructions.back(), [&](const std::string &target) {
+                targets.insert(target);
+            });
+        }
+        bool changed = false;
+        for (auto &block: cfg.blocks) {
+            auto &instructions = block.instructions;
+            if (!instructions.empty() && std::holds_alternative<IR::Label>(instructions.front()) &&
+                !targets.contains(std::get<IR::Label>(instructions.front()).name)) {
+                instructions.erase(instructions.begin());
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    int UnreachableCodeEliminationPass::next_nonempty(const CFG &cfg, int block) const {
+        while (block < static_cast<int>(cfg.blocks.size()) && cfg.blocks[block].instructions.empty()) {
+            block++;
+        }
+        return block;
+    }
+}
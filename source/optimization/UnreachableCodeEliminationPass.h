@@ -0,0 +1,39 @@
+#ifndef UNREACHABLECODEELIMINATIONPASS_H
+#define UNREACHABLECODEELIMINATIONPASS_H
+
+#include "CFG.h"
+#include "../IR.h"
+
+// removes blocks control never reaches and the jumps and labels the generator leaves behind:
+// jumps to jumps are threaded to their final target, jumps to the code that follows anyway are dropped,
+// a conditional jump over an unconditional one becomes the inverted conditional jump and labels no jump refers to
+// go away
+
+namespace optimization {
+    class UnreachableCodeEliminationPass {
+    public:
+        explicit UnreachableCodeEliminationPass(IR::Function *function) : function(function) {
+        }
+
+        // true if anything was removed or retargeted
+        bool run();
+
+    private:
+        bool remove_unreachable_blocks(CFG &cfg);
+        bool thread_jumps(CFG &cfg);
+        bool remove_jumps_to_next(CFG &cfg);
+        bool invert_branches_over_jumps(CFG &cfg);
+        bool remove_unused_labels(CFG &cfg);
+
+        // where a jump to the label ends up after passing through blocks that only jump or fall through
+        std::string final_target(const CFG &cfg, const std::string &label) const;
+        // true if falling through from the end of block gets to target_block, only labels are in between
+        bool falls_through_to(const CFG &cfg, int block, int target_block) const;
+        // first non-empty block at or after the given one, blocks.size() if there is none
+        int next_nonempty(const CFG &cfg, int block) const;
+
+        IR::Function *function;
+    };
+}
+
+#endif //UNREACHABLECODEELIMINATIONPASS_H
@@ -0,0 +1,64 @@
+/* Division and remainder by constants turn into multiplies and shifts, which have to round towards zero for
+   negative dividends and divisors and must not overflow on INT_MIN and LONG_MIN */
+static int check_int(int x) {
+    if (x / 3 * 3 + x % 3 != x) return 1;
+    if (x / -3 * -3 + x % -3 != x) return 2;
+    if (x / 7 * 7 + x % 7 != x) return 3;
+    if (x / -7 * -7 + x % -7 != x) return 4;
+    if (x / 8 * 8 + x % 8 != x) return 5;
+    if (x / -8 * -8 + x % -8 != x) return 6;
+    if (x / 1 != x || x % 1 != 0) return 7;
+    if (x / 2147483647 * 2147483647 + x % 2147483647 != x) return 8;
+    if ((x % 3 < 0) != (x < 0 && x % 3 != 0)) return 9;
+    if ((x % -3 < 0) != (x < 0 && x % -3 != 0)) return 10;
+    return 0;
+}
+
+static int check_long(long x) {
+    if (x / 10l * 10l + x % 10l != x) return 11;
+    if (x / -10l * -10l + x % -10l != x) return 12;
+    if (x / 16l * 16l + x % 16l != x) return 13;
+    if (x / -16l * -16l + x % -16l != x) return 14;
+    if (x / 4294967296l * 4294967296l + x % 4294967296l != x) return 15;
+    if (x / 9223372036854775807l * 9223372036854775807l + x % 9223372036854775807l != x) return 16;
+    return 0;
+}
+
+static int check_uint(unsigned int x) {
+    if (x / 3u * 3u + x % 3u != x) return 17;
+    if (x / 7u * 7u + x % 7u != x) return 18;
+    if (x / 2147483648u * 2147483648u + x % 2147483648u != x) return 19;
+    if (x / 4294967295u * 4294967295u + x % 4294967295u != x) return 20;
+    return 0;
+}
+
+int main(void) {
+    int i;
+    int min = -2147483647 - 1;
+    long long_min = -9223372036854775807l - 1l;
+    int int_values[8] = {0, 1, -1, 7, -7, 2147483647, -2147483647, min};
+    long long_values[6] = {0l, 5l, -5l, 9223372036854775807l, -9223372036854775807l, long_min};
+    unsigned int uint_values[4] = {0u, 6u, 2147483648u, 4294967295u};
+    for (i = 0; i < 8; i = i + 1) {
+        int result = check_int(int_values[i]);
+        if (result) return result;
+    }
+    for (i = 0; i < 6; i = i + 1) {
+        int result = check_long(long_values[i]);
+        if (result) return result;
+    }
+    for (i = 0; i < 4; i = i + 1) {
+        int result = check_uint(uint_values[i]);
+        if (result) return result;
+    }
+    if (min / 2 != -1073741824 || min % 2 != 0) return 21;
+    if (min / -2 != 1073741824 || min % -2 != 0) return 22;
+    if (min / 3 != -715827882 || min % 3 != -2) return 23;
+    if (min / -3 != 715827882 || min % -3 != -2) return 24;
+    if (min / 2147483647 != -1 || min % 2147483647 != -1) return 25;
+    if (-7 / 2 != -3 || -7 % 2 != -1 || 7 / -2 != -3 || 7 % -2 != 1) return 26;
+    if (long_min / 10l != -922337203685477580l || long_min % 10l != -8l) return 27;
+    if (long_min / -7l != 1317624576693539401l || long_min % -7l != -1l) return 28;
+    if (2147483648u / 3u != 715827882u || 4294967295u / 7u != 613566756u) return 29;
+    return 0;
+}
@@ -0,0 +1,101 @@
+/* Array indexing in loops becomes pointers stepping along with the counter, and tests of the counter become
+   pointer comparisons, both inside the body and for the exit. A test may only be rewritten when the counter
+   and the pointer cannot wrap around differently, which an unsigned counter below zero does */
+static int unsigned_below_zero(int *p) {
+    int c = 0;
+    unsigned long i;
+    int *q = p;
+    for (i = 0; i < 1000; i = i + 1) {
+        if (i - 1 < 5) c = c + 1;
+        *q = 1;
+        q = q + 1;
+    }
+    return c;
+}
+
+static long unsigned_index(long *values, unsigned long n) {
+    long total = 0l;
+    unsigned long i;
+    for (i = 0; i < n; i = i + 1) total = total + values[i] * (long)(i + 1);
+    return total;
+}
+
+/* the counter tested is offset from the one that indexes */
+static int offset_counters(int *values) {
+    int total = 0;
+    int i;
+    for (i = 0; i + 2 < 40; i = i + 1) total = total + values[i + 2] - values[i];
+    return total;
+}
+
+/* tests of the counter inside the body, against bounds on both sides of where the loop starts */
+static int body_tests(int *values) {
+    int total = 0;
+    int i;
+    for (i = 3; i < 40; i = i + 1) {
+        if (i < 10) total = total + values[i];
+        if (i - 5 >= 20) total = total - values[i];
+        if (i == 17) total = total * 2;
+        if (i + 1 != 30) total = total + 1;
+    }
+    return total;
+}
+
+/* an explicit pointer phi next to the counter, like the ones an earlier run leaves behind */
+static long pointer_and_counter(long *values) {
+    long total = 0l;
+    long *p = values + 1;
+    int i;
+    for (i = 1; i < 39; i = i + 2) {
+        total = total + *p * i;
+        p = p + 2;
+    }
+    return total;
+}
+
+/* two counters with the same start and step, one of them unsigned */
+static unsigned long merged_counters(unsigned long *values) {
+    unsigned long total = 0ul;
+    unsigned long j = 0ul;
+    long i;
+    for (i = 0; i < 40; i = i + 1) {
+        total = total + values[i] * values[j];
+        j = j + 1ul;
+    }
+    return total;
+}
+
+int main(void) {
+    int ints[1000];
+    int values[40];
+    long longs[40];
+    unsigned long unsigned_longs[40];
+    int i;
+    int expected = 0;
+    long long_expected = 0l;
+    unsigned long unsigned_expected = 0ul;
+    if (unsigned_below_zero(ints) != 5) return 1;
+    for (i = 0; i < 40; i = i + 1) {
+        values[i] = i * i - 3 * i;
+        longs[i] = 1000l - i * 7l;
+        unsigned_longs[i] = i * 3ul + 1ul;
+    }
+    for (i = 0; i < 40; i = i + 1) long_expected = long_expected + longs[i] * (i + 1);
+    if (unsigned_index(longs, 40ul) != long_expected || unsigned_index(longs, 0ul) != 0l) return 2;
+    for (i = 0; i + 2 < 40; i = i + 1) expected = expected + values[i + 2] - values[i];
+    if (offset_counters(values) != expected) return 3;
+    expected = 0;
+    for (i = 3; i < 40; i = i + 1) {
+        if (i < 10) expected = expected + values[i];
+        if (i >= 25) expected = expected - values[i];
+        if (i == 17) expected = expected * 2;
+        if (i != 29) expected = expected + 1;
+    }
+    if (body_tests(values) != expected) return 4;
+    long_expected = 0l;
+    for (i = 1; i < 39; i = i + 2) long_expected = long_expected + longs[i] * i;
+    if (pointer_and_counter(longs) != long_expected) return 5;
+    for (i = 0; i < 40; i = i + 1) unsigned_expected = unsigned_expected + unsigned_longs[i] * unsigned_longs[i];
+    if (merged_counters(unsigned_longs) != unsigned_expected) return 6;
+    return 0;
+}
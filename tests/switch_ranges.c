@@ -0,0 +1,110 @@
+/* Dense switches become jump tables and sparse ones binary searches, both have to handle labels at the
+   very ends of the int range without the case index overflowing. Case values have to be literals, so negative
+   labels are written as unsigned ones that convert to them */
+static int dense(int x) {
+    switch (x) {
+        case 0: return 10;
+        case 1: return 11;
+        case 2: return 12;
+        case 3: return 13;
+        case 5: return 15;
+        case 6: return 16;
+        case 7: return 17;
+        default: return -1;
+    }
+}
+
+static int sparse(int x) {
+    switch (x) {
+        case 4293967296u: return 1;
+        case 4294967289u: return 2;
+        case 0: return 3;
+        case 13: return 4;
+        case 4096: return 5;
+        case 99999: return 6;
+        case 2000000000: return 7;
+        default: return 0;
+    }
+}
+
+static int extremes(int x) {
+    switch (x) {
+        case 2147483648u: return 1;
+        case 2147483649u: return 2;
+        case 2147483646: return 3;
+        case 2147483647: return 4;
+        default: return 0;
+    }
+}
+
+/* a dense run right below INT_MAX */
+static int top(int x) {
+    switch (x) {
+        case 2147483640: return 1;
+        case 2147483641: return 2;
+        case 2147483642: return 3;
+        case 2147483643: return 4;
+        case 2147483644: return 5;
+        case 2147483645: return 6;
+        case 2147483647: return 8;
+        default: return 0;
+    }
+}
+
+/* a dense run right above INT_MIN */
+static int bottom(int x) {
+    switch (x) {
+        case 2147483648u: return 1;
+        case 2147483649u: return 2;
+        case 2147483650u: return 3;
+        case 2147483651u: return 4;
+        case 2147483652u: return 5;
+        case 2147483654u: return 7;
+        default: return 0;
+    }
+}
+
+static int fall_through(unsigned int x) {
+    int total = 0;
+    switch (x) {
+        case 4294967295u: total += 1;
+        case 1u: total += 2;
+        case 2u: total += 4;
+            break;
+        case 3u: total += 8;
+        default: total += 16;
+    }
+    return total;
+}
+
+static long wide(long x) {
+    switch (x) {
+        case 9223372036854775808ul: return 1;
+        case 0l: return 2;
+        case 4294967296l: return 3;
+        case 9223372036854775807l: return 4;
+        default: return 0;
+    }
+}
+
+int main(void) {
+    int i;
+    for (i = -2; i < 10; i = i + 1) {
+        int expected = (i < 0 || i == 4 || i > 7) ? -1 : 10 + i;
+        if (dense(i) != expected) return 1;
+    }
+    if (sparse(-1000000) != 1 || sparse(-7) != 2 || sparse(0) != 3 || sparse(13) != 4) return 2;
+    if (sparse(4096) != 5 || sparse(99999) != 6 || sparse(2000000000) != 7) return 3;
+    if (sparse(-6) != 0 || sparse(14) != 0 || sparse(2000000001) != 0 || sparse(-2147483647 - 1) != 0) return 4;
+    if (extremes(-2147483647 - 1) != 1 || extremes(-2147483647) != 2) return 5;
+    if (extremes(2147483646) != 3 || extremes(2147483647) != 4 || extremes(0) != 0) return 6;
+    if (top(2147483640) != 1 || top(2147483645) != 6 || top(2147483646) != 0 || top(2147483647) != 8) return 7;
+    if (top(2147483639) != 0 || top(-2147483647 - 1) != 0 || top(0) != 0) return 8;
+    if (bottom(-2147483647 - 1) != 1 || bottom(-2147483644) != 5 || bottom(-2147483643) != 0) return 9;
+    if (bottom(-2147483642) != 7 || bottom(-2147483641) != 0 || bottom(2147483647) != 0) return 10;
+    if (fall_through(4294967295u) != 7 || fall_through(1u) != 6 || fall_through(2u) != 4) return 11;
+    if (fall_through(3u) != 24 || fall_through(0u) != 16 || fall_through(2147483648u) != 16) return 12;
+    if (wide(-9223372036854775807l - 1) != 1 || wide(0l) != 2 || wide(4294967296l) != 3) return 13;
+    if (wide(9223372036854775807l) != 4 || wide(1l) != 0 || wide(-1l) != 0) return 14;
+    return 0;
+}
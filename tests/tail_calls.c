@@ -0,0 +1,70 @@
+/* Tail calls reuse the caller's frame and self recursion becomes a loop, neither may happen while the frame
+   still holds something the callee can see: stack arguments, or locals whose address was taken */
+static long sum_eight(long a, long b, long c, long d, long e, long f, long g, long h) {
+    return a + b * 2 + c * 3 + d * 4 + e * 5 + f * 6 + g * 7 + h * 8;
+}
+
+/* the callee takes more stack arguments than the caller has */
+static long more_stack_arguments(long a, long b) {
+    return sum_eight(a, b, a, b, a, b, a, b);
+}
+
+/* arguments swap places on every step, including the ones passed on the stack */
+static long rotate(long n, long a, long b, long c, long d, long e, long f, long g) {
+    if (n == 0) return sum_eight(a, b, c, d, e, f, g, 0l);
+    return rotate(n - 1, g, a, b, c, d, e, f);
+}
+
+static int read_through(int *pointer, int depth) {
+    if (depth == 0) return *pointer;
+    return read_through(pointer, depth - 1);
+}
+
+/* the callee reads a local of the caller through a pointer */
+static int address_taken(int value) {
+    int local = value * 3;
+    return read_through(&local, 4);
+}
+
+/* a recursive call that gets a pointer to the current frame's local */
+static int chain(int n, int *previous) {
+    int local = n + *previous;
+    if (n == 0) return local;
+    return chain(n - 1, &local);
+}
+
+static long accumulate(int n, long total) {
+    if (n == 0) return total;
+    return accumulate(n - 1, total + n);
+}
+
+static double halve(double x, int n) {
+    if (n == 0) return x;
+    return halve(x / 2.0, n - 1);
+}
+
+static int is_even(unsigned int n);
+
+static int is_odd(unsigned int n) {
+    if (n == 0u) return 0;
+    return is_even(n - 1u);
+}
+
+static int is_even(unsigned int n) {
+    if (n == 0u) return 1;
+    return is_odd(n - 1u);
+}
+
+int main(void) {
+    int start = 1;
+    if (more_stack_arguments(1l, 2l) != 1l * 16l + 2l * 20l) return 1;
+    if (rotate(0l, 1l, 2l, 3l, 4l, 5l, 6l, 7l) != 140l) return 2;
+    if (rotate(7l, 1l, 2l, 3l, 4l, 5l, 6l, 7l) != 140l) return 3;
+    if (rotate(3l, 1l, 2l, 3l, 4l, 5l, 6l, 7l) != 5l + 12l + 21l + 4l + 10l + 18l + 28l) return 4;
+    if (address_taken(5) != 15) return 5;
+    if (chain(10, &start) != 56) return 6;
+    if (accumulate(100000, 0l) != 5000050000l) return 7;
+    if (halve(1024.0, 10) != 1.0) return 8;
+    if (!is_even(100000u) || is_odd(100000u) || !is_odd(99999u)) return 9;
+    return 0;
+}
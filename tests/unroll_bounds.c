@@ -0,0 +1,91 @@
+/* Unrolled loops run the remainder iterations separately, the trip count must not overflow when the bound
+   sits right at the end of the counter's range, nor for unsigned counters. The last step always stays in
+   range, an overflowing signed counter would be undefined */
+static int int_near_max(int start) {
+    int count = 0;
+    int i;
+    for (i = start; i < 2147483647; i = i + 1) count = count + 1;
+    return count;
+}
+
+static int int_up_to_max(int start) {
+    int count = 0;
+    int i;
+    for (i = start; i <= 2147483644; i = i + 3) count = count + 1;
+    return count;
+}
+
+static int int_down_to_min(int start) {
+    int count = 0;
+    int i;
+    for (i = start; i > -2147483647; i = i - 2) count = count + 1;
+    return count;
+}
+
+static long long_near_max(long start) {
+    long count = 0l;
+    long i;
+    for (i = start; i < 9223372036854775807l; i = i + 1l) count = count + i % 3l;
+    return count;
+}
+
+static long long_strided(long start) {
+    long count = 0l;
+    long i;
+    for (i = start; i < 9223372036854775807l - 5l; i = i + 4l) count = count + 1l;
+    return count;
+}
+
+static unsigned int unsigned_up(unsigned int start, unsigned int end) {
+    unsigned int count = 0u;
+    unsigned int i;
+    for (i = start; i < end; i = i + 1u) count = count + i;
+    return count;
+}
+
+static unsigned int unsigned_down(unsigned int start) {
+    unsigned int count = 0u;
+    unsigned int i;
+    for (i = start; i > 0u; i = i - 1u) count = count + 1u;
+    return count;
+}
+
+static unsigned long unsigned_long_near_max(unsigned long start) {
+    unsigned long count = 0ul;
+    unsigned long i;
+    for (i = start; i < 18446744073709551615ul; i = i + 1ul) count = count + 1ul;
+    return count;
+}
+
+static int remainder_sum(int *values, int n) {
+    int total = 0;
+    int i;
+    for (i = 0; i < n; i = i + 1) total = total + values[i] * (i + 1);
+    return total;
+}
+
+int main(void) {
+    int values[11] = {3, 1, 4, 1, 5, 9, 2, 6, 5, 3, 5};
+    int n;
+    if (int_near_max(2147483647) != 0 || int_near_max(2147483640) != 7) return 1;
+    if (int_near_max(2147483646) != 1 || int_near_max(2147483637) != 10) return 2;
+    if (int_up_to_max(2147483640) != 2 || int_up_to_max(2147483644) != 1 || int_up_to_max(2147483645) != 0) return 3;
+    if (int_down_to_min(-2147483640) != 4 || int_down_to_min(-2147483646) != 1) return 4;
+    if (int_down_to_min(-2147483647) != 0) return 5;
+    if (long_near_max(9223372036854775800l) != 6l || long_near_max(9223372036854775807l) != 0l) return 6;
+    if (long_strided(9223372036854775780l) != 6l || long_strided(9223372036854775801l) != 1l) return 7;
+    if (long_strided(9223372036854775802l) != 0l) return 8;
+    if (unsigned_up(4294967290u, 4294967295u) != 4294967276u || unsigned_up(5u, 3u) != 0u) return 9;
+    if (unsigned_up(0u, 10u) != 45u || unsigned_up(4294967294u, 4294967295u) != 4294967294u) return 10;
+    if (unsigned_down(7u) != 7u || unsigned_down(0u) != 0u || unsigned_down(1u) != 1u) return 11;
+    if (unsigned_long_near_max(18446744073709551610ul) != 5ul) return 12;
+    if (unsigned_long_near_max(18446744073709551615ul) != 0ul) return 13;
+    for (n = 0; n <= 11; n = n + 1) {
+        int expected = 0;
+        int i;
+        for (i = 0; i < n; i = i + 1) expected = expected + values[i] * (i + 1);
+        if (remainder_sum(values, n) != expected) return 14;
+    }
+    if (remainder_sum(values, 11) != 292) return 15;
+    return 0;
+}
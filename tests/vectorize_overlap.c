@@ -0,0 +1,108 @@
+/* Vectorized loops have to keep the scalar result when arrays overlap by less than a vector, and the
+   iterations left over after the last full vector run as scalar code */
+static void add_arrays(int *destination, int *left, int *right, int n) {
+    int i;
+    for (i = 0; i < n; i = i + 1) destination[i] = left[i] + right[i];
+}
+
+static void scale(long *destination, long *source, long factor, int n) {
+    int i;
+    for (i = 0; i < n; i = i + 1) destination[i] = source[i] * factor;
+}
+
+static void halve(double *destination, double *source, int n) {
+    int i;
+    for (i = 0; i < n; i = i + 1) destination[i] = source[i] * 0.5;
+}
+
+static int dot(int *left, int *right, int n) {
+    int total = 0;
+    int i;
+    for (i = 0; i < n; i = i + 1) total = total + left[i] * right[i];
+    return total;
+}
+
+static void fill(int *values, int n) {
+    int i;
+    for (i = 0; i < n; i = i + 1) values[i] = i * 7 % 11 - 5;
+}
+
+static int sum(int *values, int n) {
+    int total = 0;
+    int i;
+    for (i = 0; i < n; i = i + 1) total = total + values[i] * (i + 1);
+    return total;
+}
+
+static int run_shifted(int shift, int n) {
+    int values[40];
+    int expected[40];
+    int i;
+    fill(values, 40);
+    fill(expected, 40);
+    for (i = 0; i < n; i = i + 1) expected[i + shift] = expected[i] + expected[i + 3];
+    add_arrays(values + shift, values, values + 3, n);
+    for (i = 0; i < 40; i = i + 1) {
+        if (values[i] != expected[i]) return 1;
+    }
+    return 0;
+}
+
+int main(void) {
+    int values[40];
+    long longs[20];
+    double doubles[20];
+    int i;
+    int n;
+    /* every remainder of the vector length, and lengths shorter than one vector */
+    for (n = 0; n <= 13; n = n + 1) {
+        int left[13];
+        int right[13];
+        int out[13];
+        int expected;
+        fill(left, 13);
+        for (i = 0; i < 13; i = i + 1) {
+            right[i] = 100 - i;
+            out[i] = -1;
+        }
+        add_arrays(out, left, right, n);
+        for (i = 0; i < 13; i = i + 1) {
+            if (out[i] != (i < n ? left[i] + right[i] : -1)) return 1;
+        }
+        expected = 0;
+        for (i = n - 1; i >= 0; i = i - 1) expected = expected + left[i] * right[i];
+        if (dot(left, right, n) != expected) return 2;
+    }
+    /* writes land one to eight elements ahead of the reads, so later iterations read what earlier ones wrote */
+    for (i = 1; i <= 8; i = i + 1) {
+        if (run_shifted(i, 29)) return 3;
+        if (run_shifted(i, 30)) return 4;
+    }
+    /* writes in place */
+    if (run_shifted(0, 31)) return 5;
+    /* writes behind the reads */
+    fill(values, 40);
+    add_arrays(values, values + 1, values + 2, 37);
+    if (values[0] != 0 || sum(values, 40) != 130) return 6;
+    /* the same array on both sides */
+    fill(values, 40);
+    add_arrays(values, values, values, 40);
+    for (i = 0; i < 40; i = i + 1) {
+        if (values[i] != 2 * (i * 7 % 11 - 5)) return 7;
+    }
+    for (i = 0; i < 20; i = i + 1) longs[i] = i - 10;
+    scale(longs + 1, longs, 3l, 19);
+    for (i = 0; i < 20; i = i + 1) {
+        long expected = -10l;
+        int j;
+        for (j = 0; j < i; j = j + 1) expected = expected * 3l;
+        if (longs[i] != expected) return 8;
+    }
+    for (i = 0; i < 20; i = i + 1) doubles[i] = i * 4.0;
+    halve(doubles, doubles + 1, 19);
+    for (i = 0; i < 19; i = i + 1) {
+        if (doubles[i] != (i + 1) * 2.0) return 9;
+    }
+    if (doubles[19] != 76.0) return 10;
+    return 0;
+}